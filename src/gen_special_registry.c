@@ -0,0 +1,516 @@
+/*
+ * gen_special_registry.c: generator of the special-purpose address table
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or later as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Usage: gen_special_registry (header|table) CSV_FILE...
+ *
+ * Reads registries in the CSV format IANA publishes them in
+ * (https://www.iana.org/assignments/iana-ipv4-special-registry/ and
+ * https://www.iana.org/assignments/iana-ipv6-special-registry/)
+ * and writes either the header with category bit definitions
+ * or the C source with the lookup tables to stdout.
+ *
+ * Every distinct entry name becomes a category. Entries are prefixes,
+ * so they are either nested or disjoint. The address space of each protocol
+ * is cut into intervals at every prefix boundary, and every interval
+ * records the chain of prefixes that contain it, shortest first.
+ * Classifying an address then takes one binary search in a table of a few
+ * dozen intervals. Entries with a termination date are left out.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#define MAX_CATEGORIES 64
+#define MAX_ENTRIES    256
+#define MAX_FIELDS     16
+#define MAX_CHAIN      8
+
+struct entry {
+    int proto;              /* 4 or 6 */
+    uint8_t addr[16];       /* IPv4 addresses in the last four bytes */
+    int pflen;
+    int category;
+};
+
+struct interval {
+    uint8_t start[16];
+    int count;
+    int chain[MAX_CHAIN];   /* Entry indices, shortest prefix first */
+};
+
+static char* categories[MAX_CATEGORIES];
+static int category_count = 0;
+
+static struct entry entries[MAX_ENTRIES];
+static int entry_count = 0;
+
+static void fail(const char* message, const char* detail)
+{
+    fprintf(stderr, "gen_special_registry: %s%s%s\n", message, detail ? ": " : "", detail ? detail : "");
+    exit(EXIT_FAILURE);
+}
+
+/* Category identifier from an entry name: lowercase words joined with hyphens,
+   quotes and parenthesized remarks dropped, e.g.
+   "Documentation (TEST-NET-1)" becomes "documentation" */
+static int category_from_name(const char* name)
+{
+    char slug[128];
+    size_t length = 0;
+    int depth = 0;
+    int i;
+
+    for( ; *name != '\0'; name++ )
+    {
+        if( *name == '(' )
+        {
+            depth++;
+        }
+        else if( *name == ')' )
+        {
+            depth--;
+        }
+        else if( (depth == 0) && isalnum((unsigned char)*name) && (length < sizeof(slug) - 2) )
+        {
+            slug[length++] = (char)tolower((unsigned char)*name);
+        }
+        else if( (depth == 0) && (length > 0) && (slug[length-1] != '-') && (*name != '"') )
+        {
+            slug[length++] = '-';
+        }
+    }
+    while( (length > 0) && (slug[length-1] == '-') )
+    {
+        length--;
+    }
+    slug[length] = '\0';
+
+    if( length == 0 )
+    {
+        fail("empty entry name", NULL);
+    }
+
+    for( i = 0; i < category_count; i++ )
+    {
+        if( strcmp(categories[i], slug) == 0 )
+        {
+            return(i);
+        }
+    }
+
+    if( category_count == MAX_CATEGORIES )
+    {
+        fail("too many categories for a 64 bit mask", NULL);
+    }
+    categories[category_count] = strdup(slug);
+
+    return(category_count++);
+}
+
+/* Parse a single prefix, ignoring footnote references like "[2]" */
+static void add_prefix(char* text, int category)
+{
+    struct entry* entry;
+    char* slash;
+    char* end;
+    long pflen;
+
+    while( isspace((unsigned char)*text) )
+    {
+        text++;
+    }
+    end = strchr(text, '[');
+    if( end == NULL )
+    {
+        end = text + strlen(text);
+    }
+    while( (end > text) && isspace((unsigned char)end[-1]) )
+    {
+        end--;
+    }
+    *end = '\0';
+
+    slash = strchr(text, '/');
+    if( slash == NULL )
+    {
+        fail("prefix length missing", text);
+    }
+    *slash = '\0';
+    pflen = strtol(slash + 1, &end, 10);
+    if( (*end != '\0') || (pflen < 0) )
+    {
+        fail("malformed prefix length", slash + 1);
+    }
+
+    if( entry_count == MAX_ENTRIES )
+    {
+        fail("too many entries", NULL);
+    }
+    entry = &entries[entry_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->category = category;
+    entry->pflen = (int)pflen;
+
+    if( strchr(text, ':') != NULL )
+    {
+        entry->proto = 6;
+        if( (inet_pton(AF_INET6, text, entry->addr) != 1) || (pflen > 128) )
+        {
+            fail("malformed IPv6 prefix", text);
+        }
+    }
+    else
+    {
+        entry->proto = 4;
+        if( (inet_pton(AF_INET, text, &entry->addr[12]) != 1) || (pflen > 32) )
+        {
+            fail("malformed IPv4 prefix", text);
+        }
+    }
+
+    entry_count++;
+}
+
+/* Read a registry: the first record is the header, then
+   "Address Block,Name,RFC,Allocation Date,Termination Date,..."
+   Fields may be quoted and contain commas, newlines and doubled quotes. */
+static void read_registry(const char* file_name)
+{
+    FILE* file = fopen(file_name, "r");
+    char* fields[MAX_FIELDS];
+    char field[1024];
+    size_t field_length = 0;
+    int field_count = 0;
+    int in_quotes = 0;
+    int record = 0;
+    int c;
+
+    if( file == NULL )
+    {
+        fail("could not open", file_name);
+    }
+
+    do
+    {
+        c = fgetc(file);
+
+        if( in_quotes && (c != EOF) )
+        {
+            if( c == '"' )
+            {
+                int next = fgetc(file);
+                if( next == '"' )
+                {
+                    field[field_length++] = '"';
+                }
+                else
+                {
+                    in_quotes = 0;
+                    ungetc(next, file);
+                }
+            }
+            else if( field_length < sizeof(field) - 1 )
+            {
+                field[field_length++] = (char)c;
+            }
+            continue;
+        }
+
+        if( c == '"' )
+        {
+            in_quotes = 1;
+        }
+        else if( (c == ',') || (c == '\n') || (c == EOF) )
+        {
+            field[field_length] = '\0';
+            if( field_count < MAX_FIELDS )
+            {
+                fields[field_count++] = strdup(field);
+            }
+            field_length = 0;
+
+            if( (c != ',') && ((field_count > 1) || (fields[0][0] != '\0')) )
+            {
+                int i;
+
+                if( (record > 0) && (field_count >= 5) &&
+                    ((fields[4][0] == '\0') || (strcmp(fields[4], "N/A") == 0)) )
+                {
+                    int category = category_from_name(fields[1]);
+                    char* prefix = strtok(fields[0], ",");
+
+                    while( prefix != NULL )
+                    {
+                        add_prefix(prefix, category);
+                        prefix = strtok(NULL, ",");
+                    }
+                }
+                else if( (record > 0) && (field_count < 5) )
+                {
+                    fail("too few fields in a record of", file_name);
+                }
+
+                for( i = 0; i < field_count; i++ )
+                {
+                    free(fields[i]);
+                }
+                field_count = 0;
+                record++;
+            }
+            else if( c != ',' )
+            {
+                free(fields[0]);
+                field_count = 0;
+            }
+        }
+        else if( (c != '\r') && (field_length < sizeof(field) - 1) )
+        {
+            field[field_length++] = (char)c;
+        }
+    }
+    while( c != EOF );
+
+    fclose(file);
+}
+
+static int entry_contains(const struct entry* entry, const uint8_t* addr)
+{
+    int bits = (entry->proto == 4) ? 96 + entry->pflen : entry->pflen;
+    int i;
+
+    for( i = 0; i < 16; i++ )
+    {
+        int byte_bits = bits - 8 * i;
+        uint8_t mask;
+
+        if( byte_bits <= 0 )
+        {
+            break;
+        }
+        mask = (byte_bits >= 8) ? 0xFF : (uint8_t)(0xFF << (8 - byte_bits));
+        if( (entry->addr[i] & mask) != (addr[i] & mask) )
+        {
+            return(0);
+        }
+    }
+
+    return(1);
+}
+
+static int compare_addr(const void* left, const void* right)
+{
+    return memcmp(left, right, 16);
+}
+
+/* Cut the address space of a protocol into intervals at every prefix boundary */
+static int build_intervals(int proto, struct interval* intervals, int* max_chain)
+{
+    uint8_t (*bounds)[16] = calloc(2 * MAX_ENTRIES + 1, 16);
+    int bound_count = 1;    /* The first bound is the all-zeros address */
+    int interval_count = 0;
+    int i;
+    int j;
+
+    for( i = 0; i < entry_count; i++ )
+    {
+        int bits = (proto == 4) ? 96 + entries[i].pflen : entries[i].pflen;
+        uint8_t end[16];
+        int carry = 1;
+
+        if( entries[i].proto != proto )
+        {
+            continue;
+        }
+
+        memcpy(bounds[bound_count++], entries[i].addr, 16);
+
+        /* The first address after the prefix, unless it's the end of the address space */
+        for( j = 0; j < 16; j++ )
+        {
+            int byte_bits = bits - 8 * j;
+            uint8_t host_mask = (byte_bits >= 8) ? 0 : (byte_bits <= 0) ? 0xFF : (uint8_t)(0xFF >> byte_bits);
+            end[j] = entries[i].addr[j] | host_mask;
+        }
+        for( j = 15; (j >= ((proto == 4) ? 12 : 0)) && carry; j-- )
+        {
+            end[j]++;
+            carry = (end[j] == 0);
+        }
+        if( !carry )
+        {
+            memcpy(bounds[bound_count++], end, 16);
+        }
+    }
+
+    qsort(bounds, bound_count, 16, compare_addr);
+
+    for( i = 0; i < bound_count; i++ )
+    {
+        struct interval current;
+
+        if( (i > 0) && (memcmp(bounds[i], bounds[i-1], 16) == 0) )
+        {
+            continue;
+        }
+
+        memcpy(current.start, bounds[i], 16);
+        current.count = 0;
+        for( j = 0; j < entry_count; j++ )
+        {
+            if( (entries[j].proto == proto) && entry_contains(&entries[j], current.start) )
+            {
+                int k = current.count;
+
+                if( current.count == MAX_CHAIN )
+                {
+                    fail("prefixes nested too deep", NULL);
+                }
+                /* Insertion sort by prefix length */
+                while( (k > 0) && (entries[current.chain[k-1]].pflen > entries[j].pflen) )
+                {
+                    current.chain[k] = current.chain[k-1];
+                    k--;
+                }
+                current.chain[k] = j;
+                current.count++;
+            }
+        }
+
+        /* Merge with the previous interval if nothing changes at this bound */
+        if( (interval_count > 0) && (intervals[interval_count-1].count == current.count) &&
+            (memcmp(intervals[interval_count-1].chain, current.chain, current.count * sizeof(int)) == 0) )
+        {
+            continue;
+        }
+
+        if( current.count > *max_chain )
+        {
+            *max_chain = current.count;
+        }
+        intervals[interval_count++] = current;
+    }
+
+    free(bounds);
+
+    return(interval_count);
+}
+
+static void print_table(const char* name, const struct interval* intervals, int count)
+{
+    int i;
+    int j;
+
+    printf("const struct special_range %s[] = {\n", name);
+    for( i = 0; i < count; i++ )
+    {
+        printf("    { {");
+        for( j = 0; j < 16; j++ )
+        {
+            printf("%s0x%02x", (j > 0) ? "," : "", intervals[i].start[j]);
+        }
+        printf("}, %d, {", intervals[i].count);
+        for( j = 0; j < intervals[i].count; j++ )
+        {
+            const struct entry* entry = &entries[intervals[i].chain[j]];
+            printf("%s{ %d, %d }", (j > 0) ? ", " : " ", entry->pflen, entry->category);
+        }
+        if( intervals[i].count == 0 )
+        {
+            /* Empty initializer lists are not valid C99 */
+            printf(" { 0, 0 }");
+        }
+        printf(" } },\n");
+    }
+    printf("};\n");
+    printf("const size_t %s_count = %d;\n\n", name, count);
+}
+
+int main(int argc, char* argv[])
+{
+    struct interval ipv4_intervals[2 * MAX_ENTRIES + 1];
+    struct interval ipv6_intervals[2 * MAX_ENTRIES + 1];
+    int ipv4_count;
+    int ipv6_count;
+    int max_chain = 1;
+    int i;
+
+    if( (argc < 3) || ((strcmp(argv[1], "header") != 0) && (strcmp(argv[1], "table") != 0)) )
+    {
+        fprintf(stderr, "Usage: %s (header|table) CSV_FILE...\n", argv[0]);
+        return(EXIT_FAILURE);
+    }
+
+    for( i = 2; i < argc; i++ )
+    {
+        read_registry(argv[i]);
+    }
+
+    ipv4_count = build_intervals(4, ipv4_intervals, &max_chain);
+    ipv6_count = build_intervals(6, ipv6_intervals, &max_chain);
+
+    printf("/* Generated by gen_special_registry from");
+    for( i = 2; i < argc; i++ )
+    {
+        const char* base = strrchr(argv[i], '/');
+        printf(" %s", base ? base + 1 : argv[i]);
+    }
+    printf(", do not edit. */\n\n");
+
+    if( strcmp(argv[1], "header") == 0 )
+    {
+        printf("#ifndef IPADDRCHECK_SPECIAL_REGISTRY_H\n");
+        printf("#define IPADDRCHECK_SPECIAL_REGISTRY_H\n\n");
+        printf("#define SPECIAL_CATEGORY_COUNT %d\n", category_count);
+        printf("#define SPECIAL_MAX_CHAIN %d\n\n", max_chain);
+        for( i = 0; i < category_count; i++ )
+        {
+            char macro[128];
+            size_t k;
+
+            for( k = 0; categories[i][k] != '\0'; k++ )
+            {
+                macro[k] = (categories[i][k] == '-') ? '_' : (char)toupper((unsigned char)categories[i][k]);
+            }
+            macro[k] = '\0';
+            printf("#define SPECIAL_%s ((uint64_t)1 << %d)\n", macro, i);
+        }
+        printf("\n#endif /* IPADDRCHECK_SPECIAL_REGISTRY_H */\n");
+    }
+    else
+    {
+        printf("#include \"ipaddrcheck_special.h\"\n\n");
+        printf("const char* const special_category_names[SPECIAL_CATEGORY_COUNT] = {\n");
+        for( i = 0; i < category_count; i++ )
+        {
+            printf("    \"%s\",\n", categories[i]);
+        }
+        printf("};\n\n");
+        print_table("special_ranges_ipv4", ipv4_intervals, ipv4_count);
+        print_table("special_ranges_ipv6", ipv6_intervals, ipv6_count);
+    }
+
+    return(EXIT_SUCCESS);
+}
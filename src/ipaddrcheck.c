@@ -21,44 +21,73 @@
 #include <errno.h>
 #include "config.h"
 #include "ipaddrcheck_functions.h"
+#include "ipaddrcheck_actions.h"
+#include "ipaddrcheck_sort.h"
+#include "ipaddrcheck_lookup.h"
+#include "ipaddrcheck_special.h"
+#include "ipaddrcheck_blocklist.h"
+#include "ipaddrcheck_json.h"
+#include "ipaddrcheck_binary.h"
+#include "ipaddrcheck_pcap.h"
+#include "ipaddrcheck_scan.h"
+#include "ipaddrcheck_interval.h"
+#include "ipaddrcheck_enumerate.h"
+#include "ipaddrcheck_ipam.h"
+#include "ipaddrcheck_reverse.h"
+#include "ipaddrcheck_rules.h"
+#include "ipaddrcheck_csv.h"
+#include "ipaddrcheck_filter.h"
+#include "ipaddrcheck_files.h"
+#include "ipaddrcheck_stats.h"
+#include "ipaddrcheck_distinct.h"
+#include "ipaddrcheck_prefix_index.h"
+#include "ipaddrcheck_ifaddr.h"
 
-/* Option codes */
-#define IS_VALID              10
-#define IS_IPV4               20
-#define IS_IPV4_CIDR          30
-#define IS_IPV4_SINGLE        40
-#define IS_IPV4_HOST          50
-#define IS_IPV4_NET           60
-#define IS_IPV4_BROADCAST     70
-#define IS_IPV4_UNICAST       80
-#define IS_IPV4_MULTICAST     90
-#define IS_IPV4_RFC1918       100
-#define IS_IPV4_LOOPBACK      110
-#define IS_IPV4_LINKLOCAL     120
-#define IS_IPV6               130
-#define IS_IPV6_CIDR          140
-#define IS_IPV6_SINGLE        150
-#define IS_IPV6_HOST          160
-#define IS_IPV6_NET           170
-#define IS_IPV6_UNICAST       180
-#define IS_IPV6_MULTICAST     190
-#define IS_IPV6_LINKLOCAL     200
-#define IS_VALID_INTF_ADDR    220
-#define IS_ANY_CIDR           230
-#define IS_ANY_SINGLE         240
-#define ALLOW_LOOPBACK        250
-#define IS_ANY_HOST           260
-#define IS_ANY_NET            270
-
-/* XXX: These options are handled outside of the main switch
- * because they the main switch was design to handle
- * only single addresses directly parseable by libcidr.
- * Ideally, we should refactor that at some point in the future...
+/* Long-only options of the bulk modes that work on lists of addresses
+ * rather than a single address. Their codes are outside of the character range
+ * so that they cannot clash with short options.
  */
-#define IS_IPV4_RANGE         280
-#define IS_IPV6_RANGE         290
-
-#define NO_ACTION             500
+#define OPT_SORT              1000
+#define OPT_NORMALIZE         1010
+#define OPT_LOOKUP            1020
+#define OPT_CLASSIFY          1030
+#define OPT_BUILD_BLOCKLIST   1040
+#define OPT_BLOCKLIST         1050
+#define OPT_JSON              1060
+#define OPT_BINARY            1070
+#define OPT_TO_BINARY         1080
+#define OPT_PCAP              1090
+#define OPT_SCAN              1100
+#define OPT_OVERLAPS          1110
+#define OPT_HOSTS             1120
+#define OPT_SUBNETS           1130
+#define OPT_ALLOCATE          1140
+#define OPT_COUNT             1150
+#define OPT_REVERSE           1160
+#define OPT_REPORT            1170
+#define OPT_RULES             1180
+#define OPT_CSV               1190
+#define OPT_TSV               1200
+#define OPT_COLUMN            1210
+#define OPT_HEADER            1220
+#define OPT_ANNOTATE          1230
+#define OPT_FILTER            1240
+#define OPT_FILTER_INVERT     1250
+#define OPT_SCAN_FILES        1260
+#define OPT_STATS             1270
+#define OPT_TOP               1280
+#define OPT_DISTINCT          1290
+#define OPT_MERGE_SKETCHES    1300
+#define OPT_SKETCH_OUT        1310
+#define OPT_IPV4_PREFIX_LENGTH 1320
+#define OPT_IPV6_PREFIX_LENGTH 1330
+#define OPT_BUILD_PREFIX_INDEX 1340
+#define OPT_IS_IN_PREFIX_INDEX 1350
+#define OPT_VERIFY_PREFIX_INDEX 1360
+#define OPT_INTERFACE_CONFLICTS 1370
+#define OPT_INTERFACE         1380
+#define OPT_NETLINK_DUMP      1390
+#define OPT_SAVE_NETLINK_DUMP 1400
 
 static const struct option options[] =
 {
@@ -89,6 +118,47 @@ static const struct option options[] =
     { "is-ipv4-range",         no_argument, NULL, 'F' },
     { "is-ipv6-range",         no_argument, NULL, 'G' },
     { "range-prefix-length",   required_argument, NULL, 'H' },
+    { "sort",                  no_argument, NULL, OPT_SORT },
+    { "normalize",             no_argument, NULL, OPT_NORMALIZE },
+    { "lookup",                required_argument, NULL, OPT_LOOKUP },
+    { "classify",              no_argument, NULL, OPT_CLASSIFY },
+    { "build-blocklist",       required_argument, NULL, OPT_BUILD_BLOCKLIST },
+    { "blocklist",             required_argument, NULL, OPT_BLOCKLIST },
+    { "json",                  no_argument, NULL, OPT_JSON },
+    { "binary",                no_argument, NULL, OPT_BINARY },
+    { "to-binary",             no_argument, NULL, OPT_TO_BINARY },
+    { "pcap",                  required_argument, NULL, OPT_PCAP },
+    { "scan",                  no_argument, NULL, OPT_SCAN },
+    { "overlaps",              no_argument, NULL, OPT_OVERLAPS },
+    { "hosts",                 no_argument, NULL, OPT_HOSTS },
+    { "subnets",               required_argument, NULL, OPT_SUBNETS },
+    { "allocate",              required_argument, NULL, OPT_ALLOCATE },
+    { "count",                 required_argument, NULL, OPT_COUNT },
+    { "reverse",               no_argument, NULL, OPT_REVERSE },
+    { "report",                no_argument, NULL, OPT_REPORT },
+    { "rules",                 required_argument, NULL, OPT_RULES },
+    { "csv",                   no_argument, NULL, OPT_CSV },
+    { "tsv",                   no_argument, NULL, OPT_TSV },
+    { "column",                required_argument, NULL, OPT_COLUMN },
+    { "header",                no_argument, NULL, OPT_HEADER },
+    { "annotate",              no_argument, NULL, OPT_ANNOTATE },
+    { "filter",                no_argument, NULL, OPT_FILTER },
+    { "filter-invert",         no_argument, NULL, OPT_FILTER_INVERT },
+    { "scan-files",            no_argument, NULL, OPT_SCAN_FILES },
+    { "stats",                 no_argument, NULL, OPT_STATS },
+    { "top",                   required_argument, NULL, OPT_TOP },
+    { "distinct",              no_argument, NULL, OPT_DISTINCT },
+    { "merge-sketches",        no_argument, NULL, OPT_MERGE_SKETCHES },
+    { "sketch-out",            required_argument, NULL, OPT_SKETCH_OUT },
+    { "ipv4-prefix-length",    required_argument, NULL, OPT_IPV4_PREFIX_LENGTH },
+    { "ipv6-prefix-length",    required_argument, NULL, OPT_IPV6_PREFIX_LENGTH },
+    { "build-prefix-index",    required_argument, NULL, OPT_BUILD_PREFIX_INDEX },
+    { "is-in-prefix-index",    required_argument, NULL, OPT_IS_IN_PREFIX_INDEX },
+    { "verify-prefix-index",   required_argument, NULL, OPT_VERIFY_PREFIX_INDEX },
+    { "interface-conflicts",   no_argument, NULL, OPT_INTERFACE_CONFLICTS },
+    { "interface",             required_argument, NULL, OPT_INTERFACE },
+    { "netlink-dump",          required_argument, NULL, OPT_NETLINK_DUMP },
+    { "save-netlink-dump",     required_argument, NULL, OPT_SAVE_NETLINK_DUMP },
     { "version",               no_argument, NULL, 'z' },
     { "help",                  no_argument, NULL, '?' },
     { "verbose",               no_argument, NULL, 'V' },
@@ -98,6 +168,12 @@ static const struct option options[] =
 /* Auxiliary functions */
 static void print_help(const char* program_name);
 static void print_version(void);
+static FILE* open_bulk_input(int argc, char* argv[], int first_arg);
+static int collect_checks(int* actions, int action_count);
+static int collect_column_checks(int* actions, int action_count, const int* column_slots,
+                                 struct csv_column* columns, size_t column_count);
+static int bulk_exit_code(int result);
+static int parse_prefix_length(const char* str, int max_length);
 
 int main(int argc, char* argv[])
 {
@@ -121,6 +197,51 @@ int main(int argc, char* argv[])
     int ipv4_range_check = 0;
     int ipv6_range_check = 0;
 
+    /* Bulk modes read a list of addresses from a file or stdin */
+    int sort_mode = 0;
+    int normalize = SORT_ORIGINAL;
+    const char* lookup_table_name = NULL;
+    int classify_mode = 0;
+    const char* build_blocklist_name = NULL;
+    const char* blocklist_name = NULL;
+    const char* build_prefix_index_name = NULL;
+    const char* prefix_index_name = NULL;
+    struct prefix_index check_index;   /* Of --is-in-prefix-index */
+    const char* verify_prefix_index_name = NULL;
+    int interface_conflicts_mode = 0;
+    const char* interface_name = NULL;
+    const char* netlink_dump_name = NULL;
+    const char* save_netlink_dump_name = NULL;
+    int json_mode = 0;
+    const char* rules_name = NULL;
+    int binary_mode = 0;
+    int to_binary_mode = 0;
+    const char* pcap_name = NULL;
+    int scan_mode = 0;
+    int scan_files_mode = 0;
+    int stats_mode = 0;
+    long top_count = STATS_DEFAULT_TOP;
+    int distinct_mode = 0;
+    int merge_sketches_mode = 0;
+    const char* sketch_out_name = NULL;
+    int distinct_ipv4_length = 32;
+    int distinct_ipv6_length = 128;
+    int filter_select = -1;
+    int overlaps_mode = 0;
+    int reverse_mode = 0;
+    char csv_delimiter = '\0';
+    int csv_flags = 0;
+    struct csv_column* csv_columns = NULL;
+    int* csv_column_slots = NULL;   /* Position of every --column in the actions array */
+    size_t csv_column_count = 0;
+    int hosts_mode = 0;
+    int subnet_length = -1;
+    int allocate_length = -1;
+    long allocate_count = 1;
+
+    int report_mode = 0;   /* Run all checks and print the result of each one */
+    int mode_count;
+
     int verbose = 0;
 
     const char* program_name = argv[0]; /* Program name for use in messages */
@@ -240,9 +361,230 @@ int main(int argc, char* argv[])
                      fprintf(stderr, "Error: \"%s\" is not a valid prefix length\n", optarg);
                      return(RESULT_INT_ERROR);
                  }
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_SORT:
+                 sort_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_NORMALIZE:
+                 normalize = SORT_NORMALIZE;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_LOOKUP:
+                 lookup_table_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_CLASSIFY:
+                 classify_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_BUILD_BLOCKLIST:
+                 build_blocklist_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_BLOCKLIST:
+                 blocklist_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_JSON:
+                 json_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_BINARY:
+                 binary_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_TO_BINARY:
+                 to_binary_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_PCAP:
+                 pcap_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_SCAN:
+                 scan_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_SCAN_FILES:
+                 scan_files_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_STATS:
+                 stats_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_TOP:
+                 errno = 0;
+                 char* top_end = "";
+                 top_count = strtol(optarg, &top_end, 10);
+                 if( (errno != 0) || (top_end == optarg) || (*top_end != '\0') ||
+                     (top_count < 1) || (top_count > STATS_MAX_TOP) )
+                 {
+                     fprintf(stderr, "Error: \"%s\" is not a valid count\n", optarg);
+                     return(RESULT_INT_ERROR);
+                 }
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_DISTINCT:
+                 distinct_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_MERGE_SKETCHES:
+                 merge_sketches_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_SKETCH_OUT:
+                 sketch_out_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_IPV4_PREFIX_LENGTH:
+                 distinct_ipv4_length = parse_prefix_length(optarg, 32);
+                 if( distinct_ipv4_length < 0 )
+                 {
+                     return(RESULT_INT_ERROR);
+                 }
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_IPV6_PREFIX_LENGTH:
+                 distinct_ipv6_length = parse_prefix_length(optarg, 128);
+                 if( distinct_ipv6_length < 0 )
+                 {
+                     return(RESULT_INT_ERROR);
+                 }
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_BUILD_PREFIX_INDEX:
+                 build_prefix_index_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_IS_IN_PREFIX_INDEX:
+                 if( prefix_index_name != NULL )
+                 {
+                     fprintf(stderr, "Error: --is-in-prefix-index can only be used once\n");
+                     return(RESULT_INT_ERROR);
+                 }
+                 prefix_index_name = optarg;
+                 action = IS_IN_PREFIX_INDEX;
+                 break;
+             case OPT_VERIFY_PREFIX_INDEX:
+                 verify_prefix_index_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_INTERFACE_CONFLICTS:
+                 interface_conflicts_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_INTERFACE:
+                 interface_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_NETLINK_DUMP:
+                 netlink_dump_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_SAVE_NETLINK_DUMP:
+                 save_netlink_dump_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_FILTER:
+                 filter_select = FILTER_PASSING;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_FILTER_INVERT:
+                 filter_select = FILTER_FAILING;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_OVERLAPS:
+                 overlaps_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_RULES:
+                 rules_name = optarg;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_REPORT:
+                 report_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_REVERSE:
+                 reverse_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_CSV:
+                 csv_delimiter = ',';
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_TSV:
+                 csv_delimiter = '\t';
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_COLUMN:
+                 if( csv_columns == NULL )
+                 {
+                     csv_columns = calloc(argc, sizeof(struct csv_column));
+                     csv_column_slots = calloc(argc, sizeof(int));
+                     if( (csv_columns == NULL) || (csv_column_slots == NULL) )
+                     {
+                         fprintf(stderr, "Error: could not allocate memory!\n");
+                         return(RESULT_INT_ERROR);
+                     }
+                 }
+                 csv_columns[csv_column_count].name = optarg;
+                 csv_column_slots[csv_column_count++] = optind - 2;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_HEADER:
+                 csv_flags |= CSV_HEADER;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_ANNOTATE:
+                 csv_flags |= CSV_ANNOTATE;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_HOSTS:
+                 hosts_mode = 1;
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_SUBNETS:
+                 errno = 0;
+                 char* length_end = "";
+                 subnet_length = (int)strtol(optarg, &length_end, 10);
+                 if( (errno != 0) || (length_end == optarg) || (*length_end != '\0') ||
+                     (subnet_length < 0) || (subnet_length > 128) )
+                 {
+                     fprintf(stderr, "Error: \"%s\" is not a valid prefix length\n", optarg);
+                     return(RESULT_INT_ERROR);
+                 }
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_ALLOCATE:
+                 errno = 0;
+                 char* allocate_end = "";
+                 allocate_length = (int)strtol(optarg, &allocate_end, 10);
+                 if( (errno != 0) || (allocate_end == optarg) || (*allocate_end != '\0') ||
+                     (allocate_length < 0) || (allocate_length > 128) )
+                 {
+                     fprintf(stderr, "Error: \"%s\" is not a valid prefix length\n", optarg);
+                     return(RESULT_INT_ERROR);
+                 }
+                 no_action = NO_ACTION;
+                 break;
+             case OPT_COUNT:
+                 errno = 0;
+                 char* count_end = "";
+                 allocate_count = strtol(optarg, &count_end, 10);
+                 if( (errno != 0) || (count_end == optarg) || (*count_end != '\0') || (allocate_count < 1) )
+                 {
+                     fprintf(stderr, "Error: \"%s\" is not a valid count\n", optarg);
+                     return(RESULT_INT_ERROR);
+                 }
+                 no_action = NO_ACTION;
                  break;
              case 'V':
                  verbose = 1;
+                 no_action = NO_ACTION;
                  break;
              case '?':
                  print_help(program_name);
@@ -275,345 +617,924 @@ int main(int argc, char* argv[])
         return(RESULT_INT_ERROR);
     }
 
-    /* Get non-option arguments */
-    if( (argc - optind) == 1 )
+    if( (csv_delimiter == '\0') && ((csv_column_count > 0) || (csv_flags != 0)) )
     {
-         address_str = argv[optind];
+        fprintf(stderr, "Error: --column, --header and --annotate require --csv or --tsv\n");
+        return(RESULT_INT_ERROR);
     }
-    else
+
+    /* Modes are checked in a fixed order below, so only one of them can be given */
+    mode_count = sort_mode + (lookup_table_name != NULL) + classify_mode + (build_blocklist_name != NULL) +
+                 (blocklist_name != NULL) + (build_prefix_index_name != NULL) +
+                 (verify_prefix_index_name != NULL) + (interface_conflicts_mode || (save_netlink_dump_name != NULL)) +
+                 (rules_name != NULL) + (csv_delimiter != '\0') + json_mode + binary_mode + (pcap_name != NULL) +
+                 scan_mode + scan_files_mode + (filter_select >= 0) + stats_mode + distinct_mode +
+                 merge_sketches_mode + overlaps_mode + reverse_mode + to_binary_mode + hosts_mode +
+                 (subnet_length >= 0) + (allocate_length >= 0) + report_mode;
+    if( mode_count > 1 )
     {
-         fprintf(stderr, "Error: wrong number of arguments, one argument required!\n");
-         print_help(program_name);
-         return(RESULT_INT_ERROR);
+        fprintf(stderr, "Error: only one mode option, such as --sort, --filter or --json, can be used at a time\n");
+        return(RESULT_INT_ERROR);
     }
 
-    /* If the argument is a range, use special functions that can handle it. */
-    if( ipv4_range_check )
+    /* The index of --is-in-prefix-index is mapped once for all checks,
+       and stays mapped until the program exits */
+    if( prefix_index_name != NULL )
     {
-        if( range_prefix_length > 32 )
+        if( prefix_index_open(&check_index, prefix_index_name, 0) != RESULT_SUCCESS )
         {
-            fprintf(stderr, "Error: prefix length cannot exceed 32 for IPv4!\n");
             return(RESULT_INT_ERROR);
         }
+        set_check_prefix_index(&check_index);
+    }
 
-        int result = is_ipv4_range(address_str, range_prefix_length, verbose);
-        if( result == RESULT_SUCCESS )
+    /* Bulk modes take an optional file name instead of an address */
+    if( sort_mode )
+    {
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
         {
-            return(EXIT_SUCCESS);
+            fprintf(stderr, "Error: --sort cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
         }
-        else
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
         {
-            return(EXIT_FAILURE);
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = sort_addresses(input, stdout, normalize, verbose);
+        if( input != stdin )
+        {
+            fclose(input);
         }
+        free(actions);
+
+        return(bulk_exit_code(result));
     }
 
-    if( ipv6_range_check )
+    if( lookup_table_name != NULL )
     {
-        if( range_prefix_length > 128 )
+        struct lookup_table table;
+        FILE* table_file;
+
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
         {
-            fprintf(stderr, "Error: prefix length cannot exceed 32 for IPv4!\n");
+            fprintf(stderr, "Error: --lookup cannot be used with other checks\n");
             return(RESULT_INT_ERROR);
         }
 
-        int result = is_ipv6_range(address_str, range_prefix_length, verbose);
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        table_file = fopen(lookup_table_name, "r");
+        if( table_file == NULL )
+        {
+            fprintf(stderr, "Error: could not open %s: %s\n", lookup_table_name, strerror(errno));
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = lookup_table_load(&table, table_file, lookup_table_name);
+        fclose(table_file);
         if( result == RESULT_SUCCESS )
         {
-            return(EXIT_SUCCESS);
+            result = lookup_addresses(&table, input, stdout, verbose);
+            lookup_table_free(&table);
         }
-        else
+
+        if( input != stdin )
         {
-            return(EXIT_FAILURE);
+            fclose(input);
         }
+        free(actions);
+
+        return(bulk_exit_code(result));
     }
 
-   /* If ipaddrcheck is called with options other than --is-ipv4-range or --is-ipv6-range,
-    * the argument is a single address that we can parse beforehand and pass to various checking functions.
-    */
+    if( classify_mode )
+    {
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --classify cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
 
-    CIDR *address;
-    address = cidr_from_str(address_str);
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
 
-    int result = RESULT_SUCCESS;
+        int result = classify_addresses(input, stdout, verbose);
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(actions);
 
-    /* Check if the address is valid and well-formatted at all,
-       if not there is no point in going further */
-    if( !( (is_valid_address(address) == RESULT_SUCCESS) &&
-        ((is_any_cidr(address_str) == RESULT_SUCCESS) || (is_any_single(address_str) == RESULT_SUCCESS)) ) )
+        return(bulk_exit_code(result));
+    }
+
+    if( build_blocklist_name != NULL )
     {
-        if( verbose )
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --build-blocklist cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
         {
-            printf("Malformed address %s\n", address_str);
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
         }
-        return(EXIT_FAILURE);
-    }
 
-    /* FIXUP: libcidr allows more than one double colon, but RFC 4291 does not! */
-    if( duplicate_double_colons(address_str) ) {
-        if( verbose )
+        int result = blocklist_build(input, (input == stdin) ? "stdin" : argv[optind], build_blocklist_name);
+        if( input != stdin )
         {
-            printf("More than one \"::\" is not allowed in IPv6 addresses\n");
+            fclose(input);
         }
-        return(EXIT_FAILURE);
+        free(actions);
+
+        return(bulk_exit_code(result));
     }
 
-    while( (action_count >= 0) && (result == RESULT_SUCCESS) )
+    if( blocklist_name != NULL )
     {
-        switch(actions[action_count])
-        {
-            case IS_VALID:
-                result = is_valid_address(address);
-                break;
-            case IS_IPV4:
-                result = is_ipv4(address);
-                break;
-            case IS_IPV4_CIDR:
-                result = is_ipv4_cidr(address_str);
-                break;
-            case IS_IPV4_SINGLE:
-                result = is_ipv4_single(address_str);
-                break;
-            case IS_IPV4_HOST:
-                /* Host vs. network address check only makes sense
-                   if prefix length is given */
-                if( !(cidr_get_proto(address) == CIDR_IPV4) )
-                {
-                    if( verbose )
-                    {
-                        printf("%s is not a valid IPv4 address\n", address_str);
-                    }
-                    result = RESULT_FAILURE;
-                    break;
-                }
+        struct blocklist blocklist;
 
-                if( !is_ipv4_cidr(address_str) )
-                {
-                    if( verbose )
-                    {
-                        printf("Cannot check if %s is a valid host address: missing prefix length\n", address_str);
-                    }
-                    result = RESULT_FAILURE;
-                }
-                else
-                {
-                    result = is_ipv4_host(address);
-                    if( (result == RESULT_FAILURE) && verbose )
-                    {
-                        if( ((cidr_equals(address, cidr_addr_network(address)) >= 0) &&
-                             (cidr_get_pflen(address) != 32)) )
-                        {
-                            printf("%s is an IPv4 network address, not a host address\n", address_str);
-                        }
-                    }
-                }
-                break;
-            case IS_IPV4_NET:
-                /* Host vs. network address check only makes sense
-                   if prefix length is given */
-                if( !(cidr_get_proto(address) == CIDR_IPV4) ) {
-                    if( verbose )
-                    {
-                        printf("%s is not a valid IPv4 address\n", address_str);
-                    }
-                    result = RESULT_FAILURE;
-                    break;
-                }
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --blocklist cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
 
-                if( !is_ipv4_cidr(address_str) )
-                {
-                    if( verbose )
-                    {
-                        printf("Cannot check if %s is a valid network address: missing prefix length\n", address_str);
-                    }
-                    result = RESULT_FAILURE;
-                }
-                else
-                {
-                    result = is_ipv4_net(address);
-                    if( (result == RESULT_FAILURE) && verbose )
-                    {
-                        if( ((cidr_equals(address, cidr_addr_network(address)) < 0) &&
-                             (cidr_get_pflen(address) != 32)) )
-                        {
-                            char* network_addr = cidr_to_str(cidr_addr_network(address), 0);
-                            printf("%s is an IPv4 host address, not a network address. Did you mean %s?\n", address_str, network_addr);
-                        }
-                    }
-                }
-                break;
-            case IS_IPV4_BROADCAST:
-                /* Broadcast address check only makes sense
-                   if prefix length is given */
-                if( !is_ipv4_cidr(address_str) )
-                {
-                    if( verbose )
-                    {
-                        printf("Cannot check if %s is a broadcast address: missing prefix length\n", address_str);
-                    }
-                    result = RESULT_FAILURE;
-                }
-                else
-                {
-                    result = is_ipv4_broadcast(address);
-                }
-                break;
-            case IS_IPV4_MULTICAST:
-                result = is_ipv4_multicast(address);
-                break;
-            case IS_IPV4_LOOPBACK:
-                result = is_ipv4_loopback(address);
-                break;
-            case IS_IPV4_LINKLOCAL:
-                result = is_ipv4_link_local(address);
-                break;
-            case IS_IPV4_RFC1918:
-                result = is_ipv4_rfc1918(address);
-                break;
-            case IS_IPV6:
-                result = is_ipv6(address);
-                break;
-            case IS_IPV6_CIDR:
-                result = is_ipv6_cidr(address_str);
-                break;
-            case IS_IPV6_SINGLE:
-                result = is_ipv6_single(address_str);
-                break;
-            case IS_IPV6_HOST:
-                /* Host vs. network address check only makes sense
-                   if prefix length is given */
-                if( !(cidr_get_proto(address) == CIDR_IPV6) ) {
-                    if( verbose )
-                    {
-                        printf("%s is not a valid IPv6 address\n", address_str);
-                    }
-                    result = RESULT_FAILURE;
-                    break;
-                }
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
 
-                if( !is_ipv6_cidr(address_str) )
-                {
-                    if( verbose )
-                    {
-                        printf("Cannot check if %s is a valid IPv6 host address: missing prefix length\n", address_str);
-                    }
-                    result = RESULT_FAILURE;
-                }
-                else
-                {
-                    result = is_ipv6_host(address);
-                    if( (result == RESULT_FAILURE) && verbose )
-                    {
-                        if( ((cidr_equals(address, cidr_addr_network(address)) >= 0) && (cidr_get_pflen(address) != 128)) )
-                        {
-                            printf("%s is an IPv6 network address, not a host address\n", address_str);
-                        }
-                    }
-                }
-                break;
-            case IS_IPV6_NET:
-                /* Host vs. network address check only makes sense
-                   if prefix length is given */
-                if( !(cidr_get_proto(address) == CIDR_IPV6) ) {
-                    if( verbose )
-                    {
-                        printf("%s is not a valid IPv6 address\n", address_str);
-                    }
-                    result = RESULT_FAILURE;
-                    break;
-                }
+        int result = blocklist_open(&blocklist, blocklist_name);
+        if( result == RESULT_SUCCESS )
+        {
+            result = blocklist_check_addresses(&blocklist, input, stdout, verbose);
+            blocklist_close(&blocklist);
+        }
 
-                if( !is_ipv6_cidr(address_str) )
-                {
-                    if( verbose )
-                    {
-                        printf("Cannot check if %s is a valid IPv6 network address: missing prefix length\n", address_str);
-                    }
-                    result = RESULT_FAILURE;
-                }
-                else
-                {
-                    result = is_ipv6_net(address);
-                    if( (result == RESULT_FAILURE) && verbose )
-                    {
-                        if( ((cidr_equals(address, cidr_addr_network(address)) < 0) && (cidr_get_pflen(address) != 128)) ) {
-                            char* network_addr = cidr_to_str(cidr_addr_network(address), 0);
-                            printf("%s is an IPv6 host address, not a network address. Did you mean %s?\n", address_str, network_addr);
-                        }
-                    }
-                }
-                break;
-            case IS_IPV6_MULTICAST:
-                 result = is_ipv6_multicast(address);
-                 break;
-            case IS_IPV6_LINKLOCAL:
-                 result = is_ipv6_link_local(address);
-                 break;
-            case IS_ANY_CIDR:
-                 result = is_any_cidr(address_str);
-                 break;
-            case IS_ANY_SINGLE:
-                 result = is_any_single(address_str);
-                 break;
-            case IS_VALID_INTF_ADDR:
-                 result = is_valid_intf_address(address, address_str, allow_loopback);
-                 break;
-            case NO_ACTION:
-                 break;
-            case IS_ANY_HOST:
-                /* Host vs. network address check only makes sense if prefix length is given */
-                 if( !is_any_cidr(address_str) )
-                 {
-                    if( verbose )
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( build_prefix_index_name != NULL )
+    {
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --build-prefix-index cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = prefix_index_build(input, (input == stdin) ? "stdin" : argv[optind], build_prefix_index_name);
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( verify_prefix_index_name != NULL )
+    {
+        struct prefix_index index;
+
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --verify-prefix-index cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( (argc - optind) > 0 )
+        {
+            fprintf(stderr, "Error: wrong number of arguments, no argument expected!\n");
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = prefix_index_open(&index, verify_prefix_index_name, 1);
+        if( result == RESULT_SUCCESS )
+        {
+            prefix_index_close(&index);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( (save_netlink_dump_name != NULL) && !interface_conflicts_mode )
+    {
+        struct ifaddr_table table;
+
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --save-netlink-dump cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( (argc - optind) > 0 )
+        {
+            fprintf(stderr, "Error: wrong number of arguments, no argument expected!\n");
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        ifaddr_table_init(&table);
+        int result = ifaddr_table_load_kernel(&table, save_netlink_dump_name);
+        ifaddr_table_free(&table);
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    /* Configured addresses are taken from the kernel once, or from a saved
+       dump, and checked against STRING or addresses from stdin like --rules */
+    if( interface_conflicts_mode )
+    {
+        struct ifaddr_table table;
+        char* conflicts_address_str = NULL;
+
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --interface-conflicts cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( (netlink_dump_name != NULL) && (save_netlink_dump_name != NULL) )
+        {
+            fprintf(stderr, "Error: --netlink-dump and --save-netlink-dump cannot be used together\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( (argc - optind) > 1 )
+        {
+            fprintf(stderr, "Error: wrong number of arguments, at most one argument expected!\n");
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+        if( ((argc - optind) == 1) && (strcmp(argv[optind], "-") != 0) )
+        {
+            conflicts_address_str = argv[optind];
+        }
+
+        ifaddr_table_init(&table);
+        int result = (netlink_dump_name != NULL) ? ifaddr_table_load_file(&table, netlink_dump_name)
+                                                 : ifaddr_table_load_kernel(&table, save_netlink_dump_name);
+        if( result == RESULT_SUCCESS )
+        {
+            result = check_ifaddr_conflicts(&table, stdin, conflicts_address_str, interface_name, stdout, verbose);
+        }
+        ifaddr_table_free(&table);
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    /* Rules are matched like checks, but also read addresses from stdin
+       if there is none or it is "-" */
+    if( rules_name != NULL )
+    {
+        static struct rule_set rules;
+        char* rules_address_str = NULL;
+        FILE* rules_file;
+
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --rules cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( (argc - optind) > 1 )
+        {
+            fprintf(stderr, "Error: wrong number of arguments, at most one argument expected!\n");
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+        if( ((argc - optind) == 1) && (strcmp(argv[optind], "-") != 0) )
+        {
+            rules_address_str = argv[optind];
+        }
+
+        rules_file = fopen(rules_name, "r");
+        if( rules_file == NULL )
+        {
+            fprintf(stderr, "Error: could not open %s: %s\n", rules_name, strerror(errno));
+            return(RESULT_INT_ERROR);
+        }
+        rules_init(&rules);
+        int result = rules_load(&rules, rules_file, rules_name);
+        fclose(rules_file);
+
+        if( result == RESULT_SUCCESS )
+        {
+            result = check_rules(&rules, stdin, rules_address_str, stdout, allow_loopback, verbose);
+        }
+        rules_free(&rules);
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    /* Delimited files have checks per column: those after
+       a --column option apply to that column */
+    if( csv_delimiter != '\0' )
+    {
+        if( ipv4_range_check || ipv6_range_check )
+        {
+            fprintf(stderr, "Error: --csv and --tsv cannot be used with range checks\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( csv_column_count == 0 )
+        {
+            fprintf(stderr, "Error: --csv and --tsv require at least one --column!\n");
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+        if( collect_column_checks(actions, action_count, csv_column_slots,
+                                  csv_columns, csv_column_count) != RESULT_SUCCESS )
+        {
+            fprintf(stderr, "Error: checks must follow the --column they apply to\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = check_csv(input, stdout, csv_delimiter, csv_flags, csv_columns, csv_column_count,
+                               allow_loopback, verbose);
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(csv_columns);
+        free(csv_column_slots);
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    /* JSON mode takes a single address, or reads addresses from stdin
+       if there is none or it is "-" */
+    if( json_mode )
+    {
+        char* json_address_str = NULL;
+
+        if( ipv4_range_check || ipv6_range_check )
+        {
+            fprintf(stderr, "Error: --json cannot be used with range checks\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( (argc - optind) > 1 )
+        {
+            fprintf(stderr, "Error: wrong number of arguments, at most one argument expected!\n");
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+        if( ((argc - optind) == 1) && (strcmp(argv[optind], "-") != 0) )
+        {
+            json_address_str = argv[optind];
+        }
+
+        int result = check_addresses_json(stdin, json_address_str, stdout, actions, action_count, allow_loopback);
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( binary_mode )
+    {
+        int check_count;
+
+        if( ipv4_range_check || ipv6_range_check )
+        {
+            fprintf(stderr, "Error: --binary cannot be used with range checks\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        /* Result bits follow the order of checks on the command line */
+        check_count = collect_checks(actions, action_count);
+        if( check_count == 0 )
+        {
+            fprintf(stderr, "Error: --binary requires at least one check!\n");
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = check_binary_records(input, stdout, actions, check_count, allow_loopback);
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( pcap_name != NULL )
+    {
+        if( ipv4_range_check || ipv6_range_check )
+        {
+            fprintf(stderr, "Error: --pcap cannot be used with range checks\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( (argc - optind) > 0 )
+        {
+            fprintf(stderr, "Error: --pcap takes no arguments other than the capture file!\n");
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = classify_pcap(pcap_name, stdout, actions, collect_checks(actions, action_count), allow_loopback);
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( scan_mode )
+    {
+        if( ipv4_range_check || ipv6_range_check )
+        {
+            fprintf(stderr, "Error: --scan cannot be used with range checks\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = scan_addresses(input, stdout, actions, collect_checks(actions, action_count),
+                                    allow_loopback, verbose);
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    /* Multiple files take their names as arguments, or from stdin
+       if there are none or the only one is "-" */
+    if( scan_files_mode )
+    {
+        char** names = argv + optind;
+        size_t name_count = argc - optind;
+        char** stdin_names = NULL;
+
+        if( ipv4_range_check || ipv6_range_check )
+        {
+            fprintf(stderr, "Error: --scan-files cannot be used with range checks\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( (name_count == 0) || ((name_count == 1) && (strcmp(names[0], "-") == 0)) )
+        {
+            stdin_names = read_file_names(stdin, &name_count);
+            if( stdin_names == NULL )
+            {
+                return(RESULT_INT_ERROR);
+            }
+            names = stdin_names;
+        }
+
+        int result = scan_files(names, name_count, stdout, actions, collect_checks(actions, action_count),
+                                allow_loopback, verbose, FILES_READ_AUTO, 0);
+        if( stdin_names != NULL )
+        {
+            free_file_names(stdin_names, name_count);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( filter_select >= 0 )
+    {
+        if( ipv4_range_check || ipv6_range_check )
+        {
+            fprintf(stderr, "Error: --filter and --filter-invert cannot be used with range checks\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = filter_addresses(input, stdout, actions, collect_checks(actions, action_count),
+                                      allow_loopback, filter_select, verbose);
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( stats_mode )
+    {
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --stats cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = address_stats(input, stdout, top_count, 0);
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    /* Sketches of --distinct, or of several merged with --merge-sketches,
+       can be saved with --sketch-out to be merged later */
+    if( distinct_mode || merge_sketches_mode )
+    {
+        struct distinct_counter counter;
+        int result;
+        int i;
+
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --distinct and --merge-sketches cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        if( merge_sketches_mode )
+        {
+            if( (argc - optind) == 0 )
+            {
+                fprintf(stderr, "Error: --merge-sketches requires at least one sketch file!\n");
+                print_help(program_name);
+                return(RESULT_INT_ERROR);
+            }
+
+            result = distinct_load(&counter, argv[optind]);
+            for( i = optind + 1; (i < argc) && (result == RESULT_SUCCESS); i++ )
+            {
+                struct distinct_counter other;
+
+                result = distinct_load(&other, argv[i]);
+                if( result == RESULT_SUCCESS )
+                {
+                    result = distinct_merge(&counter, &other);
+                    if( result == RESULT_FAILURE )
                     {
-                        printf("Cannot check if %s is a valid host address: missing prefix length\n", address_str);
+                        fprintf(stderr, "Error: %s and %s count prefixes of different lengths\n",
+                                argv[optind], argv[i]);
+                        result = RESULT_INT_ERROR;
                     }
-                    result = RESULT_FAILURE;
-                 }
-                 else
-                 {
-                     result = is_any_host(address);
-                     if( (result == RESULT_FAILURE) && verbose ) {
-                         if( ((cidr_equals(address, cidr_addr_network(address)) >= 0) &&
-                              (cidr_get_pflen(address) != 32) &&
-                              (cidr_get_pflen(address) != 128)) )
-                         {
-                             printf("%s is a network address, not a host address\n", address_str);
-                         }
-                     }
-                 }
-                 break;
-            case IS_ANY_NET:
-                /* Host vs. network address check only makes sense if prefix length is given */
-                 if( !is_any_cidr(address_str) )
-                 {
-                     if( verbose )
-                     {
-                         printf("Cannot check if %s is a valid network address: missing prefix length\n", address_str);
-                     }
-                    result = RESULT_FAILURE;
-                 }
-                 else
-                 {
-                     result = is_any_net(address);
-                     if( (result == RESULT_FAILURE) && verbose )
-                     {
-                         if( ((cidr_equals(address, cidr_addr_network(address)) < 0) &&
-                              (cidr_get_pflen(address) != 128) &&
-                              (cidr_get_pflen(address) != 32)) )
-                         {
-                             char* network_addr = cidr_to_str(cidr_addr_network(address), 0);
-                             printf("%s is a host address, not a network address. Did you mean %s?\n", address_str, network_addr);
-                         }
-                     }
-                 }
-                 break;
-            default:
-                 break;
+                    distinct_free(&other);
+                }
+                if( result != RESULT_SUCCESS )
+                {
+                    distinct_free(&counter);
+                }
+            }
+        }
+        else
+        {
+            FILE* input = open_bulk_input(argc, argv, optind);
+            if( input == NULL )
+            {
+                print_help(program_name);
+                return(RESULT_INT_ERROR);
+            }
+
+            result = distinct_init(&counter, distinct_ipv4_length, distinct_ipv6_length);
+            if( result == RESULT_SUCCESS )
+            {
+                result = distinct_add_addresses(&counter, input, verbose);
+                if( result == RESULT_INT_ERROR )
+                {
+                    distinct_free(&counter);
+                }
+            }
+            if( input != stdin )
+            {
+                fclose(input);
+            }
+        }
+
+        if( result != RESULT_INT_ERROR )
+        {
+            if( (sketch_out_name != NULL) && (distinct_save(&counter, sketch_out_name) != RESULT_SUCCESS) )
+            {
+                result = RESULT_INT_ERROR;
+            }
+            else if( distinct_print(&counter, stdout) != RESULT_SUCCESS )
+            {
+                result = RESULT_INT_ERROR;
+            }
+            distinct_free(&counter);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( overlaps_mode )
+    {
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --overlaps cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = check_overlaps(input, stdout, verbose);
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( reverse_mode )
+    {
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --reverse cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = reverse_addresses(input, stdout, verbose);
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    if( to_binary_mode )
+    {
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --to-binary cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* input = open_bulk_input(argc, argv, optind);
+        if( input == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = convert_to_binary(input, stdout, verbose);
+        if( input != stdin )
+        {
+            fclose(input);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    /* Enumeration modes take a prefix or range instead of an address */
+    if( hosts_mode || (subnet_length >= 0) )
+    {
+        struct address_interval interval;
+
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --hosts and --subnets cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( (argc - optind) != 1 )
+        {
+            fprintf(stderr, "Error: wrong number of arguments, one argument required!\n");
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+        if( interval_from_str(argv[optind], &interval) != RESULT_SUCCESS )
+        {
+            fprintf(stderr, "Error: %s is not a valid prefix, range or address\n", argv[optind]);
+            return(EXIT_FAILURE);
+        }
+        free(actions);
+
+        if( hosts_mode )
+        {
+            return(bulk_exit_code(enumerate_hosts(&interval, stdout)));
+        }
+        else
+        {
+            return(bulk_exit_code(enumerate_subnets(&interval, subnet_length, stdout)));
+        }
+    }
+
+    /* Allocation takes the pool prefix and an optional file of used subnets */
+    if( allocate_length >= 0 )
+    {
+        if( ipv4_range_check || ipv6_range_check || (collect_checks(actions, action_count) > 0) )
+        {
+            fprintf(stderr, "Error: --allocate cannot be used with other checks\n");
+            return(RESULT_INT_ERROR);
+        }
+        if( (argc - optind) < 1 )
+        {
+            fprintf(stderr, "Error: wrong number of arguments, pool prefix required!\n");
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        FILE* used = open_bulk_input(argc, argv, optind + 1);
+        if( used == NULL )
+        {
+            print_help(program_name);
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = allocate_subnets(argv[optind], used, (used == stdin) ? "stdin" : argv[optind + 1],
+                                      allocate_length, allocate_count, stdout);
+        if( used != stdin )
+        {
+            fclose(used);
+        }
+        free(actions);
+
+        return(bulk_exit_code(result));
+    }
+
+    /* Get non-option arguments */
+    if( (argc - optind) == 1 )
+    {
+         address_str = argv[optind];
+    }
+    else
+    {
+         fprintf(stderr, "Error: wrong number of arguments, one argument required!\n");
+         print_help(program_name);
+         return(RESULT_INT_ERROR);
+    }
+
+    if( report_mode && (ipv4_range_check || ipv6_range_check) )
+    {
+        fprintf(stderr, "Error: --report cannot be used with range checks\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    /* If the argument is a range, use special functions that can handle it. */
+    if( ipv4_range_check )
+    {
+        if( range_prefix_length > 32 )
+        {
+            fprintf(stderr, "Error: prefix length cannot exceed 32 for IPv4!\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = is_ipv4_range(address_str, range_prefix_length, verbose);
+        if( result == RESULT_SUCCESS )
+        {
+            return(EXIT_SUCCESS);
+        }
+        else
+        {
+            return(EXIT_FAILURE);
+        }
+    }
+
+    if( ipv6_range_check )
+    {
+        if( range_prefix_length > 128 )
+        {
+            fprintf(stderr, "Error: prefix length cannot exceed 32 for IPv4!\n");
+            return(RESULT_INT_ERROR);
+        }
+
+        int result = is_ipv6_range(address_str, range_prefix_length, verbose);
+        if( result == RESULT_SUCCESS )
+        {
+            return(EXIT_SUCCESS);
+        }
+        else
+        {
+            return(EXIT_FAILURE);
+        }
+    }
+
+   /* If ipaddrcheck is called with options other than --is-ipv4-range or --is-ipv6-range,
+    * the argument is a single address that we can parse beforehand and pass to various checking functions.
+    */
+
+    CIDR *address;
+    address = cidr_from_str(address_str);
+
+    if( report_mode )
+    {
+        int result = report_checks(actions, collect_checks(actions, action_count), address, address_str,
+                                   allow_loopback, verbose, stdout);
+        free(actions);
+        if( address != NULL )
+        {
+            cidr_free(address);
+        }
+
+        return(bulk_exit_code(result));
+    }
+
+    int result = RESULT_SUCCESS;
+    size_t reason_size = CHECK_REASON_SIZE(strlen(address_str));
+    char* reason = malloc(reason_size);
+    if( reason == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    /* Check if the address is valid and well-formatted at all,
+       if not there is no point in going further */
+    if( check_address_format(address, address_str, reason, reason_size) != RESULT_SUCCESS )
+    {
+        if( verbose )
+        {
+            printf("%s\n", reason);
+        }
+        return(EXIT_FAILURE);
+    }
+
+    while( (action_count >= 0) && (result == RESULT_SUCCESS) )
+    {
+        result = check_address(actions[action_count], address, address_str, allow_loopback,
+                               reason, reason_size);
+        if( verbose && (reason[0] != '\0') )
+        {
+            printf("%s\n", reason);
         }
         action_count--;
     }
 
     /* Clean up */
     free(actions);
+    free(reason);
     cidr_free(address);
 
     if( result == RESULT_SUCCESS )
@@ -661,15 +1582,120 @@ Address checking options:\n\
   --is-ipv6-link-local       Check if STRING is an IPv6 link-local address \n\
   --is-valid-intf-address    Check if STRING is an IPv4 or IPv6 address that \n\
                                can be assigned to a network interface \n\
+  --is-in-prefix-index <INDEX>\n\
+                             Check if STRING, and with a prefix length\n\
+                               its whole prefix, is in a prefix of INDEX\n\
   --is-ipv4-range            Check if STRING is a valid IPv4 address range\n\
   --is-ipv6-range            Check if STRING is a valid IPv6 address range\n\
-  \n\
+  \n");
+    printf("\
+Bulk modes (read addresses one per line from FILE or stdin):\n\
+  --sort [FILE]              Sort addresses in numeric order, IPv4 first\n\
+  --lookup <TABLE> [FILE]    Print the longest matching prefix from TABLE,\n\
+                               or its label, for every address\n\
+  --classify [FILE]          Print the IANA special-purpose registry\n\
+                               categories of every address\n\
+  --build-blocklist <OUT> [FILE]\n\
+                             Build a Bloom filter blocklist file OUT\n\
+                               from a list of host addresses\n\
+  --blocklist <BLOCKLIST> [FILE]\n\
+                             Print \"blocked\" for every address that is\n\
+                               in BLOCKLIST, or \"-\" otherwise\n\
+  --build-prefix-index <OUT> [FILE]\n\
+                             Compile a --lookup table into a prefix index\n\
+                               file OUT for --is-in-prefix-index\n\
+  --verify-prefix-index <INDEX>\n\
+                             Check the format and checksums of INDEX\n\
+  --save-netlink-dump <FILE> Save the interface addresses of the host\n\
+                               to FILE for --netlink-dump\n\
+  --binary [FILE]            Run the checks on packed binary records and\n\
+                               write one result bit mask per record\n\
+  --to-binary [FILE]         Convert addresses to packed binary records\n\
+  --pcap <FILE>              Run the checks on source and destination\n\
+                               addresses of packets in a pcap or pcapng\n\
+                               file and print counts and packet numbers\n\
+  --scan [FILE]              Find addresses in free text, run the checks\n\
+                               on them and print their line, column\n\
+                               and result\n\
+  --scan-files [FILE...]     Same as --scan, for many files read concurrently,\n\
+                               with their names in front; reads the names\n\
+                               from stdin if none are given\n\
+  --filter [FILE]            Print the lines that pass the checks, like grep;\n\
+                               exits with 0 if any line was printed\n\
+  --filter-invert [FILE]     Print the lines that fail the checks\n\
+  --stats [FILE]             Print address counts per special-purpose\n\
+                               category and the most frequent IPv4 /24\n\
+                               and IPv6 /48 prefixes\n\
+  --distinct [FILE]          Estimate the number of distinct IPv4 and IPv6\n\
+                               addresses with HyperLogLog++ sketches\n\
+  --merge-sketches <FILE...> Estimate the number of distinct addresses\n\
+                               in sketch files saved with --sketch-out\n\
+  --overlaps [FILE]          Report ranges (FIRST-LAST) that overlap each\n\
+                               other or are partly outside of a subnet\n\
+  --reverse [FILE]           Print the in-addr.arpa or ip6.arpa name\n\
+                               of every address, or the zone of a prefix\n\
+  --csv [FILE]               Run the checks after every --column option\n\
+                               on that column of a CSV file and print\n\
+                               the rows that fail\n\
+  --tsv [FILE]               Same as --csv, for tab-separated files\n\
+\n\
+Enumeration modes:\n\
+  --hosts                    Print the host addresses of the prefix STRING\n\
+                               or every address of the range STRING\n\
+  --subnets <LENGTH>         Print the subnets of given length\n\
+                               in the prefix STRING\n\
+  --allocate <LENGTH> <POOL> [FILE]\n\
+                             Print the first free subnet of given length\n\
+                               in POOL, leaving out the subnets and\n\
+                               addresses listed in FILE or stdin\n\
+  \n");
+    printf("\
 Behavior options:\n\
   --allow-loopback             When used with --is-valid-intf-address,\n\
                                  makes IPv4 loopback addresses pass the check\n\
   --range-prefix-length <INT>  When used with --is-ipv4-range or --is-ipv6-range,\n\
                                  requires the range boundaries to lie within\n\
                                  a prefix of given length\n\
+  --normalize                  When used with --sort, prints addresses\n\
+                                 in canonical form rather than as given\n\
+  --count <N>                  When used with --allocate, prints\n\
+                                 the first N free subnets\n\
+  --top <N>                    When used with --stats, prints the N most\n\
+                                 frequent prefixes of each kind (default 10)\n\
+  --sketch-out <FILE>          When used with --distinct or --merge-sketches,\n\
+                                 saves the sketch to FILE for merging\n\
+  --ipv4-prefix-length <INT>   When used with --distinct, counts distinct\n\
+                                 IPv4 prefixes of this length, such as /24\n\
+  --ipv6-prefix-length <INT>   Same as --ipv4-prefix-length, for IPv6\n\
+  --column <COLUMN>            When used with --csv or --tsv, applies\n\
+                                 the checks that follow to COLUMN, given\n\
+                                 by number from 1 or by name from the header\n\
+  --header                     When used with --csv or --tsv, treats\n\
+                                 the first row as column names\n\
+  --annotate                   When used with --csv or --tsv, prints\n\
+                                 every row with a pass or fail column\n\
+                                 added for every --column\n\
+  --rules <FILE>               Check if STRING matches every rule in FILE,\n\
+                                 one per line, such as \"is-ipv4-host and\n\
+                                 not (is-ipv4-rfc1918 or in 192.0.2.0/24)\";\n\
+                                 reads addresses from stdin and prints\n\
+                                 pass or fail if STRING is omitted or \"-\"\n\
+  --interface-conflicts        Print the addresses configured on the host\n\
+                                 that STRING duplicates or whose subnets\n\
+                                 overlap with its subnet; reads addresses\n\
+                                 from stdin if STRING is omitted or \"-\"\n\
+  --interface <NAME>           When used with --interface-conflicts, leaves\n\
+                                 out subnets of NAME, the interface that\n\
+                                 the address is for\n\
+  --netlink-dump <FILE>        When used with --interface-conflicts, reads\n\
+                                 the configured addresses from FILE, saved\n\
+                                 with --save-netlink-dump\n\
+  --report                     Run all checks on STRING, rather than\n\
+                                 stopping at the first failure, and print\n\
+                                 \"pass\" or \"fail\" for each one\n\
+  --json                       Print the results of all checks as one\n\
+                                 JSON object per address; reads addresses\n\
+                                 from stdin if STRING is omitted or \"-\"\n\
 \n\
 Other options:\n\
   --version                  Print version information and exit \n\
@@ -681,6 +1707,143 @@ Exit codes:\n\
   2    if a problem occured (wrong option, internal error etc.)\n");
 }
 
+/*
+ * Open the input of a bulk mode: the file given as the only
+ * non-option argument, or stdin if there is none or it's "-"
+ */
+FILE* open_bulk_input(int argc, char* argv[], int first_arg)
+{
+    FILE* input;
+
+    if( (argc - first_arg) == 0 )
+    {
+        return(stdin);
+    }
+    else if( (argc - first_arg) > 1 )
+    {
+        fprintf(stderr, "Error: wrong number of arguments, at most one file name expected!\n");
+        return(NULL);
+    }
+
+    if( strcmp(argv[first_arg], "-") == 0 )
+    {
+        return(stdin);
+    }
+
+    input = fopen(argv[first_arg], "r");
+    if( input == NULL )
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n", argv[first_arg], strerror(errno));
+    }
+
+    return(input);
+}
+
+/*
+ * Convert the result of a bulk mode to an exit code
+ */
+int bulk_exit_code(int result)
+{
+    if( result == RESULT_SUCCESS )
+    {
+        return(EXIT_SUCCESS);
+    }
+    else if( result == RESULT_FAILURE )
+    {
+        return(EXIT_FAILURE);
+    }
+    else
+    {
+        return(RESULT_INT_ERROR);
+    }
+}
+
+/*
+ * Parse a prefix length option, returns -1 if it is not a number
+ * from 0 to max_length
+ */
+int parse_prefix_length(const char* str, int max_length)
+{
+    char* end = "";
+    long length;
+
+    errno = 0;
+    length = strtol(str, &end, 10);
+    if( (errno != 0) || (end == str) || (*end != '\0') || (length < 0) || (length > max_length) )
+    {
+        fprintf(stderr, "Error: \"%s\" is not a valid prefix length\n", str);
+        return(-1);
+    }
+
+    return((int)length);
+}
+
+/*
+ * Move the codes of actual checks to the start of the actions array,
+ * in command line order, and return their number
+ */
+int collect_checks(int* actions, int action_count)
+{
+    int check_count = 0;
+    int i;
+
+    for( i = 0; i <= action_count; i++ )
+    {
+        if( action_name(actions[i]) != NULL )
+        {
+            actions[check_count++] = actions[i];
+        }
+    }
+
+    return(check_count);
+}
+
+/*
+ * Split the checks among the columns: the checks of a column are those
+ * after its --column option and before the next one. Like collect_checks,
+ * move them to the start of the actions array, a column after another.
+ * Returns RESULT_FAILURE if there are checks before the first --column.
+ */
+int collect_column_checks(int* actions, int action_count, const int* column_slots,
+                          struct csv_column* columns, size_t column_count)
+{
+    int check_count = 0;
+    size_t column = 0;
+    int i;
+
+    columns[0].checks = actions;
+    columns[0].check_count = 0;
+
+    for( i = 0; i <= action_count; i++ )
+    {
+        while( (column + 1 < column_count) && (column_slots[column + 1] < i) )
+        {
+            column++;
+            columns[column].checks = actions + check_count;
+            columns[column].check_count = 0;
+        }
+
+        if( action_name(actions[i]) != NULL )
+        {
+            if( column_slots[column] >= i )
+            {
+                return(RESULT_FAILURE);
+            }
+            actions[check_count++] = actions[i];
+            columns[column].check_count++;
+        }
+    }
+
+    /* Columns after the last check have none */
+    while( ++column < column_count )
+    {
+        columns[column].checks = actions + check_count;
+        columns[column].check_count = 0;
+    }
+
+    return(RESULT_SUCCESS);
+}
+
 /*
  * Print version information, no other side effects
  */
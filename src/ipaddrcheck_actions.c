@@ -0,0 +1,628 @@
+/*
+ * ipaddrcheck_actions.c: evaluation of the checks selected on the command line
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "ipaddrcheck_actions.h"
+#include "ipaddrcheck_special.h"
+#include "ipaddrcheck_prefix_index.h"
+
+/* The prefix index of IS_IN_PREFIX_INDEX, mapped by the caller */
+static const struct prefix_index* check_prefix_index = NULL;
+
+/* Option name of a check, without the leading dashes,
+   or NULL for codes that are not checks */
+const char* action_name(int action)
+{
+    switch(action)
+    {
+        case IS_VALID:           return("is-valid");
+        case IS_IPV4:            return("is-ipv4");
+        case IS_IPV4_CIDR:       return("is-ipv4-cidr");
+        case IS_IPV4_SINGLE:     return("is-ipv4-single");
+        case IS_IPV4_HOST:       return("is-ipv4-host");
+        case IS_IPV4_NET:        return("is-ipv4-net");
+        case IS_IPV4_BROADCAST:  return("is-ipv4-broadcast");
+        case IS_IPV4_MULTICAST:  return("is-ipv4-multicast");
+        case IS_IPV4_RFC1918:    return("is-ipv4-rfc1918");
+        case IS_IPV4_LOOPBACK:   return("is-ipv4-loopback");
+        case IS_IPV4_LINKLOCAL:  return("is-ipv4-link-local");
+        case IS_IPV6:            return("is-ipv6");
+        case IS_IPV6_CIDR:       return("is-ipv6-cidr");
+        case IS_IPV6_SINGLE:     return("is-ipv6-single");
+        case IS_IPV6_HOST:       return("is-ipv6-host");
+        case IS_IPV6_NET:        return("is-ipv6-net");
+        case IS_IPV6_MULTICAST:  return("is-ipv6-multicast");
+        case IS_IPV6_LINKLOCAL:  return("is-ipv6-link-local");
+        case IS_VALID_INTF_ADDR: return("is-valid-intf-address");
+        case IS_ANY_CIDR:        return("is-any-cidr");
+        case IS_ANY_SINGLE:      return("is-any-single");
+        case IS_ANY_HOST:        return("is-any-host");
+        case IS_ANY_NET:         return("is-any-net");
+        case IS_IN_PREFIX_INDEX: return("is-in-prefix-index");
+        default:                 return(NULL);
+    }
+}
+
+/* Set the prefix index that IS_IN_PREFIX_INDEX checks addresses against.
+   It is shared by all threads, so it has to be set before any checks run,
+   and stay mapped while they do. Without an index, the check fails. */
+void set_check_prefix_index(const struct prefix_index* index)
+{
+    check_prefix_index = index;
+}
+
+/* cidr_equals() of an address and the network address of its prefix */
+static int compare_network_address(CIDR* address)
+{
+    CIDR* network = cidr_addr_network(address);
+    int result = cidr_equals(address, network);
+
+    cidr_free(network);
+
+    return(result);
+}
+
+/* Network address of a prefix as a newly allocated string */
+static char* network_address_str(CIDR* address)
+{
+    CIDR* network = cidr_addr_network(address);
+    char* network_str = cidr_to_str(network, 0);
+
+    cidr_free(network);
+
+    return(network_str);
+}
+
+/* Check if the address is valid and well-formatted at all,
+ * if not there is no point in going further.
+ *
+ * On failure, the reason is written to the reason buffer.
+ */
+int check_address_format_r(const struct ipaddrcheck_ctx* ctx, CIDR* address, const char* address_str,
+                           char* reason, size_t reason_size)
+{
+    reason[0] = '\0';
+
+    if( !( (is_valid_address(address) == RESULT_SUCCESS) &&
+        ((is_any_cidr_r(ctx, address_str) == RESULT_SUCCESS) ||
+         (is_any_single_r(ctx, address_str) == RESULT_SUCCESS)) ) )
+    {
+        snprintf(reason, reason_size, "Malformed address %s", address_str);
+        return(RESULT_FAILURE);
+    }
+
+    /* FIXUP: libcidr allows more than one double colon, but RFC 4291 does not! */
+    if( duplicate_double_colons_r(ctx, address_str) )
+    {
+        snprintf(reason, reason_size, "More than one \"::\" is not allowed in IPv6 addresses");
+        return(RESULT_FAILURE);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Run a single check on an address that passed check_address_format().
+ *
+ * Codes that are not checks succeed. If the check has something to say
+ * about a failure, the explanation is written to the reason buffer,
+ * otherwise the buffer is left empty.
+ */
+int check_address_r(const struct ipaddrcheck_ctx* ctx, int action, CIDR* address, const char* address_str,
+                    int allow_loopback, char* reason, size_t reason_size)
+{
+    int result = RESULT_SUCCESS;
+    char* network_addr;
+    struct ipaddr_bin address_bin;
+
+    reason[0] = '\0';
+
+    switch(action)
+    {
+        case IS_VALID:
+            result = is_valid_address(address);
+            break;
+        case IS_IPV4:
+            result = is_ipv4(address);
+            break;
+        case IS_IPV4_CIDR:
+            result = is_ipv4_cidr_r(ctx, address_str);
+            break;
+        case IS_IPV4_SINGLE:
+            result = is_ipv4_single_r(ctx, address_str);
+            break;
+        case IS_IPV4_HOST:
+            /* Host vs. network address check only makes sense
+               if prefix length is given */
+            if( !(cidr_get_proto(address) == CIDR_IPV4) )
+            {
+                snprintf(reason, reason_size, "%s is not a valid IPv4 address", address_str);
+                result = RESULT_FAILURE;
+                break;
+            }
+
+            if( !is_ipv4_cidr_r(ctx, address_str) )
+            {
+                snprintf(reason, reason_size, "Cannot check if %s is a valid host address: missing prefix length", address_str);
+                result = RESULT_FAILURE;
+            }
+            else
+            {
+                result = is_ipv4_host(address);
+                if( result == RESULT_FAILURE )
+                {
+                    if( ((compare_network_address(address) >= 0) &&
+                         (cidr_get_pflen(address) != 32)) )
+                    {
+                        snprintf(reason, reason_size, "%s is an IPv4 network address, not a host address", address_str);
+                    }
+                }
+            }
+            break;
+        case IS_IPV4_NET:
+            /* Host vs. network address check only makes sense
+               if prefix length is given */
+            if( !(cidr_get_proto(address) == CIDR_IPV4) ) {
+                snprintf(reason, reason_size, "%s is not a valid IPv4 address", address_str);
+                result = RESULT_FAILURE;
+                break;
+            }
+
+            if( !is_ipv4_cidr_r(ctx, address_str) )
+            {
+                snprintf(reason, reason_size, "Cannot check if %s is a valid network address: missing prefix length", address_str);
+                result = RESULT_FAILURE;
+            }
+            else
+            {
+                result = is_ipv4_net(address);
+                if( result == RESULT_FAILURE )
+                {
+                    if( ((compare_network_address(address) < 0) &&
+                         (cidr_get_pflen(address) != 32)) )
+                    {
+                        network_addr = network_address_str(address);
+                        snprintf(reason, reason_size, "%s is an IPv4 host address, not a network address. Did you mean %s?", address_str, network_addr);
+                        free(network_addr);
+                    }
+                }
+            }
+            break;
+        case IS_IPV4_BROADCAST:
+            /* Broadcast address check only makes sense
+               if prefix length is given */
+            if( !is_ipv4_cidr_r(ctx, address_str) )
+            {
+                snprintf(reason, reason_size, "Cannot check if %s is a broadcast address: missing prefix length", address_str);
+                result = RESULT_FAILURE;
+            }
+            else
+            {
+                result = is_ipv4_broadcast(address);
+            }
+            break;
+        case IS_IPV4_MULTICAST:
+            result = is_ipv4_multicast(address);
+            break;
+        case IS_IPV4_LOOPBACK:
+            result = is_ipv4_loopback(address);
+            break;
+        case IS_IPV4_LINKLOCAL:
+            result = is_ipv4_link_local(address);
+            break;
+        case IS_IPV4_RFC1918:
+            result = is_ipv4_rfc1918(address);
+            break;
+        case IS_IPV6:
+            result = is_ipv6(address);
+            break;
+        case IS_IPV6_CIDR:
+            result = is_ipv6_cidr_r(ctx, address_str);
+            break;
+        case IS_IPV6_SINGLE:
+            result = is_ipv6_single_r(ctx, address_str);
+            break;
+        case IS_IPV6_HOST:
+            /* Host vs. network address check only makes sense
+               if prefix length is given */
+            if( !(cidr_get_proto(address) == CIDR_IPV6) ) {
+                snprintf(reason, reason_size, "%s is not a valid IPv6 address", address_str);
+                result = RESULT_FAILURE;
+                break;
+            }
+
+            if( !is_ipv6_cidr_r(ctx, address_str) )
+            {
+                snprintf(reason, reason_size, "Cannot check if %s is a valid IPv6 host address: missing prefix length", address_str);
+                result = RESULT_FAILURE;
+            }
+            else
+            {
+                result = is_ipv6_host(address);
+                if( result == RESULT_FAILURE )
+                {
+                    if( ((compare_network_address(address) >= 0) && (cidr_get_pflen(address) != 128)) )
+                    {
+                        snprintf(reason, reason_size, "%s is an IPv6 network address, not a host address", address_str);
+                    }
+                }
+            }
+            break;
+        case IS_IPV6_NET:
+            /* Host vs. network address check only makes sense
+               if prefix length is given */
+            if( !(cidr_get_proto(address) == CIDR_IPV6) ) {
+                snprintf(reason, reason_size, "%s is not a valid IPv6 address", address_str);
+                result = RESULT_FAILURE;
+                break;
+            }
+
+            if( !is_ipv6_cidr_r(ctx, address_str) )
+            {
+                snprintf(reason, reason_size, "Cannot check if %s is a valid IPv6 network address: missing prefix length", address_str);
+                result = RESULT_FAILURE;
+            }
+            else
+            {
+                result = is_ipv6_net(address);
+                if( result == RESULT_FAILURE )
+                {
+                    if( ((compare_network_address(address) < 0) && (cidr_get_pflen(address) != 128)) ) {
+                        network_addr = network_address_str(address);
+                        snprintf(reason, reason_size, "%s is an IPv6 host address, not a network address. Did you mean %s?", address_str, network_addr);
+                        free(network_addr);
+                    }
+                }
+            }
+            break;
+        case IS_IPV6_MULTICAST:
+             result = is_ipv6_multicast(address);
+             break;
+        case IS_IPV6_LINKLOCAL:
+             result = is_ipv6_link_local(address);
+             break;
+        case IS_ANY_CIDR:
+             result = is_any_cidr_r(ctx, address_str);
+             break;
+        case IS_ANY_SINGLE:
+             result = is_any_single_r(ctx, address_str);
+             break;
+        case IS_VALID_INTF_ADDR:
+             result = is_valid_intf_address_r(ctx, address, address_str, allow_loopback);
+             break;
+        case NO_ACTION:
+             break;
+        case IS_ANY_HOST:
+            /* Host vs. network address check only makes sense if prefix length is given */
+             if( !is_any_cidr_r(ctx, address_str) )
+             {
+                snprintf(reason, reason_size, "Cannot check if %s is a valid host address: missing prefix length", address_str);
+                result = RESULT_FAILURE;
+             }
+             else
+             {
+                 result = is_any_host(address);
+                 if( result == RESULT_FAILURE ) {
+                     if( ((compare_network_address(address) >= 0) &&
+                          (cidr_get_pflen(address) != 32) &&
+                          (cidr_get_pflen(address) != 128)) )
+                     {
+                         snprintf(reason, reason_size, "%s is a network address, not a host address", address_str);
+                     }
+                 }
+             }
+             break;
+        case IS_ANY_NET:
+            /* Host vs. network address check only makes sense if prefix length is given */
+             if( !is_any_cidr_r(ctx, address_str) )
+             {
+                 snprintf(reason, reason_size, "Cannot check if %s is a valid network address: missing prefix length", address_str);
+                 result = RESULT_FAILURE;
+             }
+             else
+             {
+                 result = is_any_net(address);
+                 if( result == RESULT_FAILURE )
+                 {
+                     if( ((compare_network_address(address) < 0) &&
+                          (cidr_get_pflen(address) != 128) &&
+                          (cidr_get_pflen(address) != 32)) )
+                     {
+                         network_addr = network_address_str(address);
+                         snprintf(reason, reason_size, "%s is a host address, not a network address. Did you mean %s?", address_str, network_addr);
+                         free(network_addr);
+                     }
+                 }
+             }
+             break;
+        case IS_IN_PREFIX_INDEX:
+             if( str_to_ipaddr_bin_r(ctx, address_str, &address_bin) != RESULT_SUCCESS )
+             {
+                 result = RESULT_FAILURE;
+             }
+             else
+             {
+                 /* The check does not use the categories */
+                 result = check_ipaddr_bin_classified(IS_IN_PREFIX_INDEX, &address_bin, 0, allow_loopback);
+             }
+             break;
+        default:
+             break;
+    }
+
+    return(result);
+}
+
+int check_address_format(CIDR* address, char* address_str, char* reason, size_t reason_size)
+{
+    return(check_address_format_r(ipaddrcheck_default_ctx(), address, address_str, reason, reason_size));
+}
+
+int check_address(int action, CIDR* address, char* address_str, int allow_loopback,
+                  char* reason, size_t reason_size)
+{
+    return(check_address_r(ipaddrcheck_default_ctx(), action, address, address_str, allow_loopback,
+                           reason, reason_size));
+}
+
+/* Run the format check and then the given checks on the first len bytes
+ * at ptr, which need not be null-terminated, until one of them fails.
+ * The input is never read past len or written to.
+ *
+ * The reason buffer gets the explanation of the failure, if any.
+ */
+int check_address_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len,
+                    const int* checks, int check_count, int allow_loopback,
+                    char* reason, size_t reason_size)
+{
+    char address_str[ADDRESS_SLICE_MAX];
+    CIDR* address;
+    int result;
+    int i;
+
+    /* Embedded null bytes would cut the copy short */
+    if( (len >= sizeof(address_str)) || (memchr(ptr, '\0', len) != NULL) )
+    {
+        snprintf(reason, reason_size, "Malformed address %.*s",
+                 (int)((len < reason_size) ? len : reason_size), ptr);
+        return(RESULT_FAILURE);
+    }
+    memcpy(address_str, ptr, len);
+    address_str[len] = '\0';
+
+    address = cidr_from_str(address_str);
+    result = check_address_format_r(ctx, address, address_str, reason, reason_size);
+    for( i = 0; (i < check_count) && (result == RESULT_SUCCESS); i++ )
+    {
+        result = check_address_r(ctx, checks[i], address, address_str, allow_loopback,
+                                 reason, reason_size);
+        if( (result != RESULT_SUCCESS) && (reason[0] == '\0') )
+        {
+            snprintf(reason, reason_size, "%s did not pass --%s", address_str, action_name(checks[i]));
+        }
+    }
+
+    if( address != NULL )
+    {
+        cidr_free(address);
+    }
+
+    return(result);
+}
+
+/* Run every check on an address, rather than stopping at the first failure,
+ * and print one "NAME pass" or "NAME fail" line per check in the given order.
+ * A malformed address fails all of them. With verbose, the reasons
+ * of the failures go to stderr.
+ *
+ * Returns RESULT_SUCCESS if the address passed all checks.
+ */
+int report_checks(const int* actions, int check_count, CIDR* address, char* address_str,
+                  int allow_loopback, int verbose, FILE* output)
+{
+    size_t reason_size = CHECK_REASON_SIZE(strlen(address_str));
+    char* reason = malloc(reason_size);
+    int format_result;
+    int result = RESULT_SUCCESS;
+    int i;
+
+    if( reason == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    format_result = check_address_format(address, address_str, reason, reason_size);
+    if( (format_result != RESULT_SUCCESS) && verbose )
+    {
+        fprintf(stderr, "%s\n", reason);
+    }
+
+    for( i = 0; i < check_count; i++ )
+    {
+        int check_result = format_result;
+
+        if( format_result == RESULT_SUCCESS )
+        {
+            check_result = check_address(actions[i], address, address_str, allow_loopback,
+                                         reason, reason_size);
+            if( verbose && (reason[0] != '\0') )
+            {
+                fprintf(stderr, "%s\n", reason);
+            }
+        }
+
+        fprintf(output, "%s %s\n", action_name(actions[i]),
+                (check_result == RESULT_SUCCESS) ? "pass" : "fail");
+        if( check_result != RESULT_SUCCESS )
+        {
+            result = RESULT_FAILURE;
+        }
+    }
+
+    free(reason);
+    fflush(output);
+
+    return(result);
+}
+
+/* Are all bits after the prefix equal to value (0 or 1)? */
+static int host_bits_equal(const struct ipaddr_bin* address, int value)
+{
+    int first_bit = (address->proto == CIDR_IPV4) ? 96 + address->pflen : address->pflen;
+    uint8_t fill = value ? 0xFF : 0x00;
+    int i;
+
+    if( first_bit % 8 != 0 )
+    {
+        uint8_t mask = 0xFF >> (first_bit % 8);
+        if( (address->addr[first_bit / 8] & mask) != (fill & mask) )
+        {
+            return(0);
+        }
+        first_bit += 8 - first_bit % 8;
+    }
+
+    for( i = first_bit / 8; i < 16; i++ )
+    {
+        if( address->addr[i] != fill )
+        {
+            return(0);
+        }
+    }
+
+    return(1);
+}
+
+/* Are all bytes of the address equal to byte? */
+static int is_filled_address(const struct ipaddr_bin* address, uint8_t byte)
+{
+    int i;
+
+    for( i = (address->proto == CIDR_IPV4) ? 12 : 0; i < 16; i++ )
+    {
+        if( address->addr[i] != byte )
+        {
+            return(0);
+        }
+    }
+
+    return(1);
+}
+
+/* Is it ::1, regardless of prefix length? */
+static int is_ipv6_loopback_address(const struct ipaddr_bin* address)
+{
+    int i;
+
+    for( i = 0; i < 15; i++ )
+    {
+        if( address->addr[i] != 0 )
+        {
+            return(0);
+        }
+    }
+
+    return(address->addr[15] == 1);
+}
+
+#define BIN_RESULT(condition) ((condition) ? RESULT_SUCCESS : RESULT_FAILURE)
+
+/* Run a single check on an address in binary form.
+ *
+ * The results match check_address() for the text form with a prefix length,
+ * with the difference that binary addresses always carry one: host and network
+ * checks are never refused for a missing prefix length, and "single" checks
+ * succeed for full length prefixes.
+ */
+int check_ipaddr_bin_classified(int action, const struct ipaddr_bin* address, uint64_t categories,
+                                int allow_loopback)
+{
+    int ipv4 = (address->proto == CIDR_IPV4);
+    int ipv6 = (address->proto == CIDR_IPV6);
+    int full_length = (address->pflen == (ipv4 ? 32 : 128));
+
+    switch(action)
+    {
+        case IS_VALID:
+        case IS_ANY_CIDR:
+            return(RESULT_SUCCESS);
+        case IS_IPV4:
+        case IS_IPV4_CIDR:
+            return(BIN_RESULT(ipv4));
+        case IS_IPV4_SINGLE:
+            return(BIN_RESULT(ipv4 && full_length));
+        case IS_IPV4_HOST:
+            return(BIN_RESULT(ipv4 && (!host_bits_equal(address, 0) || (address->pflen >= 31))));
+        case IS_IPV4_NET:
+            return(BIN_RESULT(ipv4 && host_bits_equal(address, 0)));
+        case IS_IPV4_BROADCAST:
+            return(BIN_RESULT(ipv4 && host_bits_equal(address, 1) && (address->pflen < 31)));
+        case IS_IPV4_MULTICAST:
+            return(BIN_RESULT(ipv4 && (categories & SPECIAL_MULTICAST)));
+        case IS_IPV4_LOOPBACK:
+            return(BIN_RESULT(ipv4 && (categories & SPECIAL_LOOPBACK)));
+        case IS_IPV4_LINKLOCAL:
+            return(BIN_RESULT(ipv4 && (categories & SPECIAL_LINK_LOCAL)));
+        case IS_IPV4_RFC1918:
+            return(BIN_RESULT(ipv4 && (categories & SPECIAL_PRIVATE_USE)));
+        case IS_IPV6:
+        case IS_IPV6_CIDR:
+            return(BIN_RESULT(ipv6));
+        case IS_IPV6_SINGLE:
+            return(BIN_RESULT(ipv6 && full_length));
+        case IS_IPV6_HOST:
+            return(BIN_RESULT(ipv6 && (!host_bits_equal(address, 0) || (address->pflen >= 127))));
+        case IS_IPV6_NET:
+            return(BIN_RESULT(ipv6 && host_bits_equal(address, 0)));
+        case IS_IPV6_MULTICAST:
+            return(BIN_RESULT(ipv6 && (categories & SPECIAL_MULTICAST)));
+        case IS_IPV6_LINKLOCAL:
+            return(BIN_RESULT(ipv6 && (categories & SPECIAL_LINK_LOCAL_SUBNET)));
+        case IS_ANY_SINGLE:
+            return(BIN_RESULT(full_length));
+        case IS_ANY_HOST:
+            return(BIN_RESULT((check_ipaddr_bin_classified(IS_IPV4_HOST, address, categories, allow_loopback) == RESULT_SUCCESS) ||
+                              (check_ipaddr_bin_classified(IS_IPV6_HOST, address, categories, allow_loopback) == RESULT_SUCCESS)));
+        case IS_ANY_NET:
+            return(BIN_RESULT(host_bits_equal(address, 0)));
+        case IS_VALID_INTF_ADDR:
+            return(BIN_RESULT(
+                (check_ipaddr_bin_classified(IS_IPV4_BROADCAST, address, categories, allow_loopback) == RESULT_FAILURE) &&
+                !(categories & SPECIAL_MULTICAST) &&
+                (!(ipv4 && (categories & SPECIAL_LOOPBACK)) || (allow_loopback == LOOPBACK_ALLOWED)) &&
+                !(ipv6 && full_length && is_ipv6_loopback_address(address)) &&
+                !(ipv4 && (address->pflen == 0) && is_filled_address(address, 0x00)) &&
+                !(categories & SPECIAL_THIS_NETWORK) &&
+                !(ipv4 && full_length && is_filled_address(address, 0xFF)) &&
+                (check_ipaddr_bin_classified(IS_ANY_HOST, address, categories, allow_loopback) == RESULT_SUCCESS) ));
+        case IS_IN_PREFIX_INDEX:
+            return(BIN_RESULT((check_prefix_index != NULL) &&
+                              (prefix_index_contains(check_prefix_index, address) == RESULT_SUCCESS)));
+        default:
+            return(RESULT_SUCCESS);
+    }
+}
+
+/* Run a single check on an address in binary form,
+   see check_ipaddr_bin_classified() */
+int check_ipaddr_bin(int action, const struct ipaddr_bin* address, int allow_loopback)
+{
+    return(check_ipaddr_bin_classified(action, address, classify_ipaddr_bin(address), allow_loopback));
+}
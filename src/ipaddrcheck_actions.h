@@ -0,0 +1,92 @@
+/*
+ * ipaddrcheck_actions.h: evaluation of the checks selected on the command line
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_ACTIONS_H
+#define IPADDRCHECK_ACTIONS_H
+
+#include "ipaddrcheck_functions.h"
+
+/* Option codes */
+#define IS_VALID              10
+#define IS_IPV4               20
+#define IS_IPV4_CIDR          30
+#define IS_IPV4_SINGLE        40
+#define IS_IPV4_HOST          50
+#define IS_IPV4_NET           60
+#define IS_IPV4_BROADCAST     70
+#define IS_IPV4_UNICAST       80
+#define IS_IPV4_MULTICAST     90
+#define IS_IPV4_RFC1918       100
+#define IS_IPV4_LOOPBACK      110
+#define IS_IPV4_LINKLOCAL     120
+#define IS_IPV6               130
+#define IS_IPV6_CIDR          140
+#define IS_IPV6_SINGLE        150
+#define IS_IPV6_HOST          160
+#define IS_IPV6_NET           170
+#define IS_IPV6_UNICAST       180
+#define IS_IPV6_MULTICAST     190
+#define IS_IPV6_LINKLOCAL     200
+#define IS_VALID_INTF_ADDR    220
+#define IS_ANY_CIDR           230
+#define IS_ANY_SINGLE         240
+#define ALLOW_LOOPBACK        250
+#define IS_ANY_HOST           260
+#define IS_ANY_NET            270
+
+/* Uses the index set with set_check_prefix_index() */
+#define IS_IN_PREFIX_INDEX    300
+
+/* XXX: These options are handled outside of the main switch
+ * because they the main switch was design to handle
+ * only single addresses directly parseable by libcidr.
+ * Ideally, we should refactor that at some point in the future...
+ */
+#define IS_IPV4_RANGE         280
+#define IS_IPV6_RANGE         290
+
+#define NO_ACTION             500
+
+/* Size of a buffer large enough for any diagnostic about an address string
+   of given length: the messages quote it once, plus a network address */
+#define CHECK_REASON_SIZE(address_length) ((address_length) + IPADDR_STR_MAX + 128)
+
+struct prefix_index;
+
+const char* action_name(int action);
+void set_check_prefix_index(const struct prefix_index* index);
+int check_address_format_r(const struct ipaddrcheck_ctx* ctx, CIDR* address, const char* address_str,
+                           char* reason, size_t reason_size);
+int check_address_r(const struct ipaddrcheck_ctx* ctx, int action, CIDR* address, const char* address_str,
+                    int allow_loopback, char* reason, size_t reason_size);
+int check_address_format(CIDR* address, char* address_str, char* reason, size_t reason_size);
+int check_address(int action, CIDR* address, char* address_str, int allow_loopback,
+                  char* reason, size_t reason_size);
+int check_address_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len,
+                    const int* checks, int check_count, int allow_loopback,
+                    char* reason, size_t reason_size);
+int report_checks(const int* actions, int check_count, CIDR* address, char* address_str,
+                  int allow_loopback, int verbose, FILE* output);
+int check_ipaddr_bin_classified(int action, const struct ipaddr_bin* address, uint64_t categories,
+                                int allow_loopback);
+int check_ipaddr_bin(int action, const struct ipaddr_bin* address, int allow_loopback);
+
+#endif /* IPADDRCHECK_ACTIONS_H */
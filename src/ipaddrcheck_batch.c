@@ -0,0 +1,355 @@
+/*
+ * ipaddrcheck_batch.c: classification of address batches
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "ipaddrcheck_batch.h"
+#include "ipaddrcheck_actions.h"
+
+/* The vector implementations are compiled for their instruction sets
+   function by function, so that the rest of the program runs anywhere */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+#define BATCH_ALIGNMENT 64
+
+/* The registry entries behind the properties, see data/.
+   An address with a prefix length only has a property
+   if the whole prefix is in the entry, like in classify_ipaddr_bin(). */
+#define BATCH_MASK(length) ((uint32_t)(0xFFFFFFFFULL << (32 - (length))))
+
+#define BATCH_IPV4_MULTICAST_NET    0xE0000000  /* 224.0.0.0/4 */
+#define BATCH_IPV4_MULTICAST_LEN    4
+#define BATCH_IPV4_LOOPBACK_NET     0x7F000000  /* 127.0.0.0/8 */
+#define BATCH_IPV4_LOOPBACK_LEN     8
+#define BATCH_IPV4_LINKLOCAL_NET    0xA9FE0000  /* 169.254.0.0/16 */
+#define BATCH_IPV4_LINKLOCAL_LEN    16
+#define BATCH_IPV4_RFC1918_A_NET    0x0A000000  /* 10.0.0.0/8 */
+#define BATCH_IPV4_RFC1918_A_LEN    8
+#define BATCH_IPV4_RFC1918_B_NET    0xAC100000  /* 172.16.0.0/12 */
+#define BATCH_IPV4_RFC1918_B_LEN    12
+#define BATCH_IPV4_RFC1918_C_NET    0xC0A80000  /* 192.168.0.0/16 */
+#define BATCH_IPV4_RFC1918_C_LEN    16
+#define BATCH_IPV6_MULTICAST_NET    0xFF000000  /* ff00::/8, in the first word */
+#define BATCH_IPV6_MULTICAST_LEN    8
+#define BATCH_IPV6_LINKLOCAL_NET    0xFE800000  /* fe80::/64, the second word is zero */
+#define BATCH_IPV6_LINKLOCAL_LEN    64
+
+int ipaddr_batch_init(struct ipaddr_batch* batch, size_t size)
+{
+    void* arrays[6] = { NULL, NULL, NULL, NULL, NULL, NULL };
+    int failed = 0;
+    int i;
+
+    memset(batch, 0, sizeof(*batch));
+    for( i = 0; i < 6; i++ )
+    {
+        size_t array_size = (i < 4) ? size * sizeof(uint32_t) : size;
+
+        if( posix_memalign(&arrays[i], BATCH_ALIGNMENT, array_size ? array_size : 1) != 0 )
+        {
+            arrays[i] = NULL;
+            failed = 1;
+        }
+    }
+    if( failed )
+    {
+        for( i = 0; i < 6; i++ )
+        {
+            free(arrays[i]);
+        }
+        return(RESULT_INT_ERROR);
+    }
+
+    for( i = 0; i < 4; i++ )
+    {
+        batch->words[i] = arrays[i];
+    }
+    batch->protos = arrays[4];
+    batch->pflens = arrays[5];
+    batch->size = size;
+
+    return(RESULT_SUCCESS);
+}
+
+void ipaddr_batch_free(struct ipaddr_batch* batch)
+{
+    int i;
+
+    for( i = 0; i < 4; i++ )
+    {
+        free(batch->words[i]);
+    }
+    free(batch->protos);
+    free(batch->pflens);
+    memset(batch, 0, sizeof(*batch));
+}
+
+/* Store an address at index, which must be below the size of the batch,
+   or no address if it is NULL. Does not change the count. */
+void ipaddr_batch_set(struct ipaddr_batch* batch, size_t index, const struct ipaddr_bin* address)
+{
+    int i;
+
+    if( address == NULL )
+    {
+        for( i = 0; i < 4; i++ )
+        {
+            batch->words[i][index] = 0;
+        }
+        batch->protos[index] = 0;
+        batch->pflens[index] = 0;
+        return;
+    }
+
+    for( i = 0; i < 4; i++ )
+    {
+        const uint8_t* word = &address->addr[4 * i];
+
+        batch->words[i][index] = ((uint32_t)word[0] << 24) | ((uint32_t)word[1] << 16) |
+                                 ((uint32_t)word[2] << 8) | (uint32_t)word[3];
+    }
+    batch->protos[index] = address->proto;
+    batch->pflens[index] = address->pflen;
+}
+
+/* The property bit of a check, or 0 if it is not one of them */
+uint8_t batch_property(int action)
+{
+    switch(action)
+    {
+        case IS_IPV4:
+        case IS_IPV4_CIDR:
+            return(BATCH_IPV4);
+        case IS_IPV6:
+        case IS_IPV6_CIDR:
+            return(BATCH_IPV6);
+        case IS_IPV4_MULTICAST:
+            return(BATCH_IPV4_MULTICAST);
+        case IS_IPV4_LOOPBACK:
+            return(BATCH_IPV4_LOOPBACK);
+        case IS_IPV4_LINKLOCAL:
+            return(BATCH_IPV4_LINKLOCAL);
+        case IS_IPV4_RFC1918:
+            return(BATCH_IPV4_RFC1918);
+        case IS_IPV6_MULTICAST:
+            return(BATCH_IPV6_MULTICAST);
+        case IS_IPV6_LINKLOCAL:
+            return(BATCH_IPV6_LINKLOCAL);
+        default:
+            return(0);
+    }
+}
+
+#define BATCH_IN_WORD(word, pflen, name) \
+    ((((word) & BATCH_MASK(name ## _LEN)) == name ## _NET) && ((pflen) >= name ## _LEN))
+
+static void classify_batch_scalar(const struct ipaddr_batch* batch, uint8_t* properties, size_t start)
+{
+    size_t i;
+
+    for( i = start; i < batch->count; i++ )
+    {
+        uint32_t first = batch->words[0][i];
+        uint32_t last = batch->words[3][i];
+        unsigned int pflen = batch->pflens[i];
+        int ipv4 = (batch->protos[i] == CIDR_IPV4);
+        int ipv6 = (batch->protos[i] == CIDR_IPV6);
+        int rfc1918 = BATCH_IN_WORD(last, pflen, BATCH_IPV4_RFC1918_A) ||
+                      BATCH_IN_WORD(last, pflen, BATCH_IPV4_RFC1918_B) ||
+                      BATCH_IN_WORD(last, pflen, BATCH_IPV4_RFC1918_C);
+
+        properties[i] = (uint8_t)(
+            (ipv4 ? BATCH_IPV4 : 0) |
+            (ipv6 ? BATCH_IPV6 : 0) |
+            ((ipv4 && BATCH_IN_WORD(last, pflen, BATCH_IPV4_MULTICAST)) ? BATCH_IPV4_MULTICAST : 0) |
+            ((ipv4 && BATCH_IN_WORD(last, pflen, BATCH_IPV4_LOOPBACK)) ? BATCH_IPV4_LOOPBACK : 0) |
+            ((ipv4 && BATCH_IN_WORD(last, pflen, BATCH_IPV4_LINKLOCAL)) ? BATCH_IPV4_LINKLOCAL : 0) |
+            ((ipv4 && rfc1918) ? BATCH_IPV4_RFC1918 : 0) |
+            ((ipv6 && BATCH_IN_WORD(first, pflen, BATCH_IPV6_MULTICAST)) ? BATCH_IPV6_MULTICAST : 0) |
+            ((ipv6 && (first == BATCH_IPV6_LINKLOCAL_NET) && (batch->words[1][i] == 0) &&
+              (pflen >= BATCH_IPV6_LINKLOCAL_LEN)) ? BATCH_IPV6_LINKLOCAL : 0));
+    }
+}
+
+#ifdef BATCH_X86
+
+/* All ones in the lanes where the masked words equal the network
+   and the prefix length is at least that of the network */
+#define BATCH_AVX2_IN(words, pflens, name) \
+    _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256((words), _mm256_set1_epi32((int)BATCH_MASK(name ## _LEN))), \
+                                        _mm256_set1_epi32((int)name ## _NET)), \
+                     _mm256_cmpgt_epi32((pflens), _mm256_set1_epi32(name ## _LEN - 1)))
+
+#define BATCH_AVX2_BIT(lanes, bit) _mm256_and_si256((lanes), _mm256_set1_epi32(bit))
+
+__attribute__((target("avx2")))
+static size_t classify_batch_avx2(const struct ipaddr_batch* batch, uint8_t* properties)
+{
+    /* Byte 0 of every 32-bit lane, to the low 4 bytes of each 128-bit half */
+    const __m256i pack = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    size_t i;
+
+    for( i = 0; i + 8 <= batch->count; i += 8 )
+    {
+        __m256i first = _mm256_load_si256((const __m256i*)&batch->words[0][i]);
+        __m256i second = _mm256_load_si256((const __m256i*)&batch->words[1][i]);
+        __m256i last = _mm256_load_si256((const __m256i*)&batch->words[3][i]);
+        __m256i protos = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&batch->protos[i]));
+        __m256i pflens = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&batch->pflens[i]));
+        __m256i ipv4 = _mm256_cmpeq_epi32(protos, _mm256_set1_epi32(CIDR_IPV4));
+        __m256i ipv6 = _mm256_cmpeq_epi32(protos, _mm256_set1_epi32(CIDR_IPV6));
+        __m256i rfc1918 = _mm256_or_si256(_mm256_or_si256(BATCH_AVX2_IN(last, pflens, BATCH_IPV4_RFC1918_A),
+                                                          BATCH_AVX2_IN(last, pflens, BATCH_IPV4_RFC1918_B)),
+                                          BATCH_AVX2_IN(last, pflens, BATCH_IPV4_RFC1918_C));
+        __m256i ipv6_linklocal = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi32(first, _mm256_set1_epi32((int)BATCH_IPV6_LINKLOCAL_NET)),
+                             _mm256_cmpeq_epi32(second, _mm256_setzero_si256())),
+            _mm256_cmpgt_epi32(pflens, _mm256_set1_epi32(BATCH_IPV6_LINKLOCAL_LEN - 1)));
+        __m256i ipv4_bits = _mm256_or_si256(
+            _mm256_or_si256(BATCH_AVX2_BIT(BATCH_AVX2_IN(last, pflens, BATCH_IPV4_MULTICAST), BATCH_IPV4_MULTICAST),
+                            BATCH_AVX2_BIT(BATCH_AVX2_IN(last, pflens, BATCH_IPV4_LOOPBACK), BATCH_IPV4_LOOPBACK)),
+            _mm256_or_si256(BATCH_AVX2_BIT(BATCH_AVX2_IN(last, pflens, BATCH_IPV4_LINKLOCAL), BATCH_IPV4_LINKLOCAL),
+                            BATCH_AVX2_BIT(rfc1918, BATCH_IPV4_RFC1918)));
+        __m256i ipv6_bits = _mm256_or_si256(
+            BATCH_AVX2_BIT(BATCH_AVX2_IN(first, pflens, BATCH_IPV6_MULTICAST), BATCH_IPV6_MULTICAST),
+            BATCH_AVX2_BIT(ipv6_linklocal, BATCH_IPV6_LINKLOCAL));
+        __m256i bits = _mm256_or_si256(_mm256_and_si256(ipv4, _mm256_or_si256(ipv4_bits, _mm256_set1_epi32(BATCH_IPV4))),
+                                       _mm256_and_si256(ipv6, _mm256_or_si256(ipv6_bits, _mm256_set1_epi32(BATCH_IPV6))));
+        __m256i packed = _mm256_shuffle_epi8(bits, pack);
+        uint32_t low = (uint32_t)_mm256_extract_epi32(packed, 0);
+        uint32_t high = (uint32_t)_mm256_extract_epi32(packed, 4);
+
+        memcpy(&properties[i], &low, 4);
+        memcpy(&properties[i + 4], &high, 4);
+    }
+
+    return(i);
+}
+
+/* The same with mask registers */
+#define BATCH_AVX512_IN(words, pflens, name) \
+    _mm512_mask_cmpeq_epi32_mask(_mm512_cmpgt_epi32_mask((pflens), _mm512_set1_epi32(name ## _LEN - 1)), \
+                                 _mm512_and_si512((words), _mm512_set1_epi32((int)BATCH_MASK(name ## _LEN))), \
+                                 _mm512_set1_epi32((int)name ## _NET))
+
+#define BATCH_AVX512_SET(bits, lanes, bit) _mm512_mask_or_epi32((bits), (lanes), (bits), _mm512_set1_epi32(bit))
+
+__attribute__((target("avx512f")))
+static size_t classify_batch_avx512(const struct ipaddr_batch* batch, uint8_t* properties)
+{
+    size_t i;
+
+    for( i = 0; i + 16 <= batch->count; i += 16 )
+    {
+        __m512i first = _mm512_load_si512((const void*)&batch->words[0][i]);
+        __m512i second = _mm512_load_si512((const void*)&batch->words[1][i]);
+        __m512i last = _mm512_load_si512((const void*)&batch->words[3][i]);
+        __m512i protos = _mm512_cvtepu8_epi32(_mm_load_si128((const __m128i*)&batch->protos[i]));
+        __m512i pflens = _mm512_cvtepu8_epi32(_mm_load_si128((const __m128i*)&batch->pflens[i]));
+        __mmask16 ipv4 = _mm512_cmpeq_epi32_mask(protos, _mm512_set1_epi32(CIDR_IPV4));
+        __mmask16 ipv6 = _mm512_cmpeq_epi32_mask(protos, _mm512_set1_epi32(CIDR_IPV6));
+        __mmask16 rfc1918 = BATCH_AVX512_IN(last, pflens, BATCH_IPV4_RFC1918_A) |
+                            BATCH_AVX512_IN(last, pflens, BATCH_IPV4_RFC1918_B) |
+                            BATCH_AVX512_IN(last, pflens, BATCH_IPV4_RFC1918_C);
+        __mmask16 ipv6_linklocal = _mm512_cmpeq_epi32_mask(first, _mm512_set1_epi32((int)BATCH_IPV6_LINKLOCAL_NET)) &
+                                   _mm512_cmpeq_epi32_mask(second, _mm512_setzero_si512()) &
+                                   _mm512_cmpgt_epi32_mask(pflens, _mm512_set1_epi32(BATCH_IPV6_LINKLOCAL_LEN - 1));
+        __m512i bits = _mm512_setzero_si512();
+
+        bits = BATCH_AVX512_SET(bits, ipv4, BATCH_IPV4);
+        bits = BATCH_AVX512_SET(bits, ipv6, BATCH_IPV6);
+        bits = BATCH_AVX512_SET(bits, ipv4 & BATCH_AVX512_IN(last, pflens, BATCH_IPV4_MULTICAST), BATCH_IPV4_MULTICAST);
+        bits = BATCH_AVX512_SET(bits, ipv4 & BATCH_AVX512_IN(last, pflens, BATCH_IPV4_LOOPBACK), BATCH_IPV4_LOOPBACK);
+        bits = BATCH_AVX512_SET(bits, ipv4 & BATCH_AVX512_IN(last, pflens, BATCH_IPV4_LINKLOCAL), BATCH_IPV4_LINKLOCAL);
+        bits = BATCH_AVX512_SET(bits, ipv4 & rfc1918, BATCH_IPV4_RFC1918);
+        bits = BATCH_AVX512_SET(bits, ipv6 & BATCH_AVX512_IN(first, pflens, BATCH_IPV6_MULTICAST), BATCH_IPV6_MULTICAST);
+        bits = BATCH_AVX512_SET(bits, ipv6 & ipv6_linklocal, BATCH_IPV6_LINKLOCAL);
+
+        _mm_storeu_si128((__m128i*)&properties[i], _mm512_cvtepi32_epi8(bits));
+    }
+
+    return(i);
+}
+
+#endif /* BATCH_X86 */
+
+/* The fastest implementation this CPU can run */
+int classify_batch_best_impl(void)
+{
+#ifdef BATCH_X86
+    if( __builtin_cpu_supports("avx512f") )
+    {
+        return(BATCH_IMPL_AVX512);
+    }
+    if( __builtin_cpu_supports("avx2") )
+    {
+        return(BATCH_IMPL_AVX2);
+    }
+#endif
+    return(BATCH_IMPL_SCALAR);
+}
+
+const char* classify_batch_impl_name(int impl)
+{
+    switch(impl)
+    {
+        case BATCH_IMPL_AVX2:
+            return("avx2");
+        case BATCH_IMPL_AVX512:
+            return("avx512");
+        default:
+            return("scalar");
+    }
+}
+
+/* Write the property bits of every address of the batch to properties,
+ * with the given implementation, which must not be better than
+ * classify_batch_best_impl(). Vector implementations leave the
+ * addresses after the last whole vector to the scalar one.
+ */
+void classify_ipaddr_batch_impl(const struct ipaddr_batch* batch, uint8_t* properties, int impl)
+{
+    size_t done = 0;
+
+#ifdef BATCH_X86
+    if( impl == BATCH_IMPL_AVX512 )
+    {
+        done = classify_batch_avx512(batch, properties);
+    }
+    else if( impl == BATCH_IMPL_AVX2 )
+    {
+        done = classify_batch_avx2(batch, properties);
+    }
+#else
+    (void)impl;
+#endif
+
+    classify_batch_scalar(batch, properties, done);
+}
+
+void classify_ipaddr_batch(const struct ipaddr_batch* batch, uint8_t* properties)
+{
+    classify_ipaddr_batch_impl(batch, properties, classify_batch_best_impl());
+}
@@ -0,0 +1,66 @@
+/*
+ * ipaddrcheck_batch.h: classification of address batches
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_BATCH_H
+#define IPADDRCHECK_BATCH_H
+
+#include "ipaddrcheck_functions.h"
+
+/* Properties computed by classify_ipaddr_batch(), one bit each.
+   They have the same results as the checks of the same names. */
+#define BATCH_IPV4              (1 << 0)
+#define BATCH_IPV6              (1 << 1)
+#define BATCH_IPV4_MULTICAST    (1 << 2)
+#define BATCH_IPV4_LOOPBACK     (1 << 3)
+#define BATCH_IPV4_LINKLOCAL    (1 << 4)
+#define BATCH_IPV4_RFC1918      (1 << 5)
+#define BATCH_IPV6_MULTICAST    (1 << 6)
+#define BATCH_IPV6_LINKLOCAL    (1 << 7)
+
+/* Implementations, the best one the CPU supports is used by default */
+#define BATCH_IMPL_SCALAR       0
+#define BATCH_IMPL_AVX2         1   /* 8 addresses per instruction */
+#define BATCH_IMPL_AVX512       2   /* 16 addresses per instruction */
+
+/* Addresses in structure-of-arrays layout: every 32-bit word of the
+ * addresses has an array of its own, so that one vector load gets the
+ * same word of 8 or 16 addresses. Words are in host byte order and
+ * IPv4 addresses are in words[3], like in struct ipaddr_bin.
+ * The arrays are 64-byte aligned.
+ */
+struct ipaddr_batch {
+    uint32_t* words[4];
+    uint8_t* protos;        /* CIDR_IPV4, CIDR_IPV6, or 0 for no address */
+    uint8_t* pflens;
+    size_t count;
+    size_t size;
+};
+
+int ipaddr_batch_init(struct ipaddr_batch* batch, size_t size);
+void ipaddr_batch_free(struct ipaddr_batch* batch);
+void ipaddr_batch_set(struct ipaddr_batch* batch, size_t index, const struct ipaddr_bin* address);
+uint8_t batch_property(int action);
+int classify_batch_best_impl(void);
+const char* classify_batch_impl_name(int impl);
+void classify_ipaddr_batch_impl(const struct ipaddr_batch* batch, uint8_t* properties, int impl);
+void classify_ipaddr_batch(const struct ipaddr_batch* batch, uint8_t* properties);
+
+#endif /* IPADDRCHECK_BATCH_H */
@@ -0,0 +1,308 @@
+/*
+ * ipaddrcheck_binary.c: packed binary address records
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "ipaddrcheck_binary.h"
+#include "ipaddrcheck_actions.h"
+#include "ipaddrcheck_special.h"
+#include "ipaddrcheck_batch.h"
+
+/* Number of records read and written with a single call */
+#define BINARY_BATCH_SIZE 4096
+
+/* Convert a record to the internal form, fails for records that are
+   malformed or of family BINARY_FAMILY_INVALID */
+int binary_record_to_ipaddr_bin(const struct binary_record* record, struct ipaddr_bin* address)
+{
+    int i;
+
+    memset(address, 0, sizeof(*address));
+
+    if( record->family == BINARY_FAMILY_IPV4 )
+    {
+        if( record->pflen > 32 )
+        {
+            return(RESULT_FAILURE);
+        }
+        for( i = 4; i < 16; i++ )
+        {
+            if( record->addr[i] != 0 )
+            {
+                return(RESULT_FAILURE);
+            }
+        }
+        address->proto = CIDR_IPV4;
+        memcpy(&address->addr[12], record->addr, 4);
+    }
+    else if( record->family == BINARY_FAMILY_IPV6 )
+    {
+        if( record->pflen > 128 )
+        {
+            return(RESULT_FAILURE);
+        }
+        address->proto = CIDR_IPV6;
+        memcpy(address->addr, record->addr, 16);
+    }
+    else
+    {
+        return(RESULT_FAILURE);
+    }
+
+    address->pflen = record->pflen;
+
+    return(RESULT_SUCCESS);
+}
+
+void ipaddr_bin_to_binary_record(const struct ipaddr_bin* address, struct binary_record* record)
+{
+    memset(record, 0, sizeof(*record));
+
+    if( address->proto == CIDR_IPV4 )
+    {
+        record->family = BINARY_FAMILY_IPV4;
+        memcpy(record->addr, &address->addr[12], 4);
+    }
+    else
+    {
+        record->family = BINARY_FAMILY_IPV6;
+        memcpy(record->addr, address->addr, 16);
+    }
+    record->pflen = address->pflen;
+}
+
+/* Run the checks on every input record and write a result bit mask for each.
+ * If all checks are properties of classify_ipaddr_batch(), records are
+ * classified a batch at a time rather than one check at a time.
+ *
+ * Malformed records get a mask of all zeros and make the function return
+ * RESULT_FAILURE, as does an incomplete record at the end of the input.
+ * Read and write errors return RESULT_INT_ERROR.
+ */
+int check_binary_records(FILE* input, FILE* output, const int* checks, int check_count, int allow_loopback)
+{
+    int result = RESULT_SUCCESS;
+    size_t mask_size = (check_count + 7) / 8;
+    unsigned char* records;
+    unsigned char* masks;
+    uint8_t* check_properties;
+    uint8_t* properties = NULL;
+    struct ipaddr_batch batch;
+    int use_batch = 1;
+    size_t record_number = 0;
+    size_t pending = 0;
+    size_t bytes_read;
+    size_t count;
+    int j;
+
+    memset(&batch, 0, sizeof(batch));
+    records = malloc(BINARY_BATCH_SIZE * BINARY_RECORD_SIZE);
+    masks = malloc(BINARY_BATCH_SIZE * mask_size);
+    check_properties = malloc(check_count + 1);
+    if( (records == NULL) || (masks == NULL) || (check_properties == NULL) )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free(records);
+        free(masks);
+        free(check_properties);
+        return(RESULT_INT_ERROR);
+    }
+
+    for( j = 0; j < check_count; j++ )
+    {
+        check_properties[j] = batch_property(checks[j]);
+        if( check_properties[j] == 0 )
+        {
+            use_batch = 0;
+        }
+    }
+    if( use_batch )
+    {
+        properties = malloc(BINARY_BATCH_SIZE);
+        if( (properties == NULL) || (ipaddr_batch_init(&batch, BINARY_BATCH_SIZE) != RESULT_SUCCESS) )
+        {
+            /* The checks work without it, only slower */
+            use_batch = 0;
+        }
+    }
+
+    /* Read raw bytes rather than whole records, so that an incomplete
+       record at the end of the input is detected rather than dropped */
+    while( (bytes_read = fread(records + pending, 1, BINARY_BATCH_SIZE * BINARY_RECORD_SIZE - pending, input)) > 0 )
+    {
+        size_t i;
+
+        pending += bytes_read;
+        count = pending / BINARY_RECORD_SIZE;
+        memset(masks, 0, count * mask_size);
+
+        if( use_batch )
+        {
+            for( i = 0; i < count; i++ )
+            {
+                struct binary_record record;
+                struct ipaddr_bin address;
+
+                memcpy(&record, records + i * BINARY_RECORD_SIZE, BINARY_RECORD_SIZE);
+                if( binary_record_to_ipaddr_bin(&record, &address) == RESULT_SUCCESS )
+                {
+                    ipaddr_batch_set(&batch, i, &address);
+                }
+                else
+                {
+                    ipaddr_batch_set(&batch, i, NULL);
+                    result = RESULT_FAILURE;
+                }
+            }
+            batch.count = count;
+            classify_ipaddr_batch(&batch, properties);
+
+            for( i = 0; i < count; i++ )
+            {
+                unsigned char* mask = masks + i * mask_size;
+
+                for( j = 0; j < check_count; j++ )
+                {
+                    if( properties[i] & check_properties[j] )
+                    {
+                        mask[j / 8] |= 1 << (j % 8);
+                    }
+                }
+            }
+        }
+        else
+        {
+            for( i = 0; i < count; i++ )
+            {
+                struct binary_record record;
+                struct ipaddr_bin address;
+                unsigned char* mask = masks + i * mask_size;
+                uint64_t categories;
+
+                memcpy(&record, records + i * BINARY_RECORD_SIZE, BINARY_RECORD_SIZE);
+                if( binary_record_to_ipaddr_bin(&record, &address) != RESULT_SUCCESS )
+                {
+                    result = RESULT_FAILURE;
+                    continue;
+                }
+
+                categories = classify_ipaddr_bin(&address);
+                for( j = 0; j < check_count; j++ )
+                {
+                    if( check_ipaddr_bin_classified(checks[j], &address, categories, allow_loopback) == RESULT_SUCCESS )
+                    {
+                        mask[j / 8] |= 1 << (j % 8);
+                    }
+                }
+            }
+        }
+        record_number += count;
+
+        if( fwrite(masks, mask_size, count, output) != count )
+        {
+            fprintf(stderr, "Error: could not write output\n");
+            result = RESULT_INT_ERROR;
+            break;
+        }
+
+        pending -= count * BINARY_RECORD_SIZE;
+        memmove(records, records + count * BINARY_RECORD_SIZE, pending);
+    }
+
+    if( ferror(input) )
+    {
+        fprintf(stderr, "Error: could not read input\n");
+        result = RESULT_INT_ERROR;
+    }
+    else if( (result != RESULT_INT_ERROR) && (pending > 0) )
+    {
+        fprintf(stderr, "Error: incomplete record after record %zu\n", record_number);
+        result = RESULT_FAILURE;
+    }
+
+    if( fflush(output) != 0 )
+    {
+        result = RESULT_INT_ERROR;
+    }
+
+    free(records);
+    free(masks);
+    free(check_properties);
+    free(properties);
+    ipaddr_batch_free(&batch);
+
+    return(result);
+}
+
+/* Convert text addresses, one per line, to binary records.
+   Malformed addresses produce BINARY_FAMILY_INVALID records
+   and make the function return RESULT_FAILURE. */
+int convert_to_binary(FILE* input, FILE* output, int verbose)
+{
+    int result = RESULT_SUCCESS;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+
+    while( (line_length = getline(&line, &line_size, input)) != -1 )
+    {
+        struct ipaddr_bin address;
+        struct binary_record record;
+
+        while( (line_length > 0) &&
+               ((line[line_length-1] == '\n') || (line[line_length-1] == '\r')) )
+        {
+            line[--line_length] = '\0';
+        }
+
+        if( str_to_ipaddr_bin(line, &address) == RESULT_SUCCESS )
+        {
+            ipaddr_bin_to_binary_record(&address, &record);
+        }
+        else
+        {
+            if( verbose )
+            {
+                fprintf(stderr, "Malformed address %s\n", line);
+            }
+            memset(&record, 0, sizeof(record));
+            result = RESULT_FAILURE;
+        }
+
+        if( fwrite(&record, BINARY_RECORD_SIZE, 1, output) != 1 )
+        {
+            result = RESULT_INT_ERROR;
+            break;
+        }
+    }
+
+    free(line);
+    if( (fflush(output) != 0) || ferror(output) )
+    {
+        result = RESULT_INT_ERROR;
+    }
+    if( result == RESULT_INT_ERROR )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+    }
+
+    return(result);
+}
@@ -0,0 +1,54 @@
+/*
+ * ipaddrcheck_binary.h: packed binary address records
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_BINARY_H
+#define IPADDRCHECK_BINARY_H
+
+#include "ipaddrcheck_functions.h"
+
+/*
+ * Input record: one family byte (4 or 6), 16 address bytes in network order
+ * with IPv4 addresses in the first four and the rest zero, and one prefix
+ * length byte. Records of family BINARY_FAMILY_INVALID mark malformed input
+ * and are produced by --to-binary to keep records aligned with input lines.
+ *
+ * Output record: one bit per requested check, in command line order,
+ * starting from the least significant bit of the first byte,
+ * padded to a whole number of bytes.
+ */
+#define BINARY_FAMILY_INVALID  0
+#define BINARY_FAMILY_IPV4     4
+#define BINARY_FAMILY_IPV6     6
+
+struct binary_record {
+    uint8_t family;
+    uint8_t addr[16];
+    uint8_t pflen;
+};
+
+#define BINARY_RECORD_SIZE     18
+
+int binary_record_to_ipaddr_bin(const struct binary_record* record, struct ipaddr_bin* address);
+void ipaddr_bin_to_binary_record(const struct ipaddr_bin* address, struct binary_record* record);
+int check_binary_records(FILE* input, FILE* output, const int* checks, int check_count, int allow_loopback);
+int convert_to_binary(FILE* input, FILE* output, int verbose);
+
+#endif /* IPADDRCHECK_BINARY_H */
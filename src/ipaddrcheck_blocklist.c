@@ -0,0 +1,501 @@
+/*
+ * ipaddrcheck_blocklist.c: Bloom filter files for large host blocklists
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ipaddrcheck_blocklist.h"
+#include "ipaddrcheck_sort.h"
+
+/* Number of input addresses whose filter blocks are prefetched together */
+#define BLOCKLIST_BATCH_SIZE 64
+
+#ifdef __GNUC__
+#define BLOCKLIST_PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#define BLOCKLIST_PREFETCH(ptr)
+#endif
+
+/* Finalizer of MurmurHash3, every input bit affects every output bit */
+static inline uint64_t blocklist_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return(h);
+}
+
+static uint64_t blocklist_hash(const struct blocklist_key* key)
+{
+    uint64_t words[2];
+    uint64_t h;
+
+    memcpy(words, key->addr, 16);
+    h = blocklist_mix(key->proto * 0x9e3779b97f4a7c15ULL ^ words[0]);
+    h = blocklist_mix(h ^ words[1]);
+
+    return(h);
+}
+
+/* The upper half of the hash selects the block, a second round of mixing
+   provides six bits per word for the bit set in it */
+static inline uint64_t blocklist_block(uint64_t hash, uint64_t block_count)
+{
+    return(((hash >> 32) * block_count) >> 32);
+}
+
+static void blocklist_set(uint64_t* filter, uint64_t block_count, uint64_t hash)
+{
+    uint64_t* block = filter + blocklist_block(hash, block_count) * BLOCKLIST_BLOCK_WORDS;
+    uint64_t bits = blocklist_mix(hash ^ 0x9e3779b97f4a7c15ULL);
+    int i;
+
+    for( i = 0; i < BLOCKLIST_BLOCK_WORDS; i++ )
+    {
+        block[i] |= (uint64_t)1 << ((bits >> (6 * i)) & 63);
+    }
+}
+
+static int blocklist_test(const uint64_t* filter, uint64_t block_count, uint64_t hash)
+{
+    const uint64_t* block = filter + blocklist_block(hash, block_count) * BLOCKLIST_BLOCK_WORDS;
+    uint64_t bits = blocklist_mix(hash ^ 0x9e3779b97f4a7c15ULL);
+    uint64_t missing = 0;
+    int i;
+
+    for( i = 0; i < BLOCKLIST_BLOCK_WORDS; i++ )
+    {
+        missing |= ~block[i] & ((uint64_t)1 << ((bits >> (6 * i)) & 63));
+    }
+
+    return(missing == 0);
+}
+
+static void blocklist_key_from_bin(struct blocklist_key* key, const struct ipaddr_bin* address)
+{
+    key->proto = address->proto;
+    memcpy(key->addr, address->addr, 16);
+}
+
+/* Exact check of a filter positive */
+static int blocklist_search(const struct blocklist* blocklist, const struct blocklist_key* key)
+{
+    uint64_t low = 0;
+    uint64_t high = blocklist->key_count;
+
+    while( low < high )
+    {
+        uint64_t middle = low + (high - low) / 2;
+        int cmp = memcmp(&blocklist->keys[middle], key, sizeof(*key));
+
+        if( cmp == 0 )
+        {
+            return(RESULT_SUCCESS);
+        }
+        else if( cmp < 0 )
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return(RESULT_FAILURE);
+}
+
+static int blocklist_write(FILE* output, const struct blocklist_header* header,
+                           const uint64_t* filter, const struct blocklist_key* keys)
+{
+    if( (fwrite(header, sizeof(*header), 1, output) != 1) ||
+        (fwrite(filter, BLOCKLIST_BLOCK_SIZE, header->block_count, output) != header->block_count) ||
+        (fwrite(keys, sizeof(*keys), header->key_count, output) != header->key_count) )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Build a blocklist file from a list of hosts.
+ *
+ * Every line holds one IPv4 or IPv6 host address, either without a prefix length
+ * or as a /32 or /128. Empty lines and lines starting with "#" are ignored,
+ * duplicates are stored once. Errors are reported to stderr with the offending line number.
+ * Inputs are limited to 2^32 - 1 lines.
+ */
+int blocklist_build(FILE* input, const char* input_name, const char* blocklist_name)
+{
+    int result = RESULT_SUCCESS;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+    size_t line_number = 0;
+
+    struct ipaddr_sort_record* records = NULL;
+    struct ipaddr_sort_record* scratch;
+    size_t count = 0;
+    size_t size = 0;
+
+    struct blocklist_header header;
+    struct blocklist_key* keys;
+    uint64_t* filter;
+    size_t key_count = 0;
+    size_t i;
+    FILE* output;
+
+    while( (line_length = getline(&line, &line_size, input)) != -1 )
+    {
+        char* host_str = line;
+        char* end;
+        struct ipaddr_bin address;
+
+        line_number++;
+
+        while( isspace((unsigned char)*host_str) )
+        {
+            host_str++;
+        }
+        end = host_str + strlen(host_str);
+        while( (end > host_str) && isspace((unsigned char)end[-1]) )
+        {
+            *--end = '\0';
+        }
+        if( (*host_str == '\0') || (*host_str == '#') )
+        {
+            continue;
+        }
+
+        if( (str_to_ipaddr_bin(host_str, &address) != RESULT_SUCCESS) ||
+            (address.pflen != ((address.proto == CIDR_IPV4) ? 32 : 128)) )
+        {
+            fprintf(stderr, "Error: %s line %zu: %s is not a valid IPv4 or IPv6 host address\n",
+                    input_name, line_number, host_str);
+            result = RESULT_INT_ERROR;
+            break;
+        }
+
+        /* Records keep their line numbers in 32 bits */
+        if( line_number > UINT32_MAX )
+        {
+            fprintf(stderr, "Error: %s has more than %lu lines\n", input_name, (unsigned long)UINT32_MAX);
+            result = RESULT_INT_ERROR;
+            break;
+        }
+
+        if( count == size )
+        {
+            struct ipaddr_sort_record* new_records;
+
+            size = size ? size * 2 : 1024;
+            new_records = realloc(records, size * sizeof(*records));
+            if( new_records == NULL )
+            {
+                fprintf(stderr, "Error: could not allocate memory!\n");
+                result = RESULT_INT_ERROR;
+                break;
+            }
+            records = new_records;
+        }
+        records[count].key = address;
+        records[count].line = (uint32_t)line_number;
+        count++;
+    }
+    free(line);
+
+    if( result != RESULT_SUCCESS )
+    {
+        free(records);
+        return(result);
+    }
+
+    /* Sorted, deduplicated keys for exact checks */
+    scratch = malloc((count ? count : 1) * sizeof(*scratch));
+    keys = malloc((count ? count : 1) * sizeof(*keys));
+    if( (scratch == NULL) || (keys == NULL) )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free(records);
+        free(scratch);
+        free(keys);
+        return(RESULT_INT_ERROR);
+    }
+    result = radix_sort_ipaddr(records, scratch, count);
+    free(scratch);
+    if( result != RESULT_SUCCESS )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free(records);
+        free(keys);
+        return(result);
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        blocklist_key_from_bin(&keys[key_count], &records[i].key);
+        if( (key_count == 0) || (memcmp(&keys[key_count-1], &keys[key_count], sizeof(*keys)) != 0) )
+        {
+            key_count++;
+        }
+    }
+    free(records);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BLOCKLIST_MAGIC, sizeof(header.magic));
+    header.version = BLOCKLIST_VERSION;
+    header.byte_order = BLOCKLIST_BYTE_ORDER;
+    header.block_count = (key_count * BLOCKLIST_BITS_PER_HOST + BLOCKLIST_BLOCK_SIZE * 8 - 1) / (BLOCKLIST_BLOCK_SIZE * 8);
+    if( header.block_count == 0 )
+    {
+        header.block_count = 1;
+    }
+    header.key_count = key_count;
+    header.filter_offset = sizeof(header);
+    header.keys_offset = header.filter_offset + header.block_count * BLOCKLIST_BLOCK_SIZE;
+
+    filter = calloc(header.block_count, BLOCKLIST_BLOCK_SIZE);
+    if( filter == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free(keys);
+        return(RESULT_INT_ERROR);
+    }
+    for( i = 0; i < key_count; i++ )
+    {
+        blocklist_set(filter, header.block_count, blocklist_hash(&keys[i]));
+    }
+
+    output = fopen(blocklist_name, "wb");
+    if( output == NULL )
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n", blocklist_name, strerror(errno));
+        result = RESULT_INT_ERROR;
+    }
+    else
+    {
+        result = blocklist_write(output, &header, filter, keys);
+        if( fclose(output) != 0 )
+        {
+            result = RESULT_FAILURE;
+        }
+        if( result != RESULT_SUCCESS )
+        {
+            fprintf(stderr, "Error: could not write %s: %s\n", blocklist_name, strerror(errno));
+            remove(blocklist_name);
+            result = RESULT_INT_ERROR;
+        }
+    }
+
+    free(filter);
+    free(keys);
+
+    return(result);
+}
+
+/* Map a blocklist file into memory after checking that its header
+   matches this program and the size of the file */
+int blocklist_open(struct blocklist* blocklist, const char* blocklist_name)
+{
+    const struct blocklist_header* header;
+    struct stat st;
+    int fd;
+
+    memset(blocklist, 0, sizeof(*blocklist));
+
+    fd = open(blocklist_name, O_RDONLY);
+    if( fd < 0 )
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n", blocklist_name, strerror(errno));
+        return(RESULT_INT_ERROR);
+    }
+    if( fstat(fd, &st) != 0 )
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n", blocklist_name, strerror(errno));
+        close(fd);
+        return(RESULT_INT_ERROR);
+    }
+    if( (size_t)st.st_size < sizeof(*header) )
+    {
+        fprintf(stderr, "Error: %s is not a valid blocklist file\n", blocklist_name);
+        close(fd);
+        return(RESULT_INT_ERROR);
+    }
+
+    blocklist->map_size = (size_t)st.st_size;
+    blocklist->map = mmap(NULL, blocklist->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( blocklist->map == MAP_FAILED )
+    {
+        fprintf(stderr, "Error: could not map %s: %s\n", blocklist_name, strerror(errno));
+        blocklist->map = NULL;
+        return(RESULT_INT_ERROR);
+    }
+
+    header = blocklist->map;
+    if( (memcmp(header->magic, BLOCKLIST_MAGIC, sizeof(header->magic)) != 0) ||
+        (header->byte_order != BLOCKLIST_BYTE_ORDER) ||
+        (header->filter_offset != sizeof(*header)) ||
+        (header->block_count == 0) || (header->block_count > UINT32_MAX) ||
+        (header->block_count > blocklist->map_size / BLOCKLIST_BLOCK_SIZE) ||
+        (header->keys_offset != header->filter_offset + header->block_count * BLOCKLIST_BLOCK_SIZE) ||
+        (header->key_count > blocklist->map_size / sizeof(struct blocklist_key)) ||
+        (header->keys_offset + header->key_count * sizeof(struct blocklist_key) != blocklist->map_size) )
+    {
+        fprintf(stderr, "Error: %s is not a valid blocklist file\n", blocklist_name);
+        blocklist_close(blocklist);
+        return(RESULT_INT_ERROR);
+    }
+    if( header->version != BLOCKLIST_VERSION )
+    {
+        fprintf(stderr, "Error: %s has unsupported blocklist format version %u\n",
+                blocklist_name, (unsigned int)header->version);
+        blocklist_close(blocklist);
+        return(RESULT_INT_ERROR);
+    }
+
+    /* Filter blocks are visited in no particular order */
+    posix_madvise(blocklist->map, blocklist->map_size, POSIX_MADV_RANDOM);
+
+    blocklist->filter = (const uint64_t*)((const char*)blocklist->map + header->filter_offset);
+    blocklist->keys = (const struct blocklist_key*)((const char*)blocklist->map + header->keys_offset);
+    blocklist->block_count = header->block_count;
+    blocklist->key_count = header->key_count;
+
+    return(RESULT_SUCCESS);
+}
+
+void blocklist_close(struct blocklist* blocklist)
+{
+    if( blocklist->map != NULL )
+    {
+        munmap(blocklist->map, blocklist->map_size);
+    }
+    memset(blocklist, 0, sizeof(*blocklist));
+}
+
+/* Check if an address is in the blocklist. The prefix length is ignored,
+   so 192.0.2.1/24 is checked as 192.0.2.1. */
+int blocklist_contains(const struct blocklist* blocklist, const struct ipaddr_bin* address)
+{
+    struct blocklist_key key;
+
+    blocklist_key_from_bin(&key, address);
+    if( !blocklist_test(blocklist->filter, blocklist->block_count, blocklist_hash(&key)) )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    return(blocklist_search(blocklist, &key));
+}
+
+/* Print BLOCKLIST_BLOCKED_STR or BLOCKLIST_PASS_STR for every input line.
+ *
+ * Output lines correspond to input lines one to one. Malformed addresses
+ * make the function return RESULT_FAILURE. Filter blocks of a whole batch
+ * of addresses are prefetched before any of them is tested.
+ */
+int blocklist_check_addresses(const struct blocklist* blocklist, FILE* input, FILE* output, int verbose)
+{
+    int result = RESULT_SUCCESS;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+
+    struct blocklist_key keys[BLOCKLIST_BATCH_SIZE];
+    uint64_t hashes[BLOCKLIST_BATCH_SIZE];
+    int valid[BLOCKLIST_BATCH_SIZE];
+    size_t batch_count = 0;
+    int done = 0;
+
+    while( !done )
+    {
+        line_length = getline(&line, &line_size, input);
+        if( line_length == -1 )
+        {
+            done = 1;
+        }
+        else
+        {
+            struct ipaddr_bin address;
+
+            while( (line_length > 0) &&
+                   ((line[line_length-1] == '\n') || (line[line_length-1] == '\r')) )
+            {
+                line[--line_length] = '\0';
+            }
+
+            valid[batch_count] = (str_to_ipaddr_bin(line, &address) == RESULT_SUCCESS);
+            if( valid[batch_count] )
+            {
+                blocklist_key_from_bin(&keys[batch_count], &address);
+                hashes[batch_count] = blocklist_hash(&keys[batch_count]);
+                BLOCKLIST_PREFETCH(blocklist->filter +
+                                   blocklist_block(hashes[batch_count], blocklist->block_count) * BLOCKLIST_BLOCK_WORDS);
+            }
+            else
+            {
+                if( verbose )
+                {
+                    fprintf(stderr, "Malformed address %s\n", line);
+                }
+                result = RESULT_FAILURE;
+            }
+            batch_count++;
+        }
+
+        if( (batch_count == BLOCKLIST_BATCH_SIZE) || (done && (batch_count > 0)) )
+        {
+            size_t i;
+
+            for( i = 0; i < batch_count; i++ )
+            {
+                if( valid[i] &&
+                    blocklist_test(blocklist->filter, blocklist->block_count, hashes[i]) &&
+                    (blocklist_search(blocklist, &keys[i]) == RESULT_SUCCESS) )
+                {
+                    fputs(BLOCKLIST_BLOCKED_STR, output);
+                }
+                else
+                {
+                    fputs(BLOCKLIST_PASS_STR, output);
+                }
+                fputc('\n', output);
+            }
+
+            batch_count = 0;
+        }
+    }
+
+    free(line);
+    fflush(output);
+
+    return(result);
+}
@@ -0,0 +1,82 @@
+/*
+ * ipaddrcheck_blocklist.h: Bloom filter files for large host blocklists
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_BLOCKLIST_H
+#define IPADDRCHECK_BLOCKLIST_H
+
+#include "ipaddrcheck_functions.h"
+
+/*
+ * File layout, all integers in native byte order:
+ *   header       struct blocklist_header, padded to one cache line
+ *   filter       block_count blocks of BLOCKLIST_BLOCK_SIZE bytes
+ *   keys         key_count struct blocklist_key entries in ascending order
+ *
+ * The filter is a blocked Bloom filter: every host sets one bit in each of
+ * the eight 64 bit words of a single cache line sized block, so a negative
+ * answer costs one cache miss. Positive answers are confirmed with a binary
+ * search in the sorted key list.
+ */
+#define BLOCKLIST_MAGIC          "IPCBLOOM"
+#define BLOCKLIST_VERSION        1
+#define BLOCKLIST_BYTE_ORDER     0x01020304
+#define BLOCKLIST_BLOCK_WORDS    8
+#define BLOCKLIST_BLOCK_SIZE     (BLOCKLIST_BLOCK_WORDS * 8)
+#define BLOCKLIST_BITS_PER_HOST  16
+
+/* Printed for blocked addresses, addresses that are not blocked
+   and malformed ones produce BLOCKLIST_PASS_STR */
+#define BLOCKLIST_BLOCKED_STR    "blocked"
+#define BLOCKLIST_PASS_STR       "-"
+
+struct blocklist_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t block_count;
+    uint64_t key_count;
+    uint64_t filter_offset;
+    uint64_t keys_offset;
+    uint8_t reserved[16];
+};
+
+struct blocklist_key {
+    uint8_t proto;
+    uint8_t addr[16];
+};
+
+/* A blocklist file mapped into memory */
+struct blocklist {
+    void* map;
+    size_t map_size;
+    const uint64_t* filter;
+    const struct blocklist_key* keys;
+    uint64_t block_count;
+    uint64_t key_count;
+};
+
+int blocklist_build(FILE* input, const char* input_name, const char* blocklist_name);
+int blocklist_open(struct blocklist* blocklist, const char* blocklist_name);
+void blocklist_close(struct blocklist* blocklist);
+int blocklist_contains(const struct blocklist* blocklist, const struct ipaddr_bin* address);
+int blocklist_check_addresses(const struct blocklist* blocklist, FILE* input, FILE* output, int verbose);
+
+#endif /* IPADDRCHECK_BLOCKLIST_H */
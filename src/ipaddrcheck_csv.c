@@ -0,0 +1,527 @@
+/*
+ * ipaddrcheck_csv.c: validation of address columns in CSV and TSV files
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <errno.h>
+#include "ipaddrcheck_csv.h"
+#include "ipaddrcheck_actions.h"
+
+/* Index of a column that is named, until the header is read */
+#define CSV_UNRESOLVED ((size_t)-1)
+
+/* Word-at-a-time search, as in ipaddrcheck_scan.c */
+#define CSV_ONES               0x0101010101010101ULL
+#define CSV_HIGHS              0x8080808080808080ULL
+#define CSV_HAS_ZERO_BYTE(w)   (((w) - CSV_ONES) & ~(w) & CSV_HIGHS)
+#define CSV_HAS_BYTE(w, c)     CSV_HAS_ZERO_BYTE((w) ^ (CSV_ONES * (unsigned char)(c)))
+
+/* A field of the current row. It points into the read buffer, so fields
+   are never copied; quoted fields point between the quotes and keep
+   their "" escapes, which no address can contain anyway. */
+struct csv_field {
+    const char* start;
+    size_t length;
+    int quoted;
+    int present;
+};
+
+struct csv_state {
+    FILE* output;
+    char delimiter;
+    int flags;
+    struct csv_column* columns;
+    size_t column_count;
+    size_t max_index;
+    struct csv_field* fields;    /* One per column */
+    int* results;                /* One per column */
+    int allow_loopback;
+    int verbose;
+    char* reason;
+    size_t reason_size;
+    uint64_t row;
+    int result;
+};
+
+/* Find the next delimiter or line break */
+static const char* csv_find_stop(const char* p, const char* end, char delimiter)
+{
+    while( end - p >= 8 )
+    {
+        uint64_t word;
+
+        memcpy(&word, p, 8);
+        if( CSV_HAS_BYTE(word, delimiter) | CSV_HAS_BYTE(word, '\n') )
+        {
+            break;
+        }
+        p += 8;
+    }
+
+    while( (p < end) && (*p != delimiter) && (*p != '\n') )
+    {
+        p++;
+    }
+
+    return(p);
+}
+
+/* Parse the field at p. Returns the position after the delimiter or line
+ * break that ends it and sets last at the end of a row, or returns NULL
+ * if the buffer ends first and more input may follow.
+ *
+ * Text between a closing quote and the delimiter makes the field
+ * malformed, and it is taken as is, quotes included.
+ */
+static const char* csv_parse_field(const char* p, const char* end, char delimiter, int at_eof,
+                                   struct csv_field* field, int* last)
+{
+    const char* start = p;
+    const char* content_end;
+    const char* stop;
+
+    field->quoted = 0;
+    if( (p < end) && (*p == '"') )
+    {
+        const char* quote = p + 1;
+
+        while( (quote = memchr(quote, '"', end - quote)) != NULL )
+        {
+            if( (quote + 1 < end) && (quote[1] == '"') )
+            {
+                quote += 2;
+            }
+            else
+            {
+                break;
+            }
+        }
+        if( (quote == NULL) || ((quote + 1 == end) && !at_eof) )
+        {
+            return(NULL);
+        }
+
+        field->quoted = 1;
+        field->start = start + 1;
+        field->length = quote - start - 1;
+        p = quote + 1;
+    }
+
+    stop = csv_find_stop(p, end, delimiter);
+    if( (stop == end) && !at_eof )
+    {
+        return(NULL);
+    }
+
+    content_end = stop;
+    if( (content_end > p) && (content_end[-1] == '\r') && ((stop == end) || (*stop == '\n')) )
+    {
+        content_end--;
+    }
+    if( !field->quoted || (content_end != p) )
+    {
+        field->quoted = 0;
+        field->start = start;
+        field->length = content_end - start;
+    }
+
+    *last = (stop == end) || (*stop == '\n');
+
+    return( (stop == end) ? end : stop + 1 );
+}
+
+/* Write a row without its line break, and the result columns after it */
+static void csv_write_annotated(struct csv_state* state, const char* row_start, const char* row_end)
+{
+    size_t i;
+
+    if( (row_end > row_start) && (row_end[-1] == '\n') )
+    {
+        row_end--;
+    }
+    if( (row_end > row_start) && (row_end[-1] == '\r') )
+    {
+        row_end--;
+    }
+    fwrite(row_start, 1, row_end - row_start, state->output);
+
+    for( i = 0; i < state->column_count; i++ )
+    {
+        fputc(state->delimiter, state->output);
+        if( state->row > 1 || !(state->flags & CSV_HEADER) )
+        {
+            fputs((state->results[i] == RESULT_SUCCESS) ? CSV_PASS_STR : CSV_FAIL_STR, state->output);
+        }
+        else if( state->fields[i].quoted )
+        {
+            fprintf(state->output, "\"%.*s" CSV_RESULT_SUFFIX "\"",
+                    (int)state->fields[i].length, state->fields[i].start);
+        }
+        else
+        {
+            fprintf(state->output, "%.*s" CSV_RESULT_SUFFIX,
+                    (int)state->fields[i].length, state->fields[i].start);
+        }
+    }
+    fputc('\n', state->output);
+}
+
+/* Find the named columns in the header */
+static int csv_resolve_header(struct csv_state* state)
+{
+    size_t i;
+
+    state->max_index = 0;
+    for( i = 0; i < state->column_count; i++ )
+    {
+        if( state->columns[i].index == CSV_UNRESOLVED )
+        {
+            fprintf(stderr, "Error: column \"%s\" is not in the header\n", state->columns[i].name);
+            return(RESULT_INT_ERROR);
+        }
+        if( state->columns[i].index > state->max_index )
+        {
+            state->max_index = state->columns[i].index;
+        }
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Run the checks of every column on its field in place */
+static int csv_check_fields(struct csv_state* state)
+{
+    int result = RESULT_SUCCESS;
+    size_t i;
+
+    for( i = 0; i < state->column_count; i++ )
+    {
+        struct csv_field* field = &state->fields[i];
+
+        if( !field->present )
+        {
+            snprintf(state->reason, state->reason_size, "there is no column %s", state->columns[i].name);
+            state->results[i] = RESULT_FAILURE;
+        }
+        else
+        {
+            /* Diagnostics quote the field, so the buffer grows with the longest one */
+            if( CHECK_REASON_SIZE(field->length) > state->reason_size )
+            {
+                state->reason_size = CHECK_REASON_SIZE(field->length) * 2;
+                free(state->reason);
+                state->reason = malloc(state->reason_size);
+                if( state->reason == NULL )
+                {
+                    fprintf(stderr, "Error: could not allocate memory!\n");
+                    return(RESULT_INT_ERROR);
+                }
+            }
+
+            state->results[i] = check_address_n(ipaddrcheck_default_ctx(), field->start, field->length,
+                                                state->columns[i].checks, state->columns[i].check_count,
+                                                state->allow_loopback, state->reason, state->reason_size);
+        }
+
+        if( state->results[i] != RESULT_SUCCESS )
+        {
+            if( state->verbose )
+            {
+                fprintf(stderr, "row %llu, column %s: %s\n", (unsigned long long)state->row,
+                        state->columns[i].name, state->reason);
+            }
+            result = RESULT_FAILURE;
+        }
+    }
+
+    return(result);
+}
+
+/* Parse the row at p and check or print it. Returns the position
+   after it, or NULL if the buffer ends first and more input may follow. */
+static const char* csv_row(struct csv_state* state, const char* p, const char* end, int at_eof)
+{
+    const char* row_start = p;
+    int is_header;
+    size_t index = 0;
+    size_t i;
+    int last = 0;
+
+    for( i = 0; i < state->column_count; i++ )
+    {
+        state->fields[i].present = 0;
+    }
+
+    while( !last )
+    {
+        struct csv_field field;
+
+        p = csv_parse_field(p, end, state->delimiter, at_eof, &field, &last);
+        if( p == NULL )
+        {
+            return(NULL);
+        }
+
+        /* Lines with nothing on them are not rows */
+        if( last && (index == 0) && (field.length == 0) && !field.quoted )
+        {
+            return(p);
+        }
+
+        if( index <= state->max_index )
+        {
+            for( i = 0; i < state->column_count; i++ )
+            {
+                struct csv_column* column = &state->columns[i];
+
+                if( (column->index == CSV_UNRESOLVED) && (strlen(column->name) == field.length) &&
+                    (memcmp(column->name, field.start, field.length) == 0) )
+                {
+                    column->index = index;
+                }
+                if( column->index == index )
+                {
+                    state->fields[i] = field;
+                    state->fields[i].present = 1;
+                }
+            }
+        }
+        index++;
+    }
+
+    state->row++;
+    is_header = (state->row == 1) && (state->flags & CSV_HEADER);
+
+    if( is_header )
+    {
+        if( csv_resolve_header(state) != RESULT_SUCCESS )
+        {
+            state->result = RESULT_INT_ERROR;
+            return(p);
+        }
+        for( i = 0; i < state->column_count; i++ )
+        {
+            if( !state->fields[i].present )
+            {
+                state->fields[i].start = state->columns[i].name;
+                state->fields[i].length = strlen(state->columns[i].name);
+                state->fields[i].quoted = 0;
+            }
+        }
+    }
+    else
+    {
+        int result = csv_check_fields(state);
+
+        if( result == RESULT_INT_ERROR )
+        {
+            state->result = RESULT_INT_ERROR;
+            return(p);
+        }
+        if( result != RESULT_SUCCESS )
+        {
+            state->result = RESULT_FAILURE;
+        }
+        else if( !(state->flags & CSV_ANNOTATE) )
+        {
+            return(p);
+        }
+    }
+
+    /* Failed rows, and the header, are printed as they are */
+    if( state->flags & CSV_ANNOTATE )
+    {
+        csv_write_annotated(state, row_start, p);
+    }
+    else
+    {
+        fwrite(row_start, 1, p - row_start, state->output);
+        if( p[-1] != '\n' )
+        {
+            fputc('\n', state->output);
+        }
+    }
+
+    /* No point in checking more rows, check_csv reports the error */
+    if( ferror(state->output) )
+    {
+        state->result = RESULT_INT_ERROR;
+    }
+
+    return(p);
+}
+
+/* Number the columns given by number, counting from 1 */
+static int csv_number_columns(struct csv_column* columns, size_t column_count, int flags)
+{
+    size_t i;
+
+    for( i = 0; i < column_count; i++ )
+    {
+        char* number_end = "";
+        unsigned long number;
+
+        errno = 0;
+        number = strtoul(columns[i].name, &number_end, 10);
+        if( (columns[i].name[0] >= '0') && (columns[i].name[0] <= '9') && (*number_end == '\0') )
+        {
+            if( (errno != 0) || (number == 0) )
+            {
+                fprintf(stderr, "Error: \"%s\" is not a valid column number\n", columns[i].name);
+                return(RESULT_INT_ERROR);
+            }
+            columns[i].index = number - 1;
+        }
+        else if( flags & CSV_HEADER )
+        {
+            columns[i].index = CSV_UNRESOLVED;
+        }
+        else
+        {
+            fprintf(stderr, "Error: column \"%s\" is not a number, and there is no header\n", columns[i].name);
+            return(RESULT_INT_ERROR);
+        }
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Check the given columns of every row of a CSV file, or any other file
+ * with one row per line and fields separated by the delimiter.
+ * Fields may be enclosed in double quotes, with "" for a quote inside,
+ * and then contain delimiters and line breaks.
+ *
+ * Rows with a field that fails any check of its column are printed
+ * as they are, after the header if there is one. With CSV_ANNOTATE,
+ * every row is printed with one result column added per checked column.
+ * Columns without checks are only checked to be well-formed addresses.
+ *
+ * Returns RESULT_SUCCESS if all rows passed, RESULT_FAILURE if any
+ * did not, and RESULT_INT_ERROR on unknown columns, read and write errors.
+ */
+int check_csv(FILE* input, FILE* output, char delimiter, int flags,
+              struct csv_column* columns, size_t column_count,
+              int allow_loopback, int verbose)
+{
+    struct csv_state state;
+    size_t buffer_size = CSV_BUFFER_SIZE;
+    size_t filled = 0;
+    int at_eof = 0;
+    char* buffer;
+
+    if( csv_number_columns(columns, column_count, flags) != RESULT_SUCCESS )
+    {
+        return(RESULT_INT_ERROR);
+    }
+
+    state.output = output;
+    state.delimiter = delimiter;
+    state.flags = flags;
+    state.columns = columns;
+    state.column_count = column_count;
+    state.allow_loopback = allow_loopback;
+    state.verbose = verbose;
+    state.reason_size = CHECK_REASON_SIZE(0);
+    state.row = 0;
+    state.result = RESULT_SUCCESS;
+
+    /* The header row is searched for names in all of its fields */
+    state.max_index = CSV_UNRESOLVED;
+    if( !(flags & CSV_HEADER) )
+    {
+        csv_resolve_header(&state);
+    }
+
+    buffer = malloc(buffer_size);
+    state.fields = malloc(column_count * sizeof(struct csv_field));
+    state.results = malloc(column_count * sizeof(int));
+    state.reason = malloc(state.reason_size);
+    if( (buffer == NULL) || (state.fields == NULL) || (state.results == NULL) || (state.reason == NULL) )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        state.result = RESULT_INT_ERROR;
+    }
+
+    /* Whole rows are handled, the incomplete last one is kept for the next read */
+    while( (state.result != RESULT_INT_ERROR) && !at_eof )
+    {
+        size_t count;
+        size_t done = 0;
+        const char* next;
+
+        if( filled == buffer_size )
+        {
+            char* larger = realloc(buffer, buffer_size * 2);
+            if( larger == NULL )
+            {
+                fprintf(stderr, "Error: could not allocate memory!\n");
+                state.result = RESULT_INT_ERROR;
+                break;
+            }
+            buffer = larger;
+            buffer_size *= 2;
+        }
+
+        count = fread(buffer + filled, 1, buffer_size - filled, input);
+        if( count == 0 )
+        {
+            if( ferror(input) )
+            {
+                fprintf(stderr, "Error: could not read input\n");
+                state.result = RESULT_INT_ERROR;
+                break;
+            }
+            at_eof = 1;
+        }
+        filled += count;
+
+        while( (done < filled) && (state.result != RESULT_INT_ERROR) &&
+               ((next = csv_row(&state, buffer + done, buffer + filled, at_eof)) != NULL) )
+        {
+            done = next - buffer;
+        }
+
+        if( at_eof && (done < filled) && (state.result != RESULT_INT_ERROR) )
+        {
+            fprintf(stderr, "Error: unterminated quoted field in row %llu\n", (unsigned long long)state.row + 1);
+            state.result = RESULT_INT_ERROR;
+        }
+
+        memmove(buffer, buffer + done, filled - done);
+        filled -= done;
+    }
+
+    if( (state.result != RESULT_INT_ERROR) && (flags & CSV_HEADER) && (state.row == 0) )
+    {
+        fprintf(stderr, "Error: the input has no header\n");
+        state.result = RESULT_INT_ERROR;
+    }
+
+    free(buffer);
+    free(state.fields);
+    free(state.results);
+    free(state.reason);
+    if( (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        state.result = RESULT_INT_ERROR;
+    }
+
+    return(state.result);
+}
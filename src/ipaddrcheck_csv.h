@@ -0,0 +1,51 @@
+/*
+ * ipaddrcheck_csv.h: validation of address columns in CSV and TSV files
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_CSV_H
+#define IPADDRCHECK_CSV_H
+
+#include "ipaddrcheck_functions.h"
+
+#define CSV_BUFFER_SIZE 65536
+
+/* Flags */
+#define CSV_HEADER      0x01    /* The first row holds column names */
+#define CSV_ANNOTATE    0x02    /* Print every row with result columns added */
+
+/* Result columns, and the suffix of their names in the header */
+#define CSV_PASS_STR    "pass"
+#define CSV_FAIL_STR    "fail"
+#define CSV_RESULT_SUFFIX "_result"
+
+/* A column and the checks to run on it. The name is either a column
+   number counting from 1 or, with CSV_HEADER, a name from the header. */
+struct csv_column {
+    const char* name;
+    const int* checks;
+    int check_count;
+    size_t index;
+};
+
+int check_csv(FILE* input, FILE* output, char delimiter, int flags,
+              struct csv_column* columns, size_t column_count,
+              int allow_loopback, int verbose);
+
+#endif /* IPADDRCHECK_CSV_H */
@@ -0,0 +1,671 @@
+/*
+ * ipaddrcheck_distinct.c: estimation of distinct address counts
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <errno.h>
+#include <math.h>
+#include "ipaddrcheck_distinct.h"
+
+/* Hash bits left after the register index */
+#define DISTINCT_RANK_BITS        (64 - DISTINCT_PRECISION)
+#define DISTINCT_SPARSE_RANK_BITS (64 - DISTINCT_SPARSE_PRECISION)
+
+/* Sparse entries are the sparse index followed by six bits of rank */
+#define DISTINCT_ENTRY_RANK_BITS  6
+#define DISTINCT_ENTRY_RANK_MASK  ((1 << DISTINCT_ENTRY_RANK_BITS) - 1)
+
+/* Index bits that sparse entries have on top of registers */
+#define DISTINCT_EXTRA_BITS       (DISTINCT_SPARSE_PRECISION - DISTINCT_PRECISION)
+
+#ifdef __GNUC__
+#define DISTINCT_CLZ(x) __builtin_clzll(x)
+#else
+static int distinct_clz(uint64_t x)
+{
+    int count = 0;
+    while( !(x & ((uint64_t)1 << 63)) )
+    {
+        x <<= 1;
+        count++;
+    }
+    return(count);
+}
+#define DISTINCT_CLZ(x) distinct_clz(x)
+#endif
+
+/* Finalizer of MurmurHash3, every input bit affects every output bit */
+static uint64_t distinct_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return(h);
+}
+
+/* The sparse entry of an address hash. Its rank is the position of the
+   first set bit after the index, one more than the bits left if none is. */
+static uint32_t distinct_entry(uint64_t hash)
+{
+    uint64_t rest = hash << DISTINCT_SPARSE_PRECISION;
+    uint32_t rank = (rest == 0) ? DISTINCT_SPARSE_RANK_BITS + 1 : DISTINCT_CLZ(rest) + 1;
+
+    return(((uint32_t)(hash >> DISTINCT_SPARSE_RANK_BITS) << DISTINCT_ENTRY_RANK_BITS) | rank);
+}
+
+/* Raise the register of a sparse entry to its rank. The extra index bits
+   of the entry are the first bits after the register index, its rank only
+   counts if they are all zero. */
+static void distinct_set_register(uint8_t* registers, uint32_t entry)
+{
+    uint32_t index = entry >> (DISTINCT_ENTRY_RANK_BITS + DISTINCT_EXTRA_BITS);
+    uint32_t extra = (entry >> DISTINCT_ENTRY_RANK_BITS) & ((1 << DISTINCT_EXTRA_BITS) - 1);
+    uint8_t rank;
+
+    if( extra != 0 )
+    {
+        rank = DISTINCT_CLZ((uint64_t)extra) - (64 - DISTINCT_EXTRA_BITS) + 1;
+    }
+    else
+    {
+        rank = DISTINCT_EXTRA_BITS + (entry & DISTINCT_ENTRY_RANK_MASK);
+    }
+
+    if( registers[index] < rank )
+    {
+        registers[index] = rank;
+    }
+}
+
+static int distinct_compare_entries(const void* a, const void* b)
+{
+    uint32_t first = *(const uint32_t*)a;
+    uint32_t second = *(const uint32_t*)b;
+
+    return((first > second) - (first < second));
+}
+
+/* Sort the sparse list and keep only the highest rank of every index */
+static void distinct_compact(struct distinct_sketch* sketch)
+{
+    size_t count = 0;
+    size_t i;
+
+    qsort(sketch->sparse, sketch->sparse_count, sizeof(uint32_t), distinct_compare_entries);
+    for( i = 0; i < sketch->sparse_count; i++ )
+    {
+        if( (count > 0) &&
+            ((sketch->sparse[count - 1] >> DISTINCT_ENTRY_RANK_BITS) == (sketch->sparse[i] >> DISTINCT_ENTRY_RANK_BITS)) )
+        {
+            count--;
+        }
+        sketch->sparse[count++] = sketch->sparse[i];
+    }
+    sketch->sparse_count = count;
+}
+
+static int distinct_make_dense(struct distinct_sketch* sketch)
+{
+    size_t i;
+
+    if( sketch->registers != NULL )
+    {
+        return(RESULT_SUCCESS);
+    }
+
+    sketch->registers = calloc(DISTINCT_REGISTERS, 1);
+    if( sketch->registers == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+    for( i = 0; i < sketch->sparse_count; i++ )
+    {
+        distinct_set_register(sketch->registers, sketch->sparse[i]);
+    }
+    free(sketch->sparse);
+    sketch->sparse = NULL;
+    sketch->sparse_count = 0;
+
+    return(RESULT_SUCCESS);
+}
+
+static int distinct_insert(struct distinct_sketch* sketch, uint32_t entry)
+{
+    if( (sketch->registers == NULL) && (sketch->sparse_count == DISTINCT_SPARSE_MAX) )
+    {
+        distinct_compact(sketch);
+        if( (sketch->sparse_count >= DISTINCT_SPARSE_MAX / 2) && (distinct_make_dense(sketch) != RESULT_SUCCESS) )
+        {
+            return(RESULT_INT_ERROR);
+        }
+    }
+
+    if( sketch->registers == NULL )
+    {
+        sketch->sparse[sketch->sparse_count++] = entry;
+        return(RESULT_SUCCESS);
+    }
+
+    distinct_set_register(sketch->registers, entry);
+
+    return(RESULT_SUCCESS);
+}
+
+int distinct_init(struct distinct_counter* counter, int ipv4_length, int ipv6_length)
+{
+    int family;
+
+    counter->ipv4_length = ipv4_length;
+    counter->ipv6_length = ipv6_length;
+    for( family = 0; family < DISTINCT_FAMILIES; family++ )
+    {
+        counter->sketches[family].registers = NULL;
+        counter->sketches[family].sparse_count = 0;
+        counter->sketches[family].sparse = malloc(DISTINCT_SPARSE_MAX * sizeof(uint32_t));
+    }
+    if( (counter->sketches[DISTINCT_IPV4].sparse == NULL) || (counter->sketches[DISTINCT_IPV6].sparse == NULL) )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        distinct_free(counter);
+        return(RESULT_INT_ERROR);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+void distinct_free(struct distinct_counter* counter)
+{
+    int family;
+
+    for( family = 0; family < DISTINCT_FAMILIES; family++ )
+    {
+        free(counter->sketches[family].registers);
+        free(counter->sketches[family].sparse);
+        counter->sketches[family].registers = NULL;
+        counter->sketches[family].sparse = NULL;
+    }
+}
+
+/* Count an address, or rather its prefix of the configured length */
+int distinct_add(struct distinct_counter* counter, const struct ipaddr_bin* address)
+{
+    uint8_t bytes[16];
+    uint64_t words[2];
+    int family;
+    int start;
+    int length;
+    int i;
+
+    if( address->proto == CIDR_IPV4 )
+    {
+        family = DISTINCT_IPV4;
+        start = 12;
+        length = counter->ipv4_length;
+    }
+    else
+    {
+        family = DISTINCT_IPV6;
+        start = 0;
+        length = counter->ipv6_length;
+    }
+
+    memcpy(bytes, address->addr, 16);
+    for( i = start; i < 16; i++ )
+    {
+        int bits = length - (i - start) * 8;
+
+        if( bits <= 0 )
+        {
+            bytes[i] = 0;
+        }
+        else if( bits < 8 )
+        {
+            bytes[i] &= (uint8_t)(0xff << (8 - bits));
+        }
+    }
+
+    /* The finalizer maps zero to zero, the first round starts from a constant */
+    memcpy(words, bytes, 16);
+    return(distinct_insert(&counter->sketches[family],
+                           distinct_entry(distinct_mix(distinct_mix(0x9e3779b97f4a7c15ULL ^ words[0]) ^ words[1]))));
+}
+
+/* Count the addresses in the input, one per line. Empty lines are skipped.
+ * Returns RESULT_SUCCESS if all of them are well-formed, RESULT_FAILURE
+ * if some are not, and RESULT_INT_ERROR on errors.
+ */
+int distinct_add_addresses(struct distinct_counter* counter, FILE* input, int verbose)
+{
+    size_t buffer_size = DISTINCT_BUFFER_SIZE;
+    size_t filled = 0;
+    uint64_t line_number = 0;
+    char* buffer;
+    int result = RESULT_SUCCESS;
+    int at_eof = 0;
+
+    buffer = malloc(buffer_size);
+    if( buffer == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    while( !at_eof && (result != RESULT_INT_ERROR) )
+    {
+        size_t count;
+        char* p;
+        char* end;
+
+        if( filled == buffer_size )
+        {
+            char* larger = realloc(buffer, buffer_size * 2);
+            if( larger == NULL )
+            {
+                fprintf(stderr, "Error: could not allocate memory!\n");
+                result = RESULT_INT_ERROR;
+                break;
+            }
+            buffer = larger;
+            buffer_size *= 2;
+        }
+
+        count = fread(buffer + filled, 1, buffer_size - filled, input);
+        if( count == 0 )
+        {
+            if( ferror(input) )
+            {
+                fprintf(stderr, "Error: could not read input\n");
+                result = RESULT_INT_ERROR;
+                break;
+            }
+            at_eof = 1;
+        }
+        filled += count;
+
+        /* Whole lines are counted, the incomplete last one is kept for the next read */
+        p = buffer;
+        end = buffer + filled;
+        while( p < end )
+        {
+            char* line_end = memchr(p, '\n', end - p);
+            char* stop = line_end;
+            struct ipaddr_bin address;
+
+            if( line_end == NULL )
+            {
+                if( !at_eof )
+                {
+                    break;
+                }
+                stop = end;
+            }
+
+            line_number++;
+            if( (stop > p) && (stop[-1] == '\r') )
+            {
+                stop--;
+            }
+            if( stop > p )
+            {
+                if( str_to_ipaddr_bin_n(ipaddrcheck_default_ctx(), p, stop - p, &address) == RESULT_SUCCESS )
+                {
+                    if( distinct_add(counter, &address) != RESULT_SUCCESS )
+                    {
+                        result = RESULT_INT_ERROR;
+                        break;
+                    }
+                }
+                else
+                {
+                    if( verbose )
+                    {
+                        fprintf(stderr, "line %llu: malformed address\n", (unsigned long long)line_number);
+                    }
+                    result = RESULT_FAILURE;
+                }
+            }
+
+            p = (line_end != NULL) ? line_end + 1 : end;
+        }
+
+        memmove(buffer, p, end - p);
+        filled = end - p;
+    }
+
+    free(buffer);
+
+    return(result);
+}
+
+/* The series of Ertl, "New cardinality estimation algorithms for HyperLogLog
+   sketches" (2017), which correct the raw estimate for registers that are
+   still empty and for those that reached the highest rank */
+static double distinct_sigma(double x)
+{
+    double y = 1.0;
+    double z = x;
+    double previous;
+
+    if( x == 1.0 )
+    {
+        return(INFINITY);
+    }
+    do
+    {
+        x *= x;
+        previous = z;
+        z += x * y;
+        y += y;
+    }
+    while( z != previous );
+
+    return(z);
+}
+
+static double distinct_tau(double x)
+{
+    double y = 1.0;
+    double z;
+    double previous;
+
+    if( (x == 0.0) || (x == 1.0) )
+    {
+        return(0.0);
+    }
+    z = 1.0 - x;
+    do
+    {
+        x = sqrt(x);
+        previous = z;
+        y *= 0.5;
+        z -= (1.0 - x) * (1.0 - x) * y;
+    }
+    while( z != previous );
+
+    return(z / 3.0);
+}
+
+/* The estimate from a histogram of register values. The improved estimator
+   needs no empirical bias correction, unlike the original HyperLogLog++. */
+static double distinct_histogram_estimate(const uint64_t* histogram, int rank_bits, double registers)
+{
+    double z = registers * distinct_tau(1.0 - histogram[rank_bits + 1] / registers);
+    int k;
+
+    for( k = rank_bits; k >= 1; k-- )
+    {
+        z = 0.5 * (z + histogram[k]);
+    }
+    z += registers * distinct_sigma(histogram[0] / registers);
+
+    return(registers * registers / (2.0 * log(2.0) * z));
+}
+
+uint64_t distinct_estimate(struct distinct_counter* counter, int family)
+{
+    struct distinct_sketch* sketch = &counter->sketches[family];
+    uint64_t histogram[DISTINCT_RANK_BITS + 2];
+    size_t i;
+
+    memset(histogram, 0, sizeof(histogram));
+    if( sketch->registers != NULL )
+    {
+        for( i = 0; i < DISTINCT_REGISTERS; i++ )
+        {
+            histogram[sketch->registers[i]]++;
+        }
+        return((uint64_t)llround(distinct_histogram_estimate(histogram, DISTINCT_RANK_BITS, DISTINCT_REGISTERS)));
+    }
+
+    /* The sparse list is a sketch of the higher precision with few registers set */
+    distinct_compact(sketch);
+    for( i = 0; i < sketch->sparse_count; i++ )
+    {
+        histogram[sketch->sparse[i] & DISTINCT_ENTRY_RANK_MASK]++;
+    }
+    histogram[0] = ((uint64_t)1 << DISTINCT_SPARSE_PRECISION) - sketch->sparse_count;
+
+    return((uint64_t)llround(distinct_histogram_estimate(histogram, DISTINCT_SPARSE_RANK_BITS,
+                                                         (double)((uint64_t)1 << DISTINCT_SPARSE_PRECISION))));
+}
+
+/* Add the addresses counted by other to counter, as if they had been counted there */
+int distinct_merge(struct distinct_counter* counter, const struct distinct_counter* other)
+{
+    int family;
+
+    if( (counter->ipv4_length != other->ipv4_length) || (counter->ipv6_length != other->ipv6_length) )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    for( family = 0; family < DISTINCT_FAMILIES; family++ )
+    {
+        struct distinct_sketch* sketch = &counter->sketches[family];
+        const struct distinct_sketch* other_sketch = &other->sketches[family];
+        size_t i;
+
+        if( other_sketch->registers != NULL )
+        {
+            if( distinct_make_dense(sketch) != RESULT_SUCCESS )
+            {
+                return(RESULT_INT_ERROR);
+            }
+            for( i = 0; i < DISTINCT_REGISTERS; i++ )
+            {
+                if( sketch->registers[i] < other_sketch->registers[i] )
+                {
+                    sketch->registers[i] = other_sketch->registers[i];
+                }
+            }
+        }
+        else
+        {
+            for( i = 0; i < other_sketch->sparse_count; i++ )
+            {
+                if( distinct_insert(sketch, other_sketch->sparse[i]) != RESULT_SUCCESS )
+                {
+                    return(RESULT_INT_ERROR);
+                }
+            }
+        }
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Read a sketch file written by distinct_save into an uninitialized counter */
+int distinct_load(struct distinct_counter* counter, const char* sketch_name)
+{
+    struct distinct_header header;
+    FILE* input;
+    int valid;
+    int family;
+
+    input = fopen(sketch_name, "rb");
+    if( input == NULL )
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n", sketch_name, strerror(errno));
+        return(RESULT_INT_ERROR);
+    }
+
+    valid = (fread(&header, sizeof(header), 1, input) == 1) &&
+            (memcmp(header.magic, DISTINCT_MAGIC, sizeof(header.magic)) == 0) &&
+            (header.byte_order == DISTINCT_BYTE_ORDER);
+    if( valid && (header.version != DISTINCT_VERSION) )
+    {
+        fprintf(stderr, "Error: %s has unsupported sketch format version %u\n",
+                sketch_name, (unsigned int)header.version);
+        fclose(input);
+        return(RESULT_INT_ERROR);
+    }
+    valid = valid &&
+            (header.precision == DISTINCT_PRECISION) && (header.sparse_precision == DISTINCT_SPARSE_PRECISION) &&
+            (header.ipv4_length <= 32) && (header.ipv6_length <= 128);
+
+    if( !valid || (distinct_init(counter, header.ipv4_length, header.ipv6_length) != RESULT_SUCCESS) )
+    {
+        if( !valid )
+        {
+            fprintf(stderr, "Error: %s is not a valid sketch file\n", sketch_name);
+        }
+        fclose(input);
+        return(RESULT_INT_ERROR);
+    }
+
+    for( family = 0; (family < DISTINCT_FAMILIES) && valid; family++ )
+    {
+        struct distinct_sketch* sketch = &counter->sketches[family];
+        uint32_t count = header.sparse_count[family];
+        size_t i;
+
+        if( count == DISTINCT_DENSE )
+        {
+            if( distinct_make_dense(sketch) != RESULT_SUCCESS )
+            {
+                distinct_free(counter);
+                fclose(input);
+                return(RESULT_INT_ERROR);
+            }
+            valid = (fread(sketch->registers, 1, DISTINCT_REGISTERS, input) == DISTINCT_REGISTERS);
+            for( i = 0; (i < DISTINCT_REGISTERS) && valid; i++ )
+            {
+                valid = (sketch->registers[i] <= DISTINCT_RANK_BITS + 1);
+            }
+        }
+        else
+        {
+            /* Entries are sorted with one per index, as compacting leaves them */
+            valid = (count <= DISTINCT_SPARSE_MAX) &&
+                    (fread(sketch->sparse, sizeof(uint32_t), count, input) == count);
+            for( i = 0; (i < count) && valid; i++ )
+            {
+                uint32_t rank = sketch->sparse[i] & DISTINCT_ENTRY_RANK_MASK;
+
+                valid = (rank >= 1) && (rank <= DISTINCT_SPARSE_RANK_BITS + 1) &&
+                        ((i == 0) || ((sketch->sparse[i - 1] >> DISTINCT_ENTRY_RANK_BITS) <
+                                      (sketch->sparse[i] >> DISTINCT_ENTRY_RANK_BITS)));
+            }
+            sketch->sparse_count = count;
+        }
+    }
+    valid = valid && (fgetc(input) == EOF);
+    fclose(input);
+
+    if( !valid )
+    {
+        fprintf(stderr, "Error: %s is not a valid sketch file\n", sketch_name);
+        distinct_free(counter);
+        return(RESULT_INT_ERROR);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+int distinct_save(struct distinct_counter* counter, const char* sketch_name)
+{
+    struct distinct_header header;
+    FILE* output;
+    int result = RESULT_SUCCESS;
+    int family;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DISTINCT_MAGIC, sizeof(header.magic));
+    header.version = DISTINCT_VERSION;
+    header.byte_order = DISTINCT_BYTE_ORDER;
+    header.precision = DISTINCT_PRECISION;
+    header.sparse_precision = DISTINCT_SPARSE_PRECISION;
+    header.ipv4_length = counter->ipv4_length;
+    header.ipv6_length = counter->ipv6_length;
+    for( family = 0; family < DISTINCT_FAMILIES; family++ )
+    {
+        struct distinct_sketch* sketch = &counter->sketches[family];
+
+        if( sketch->registers == NULL )
+        {
+            distinct_compact(sketch);
+            header.sparse_count[family] = sketch->sparse_count;
+        }
+        else
+        {
+            header.sparse_count[family] = DISTINCT_DENSE;
+        }
+    }
+
+    output = fopen(sketch_name, "wb");
+    if( output == NULL )
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n", sketch_name, strerror(errno));
+        return(RESULT_INT_ERROR);
+    }
+
+    if( fwrite(&header, sizeof(header), 1, output) != 1 )
+    {
+        result = RESULT_FAILURE;
+    }
+    for( family = 0; (family < DISTINCT_FAMILIES) && (result == RESULT_SUCCESS); family++ )
+    {
+        struct distinct_sketch* sketch = &counter->sketches[family];
+
+        if( sketch->registers != NULL )
+        {
+            if( fwrite(sketch->registers, 1, DISTINCT_REGISTERS, output) != DISTINCT_REGISTERS )
+            {
+                result = RESULT_FAILURE;
+            }
+        }
+        else if( fwrite(sketch->sparse, sizeof(uint32_t), sketch->sparse_count, output) != sketch->sparse_count )
+        {
+            result = RESULT_FAILURE;
+        }
+    }
+    if( fclose(output) != 0 )
+    {
+        result = RESULT_FAILURE;
+    }
+    if( result != RESULT_SUCCESS )
+    {
+        fprintf(stderr, "Error: could not write %s: %s\n", sketch_name, strerror(errno));
+        remove(sketch_name);
+        result = RESULT_INT_ERROR;
+    }
+
+    return(result);
+}
+
+/* Print the estimates. Returns RESULT_INT_ERROR if they could not be written. */
+int distinct_print(struct distinct_counter* counter, FILE* output)
+{
+    uint64_t ipv4 = distinct_estimate(counter, DISTINCT_IPV4);
+    uint64_t ipv6 = distinct_estimate(counter, DISTINCT_IPV6);
+
+    fprintf(output, "ipv4 %llu ipv6 %llu total %llu\n", (unsigned long long)ipv4,
+            (unsigned long long)ipv6, (unsigned long long)(ipv4 + ipv6));
+    if( (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    return(RESULT_SUCCESS);
+}
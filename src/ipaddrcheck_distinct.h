@@ -0,0 +1,97 @@
+/*
+ * ipaddrcheck_distinct.h: estimation of distinct address counts
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_DISTINCT_H
+#define IPADDRCHECK_DISTINCT_H
+
+#include "ipaddrcheck_functions.h"
+
+/*
+ * Every address family has a HyperLogLog++ sketch of 2^DISTINCT_PRECISION
+ * registers, for a standard error of 1.04 / sqrt(16384) = 0.8%.
+ *
+ * Small sketches are sparse: a list of (index, rank) pairs with the higher
+ * precision of DISTINCT_SPARSE_PRECISION bits, which counts the first few
+ * thousand addresses almost exactly. The list is compacted when it is full,
+ * and turned into registers if it is still half full after that.
+ */
+#define DISTINCT_PRECISION        14
+#define DISTINCT_REGISTERS        (1 << DISTINCT_PRECISION)
+#define DISTINCT_SPARSE_PRECISION 25
+#define DISTINCT_SPARSE_MAX       3072   /* As many bytes as 6-bit registers */
+
+#define DISTINCT_BUFFER_SIZE      65536
+
+#define DISTINCT_IPV4             0
+#define DISTINCT_IPV6             1
+#define DISTINCT_FAMILIES         2
+
+/*
+ * Sketch file layout, all integers in native byte order:
+ *   header       struct distinct_header
+ *   IPv4 sketch  sparse_count[DISTINCT_IPV4] sorted uint32_t entries,
+ *                or DISTINCT_REGISTERS bytes if it is DISTINCT_DENSE
+ *   IPv6 sketch  the same for sparse_count[DISTINCT_IPV6]
+ *
+ * Only sketches with the same prefix lengths can be merged.
+ */
+#define DISTINCT_MAGIC            "IPCHLLPP"
+#define DISTINCT_VERSION          1
+#define DISTINCT_BYTE_ORDER       0x01020304
+#define DISTINCT_DENSE            UINT32_MAX
+
+struct distinct_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint8_t precision;
+    uint8_t sparse_precision;
+    uint8_t ipv4_length;
+    uint8_t ipv6_length;
+    uint32_t sparse_count[DISTINCT_FAMILIES];
+    uint8_t reserved[12];
+};
+
+struct distinct_sketch {
+    uint8_t* registers;     /* NULL while the sketch is sparse */
+    uint32_t* sparse;
+    size_t sparse_count;
+};
+
+/* Addresses are cut to the prefix lengths before they are counted,
+   so with 24 and 64 the sketches count distinct /24 and /64 networks */
+struct distinct_counter {
+    int ipv4_length;
+    int ipv6_length;
+    struct distinct_sketch sketches[DISTINCT_FAMILIES];
+};
+
+int distinct_init(struct distinct_counter* counter, int ipv4_length, int ipv6_length);
+void distinct_free(struct distinct_counter* counter);
+int distinct_add(struct distinct_counter* counter, const struct ipaddr_bin* address);
+int distinct_add_addresses(struct distinct_counter* counter, FILE* input, int verbose);
+uint64_t distinct_estimate(struct distinct_counter* counter, int family);
+int distinct_merge(struct distinct_counter* counter, const struct distinct_counter* other);
+int distinct_load(struct distinct_counter* counter, const char* sketch_name);
+int distinct_save(struct distinct_counter* counter, const char* sketch_name);
+int distinct_print(struct distinct_counter* counter, FILE* output);
+
+#endif /* IPADDRCHECK_DISTINCT_H */
@@ -0,0 +1,377 @@
+/*
+ * ipaddrcheck_enumerate.c: enumeration of hosts and subnets of a prefix
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "ipaddrcheck_enumerate.h"
+
+/* Longest output line: an address, a prefix length and the line break */
+#define ENUMERATE_LINE_MAX (IPADDR_STR_MAX + 2)
+
+static void writer_init(struct enumerate_writer* writer, FILE* output)
+{
+    int i;
+
+    writer->output = output;
+    writer->position = writer->buffer;
+    writer->error = 0;
+
+    for( i = 0; i < 256; i++ )
+    {
+        memset(writer->octets[i], 0, 4);
+        writer->octet_lengths[i] = (uint8_t)sprintf(writer->octets[i], "%d", i);
+    }
+}
+
+static void writer_flush(struct enumerate_writer* writer)
+{
+    size_t length = writer->position - writer->buffer;
+
+    if( (length > 0) && (fwrite(writer->buffer, 1, length, writer->output) != length) )
+    {
+        writer->error = 1;
+    }
+    writer->position = writer->buffer;
+}
+
+/* Make room for one more line */
+static void writer_reserve(struct enumerate_writer* writer)
+{
+    if( (size_t)(writer->buffer + ENUMERATE_BUFFER_SIZE - writer->position) < ENUMERATE_LINE_MAX )
+    {
+        writer_flush(writer);
+    }
+}
+
+/* Flush the rest of the output, returns RESULT_INT_ERROR if any write failed */
+static int writer_finish(struct enumerate_writer* writer)
+{
+    writer_flush(writer);
+    if( fflush(writer->output) != 0 )
+    {
+        writer->error = 1;
+    }
+
+    if( writer->error )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+static int key_less(const struct interval_key* a, const struct interval_key* b)
+{
+    return( (a->high < b->high) || ((a->high == b->high) && (a->low < b->low)) );
+}
+
+static void key_add(struct interval_key* a, const struct interval_key* b)
+{
+    uint64_t low = a->low + b->low;
+
+    a->high += b->high + (low < a->low);
+    a->low = low;
+}
+
+static void key_sub(struct interval_key* a, const struct interval_key* b)
+{
+    uint64_t low = a->low - b->low;
+
+    a->high -= b->high + (low > a->low);
+    a->low = low;
+}
+
+/* Write the canonical text form of an IPv6 address (RFC 5952) into buf,
+ * which must be at least IPADDR_STR_MAX bytes long, and return its length.
+ * The output is the same as that of ipaddr_bin_to_str(), which handles
+ * the addresses that inet_ntop() prints with an embedded IPv4 address.
+ */
+int format_ipv6_key(const struct interval_key* key, char* buf)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+    uint16_t words[8];
+    int best_base = -1;
+    int best_length = 0;
+    int run_base = -1;
+    int run_length = 0;
+    char* p = buf;
+    int i;
+
+    for( i = 0; i < 4; i++ )
+    {
+        words[i] = (uint16_t)(key->high >> (48 - 16 * i));
+        words[i + 4] = (uint16_t)(key->low >> (48 - 16 * i));
+    }
+
+    if( (key->high == 0) && (words[4] == 0) && ((words[5] == 0) || (words[5] == 0xFFFF)) )
+    {
+        struct ipaddr_bin address;
+
+        address.proto = CIDR_IPV6;
+        address.pflen = 128;
+        for( i = 0; i < 8; i++ )
+        {
+            address.addr[2 * i] = (uint8_t)(words[i] >> 8);
+            address.addr[2 * i + 1] = (uint8_t)words[i];
+        }
+        return(ipaddr_bin_to_str(&address, buf));
+    }
+
+    /* The first longest run of two or more zero words is replaced with "::" */
+    for( i = 0; i < 8; i++ )
+    {
+        if( words[i] == 0 )
+        {
+            if( run_base < 0 )
+            {
+                run_base = i;
+                run_length = 0;
+            }
+            run_length++;
+            if( run_length > best_length )
+            {
+                best_base = run_base;
+                best_length = run_length;
+            }
+        }
+        else
+        {
+            run_base = -1;
+        }
+    }
+    if( best_length < 2 )
+    {
+        best_base = -1;
+        best_length = 0;
+    }
+
+    for( i = 0; i < 8; i++ )
+    {
+        uint16_t word = words[i];
+
+        if( i == best_base )
+        {
+            *p++ = ':';
+            *p++ = ':';
+            i += best_length - 1;
+            continue;
+        }
+        if( (i > 0) && (i != best_base + best_length) )
+        {
+            *p++ = ':';
+        }
+
+        if( word >= 0x1000 )
+        {
+            *p++ = hex_digits[word >> 12];
+        }
+        if( word >= 0x100 )
+        {
+            *p++ = hex_digits[(word >> 8) & 0xF];
+        }
+        if( word >= 0x10 )
+        {
+            *p++ = hex_digits[(word >> 4) & 0xF];
+        }
+        *p++ = hex_digits[word & 0xF];
+    }
+    *p = '\0';
+
+    return(p - buf);
+}
+
+/* Write every step-th IPv4 address from first to last, followed by suffix.
+ * The first three bytes of the text only change every 256 addresses,
+ * so they are formatted once and copied, and the last byte comes from a table.
+ */
+static void enumerate_ipv4(struct enumerate_writer* writer, uint32_t first, uint32_t last, uint64_t step,
+                           const char* suffix, size_t suffix_length)
+{
+    uint32_t address = first;
+    int done = 0;
+
+    while( !done )
+    {
+        uint32_t upper = address >> 8;
+        char prefix[16];
+        size_t prefix_length = 0;
+        int i;
+
+        for( i = 2; i >= 0; i-- )
+        {
+            uint8_t byte = (uint8_t)(upper >> (8 * i));
+
+            memcpy(prefix + prefix_length, writer->octets[byte], 4);
+            prefix_length += writer->octet_lengths[byte];
+            prefix[prefix_length++] = '.';
+        }
+
+        while( !done && ((address >> 8) == upper) )
+        {
+            uint8_t byte = (uint8_t)address;
+            char* p;
+
+            writer_reserve(writer);
+            p = writer->position;
+            memcpy(p, prefix, prefix_length);
+            p += prefix_length;
+            memcpy(p, writer->octets[byte], 4);
+            p += writer->octet_lengths[byte];
+            memcpy(p, suffix, suffix_length);
+            p += suffix_length;
+            *p++ = '\n';
+            writer->position = p;
+
+            if( (uint64_t)(last - address) < step )
+            {
+                done = 1;
+            }
+            else
+            {
+                address += (uint32_t)step;
+            }
+        }
+    }
+}
+
+/* Write every IPv6 address from first to last that is a multiple of step away
+   from the first, followed by suffix */
+static void enumerate_ipv6(struct enumerate_writer* writer, struct interval_key address,
+                           const struct interval_key* last, const struct interval_key* step,
+                           const char* suffix, size_t suffix_length)
+{
+    while( 1 )
+    {
+        struct interval_key remaining = *last;
+        char* p;
+
+        writer_reserve(writer);
+        p = writer->position;
+        p += format_ipv6_key(&address, p);
+        memcpy(p, suffix, suffix_length);
+        p += suffix_length;
+        *p++ = '\n';
+        writer->position = p;
+
+        key_sub(&remaining, &address);
+        if( key_less(&remaining, step) )
+        {
+            break;
+        }
+        key_add(&address, step);
+    }
+}
+
+/* Print the host addresses of a subnet, or every address of a range.
+ *
+ * Host addresses are those that pass --is-ipv4-host or --is-ipv6-host
+ * with the prefix length of the subnet, except the IPv4 broadcast address:
+ * subnets shorter than /31 (IPv4) or /127 (IPv6) lose their first address,
+ * and IPv4 ones their last address too.
+ */
+int enumerate_hosts(const struct address_interval* interval, FILE* output)
+{
+    static const struct interval_key one = { 0, 1 };
+    struct enumerate_writer* writer;
+    struct interval_key first = interval->first;
+    struct interval_key last = interval->last;
+    int result;
+
+    writer = malloc(sizeof(*writer));
+    if( writer == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+    writer_init(writer, output);
+
+    if( interval->proto == CIDR_IPV4 )
+    {
+        if( interval->is_subnet && (interval->pflen < 31) )
+        {
+            first.low++;
+            last.low--;
+        }
+        enumerate_ipv4(writer, (uint32_t)first.low, (uint32_t)last.low, 1, "", 0);
+    }
+    else
+    {
+        if( interval->is_subnet && (interval->pflen < 127) )
+        {
+            key_add(&first, &one);
+        }
+        enumerate_ipv6(writer, first, &last, &one, "", 0);
+    }
+
+    result = writer_finish(writer);
+    free(writer);
+
+    return(result);
+}
+
+/* Print the subnets of given length in a subnet, in ascending order */
+int enumerate_subnets(const struct address_interval* prefix, int subnet_length, FILE* output)
+{
+    int full_length = (prefix->proto == CIDR_IPV4) ? 32 : 128;
+    int shift = full_length - subnet_length;
+    struct enumerate_writer* writer;
+    char suffix[8];
+    size_t suffix_length;
+    int result;
+
+    if( !prefix->is_subnet || (subnet_length < prefix->pflen) || (subnet_length > full_length) )
+    {
+        fprintf(stderr, "Error: subnet length must be between the prefix length and %d\n", full_length);
+        return(RESULT_INT_ERROR);
+    }
+
+    writer = malloc(sizeof(*writer));
+    if( writer == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+    writer_init(writer, output);
+    suffix_length = sprintf(suffix, "/%d", subnet_length);
+
+    if( prefix->proto == CIDR_IPV4 )
+    {
+        enumerate_ipv4(writer, (uint32_t)prefix->first.low, (uint32_t)prefix->last.low,
+                       UINT64_C(1) << shift, suffix, suffix_length);
+    }
+    else if( shift == 128 )
+    {
+        /* ::/0 split into /0 subnets, the step would not fit */
+        enumerate_ipv6(writer, prefix->first, &prefix->first, &prefix->last, suffix, suffix_length);
+    }
+    else
+    {
+        struct interval_key step;
+
+        step.high = (shift >= 64) ? (UINT64_C(1) << (shift - 64)) : 0;
+        step.low = (shift >= 64) ? 0 : (UINT64_C(1) << shift);
+        enumerate_ipv6(writer, prefix->first, &prefix->last, &step, suffix, suffix_length);
+    }
+
+    result = writer_finish(writer);
+    free(writer);
+
+    return(result);
+}
@@ -0,0 +1,45 @@
+/*
+ * ipaddrcheck_enumerate.h: enumeration of hosts and subnets of a prefix
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_ENUMERATE_H
+#define IPADDRCHECK_ENUMERATE_H
+
+#include "ipaddrcheck_functions.h"
+#include "ipaddrcheck_interval.h"
+
+#define ENUMERATE_BUFFER_SIZE (1024 * 1024)
+
+/* Output buffer that lines are formatted into directly,
+   there is always room for one more line after enumerate_reserve() */
+struct enumerate_writer {
+    FILE* output;
+    char* position;
+    int error;
+    char octets[256][4];     /* Decimal text of every byte value, NUL padded */
+    uint8_t octet_lengths[256];
+    char buffer[ENUMERATE_BUFFER_SIZE];
+};
+
+int format_ipv6_key(const struct interval_key* key, char* buf);
+int enumerate_hosts(const struct address_interval* interval, FILE* output);
+int enumerate_subnets(const struct address_interval* prefix, int subnet_length, FILE* output);
+
+#endif /* IPADDRCHECK_ENUMERATE_H */
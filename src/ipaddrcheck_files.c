@@ -0,0 +1,813 @@
+/*
+ * ipaddrcheck_files.c: concurrent scanning of many files
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "config.h"
+#include "ipaddrcheck_files.h"
+#include "ipaddrcheck_scan.h"
+
+/* io_uring is used through the system calls, it needs no library */
+#ifdef HAVE_LINUX_IO_URING_H
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#ifdef __NR_io_uring_setup
+#define FILES_HAVE_URING 1
+#endif
+#endif
+
+/* Largest single read, io_uring takes 32-bit lengths */
+#define FILES_READ_MAX (1024 * 1024 * 1024)
+
+/* The reading thread waits for this many free jobs rather than
+   waking up for every single one */
+#define FILES_REFILL_COUNT (FILES_BUFFER_COUNT / 4)
+
+/* What is left to do with a job */
+#define FILES_JOB_READ     0    /* Read more of the file */
+#define FILES_JOB_QUEUED   1    /* Read whole and queued for scanning, or dropped on errors */
+
+/* A file that is being read or waits to be scanned. Every job has its own
+   preallocated block, which is where small files are read. */
+struct files_job {
+    const char* name;
+    int fd;
+    char* block;
+    char* buffer;           /* The block, or a larger buffer of its own */
+    size_t size;
+    size_t filled;
+    size_t expected;        /* Size of a regular file, 0 to read to the end */
+    struct iovec iov;
+    struct files_job* next; /* In the free list or the scan queue */
+};
+
+struct files_state {
+    struct files_job jobs[FILES_BUFFER_COUNT];
+    char* blocks;
+
+    pthread_mutex_t lock;
+    pthread_cond_t queue_ready;
+    pthread_cond_t job_free;
+    struct files_job* free_jobs;
+    int free_count;
+    struct files_job* queue_head;
+    struct files_job* queue_tail;
+    int reading_done;
+
+    FILE* output;
+    const int* checks;
+    int check_count;
+    int allow_loopback;
+    int verbose;
+    int result;
+};
+
+/* Errors are worse than failures, which are worse than success */
+static void files_merge_result(struct files_state* state, int result)
+{
+    if( (result == RESULT_INT_ERROR) || ((result == RESULT_FAILURE) && (state->result == RESULT_SUCCESS)) )
+    {
+        state->result = result;
+    }
+}
+
+/* Take a free job, waiting for the scanning threads to return one if wait is set */
+static struct files_job* files_take_job(struct files_state* state, int wait)
+{
+    struct files_job* job;
+
+    pthread_mutex_lock(&state->lock);
+    if( (state->free_jobs == NULL) && wait )
+    {
+        while( state->free_count < FILES_REFILL_COUNT )
+        {
+            pthread_cond_wait(&state->job_free, &state->lock);
+        }
+    }
+    job = state->free_jobs;
+    if( job != NULL )
+    {
+        state->free_jobs = job->next;
+        state->free_count--;
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    return(job);
+}
+
+/* Free the buffer of a job, if it has its own, and put it back on the free list.
+   Called with the lock held. */
+static void files_release_job(struct files_state* state, struct files_job* job)
+{
+    if( job->buffer != job->block )
+    {
+        free(job->buffer);
+    }
+    job->buffer = job->block;
+    job->next = state->free_jobs;
+    state->free_jobs = job;
+    if( ++state->free_count == FILES_REFILL_COUNT )
+    {
+        pthread_cond_signal(&state->job_free);
+    }
+}
+
+/* Close the file and hand the job to the scanning threads,
+   or drop it with an error message if errno is not 0 */
+static int files_finish_job(struct files_state* state, struct files_job* job, int error)
+{
+    if( job->fd >= 0 )
+    {
+        close(job->fd);
+        job->fd = -1;
+    }
+
+    pthread_mutex_lock(&state->lock);
+    if( error != 0 )
+    {
+        fprintf(stderr, "Error: could not read %s: %s\n", job->name, strerror(error));
+        files_merge_result(state, RESULT_INT_ERROR);
+        files_release_job(state, job);
+    }
+    else
+    {
+        job->next = NULL;
+        if( state->queue_tail != NULL )
+        {
+            state->queue_tail->next = job;
+        }
+        else
+        {
+            state->queue_head = job;
+        }
+        state->queue_tail = job;
+        pthread_cond_signal(&state->queue_ready);
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    return(FILES_JOB_QUEUED);
+}
+
+/* Open a file and pick the buffer its size needs */
+static int files_open(struct files_state* state, struct files_job* job, const char* name)
+{
+    struct stat st;
+
+    job->name = name;
+    job->filled = 0;
+    job->buffer = job->block;
+    job->size = FILES_BLOCK_SIZE;
+
+    job->fd = open(name, O_RDONLY);
+    if( (job->fd < 0) || (fstat(job->fd, &st) != 0) )
+    {
+        return(files_finish_job(state, job, errno));
+    }
+
+    /* Pipes and the like are read until the end */
+    job->expected = S_ISREG(st.st_mode) ? (size_t)st.st_size : 0;
+    if( S_ISREG(st.st_mode) && (st.st_size == 0) )
+    {
+        return(files_finish_job(state, job, 0));
+    }
+    if( job->expected > FILES_BLOCK_SIZE )
+    {
+        job->buffer = malloc(job->expected);
+        if( job->buffer == NULL )
+        {
+            job->buffer = job->block;
+            return(files_finish_job(state, job, ENOMEM));
+        }
+        job->size = job->expected;
+    }
+
+    return(FILES_JOB_READ);
+}
+
+/* Account for a completed read, count is the number of bytes or -errno.
+   Files that turn out longer than expected only have their expected size
+   scanned, those without a known size get a larger buffer when needed. */
+static int files_advance(struct files_state* state, struct files_job* job, long count)
+{
+    if( count < 0 )
+    {
+        return(files_finish_job(state, job, (int)-count));
+    }
+
+    job->filled += (size_t)count;
+    if( (count == 0) || ((job->expected > 0) && (job->filled >= job->expected)) )
+    {
+        return(files_finish_job(state, job, 0));
+    }
+
+    if( job->filled == job->size )
+    {
+        char* larger;
+
+        if( job->buffer == job->block )
+        {
+            larger = malloc(job->size * 2);
+            if( larger != NULL )
+            {
+                memcpy(larger, job->block, job->filled);
+            }
+        }
+        else
+        {
+            larger = realloc(job->buffer, job->size * 2);
+        }
+        if( larger == NULL )
+        {
+            return(files_finish_job(state, job, ENOMEM));
+        }
+        job->buffer = larger;
+        job->size *= 2;
+    }
+
+    return(FILES_JOB_READ);
+}
+
+/* Length of the next read of a job */
+static size_t files_read_length(const struct files_job* job)
+{
+    size_t length = job->size - job->filled;
+
+    return( (length < FILES_READ_MAX) ? length : FILES_READ_MAX );
+}
+
+/* Scan the files from the queue until the reading is done and the queue empty */
+static void* files_worker(void* data)
+{
+    struct files_state* state = data;
+
+    while( 1 )
+    {
+        struct files_job* job;
+        char* text = NULL;
+        size_t text_size = 0;
+        FILE* output;
+        int result;
+
+        pthread_mutex_lock(&state->lock);
+        while( (state->queue_head == NULL) && !state->reading_done )
+        {
+            pthread_cond_wait(&state->queue_ready, &state->lock);
+        }
+        job = state->queue_head;
+        if( job != NULL )
+        {
+            state->queue_head = job->next;
+            if( state->queue_head == NULL )
+            {
+                state->queue_tail = NULL;
+            }
+        }
+        pthread_mutex_unlock(&state->lock);
+
+        if( job == NULL )
+        {
+            break;
+        }
+
+        /* The results of a file are printed together */
+        output = open_memstream(&text, &text_size);
+        if( output == NULL )
+        {
+            fprintf(stderr, "Error: could not allocate memory!\n");
+            result = RESULT_INT_ERROR;
+        }
+        else
+        {
+            result = scan_buffer(job->buffer, job->filled, job->name, output, state->checks,
+                                 state->check_count, state->allow_loopback, state->verbose);
+            fclose(output);
+        }
+
+        pthread_mutex_lock(&state->lock);
+        if( fwrite(text, 1, text_size, state->output) != text_size )
+        {
+            result = RESULT_INT_ERROR;
+        }
+        files_merge_result(state, result);
+        files_release_job(state, job);
+        pthread_mutex_unlock(&state->lock);
+        free(text);
+    }
+
+    return(NULL);
+}
+
+/* Read the files one after another with pread */
+static void files_read_plain(struct files_state* state, char* const* names, size_t name_count)
+{
+    size_t i;
+
+    for( i = 0; i < name_count; i++ )
+    {
+        struct files_job* job = files_take_job(state, 1);
+        int next = files_open(state, job, names[i]);
+
+        while( next == FILES_JOB_READ )
+        {
+            ssize_t count = pread(job->fd, job->buffer + job->filled, files_read_length(job), job->filled);
+
+            if( (count < 0) && (errno == EINTR) )
+            {
+                continue;
+            }
+            next = files_advance(state, job, (count < 0) ? -errno : (long)count);
+        }
+    }
+}
+
+#ifdef FILES_HAVE_URING
+
+struct files_uring {
+    int fd;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned pending;       /* Entries not submitted yet */
+    int registered;         /* The blocks are registered buffers */
+    int busy;               /* Reads may still write to the buffers */
+};
+
+static void uring_close(struct files_uring* ring)
+{
+    if( ring->sqes != MAP_FAILED )
+    {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if( ring->cq_ring != MAP_FAILED )
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if( ring->sq_ring != MAP_FAILED )
+    {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->fd);
+}
+
+/* Set up a ring with room for a read per job, and register the blocks
+   so that the kernel does not have to map them for every read.
+   Registration fails if it would exceed RLIMIT_MEMLOCK, then plain
+   buffers are used. */
+static int uring_open(struct files_uring* ring, struct files_state* state)
+{
+    struct io_uring_params params;
+    struct iovec blocks[FILES_BUFFER_COUNT];
+    int i;
+
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, FILES_BUFFER_COUNT, &params);
+    if( ring->fd < 0 )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      ring->fd, IORING_OFF_SQES);
+    if( (ring->sq_ring == MAP_FAILED) || (ring->cq_ring == MAP_FAILED) || (ring->sqes == MAP_FAILED) )
+    {
+        uring_close(ring);
+        return(RESULT_FAILURE);
+    }
+
+    ring->sq_tail = (unsigned*)((char*)ring->sq_ring + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)((char*)ring->sq_ring + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)((char*)ring->sq_ring + params.sq_off.array);
+    ring->cq_head = (unsigned*)((char*)ring->cq_ring + params.cq_off.head);
+    ring->cq_tail = (unsigned*)((char*)ring->cq_ring + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)((char*)ring->cq_ring + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)((char*)ring->cq_ring + params.cq_off.cqes);
+    ring->pending = 0;
+    ring->busy = 0;
+
+    for( i = 0; i < FILES_BUFFER_COUNT; i++ )
+    {
+        blocks[i].iov_base = state->jobs[i].block;
+        blocks[i].iov_len = FILES_BLOCK_SIZE;
+    }
+    ring->registered = (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS,
+                                blocks, FILES_BUFFER_COUNT) == 0);
+
+    return(RESULT_SUCCESS);
+}
+
+/* Queue the next read of a job, tagged with the job number */
+static void uring_read(struct files_uring* ring, struct files_state* state, struct files_job* job)
+{
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = job->fd;
+    sqe->off = job->filled;
+    sqe->user_data = (uint64_t)(job - state->jobs);
+    if( ring->registered && (job->buffer == job->block) )
+    {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = (uint64_t)(uintptr_t)(job->buffer + job->filled);
+        sqe->len = (uint32_t)files_read_length(job);
+        sqe->buf_index = (uint16_t)(job - state->jobs);
+    }
+    else
+    {
+        job->iov.iov_base = job->buffer + job->filled;
+        job->iov.iov_len = files_read_length(job);
+        sqe->opcode = IORING_OP_READV;
+        sqe->addr = (uint64_t)(uintptr_t)&job->iov;
+        sqe->len = 1;
+    }
+
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+}
+
+/* Wait for the reads the kernel has been given, without submitting
+   the queued ones, so that none of them writes to a buffer after it
+   is freed. Every job has at most one read queued or in flight. */
+static int uring_drain(struct files_uring* ring, unsigned in_flight)
+{
+    unsigned submitted = in_flight - ring->pending;
+
+    while( submitted > 0 )
+    {
+        unsigned head;
+        unsigned tail;
+
+        if( syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            return(RESULT_FAILURE);
+        }
+
+        head = *ring->cq_head;
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        submitted -= tail - head;
+        __atomic_store_n(ring->cq_head, tail, __ATOMIC_RELEASE);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Keep up to one read per job in flight, and hand every file
+   to the scanning threads as soon as it is read whole */
+static int files_read_uring(struct files_state* state, struct files_uring* ring,
+                            char* const* names, size_t name_count)
+{
+    size_t next_name = 0;
+    unsigned in_flight = 0;
+
+    while( (next_name < name_count) || (in_flight > 0) )
+    {
+        struct files_job* job;
+        unsigned head;
+        unsigned tail;
+        int count;
+
+        /* Only wait for a free job if there is nothing to wait for in the ring */
+        while( (next_name < name_count) && ((job = files_take_job(state, in_flight == 0)) != NULL) )
+        {
+            if( files_open(state, job, names[next_name++]) == FILES_JOB_READ )
+            {
+                uring_read(ring, state, job);
+                in_flight++;
+            }
+        }
+        if( in_flight == 0 )
+        {
+            continue;
+        }
+
+        do
+        {
+            count = (int)syscall(__NR_io_uring_enter, ring->fd, ring->pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        }
+        while( (count < 0) && (errno == EINTR) );
+        if( count < 0 )
+        {
+            fprintf(stderr, "Error: io_uring_enter failed: %s\n", strerror(errno));
+            if( uring_drain(ring, in_flight) != RESULT_SUCCESS )
+            {
+                ring->busy = 1;
+            }
+            return(RESULT_INT_ERROR);
+        }
+        ring->pending -= (unsigned)count;
+
+        head = *ring->cq_head;
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        while( head != tail )
+        {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+
+            job = &state->jobs[cqe->user_data];
+            if( files_advance(state, job, cqe->res) == FILES_JOB_READ )
+            {
+                uring_read(ring, state, job);
+            }
+            else
+            {
+                in_flight--;
+            }
+            head++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+#endif /* FILES_HAVE_URING */
+
+/* Read file names, one per line, into an array to be freed
+   with free_file_names, or return NULL if the memory runs out */
+char** read_file_names(FILE* input, size_t* name_count)
+{
+    char** names = NULL;
+    size_t names_size = 0;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+
+    *name_count = 0;
+    while( (line_length = getline(&line, &line_size, input)) != -1 )
+    {
+        if( (line_length > 0) && (line[line_length-1] == '\n') )
+        {
+            line[--line_length] = '\0';
+        }
+        if( line_length == 0 )
+        {
+            continue;
+        }
+
+        if( *name_count == names_size )
+        {
+            char** larger;
+
+            names_size = (names_size == 0) ? 64 : names_size * 2;
+            larger = realloc(names, names_size * sizeof(char*));
+            if( larger == NULL )
+            {
+                break;
+            }
+            names = larger;
+        }
+        names[*name_count] = strdup(line);
+        if( names[*name_count] == NULL )
+        {
+            break;
+        }
+        (*name_count)++;
+    }
+    free(line);
+
+    if( !feof(input) )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free_file_names(names, *name_count);
+        return(NULL);
+    }
+
+    /* An empty list is not an error */
+    if( names == NULL )
+    {
+        names = malloc(sizeof(char*));
+    }
+
+    return(names);
+}
+
+void free_file_names(char** names, size_t name_count)
+{
+    size_t i;
+
+    for( i = 0; i < name_count; i++ )
+    {
+        free(names[i]);
+    }
+    free(names);
+}
+
+/* Find the addresses in every file, run the checks on them and print
+ * the results like scan_buffer does. The reading thread keeps many reads
+ * in flight with io_uring, or reads the files one by one with plain reads
+ * where io_uring is not available, and a pool of threads scans the files
+ * that have been read whole. The results of a file are printed together,
+ * but the files come in the order their reads complete.
+ *
+ * A thread count of 0 uses one thread per processor.
+ * Returns RESULT_SUCCESS if all addresses passed, RESULT_FAILURE if any
+ * did not, and RESULT_INT_ERROR if any file could not be read
+ * or the results could not be written.
+ */
+int scan_files(char* const* names, size_t name_count, FILE* output,
+               const int* checks, int check_count, int allow_loopback, int verbose,
+               int read_method, int thread_count)
+{
+    struct files_state* state;
+    pthread_t threads[FILES_MAX_THREADS];
+    int started = 0;
+    int result;
+    int i;
+#ifdef FILES_HAVE_URING
+    struct files_uring ring;
+    int have_ring = 0;
+#endif
+    int buffers_busy = 0;
+
+    if( thread_count <= 0 )
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (processors > 0) ? (int)processors : 1;
+    }
+    if( thread_count > FILES_MAX_THREADS )
+    {
+        thread_count = FILES_MAX_THREADS;
+    }
+
+    state = malloc(sizeof(struct files_state));
+    if( state == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+    state->blocks = malloc((size_t)FILES_BUFFER_COUNT * FILES_BLOCK_SIZE);
+    if( state->blocks == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free(state);
+        return(RESULT_INT_ERROR);
+    }
+
+    state->free_jobs = NULL;
+    state->free_count = FILES_BUFFER_COUNT;
+    for( i = FILES_BUFFER_COUNT - 1; i >= 0; i-- )
+    {
+        state->jobs[i].fd = -1;
+        state->jobs[i].block = state->blocks + (size_t)i * FILES_BLOCK_SIZE;
+        state->jobs[i].buffer = state->jobs[i].block;
+        state->jobs[i].next = state->free_jobs;
+        state->free_jobs = &state->jobs[i];
+    }
+    state->queue_head = NULL;
+    state->queue_tail = NULL;
+    state->reading_done = 0;
+    state->output = output;
+    state->checks = checks;
+    state->check_count = check_count;
+    state->allow_loopback = allow_loopback;
+    state->verbose = verbose;
+    state->result = RESULT_SUCCESS;
+    pthread_mutex_init(&state->lock, NULL);
+    pthread_cond_init(&state->queue_ready, NULL);
+    pthread_cond_init(&state->job_free, NULL);
+
+#ifdef FILES_HAVE_URING
+    if( read_method != FILES_READ_PLAIN )
+    {
+        have_ring = (uring_open(&ring, state) == RESULT_SUCCESS);
+    }
+    if( !have_ring && (read_method == FILES_READ_URING) )
+    {
+        fprintf(stderr, "Error: io_uring is not available: %s\n", strerror(errno));
+        state->result = RESULT_INT_ERROR;
+    }
+#else
+    if( read_method == FILES_READ_URING )
+    {
+        fprintf(stderr, "Error: io_uring is not supported by this build\n");
+        state->result = RESULT_INT_ERROR;
+    }
+#endif
+
+    for( i = 0; (i < thread_count) && (state->result == RESULT_SUCCESS); i++ )
+    {
+        if( pthread_create(&threads[started], NULL, files_worker, state) == 0 )
+        {
+            started++;
+        }
+    }
+    if( (started == 0) && (state->result == RESULT_SUCCESS) )
+    {
+        fprintf(stderr, "Error: could not start threads\n");
+        state->result = RESULT_INT_ERROR;
+    }
+
+    if( state->result == RESULT_SUCCESS )
+    {
+#ifdef FILES_HAVE_URING
+        if( have_ring )
+        {
+            if( files_read_uring(state, &ring, names, name_count) != RESULT_SUCCESS )
+            {
+                pthread_mutex_lock(&state->lock);
+                files_merge_result(state, RESULT_INT_ERROR);
+                pthread_mutex_unlock(&state->lock);
+            }
+        }
+        else
+#endif
+        {
+            files_read_plain(state, names, name_count);
+        }
+    }
+
+    pthread_mutex_lock(&state->lock);
+    state->reading_done = 1;
+    pthread_cond_broadcast(&state->queue_ready);
+    pthread_mutex_unlock(&state->lock);
+    for( i = 0; i < started; i++ )
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+#ifdef FILES_HAVE_URING
+    if( have_ring )
+    {
+        buffers_busy = ring.busy;
+        uring_close(&ring);
+    }
+#endif
+    for( i = 0; i < FILES_BUFFER_COUNT; i++ )
+    {
+        if( state->jobs[i].fd >= 0 )
+        {
+            close(state->jobs[i].fd);
+        }
+        if( (state->jobs[i].buffer != state->jobs[i].block) && !buffers_busy )
+        {
+            free(state->jobs[i].buffer);
+        }
+    }
+
+    pthread_mutex_destroy(&state->lock);
+    pthread_cond_destroy(&state->queue_ready);
+    pthread_cond_destroy(&state->job_free);
+    result = state->result;
+    if( (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        result = RESULT_INT_ERROR;
+    }
+
+    /* Closing the ring cancels the reads that could not be waited for,
+       but not before they return, so their buffers are left allocated */
+    if( !buffers_busy )
+    {
+        free(state->blocks);
+        free(state);
+    }
+
+    return(result);
+}
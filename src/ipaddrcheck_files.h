@@ -0,0 +1,46 @@
+/*
+ * ipaddrcheck_files.h: concurrent scanning of many files
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_FILES_H
+#define IPADDRCHECK_FILES_H
+
+#include "ipaddrcheck_functions.h"
+
+/* Every file is read whole into one buffer. Files up to the block size use
+   the preallocated (and with io_uring, registered) buffers, larger ones
+   get a buffer of their own. The buffer count is also the number of reads
+   in flight. */
+#define FILES_BLOCK_SIZE   (128 * 1024)
+#define FILES_BUFFER_COUNT 64
+#define FILES_MAX_THREADS  64
+
+/* How the files are read */
+#define FILES_READ_AUTO    0    /* io_uring if the kernel allows it, otherwise plain reads */
+#define FILES_READ_URING   1
+#define FILES_READ_PLAIN   2
+
+char** read_file_names(FILE* input, size_t* name_count);
+void free_file_names(char** names, size_t name_count);
+int scan_files(char* const* names, size_t name_count, FILE* output,
+               const int* checks, int check_count, int allow_loopback, int verbose,
+               int read_method, int thread_count);
+
+#endif /* IPADDRCHECK_FILES_H */
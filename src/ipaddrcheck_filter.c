@@ -0,0 +1,204 @@
+/*
+ * ipaddrcheck_filter.c: selection of the lines that pass the checks
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "ipaddrcheck_filter.h"
+#include "ipaddrcheck_actions.h"
+
+struct filter_state {
+    FILE* output;
+    const int* checks;
+    int check_count;
+    int allow_loopback;
+    int select;
+    int verbose;
+    uint64_t line;
+    int matched;
+    int write_error;
+    /* Longer lines fail before their text is quoted */
+    char reason[CHECK_REASON_SIZE(ADDRESS_SLICE_MAX)];
+};
+
+/* Check every line in text and write the selected ones. Lines are checked
+ * in place, and every run of selected lines is written with a single call
+ * straight from the input buffer. A missing line break at the end of the
+ * text is added to the output.
+ */
+static void filter_lines(struct filter_state* state, const char* text, size_t length)
+{
+    const char* end = text + length;
+    const char* run_start = NULL;
+    const char* p = text;
+
+    while( p < end )
+    {
+        const char* line_end = memchr(p, '\n', end - p);
+        const char* next = (line_end != NULL) ? line_end + 1 : end;
+        const char* stop = (line_end != NULL) ? line_end : end;
+        int result;
+
+        if( (stop > p) && (stop[-1] == '\r') )
+        {
+            stop--;
+        }
+
+        state->line++;
+        result = check_address_n(ipaddrcheck_default_ctx(), p, stop - p, state->checks, state->check_count,
+                                 state->allow_loopback, state->reason, sizeof(state->reason));
+        if( (result != RESULT_SUCCESS) && state->verbose )
+        {
+            fprintf(stderr, "line %llu: %s\n", (unsigned long long)state->line, state->reason);
+        }
+
+        if( (result == RESULT_SUCCESS) == (state->select == FILTER_PASSING) )
+        {
+            if( run_start == NULL )
+            {
+                run_start = p;
+            }
+            state->matched = 1;
+        }
+        else if( run_start != NULL )
+        {
+            size_t run_length = p - run_start;
+            state->write_error |= (fwrite(run_start, 1, run_length, state->output) != run_length);
+            run_start = NULL;
+        }
+
+        p = next;
+    }
+
+    if( run_start != NULL )
+    {
+        size_t run_length = end - run_start;
+        state->write_error |= (fwrite(run_start, 1, run_length, state->output) != run_length);
+        if( end[-1] != '\n' )
+        {
+            state->write_error |= (fputc('\n', state->output) == EOF);
+        }
+    }
+}
+
+/* Copy the lines of the input that pass all checks to the output,
+ * or with FILTER_FAILING, those that do not, like grep and grep -v.
+ * Without checks, lines are only checked to be well-formed addresses.
+ *
+ * Returns RESULT_SUCCESS if any line was printed, RESULT_FAILURE if none
+ * was, and RESULT_INT_ERROR on read and write errors.
+ */
+int filter_addresses(FILE* input, FILE* output, const int* checks, int check_count,
+                     int allow_loopback, int select, int verbose)
+{
+    struct filter_state* state;
+    size_t buffer_size = FILTER_BUFFER_SIZE;
+    size_t filled = 0;
+    char* buffer;
+    int result = RESULT_SUCCESS;
+
+    state = malloc(sizeof(struct filter_state));
+    buffer = malloc(buffer_size);
+    if( (state == NULL) || (buffer == NULL) )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free(state);
+        free(buffer);
+        return(RESULT_INT_ERROR);
+    }
+
+    state->output = output;
+    state->checks = checks;
+    state->check_count = check_count;
+    state->allow_loopback = allow_loopback;
+    state->select = select;
+    state->verbose = verbose;
+    state->line = 0;
+    state->matched = 0;
+    state->write_error = 0;
+
+    /* Whole lines are checked, the incomplete last one is kept for the next read */
+    while( !state->write_error )
+    {
+        size_t count;
+        size_t complete;
+
+        if( filled == buffer_size )
+        {
+            char* larger = realloc(buffer, buffer_size * 2);
+            if( larger == NULL )
+            {
+                fprintf(stderr, "Error: could not allocate memory!\n");
+                result = RESULT_INT_ERROR;
+                break;
+            }
+            buffer = larger;
+            buffer_size *= 2;
+        }
+
+        count = fread(buffer + filled, 1, buffer_size - filled, input);
+        if( count == 0 )
+        {
+            if( ferror(input) )
+            {
+                fprintf(stderr, "Error: could not read input\n");
+                result = RESULT_INT_ERROR;
+            }
+            else
+            {
+                filter_lines(state, buffer, filled);
+            }
+            break;
+        }
+
+        /* The kept part has no line break, only the new bytes are searched */
+        complete = filled + count;
+        while( (complete > filled) && (buffer[complete - 1] != '\n') )
+        {
+            complete--;
+        }
+        if( complete == filled )
+        {
+            complete = 0;
+        }
+        filled += count;
+
+        if( complete > 0 )
+        {
+            filter_lines(state, buffer, complete);
+            memmove(buffer, buffer + complete, filled - complete);
+            filled -= complete;
+        }
+    }
+
+    if( (result == RESULT_SUCCESS) && !state->matched )
+    {
+        result = RESULT_FAILURE;
+    }
+
+    if( state->write_error || (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        result = RESULT_INT_ERROR;
+    }
+
+    free(buffer);
+    free(state);
+
+    return(result);
+}
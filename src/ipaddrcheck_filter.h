@@ -0,0 +1,36 @@
+/*
+ * ipaddrcheck_filter.h: selection of the lines that pass the checks
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_FILTER_H
+#define IPADDRCHECK_FILTER_H
+
+#include "ipaddrcheck_functions.h"
+
+#define FILTER_BUFFER_SIZE (1024 * 1024)
+
+/* Which lines are printed */
+#define FILTER_PASSING  0
+#define FILTER_FAILING  1
+
+int filter_addresses(FILE* input, FILE* output, const int* checks, int check_count,
+                     int allow_loopback, int select, int verbose);
+
+#endif /* IPADDRCHECK_FILTER_H */
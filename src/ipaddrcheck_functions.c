@@ -21,9 +21,14 @@
  */
 
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #include <assert.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <pthread.h>
 
 #include "ipaddrcheck_functions.h"
+#include "ipaddrcheck_special.h"
 
 /*
  * Address string functions
@@ -39,18 +44,39 @@
  * the format was.
  */
 
-int regex_matches(const char* regex, const char* str)
+#define PATTERN_DUPLICATE_DOUBLE_COLONS 0
+#define PATTERN_IPV4_CIDR               1
+#define PATTERN_IPV4_SINGLE             2
+#define PATTERN_IPV6_CIDR               3
+#define PATTERN_IPV6_SINGLE             4
+#define PATTERN_IPV4_RANGE              5
+#define PATTERN_IPV6_RANGE              6
+
+static const char* const pattern_sources[IPADDRCHECK_PATTERN_COUNT] = {
+    /* More than one double colon? IPv6 addresses allow replacing
+       no more than one group of zeros with a '::' shortcut. */
+    ".*(::).*\\1",
+    "^((([1-9]\\d{0,2}|0)\\.){3}([1-9]\\d{0,2}|0)\\/([1-9]\\d*|0))$",
+    "^((([1-9]\\d{0,2}|0)\\.){3}([1-9]\\d{0,2}|0))$",
+    "^((([0-9a-fA-F\\:])+)(\\/\\d{1,3}))$",
+    "^(([0-9a-fA-F\\:])+)$",
+    "^([0-9\\.]+\\-[0-9\\.]+)$",
+    "^([0-9a-fA-F:]+\\-[0-9a-fA-F:]+)$"
+};
+
+/* Does the pattern match the first len bytes of str?
+   pcre_exec() never reads past the given length. */
+static int pattern_matches(const struct ipaddrcheck_ctx* ctx, int pattern, const char* str, size_t len)
 {
-    int offsets[1];
-    pcre *re;
+    int offsets[3];
     int rc;
-    const char *error;
-    int erroffset;
 
-    re = pcre_compile(regex, 0, &error, &erroffset, NULL);
-    assert(re != NULL);
+    if( len > INT_MAX )
+    {
+        return RESULT_FAILURE;
+    }
 
-    rc = pcre_exec(re, NULL, str, strlen(str), 0, 0, offsets, 1);
+    rc = pcre_exec(ctx->patterns[pattern], NULL, str, (int)len, 0, 0, offsets, 3);
 
     if( rc >= 0)
     {
@@ -62,46 +88,43 @@ int regex_matches(const char* regex, const char* str)
     }
 }
 
-
-/* Does it contain more than one double colon?
-   IPv6 addresses allow replacing no more than one group of zeros with a '::' shortcut. */
-int duplicate_double_colons(char* address_str) {
-    return regex_matches(".*(::).*\\1", address_str);
+/* Does it contain more than one double colon? */
+int duplicate_double_colons_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len)
+{
+    return pattern_matches(ctx, PATTERN_DUPLICATE_DOUBLE_COLONS, ptr, len);
 }
 
 /* Is it an IPv4 address with prefix length (e.g., 192.0.2.1/24)? */
-int is_ipv4_cidr(char* address_str)
+int is_ipv4_cidr_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len)
 {
-    return regex_matches("^((([1-9]\\d{0,2}|0)\\.){3}([1-9]\\d{0,2}|0)\\/([1-9]\\d*|0))$",
-        address_str);
+    return pattern_matches(ctx, PATTERN_IPV4_CIDR, ptr, len);
 }
 
 /* Is it a single dotted decimal address? */
-int is_ipv4_single(char* address_str)
+int is_ipv4_single_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len)
 {
-    return regex_matches("^((([1-9]\\d{0,2}|0)\\.){3}([1-9]\\d{0,2}|0))$",
-        address_str);
+    return pattern_matches(ctx, PATTERN_IPV4_SINGLE, ptr, len);
 }
 
 /* Is it an IPv6 address with prefix length (e.g., 2001:db8::1/64)? */
-int is_ipv6_cidr(char* address_str)
+int is_ipv6_cidr_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len)
 {
-    return regex_matches("^((([0-9a-fA-F\\:])+)(\\/\\d{1,3}))$", address_str);
+    return pattern_matches(ctx, PATTERN_IPV6_CIDR, ptr, len);
 }
 
 /* Is it a single IPv6 address? */
-int is_ipv6_single(char* address_str)
+int is_ipv6_single_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len)
 {
-    return regex_matches("^(([0-9a-fA-F\\:])+)$", address_str);
+    return pattern_matches(ctx, PATTERN_IPV6_SINGLE, ptr, len);
 }
 
 /* Is it a CIDR-formatted IPv4 or IPv6 address? */
-int is_any_cidr(char* address_str)
+int is_any_cidr_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len)
 {
     int result;
 
-    if( (is_ipv4_cidr(address_str) == RESULT_SUCCESS) ||
-        (is_ipv6_cidr(address_str) == RESULT_SUCCESS) )
+    if( (is_ipv4_cidr_n(ctx, ptr, len) == RESULT_SUCCESS) ||
+        (is_ipv6_cidr_n(ctx, ptr, len) == RESULT_SUCCESS) )
     {
         result = RESULT_SUCCESS;
     }
@@ -114,12 +137,12 @@ int is_any_cidr(char* address_str)
 }
 
 /* Is it a single IPv4 or IPv6 address? */
-int is_any_single(char* address_str)
+int is_any_single_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len)
 {
     int result;
 
-    if( (is_ipv4_single(address_str) == RESULT_SUCCESS) ||
-        (is_ipv6_single(address_str) == RESULT_SUCCESS) )
+    if( (is_ipv4_single_n(ctx, ptr, len) == RESULT_SUCCESS) ||
+        (is_ipv6_single_n(ctx, ptr, len) == RESULT_SUCCESS) )
     {
         result = RESULT_SUCCESS;
     }
@@ -131,10 +154,228 @@ int is_any_single(char* address_str)
     return(result);
 }
 
+int duplicate_double_colons_r(const struct ipaddrcheck_ctx* ctx, const char* address_str)
+{
+    return duplicate_double_colons_n(ctx, address_str, strlen(address_str));
+}
+
+int is_ipv4_cidr_r(const struct ipaddrcheck_ctx* ctx, const char* address_str)
+{
+    return is_ipv4_cidr_n(ctx, address_str, strlen(address_str));
+}
+
+int is_ipv4_single_r(const struct ipaddrcheck_ctx* ctx, const char* address_str)
+{
+    return is_ipv4_single_n(ctx, address_str, strlen(address_str));
+}
+
+int is_ipv6_cidr_r(const struct ipaddrcheck_ctx* ctx, const char* address_str)
+{
+    return is_ipv6_cidr_n(ctx, address_str, strlen(address_str));
+}
+
+int is_ipv6_single_r(const struct ipaddrcheck_ctx* ctx, const char* address_str)
+{
+    return is_ipv6_single_n(ctx, address_str, strlen(address_str));
+}
+
+int is_any_cidr_r(const struct ipaddrcheck_ctx* ctx, const char* address_str)
+{
+    return is_any_cidr_n(ctx, address_str, strlen(address_str));
+}
+
+int is_any_single_r(const struct ipaddrcheck_ctx* ctx, const char* address_str)
+{
+    return is_any_single_n(ctx, address_str, strlen(address_str));
+}
+
+int duplicate_double_colons(char* address_str)
+{
+    return duplicate_double_colons_r(ipaddrcheck_default_ctx(), address_str);
+}
+
+int is_ipv4_cidr(char* address_str)
+{
+    return is_ipv4_cidr_r(ipaddrcheck_default_ctx(), address_str);
+}
+
+int is_ipv4_single(char* address_str)
+{
+    return is_ipv4_single_r(ipaddrcheck_default_ctx(), address_str);
+}
+
+int is_ipv6_cidr(char* address_str)
+{
+    return is_ipv6_cidr_r(ipaddrcheck_default_ctx(), address_str);
+}
+
+int is_ipv6_single(char* address_str)
+{
+    return is_ipv6_single_r(ipaddrcheck_default_ctx(), address_str);
+}
+
+int is_any_cidr(char* address_str)
+{
+    return is_any_cidr_r(ipaddrcheck_default_ctx(), address_str);
+}
+
+int is_any_single(char* address_str)
+{
+    return is_any_single_r(ipaddrcheck_default_ctx(), address_str);
+}
+
+/*
+ * Check contexts
+ */
+
+/* Compile the format patterns and constant addresses of a new context,
+   which has no diagnostics buffer */
+int ipaddrcheck_ctx_init(struct ipaddrcheck_ctx* ctx)
+{
+    int i;
+
+    memset(ctx, 0, sizeof(*ctx));
+
+    for( i = 0; i < IPADDRCHECK_PATTERN_COUNT; i++ )
+    {
+        const char* error;
+        int erroffset;
+
+        ctx->patterns[i] = pcre_compile(pattern_sources[i], 0, &error, &erroffset, NULL);
+        if( ctx->patterns[i] == NULL )
+        {
+            ipaddrcheck_ctx_free(ctx);
+            return(RESULT_INT_ERROR);
+        }
+    }
+
+    ctx->ipv4_unspecified = cidr_from_str(IPV4_UNSPECIFIED);
+    ctx->ipv4_limited_broadcast = cidr_from_str(IPV4_LIMITED_BROADCAST);
+    ctx->ipv6_loopback = cidr_from_str(IPV6_LOOPBACK);
+    if( (ctx->ipv4_unspecified == NULL) || (ctx->ipv4_limited_broadcast == NULL) ||
+        (ctx->ipv6_loopback == NULL) )
+    {
+        ipaddrcheck_ctx_free(ctx);
+        return(RESULT_INT_ERROR);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+void ipaddrcheck_ctx_free(struct ipaddrcheck_ctx* ctx)
+{
+    int i;
+
+    for( i = 0; i < IPADDRCHECK_PATTERN_COUNT; i++ )
+    {
+        if( ctx->patterns[i] != NULL )
+        {
+            pcre_free(ctx->patterns[i]);
+            ctx->patterns[i] = NULL;
+        }
+    }
+
+    if( ctx->ipv4_unspecified != NULL )
+    {
+        cidr_free(ctx->ipv4_unspecified);
+    }
+    if( ctx->ipv4_limited_broadcast != NULL )
+    {
+        cidr_free(ctx->ipv4_limited_broadcast);
+    }
+    if( ctx->ipv6_loopback != NULL )
+    {
+        cidr_free(ctx->ipv6_loopback);
+    }
+    ctx->ipv4_unspecified = NULL;
+    ctx->ipv4_limited_broadcast = NULL;
+    ctx->ipv6_loopback = NULL;
+}
+
+/* Collect the diagnostics of the checks in buf, one per line.
+   They are truncated to fit, and discarded if buf is NULL. */
+void ipaddrcheck_ctx_set_diagnostics(struct ipaddrcheck_ctx* ctx, char* buf, size_t size)
+{
+    ctx->diagnostics = buf;
+    ctx->diagnostics_size = (buf != NULL) ? size : 0;
+    if( ctx->diagnostics_size > 0 )
+    {
+        buf[0] = '\0';
+    }
+}
+
+static struct ipaddrcheck_ctx default_ctx;
+static pthread_once_t default_ctx_once = PTHREAD_ONCE_INIT;
+static int default_ctx_result = RESULT_INT_ERROR;
+
+static void default_ctx_init(void)
+{
+    default_ctx_result = ipaddrcheck_ctx_init(&default_ctx);
+}
+
+/* The context of the functions without the _r suffix,
+   compiled on first use. It has no diagnostics buffer. */
+const struct ipaddrcheck_ctx* ipaddrcheck_default_ctx(void)
+{
+    pthread_once(&default_ctx_once, default_ctx_init);
+    assert(default_ctx_result == RESULT_SUCCESS);
+
+    return(&default_ctx);
+}
+
+/* Append a line to the diagnostics buffer of a context, if it has one */
+static void ctx_diagnostic(struct ipaddrcheck_ctx* ctx, const char* format, ...)
+{
+    size_t length;
+    va_list args;
+
+    if( ctx->diagnostics_size == 0 )
+    {
+        return;
+    }
+
+    length = strlen(ctx->diagnostics);
+    if( length + 1 < ctx->diagnostics_size )
+    {
+        va_start(args, format);
+        vsnprintf(ctx->diagnostics + length, ctx->diagnostics_size - length, format, args);
+        va_end(args);
+
+        length += strlen(ctx->diagnostics + length);
+        if( length + 1 < ctx->diagnostics_size )
+        {
+            ctx->diagnostics[length++] = '\n';
+            ctx->diagnostics[length] = '\0';
+        }
+    }
+}
+
 /*
  * Address checking functions that rely on libcidr
  */
 
+/* cidr_equals() of an address and the network or broadcast address
+   of its prefix, without leaking the latter */
+static int compare_network(CIDR *address)
+{
+    CIDR* network = cidr_addr_network(address);
+    int result = cidr_equals(address, network);
+
+    cidr_free(network);
+
+    return(result);
+}
+
+static int compare_broadcast(CIDR *address)
+{
+    CIDR* broadcast = cidr_addr_broadcast(address);
+    int result = cidr_equals(address, broadcast);
+
+    cidr_free(broadcast);
+
+    return(result);
+}
+
 /* Does it look like a valid address of any protocol? */
 int is_valid_address(CIDR *address)
 {
@@ -176,7 +417,7 @@ int is_ipv4_host(CIDR *address)
     int result;
 
     if( (cidr_get_proto(address) == CIDR_IPV4) &&
-        ((cidr_equals(address, cidr_addr_network(address)) < 0) ||
+        ((compare_network(address) < 0) ||
         (cidr_get_pflen(address) >= 31)) )
     {
          result = RESULT_SUCCESS;
@@ -195,7 +436,7 @@ int is_ipv4_net(CIDR *address)
     int result;
 
     if( (cidr_get_proto(address) == CIDR_IPV4) &&
-        (cidr_equals(address, cidr_addr_network(address)) == 0) )
+        (compare_network(address) == 0) )
     {
          result = RESULT_SUCCESS;
     }
@@ -215,7 +456,7 @@ int is_ipv4_broadcast(CIDR *address)
     /* The very concept of broadcast address doesn't apply to
        IPv6 and point-to-point (/31) or isolated (/32) IPv4 addresses. */
     if( (cidr_get_proto(address) == CIDR_IPV4) &&
-        (cidr_equals(address, cidr_addr_broadcast(address)) == 0 ) &&
+        (compare_broadcast(address) == 0 ) &&
         (cidr_get_pflen(address) < 31) )
     {
         result = RESULT_SUCCESS;
@@ -234,7 +475,7 @@ int is_ipv4_multicast(CIDR *address)
     int result;
 
     if( (cidr_get_proto(address) == CIDR_IPV4) &&
-        (cidr_contains(cidr_from_str(IPV4_MULTICAST), address) == 0) )
+        (classify_address(address) & SPECIAL_MULTICAST) )
     {
         result = RESULT_SUCCESS;
     }
@@ -252,7 +493,7 @@ int is_ipv4_loopback(CIDR *address)
     int result;
 
     if( (cidr_get_proto(address) == CIDR_IPV4) &&
-        (cidr_contains(cidr_from_str(IPV4_LOOPBACK), address) == 0) )
+        (classify_address(address) & SPECIAL_LOOPBACK) )
     {
         result = RESULT_SUCCESS;
     }
@@ -270,7 +511,7 @@ int is_ipv4_link_local(CIDR *address)
     int result;
 
     if( (cidr_get_proto(address) == CIDR_IPV4) &&
-        (cidr_contains(cidr_from_str(IPV4_LINKLOCAL), address) == 0) )
+        (classify_address(address) & SPECIAL_LINK_LOCAL) )
     {
         result = RESULT_SUCCESS;
     }
@@ -287,10 +528,9 @@ int is_ipv4_rfc1918(CIDR *address)
 {
     int result;
 
+    /* RFC 1918 ranges are the "Private-Use" entries of the registry */
     if( (cidr_get_proto(address) == CIDR_IPV4) &&
-        ( (cidr_contains(cidr_from_str(IPV4_RFC1918_A), address) == 0) ||
-        (cidr_contains(cidr_from_str(IPV4_RFC1918_B), address) == 0) ||
-        (cidr_contains(cidr_from_str(IPV4_RFC1918_C), address) == 0) ) )
+        (classify_address(address) & SPECIAL_PRIVATE_USE) )
     {
         result = RESULT_SUCCESS;
     }
@@ -340,7 +580,7 @@ int is_ipv6_host(CIDR *address)
       */
 
     if( (cidr_get_proto(address) == CIDR_IPV6) &&
-        ((cidr_equals(address, cidr_addr_network(address)) < 0) ||
+        ((compare_network(address) < 0) ||
         (cidr_get_pflen(address) >= 127)) )
     {
          result = RESULT_SUCCESS;
@@ -359,7 +599,7 @@ int is_ipv6_net(CIDR *address)
     int result;
 
     if( (cidr_get_proto(address) == CIDR_IPV6) &&
-        (cidr_equals(address, cidr_addr_network(address)) == 0) )
+        (compare_network(address) == 0) )
     {
          result = RESULT_SUCCESS;
     }
@@ -377,7 +617,7 @@ int is_ipv6_multicast(CIDR *address)
     int result;
 
     if( (cidr_get_proto(address) == CIDR_IPV6) &&
-        (cidr_contains(cidr_from_str(IPV6_MULTICAST), address) == 0) )
+        (classify_address(address) & SPECIAL_MULTICAST) )
     {
         result = RESULT_SUCCESS;
     }
@@ -394,8 +634,10 @@ int is_ipv6_link_local(CIDR *address)
 {
     int result;
 
+    /* The registry reserves fe80::/10, but only fe80::/64 is actually used
+       for link-local addresses (RFC 4291 section 2.5.6) */
     if( (cidr_get_proto(address) == CIDR_IPV6) &&
-        (cidr_contains(cidr_from_str(IPV6_LINKLOCAL), address) == 0) )
+        (classify_address(address) & SPECIAL_LINK_LOCAL_SUBNET) )
     {
         result = RESULT_SUCCESS;
     }
@@ -410,7 +652,8 @@ int is_ipv6_link_local(CIDR *address)
 /* Is it an address that can be assigned to a network interface?
    (i.e., is it a host address that is not reserved for any special use)
  */
-int is_valid_intf_address(CIDR *address, char* address_str, int allow_loopback)
+int is_valid_intf_address_r(const struct ipaddrcheck_ctx* ctx, CIDR *address, const char* address_str,
+                            int allow_loopback)
 {
     int result;
 
@@ -418,12 +661,12 @@ int is_valid_intf_address(CIDR *address, char* address_str, int allow_loopback)
         (is_ipv4_multicast(address) == RESULT_FAILURE) &&
         (is_ipv6_multicast(address) == RESULT_FAILURE) &&
         ((is_ipv4_loopback(address) == RESULT_FAILURE) || (allow_loopback == LOOPBACK_ALLOWED)) &&
-        (cidr_equals(address, cidr_from_str(IPV6_LOOPBACK)) != 0) &&
-        (cidr_equals(address, cidr_from_str(IPV4_UNSPECIFIED)) != 0) &&
-        (cidr_contains(cidr_from_str(IPV4_THIS), address) != 0) &&
-        (cidr_equals(address, cidr_from_str(IPV4_LIMITED_BROADCAST)) != 0) &&
+        (cidr_equals(address, ctx->ipv6_loopback) != 0) &&
+        (cidr_equals(address, ctx->ipv4_unspecified) != 0) &&
+        !(classify_address(address) & SPECIAL_THIS_NETWORK) &&
+        (cidr_equals(address, ctx->ipv4_limited_broadcast) != 0) &&
         (is_any_host(address) == RESULT_SUCCESS) &&
-        (is_any_cidr(address_str) == RESULT_SUCCESS) )
+        (is_any_cidr_r(ctx, address_str) == RESULT_SUCCESS) )
     {
         result = RESULT_SUCCESS;
     }
@@ -435,6 +678,11 @@ int is_valid_intf_address(CIDR *address, char* address_str, int allow_loopback)
     return(result);
 }
 
+int is_valid_intf_address(CIDR *address, char* address_str, int allow_loopback)
+{
+    return is_valid_intf_address_r(ipaddrcheck_default_ctx(), address, address_str, allow_loopback);
+}
+
 /* Is it an IPv4 or IPv6 host address? */
 int is_any_host(CIDR *address)
 {
@@ -471,35 +719,34 @@ int is_any_net(CIDR *address)
     return(result);
 }
 
-/* Split a hyphen-separated range into its left and right components.
- * This function is patently unsafe,
- * whether it's safe to do what it does should be determined by its callers.
+/* Split a hyphen-separated range of len bytes into its left and right
+ * components, which must have room for component_size bytes each.
+ * Returns RESULT_FAILURE if either component would not fit.
  */
-void split_range(char* range_str, char* left, char* right)
+static int split_range(const char* range_ptr, size_t range_len, char* left, char* right, size_t component_size)
 {
-    char* ptr = left;
-    int length = strlen(range_str);
-    int pos = 0;
-    int index = 0;
-    while(pos < length)
+    const char* hyphen = memchr(range_ptr, '-', range_len);
+    size_t left_length;
+    size_t right_length;
+
+    if( hyphen == NULL )
     {
-        if( range_str[pos] == '-' )
-        {
-            ptr[index] = '\0';
-            ptr = right;
-            index = 0;
-        }
-        else
-        {
-            ptr[index] = range_str[pos];
-            index++;
-        }
+        return(RESULT_FAILURE);
+    }
 
-        pos++;
+    left_length = hyphen - range_ptr;
+    right_length = range_len - left_length - 1;
+    if( (left_length >= component_size) || (right_length >= component_size) )
+    {
+        return(RESULT_FAILURE);
     }
-    ptr[index] = '\0';
 
-    return;
+    memcpy(left, range_ptr, left_length);
+    left[left_length] = '\0';
+    memcpy(right, hyphen + 1, right_length);
+    right[right_length] = '\0';
+
+    return(RESULT_SUCCESS);
 }
 
 /* in6_addr fields are byte arrays, so we cannot compare them as numbers
@@ -518,81 +765,88 @@ int compare_ipv6(struct in6_addr *left, struct in6_addr *right)
     return 0;
 }
 
+/* Does the network of given prefix length around the left address
+   contain the right one? */
+static int range_within_prefix(const char* left, CIDR* right_addr, int prefix_length)
+{
+    /* Long enough for an IPv6 address and a prefix length of up to 128 */
+    char left_pref_str[44];
+    CIDR* left_addr_with_pref;
+    CIDR* left_net;
+    int result = RESULT_FAILURE;
+
+    sprintf(left_pref_str, "%s/%u", left, prefix_length);
+    left_addr_with_pref = cidr_from_str(left_pref_str);
+    if( left_addr_with_pref == NULL )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    left_net = cidr_addr_network(left_addr_with_pref);
+    if( cidr_contains(left_net, right_addr) == 0 )
+    {
+        result = RESULT_SUCCESS;
+    }
+    cidr_free(left_addr_with_pref);
+    cidr_free(left_net);
+
+    return(result);
+}
+
 /* Is it a valid IPv4 address range? */
-int is_ipv4_range(char* range_str, int prefix_length, int verbose)
+int is_ipv4_range_n(struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len, int prefix_length)
 {
     int result = RESULT_SUCCESS;
+    int shown = (len > INT_MAX) ? INT_MAX : (int)len;   /* Length of the range in diagnostics */
 
-    int regex_check_res = regex_matches("^([0-9\\.]+\\-[0-9\\.]+)$", range_str);
+    /* At most 15 characters for an IPv4 address, plus the terminating null byte */
+    char left[16];
+    char right[16];
 
-    if( !regex_check_res )
+    if( !pattern_matches(ctx, PATTERN_IPV4_RANGE, ptr, len) )
     {
-        if( verbose )
-        {
-            fprintf(stderr, "Malformed range %s: must be a pair of hyphen-separated IPv4 addresses\n", range_str);
-        }
+        ctx_diagnostic(ctx, "Malformed range %.*s: must be a pair of hyphen-separated IPv4 addresses", shown, ptr);
+        result = RESULT_FAILURE;
+    }
+    else if( split_range(ptr, len, left, right, sizeof(left)) != RESULT_SUCCESS )
+    {
+        ctx_diagnostic(ctx, "Malformed range %.*s: must be a pair of hyphen-separated IPv4 addresses", shown, ptr);
+        result = RESULT_FAILURE;
+    }
+    else if( !is_ipv4_single_r(ctx, left) )
+    {
+        ctx_diagnostic(ctx, "Malformed range %.*s: %s is not a valid IPv4 address", shown, ptr, left);
+        result = RESULT_FAILURE;
+    }
+    else if( !is_ipv4_single_r(ctx, right) )
+    {
+        ctx_diagnostic(ctx, "Malformed range %.*s: %s is not a valid IPv4 address", shown, ptr, right);
         result = RESULT_FAILURE;
     }
     else
     {
-       /* Extract sub-components from the range string. */
-
-        /* Allocate memory for the components of the range.
-           We need at most 15 characters for an IPv4 address, plus space for the terminating null byte. */
-        char left[16];
-        char right[16];
-
-        /* Split the string at the hyphen.
-           If the regex check succeeded, we know the hyphen is there. */
-        split_range(range_str, left, right);
+        CIDR* left_addr = cidr_from_str(left);
+        CIDR* right_addr = cidr_from_str(right);
+        struct in_addr left_in_addr;
+        struct in_addr right_in_addr;
 
-        if( !is_ipv4_single(left) )
-        {
-            if( verbose )
-            {
-                fprintf(stderr, "Malformed range %s: %s is not a valid IPv4 address\n", range_str, left);
-            }
-            result = RESULT_FAILURE;
-        }
-        else if( !is_ipv4_single(right) )
+        if( (left_addr == NULL) || (right_addr == NULL) )
         {
-            if( verbose )
-            {
-                fprintf(stderr, "Malformed range %s: %s is not a valid IPv4 address\n", range_str, right);
-            }
+            ctx_diagnostic(ctx, "Malformed range %.*s: its addresses are not valid IPv4 addresses", shown, ptr);
             result = RESULT_FAILURE;
         }
         else
         {
-            CIDR* left_addr = cidr_from_str(left);
-            CIDR* right_addr = cidr_from_str(right);
-            struct in_addr* left_in_addr = cidr_to_inaddr(left_addr, NULL);
-            struct in_addr* right_in_addr = cidr_to_inaddr(right_addr, NULL);
+            cidr_to_inaddr(left_addr, &left_in_addr);
+            cidr_to_inaddr(right_addr, &right_in_addr);
 
-            if( left_in_addr->s_addr <= right_in_addr->s_addr )
+            if( ntohl(left_in_addr.s_addr) <= ntohl(right_in_addr.s_addr) )
             {
                 /* If non-zero prefix_length is given,
                    check if the right address is within the network of the first one. */
                 if( prefix_length > 0 )
                 {
-                    char left_pref_str[19];
-
-                    /* XXX: Prefix length size is checked elsewhere, so it can't be more than 2 characters (32)
-                       and overflow cannot occur.
-                     */
-                    sprintf(left_pref_str, "%s/%u", left, prefix_length);
-                    CIDR* left_addr_with_pref = cidr_from_str(left_pref_str);
-                    CIDR* left_net = cidr_addr_network(left_addr_with_pref);
-                    if( cidr_contains(left_net, right_addr) == 0 )
-                    {
-                        result = RESULT_SUCCESS;
-                    }
-                    else
-                    {
-                        result = RESULT_FAILURE;
-                    }
-                    cidr_free(left_addr_with_pref);
-                    cidr_free(left_net);
+                    result = range_within_prefix(left, right_addr, prefix_length);
                 }
                 else
                 {
@@ -601,14 +855,17 @@ int is_ipv4_range(char* range_str, int prefix_length, int verbose)
             }
             else
             {
-                if( verbose )
-                {
-                    fprintf(stderr, "Malformed IPv4 range %s: its first address is greater than the last\n", range_str);
-                }
+                ctx_diagnostic(ctx, "Malformed IPv4 range %.*s: its first address is greater than the last", shown, ptr);
                 result = RESULT_FAILURE;
             }
+        }
 
+        if( left_addr != NULL )
+        {
             cidr_free(left_addr);
+        }
+        if( right_addr != NULL )
+        {
             cidr_free(right_addr);
         }
     }
@@ -617,80 +874,59 @@ int is_ipv4_range(char* range_str, int prefix_length, int verbose)
 }
 
 /* Is it a valid IPv6 address range? */
-int is_ipv6_range(char* range_str, int prefix_length, int verbose)
+int is_ipv6_range_n(struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len, int prefix_length)
 {
     int result = RESULT_SUCCESS;
+    int shown = (len > INT_MAX) ? INT_MAX : (int)len;   /* Length of the range in diagnostics */
 
-    int regex_check_res = regex_matches("^([0-9a-fA-F:]+\\-[0-9a-fA-F:]+)$", range_str);
+    /* At most 39 characters for an IPv6 address, plus the terminating null byte */
+    char left[40];
+    char right[40];
 
-    if( !regex_check_res )
+    if( !pattern_matches(ctx, PATTERN_IPV6_RANGE, ptr, len) )
     {
-        if( verbose )
-        {
-            fprintf(stderr, "Malformed range %s: must be a pair of hyphen-separated IPv6 addresses\n", range_str);
-        }
+        ctx_diagnostic(ctx, "Malformed range %.*s: must be a pair of hyphen-separated IPv6 addresses", shown, ptr);
+        result = RESULT_FAILURE;
+    }
+    else if( split_range(ptr, len, left, right, sizeof(left)) != RESULT_SUCCESS )
+    {
+        ctx_diagnostic(ctx, "Malformed range %.*s: must be a pair of hyphen-separated IPv6 addresses", shown, ptr);
+        result = RESULT_FAILURE;
+    }
+    else if( !is_ipv6_single_r(ctx, left) )
+    {
+        ctx_diagnostic(ctx, "Malformed range %.*s: %s is not a valid IPv6 address", shown, ptr, left);
+        result = RESULT_FAILURE;
+    }
+    else if( !is_ipv6_single_r(ctx, right) )
+    {
+        ctx_diagnostic(ctx, "Malformed range %.*s: %s is not a valid IPv6 address", shown, ptr, right);
         result = RESULT_FAILURE;
     }
     else
     {
-       /* Extract sub-components from the range string. */
-
-        /* Allocate memory for the components of the range.
-           We need at most 39 characters for an IPv6 address, plus space for the terminating null byte. */
-        char left[40];
-        char right[40];
-
-        /* Split the string at the hyphen.
-           If the regex check succeeded, we know the hyphen is there. */
-        split_range(range_str, left, right);
+        CIDR* left_addr = cidr_from_str(left);
+        CIDR* right_addr = cidr_from_str(right);
+        struct in6_addr left_in6_addr;
+        struct in6_addr right_in6_addr;
 
-        if( !is_ipv6_single(left) )
-        {
-            if( verbose )
-            {
-                fprintf(stderr, "Malformed range %s: %s is not a valid IPv6 address\n", range_str, left);
-            }
-            result = RESULT_FAILURE;
-        }
-        else if( !is_ipv6_single(right) )
+        if( (left_addr == NULL) || (right_addr == NULL) )
         {
-            if( verbose )
-            {
-                fprintf(stderr, "Malformed range %s: %s is not a valid IPv6 address\n", range_str, right);
-            }
+            ctx_diagnostic(ctx, "Malformed range %.*s: its addresses are not valid IPv6 addresses", shown, ptr);
             result = RESULT_FAILURE;
         }
         else
         {
-            CIDR* left_addr = cidr_from_str(left);
-            CIDR* right_addr = cidr_from_str(right);
-            struct in6_addr* left_in6_addr = cidr_to_in6addr(left_addr, NULL);
-            struct in6_addr* right_in6_addr = cidr_to_in6addr(right_addr, NULL);
+            cidr_to_in6addr(left_addr, &left_in6_addr);
+            cidr_to_in6addr(right_addr, &right_in6_addr);
 
-            if( compare_ipv6(left_in6_addr, right_in6_addr) <= 0 )
+            if( compare_ipv6(&left_in6_addr, &right_in6_addr) <= 0 )
             {
                 /* If non-zero prefix_length is given,
                    check if the right address is within the network of the first one. */
                 if( prefix_length > 0 )
                 {
-                    char left_pref_str[44];
-
-                    /* XXX: Prefix length size is checked elsewhere, so it can't be more than 3 characters (128)
-                       and overflow cannot occur.
-                     */
-                    sprintf(left_pref_str, "%s/%u", left, prefix_length);
-                    CIDR* left_addr_with_pref = cidr_from_str(left_pref_str);
-                    CIDR* left_net = cidr_addr_network(left_addr_with_pref);
-                    if( cidr_contains(left_net, right_addr) == 0 )
-                    {
-                        result = RESULT_SUCCESS;
-                    }
-                    else
-                    {
-                        result = RESULT_FAILURE;
-                    }
-                    cidr_free(left_addr_with_pref);
-                    cidr_free(left_net);
+                    result = range_within_prefix(left, right_addr, prefix_length);
                 }
                 else
                 {
@@ -699,14 +935,17 @@ int is_ipv6_range(char* range_str, int prefix_length, int verbose)
             }
             else
             {
-                if( verbose )
-                {
-                    fprintf(stderr, "Malformed IPv6 range %s: its first address is greater than the last\n", range_str);
-                }
+                ctx_diagnostic(ctx, "Malformed IPv6 range %.*s: its first address is greater than the last", shown, ptr);
                 result = RESULT_FAILURE;
             }
+        }
 
+        if( left_addr != NULL )
+        {
             cidr_free(left_addr);
+        }
+        if( right_addr != NULL )
+        {
             cidr_free(right_addr);
         }
     }
@@ -714,3 +953,169 @@ int is_ipv6_range(char* range_str, int prefix_length, int verbose)
     return(result);
 }
 
+int is_ipv4_range_r(struct ipaddrcheck_ctx* ctx, const char* range_str, int prefix_length)
+{
+    return(is_ipv4_range_n(ctx, range_str, strlen(range_str), prefix_length));
+}
+
+int is_ipv6_range_r(struct ipaddrcheck_ctx* ctx, const char* range_str, int prefix_length)
+{
+    return(is_ipv6_range_n(ctx, range_str, strlen(range_str), prefix_length));
+}
+
+/* Run a range check on a copy of the default context
+   that collects its diagnostics, and print them if verbose */
+static int range_check(int (*check)(struct ipaddrcheck_ctx*, const char*, int),
+                       char* range_str, int prefix_length, int verbose)
+{
+    struct ipaddrcheck_ctx ctx = *ipaddrcheck_default_ctx();
+    size_t diagnostics_size = 2 * strlen(range_str) + 128;
+    char* diagnostics = malloc(diagnostics_size);
+    int result;
+
+    ipaddrcheck_ctx_set_diagnostics(&ctx, diagnostics, diagnostics_size);
+    result = check(&ctx, range_str, prefix_length);
+    if( verbose && (diagnostics != NULL) )
+    {
+        fputs(diagnostics, stderr);
+    }
+    free(diagnostics);
+
+    return(result);
+}
+
+int is_ipv4_range(char* range_str, int prefix_length, int verbose)
+{
+    return(range_check(is_ipv4_range_r, range_str, prefix_length, verbose));
+}
+
+int is_ipv6_range(char* range_str, int prefix_length, int verbose)
+{
+    return(range_check(is_ipv6_range_r, range_str, prefix_length, verbose));
+}
+
+
+/*
+ * Fixed-width binary address functions
+ */
+
+/* Convert an address string to the fixed-width binary form.
+   The string must pass the same sanity checks that main() performs
+   before running any actions: it must be a valid address,
+   in one of the formats we support, with no more than one "::". */
+int str_to_ipaddr_bin_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len,
+                        struct ipaddr_bin* address)
+{
+    char address_str[ADDRESS_SLICE_MAX];
+    int result = RESULT_FAILURE;
+    CIDR* cidr;
+
+    /* The format checks work on the slice itself, libcidr needs a string */
+    if( (len >= sizeof(address_str)) ||
+        !((is_any_cidr_n(ctx, ptr, len) == RESULT_SUCCESS) ||
+          (is_any_single_n(ctx, ptr, len) == RESULT_SUCCESS)) ||
+        (duplicate_double_colons_n(ctx, ptr, len) == RESULT_SUCCESS) )
+    {
+        return(RESULT_FAILURE);
+    }
+    memcpy(address_str, ptr, len);
+    address_str[len] = '\0';
+
+    cidr = cidr_from_str(address_str);
+    if( is_valid_address(cidr) == RESULT_SUCCESS )
+    {
+        result = cidr_to_ipaddr_bin(cidr, address);
+    }
+
+    if( cidr != NULL )
+    {
+        cidr_free(cidr);
+    }
+
+    return(result);
+}
+
+int str_to_ipaddr_bin_r(const struct ipaddrcheck_ctx* ctx, const char* address_str, struct ipaddr_bin* address)
+{
+    return(str_to_ipaddr_bin_n(ctx, address_str, strlen(address_str), address));
+}
+
+int str_to_ipaddr_bin(char* address_str, struct ipaddr_bin* address)
+{
+    return(str_to_ipaddr_bin_r(ipaddrcheck_default_ctx(), address_str, address));
+}
+
+/* Convert an address already parsed by libcidr to the fixed-width binary form */
+int cidr_to_ipaddr_bin(CIDR* cidr, struct ipaddr_bin* address)
+{
+    int proto = cidr_get_proto(cidr);
+
+    memset(address, 0, sizeof(*address));
+
+    if( proto == CIDR_IPV4 )
+    {
+        struct in_addr in_addr;
+        cidr_to_inaddr(cidr, &in_addr);
+        memcpy(&address->addr[12], &in_addr.s_addr, 4);
+    }
+    else if( proto == CIDR_IPV6 )
+    {
+        struct in6_addr in6_addr;
+        cidr_to_in6addr(cidr, &in6_addr);
+        memcpy(address->addr, in6_addr.s6_addr, 16);
+    }
+    else
+    {
+        return(RESULT_FAILURE);
+    }
+
+    address->proto = (uint8_t)proto;
+    address->pflen = (uint8_t)cidr_get_pflen(cidr);
+
+    return(RESULT_SUCCESS);
+}
+
+/* Bit mask of the special-purpose registry categories an address belongs to,
+   see ipaddrcheck_special.h. Invalid addresses belong to none. */
+uint64_t classify_address(CIDR* address)
+{
+    struct ipaddr_bin address_bin;
+
+    if( cidr_to_ipaddr_bin(address, &address_bin) != RESULT_SUCCESS )
+    {
+        return(0);
+    }
+
+    return(classify_ipaddr_bin(&address_bin));
+}
+
+/* Write the canonical text form of a binary address into buf,
+   which must be at least IPADDR_STR_MAX bytes long.
+   Prefix length is only included if it's shorter than the address itself.
+   Returns the length of the resulting string.
+ */
+int ipaddr_bin_to_str(const struct ipaddr_bin* address, char* buf)
+{
+    int length;
+
+    if( address->proto == CIDR_IPV4 )
+    {
+        inet_ntop(AF_INET, &address->addr[12], buf, INET_ADDRSTRLEN);
+        length = strlen(buf);
+        if( address->pflen < 32 )
+        {
+            length += sprintf(buf + length, "/%u", address->pflen);
+        }
+    }
+    else
+    {
+        inet_ntop(AF_INET6, address->addr, buf, INET6_ADDRSTRLEN);
+        length = strlen(buf);
+        if( address->pflen < 128 )
+        {
+            length += sprintf(buf + length, "/%u", address->pflen);
+        }
+    }
+
+    return(length);
+}
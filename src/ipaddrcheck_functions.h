@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <getopt.h>
 #include <pcre.h>
 #include <libcidr.h>
@@ -52,6 +53,75 @@
 #define NO_LOOPBACK      0
 #define LOOPBACK_ALLOWED 1
 
+/* Longest text form of an address with prefix length,
+   e.g. "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff/128", plus the null byte */
+#define IPADDR_STR_MAX 44
+
+/* Longer slices cannot be valid addresses in any format the checks accept,
+   and are rejected before they are copied for libcidr */
+#define ADDRESS_SLICE_MAX 128
+
+/* Fixed-width binary form of an address that passed the usual checks.
+   The address is in network byte order and uses the libcidr layout,
+   i.e. IPv4 addresses occupy the last four bytes of the array. */
+struct ipaddr_bin {
+    uint8_t proto;     /* CIDR_IPV4 or CIDR_IPV6 */
+    uint8_t addr[16];
+    uint8_t pflen;
+};
+
+/* Number of compiled format patterns in a check context */
+#define IPADDRCHECK_PATTERN_COUNT 7
+
+/* Everything the checks need besides the address itself: compiled format
+ * patterns, constant addresses, and an optional buffer that collects
+ * diagnostics instead of printing them.
+ *
+ * A context is only read by the checks, except for its diagnostics buffer,
+ * so one without a buffer can be shared by any number of threads.
+ * The functions without the _r suffix use such a default context.
+ */
+struct ipaddrcheck_ctx {
+    pcre* patterns[IPADDRCHECK_PATTERN_COUNT];
+    CIDR* ipv4_unspecified;
+    CIDR* ipv4_limited_broadcast;
+    CIDR* ipv6_loopback;
+    char* diagnostics;          /* Caller-supplied, may be NULL */
+    size_t diagnostics_size;
+};
+
+int ipaddrcheck_ctx_init(struct ipaddrcheck_ctx* ctx);
+void ipaddrcheck_ctx_free(struct ipaddrcheck_ctx* ctx);
+void ipaddrcheck_ctx_set_diagnostics(struct ipaddrcheck_ctx* ctx, char* buf, size_t size);
+const struct ipaddrcheck_ctx* ipaddrcheck_default_ctx(void);
+
+/* The _n variants check the first len bytes at ptr, which need not be
+   null-terminated. They never read past them or write to them. */
+int duplicate_double_colons_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len);
+int is_ipv4_cidr_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len);
+int is_ipv4_single_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len);
+int is_ipv6_cidr_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len);
+int is_ipv6_single_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len);
+int is_any_cidr_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len);
+int is_any_single_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len);
+int is_ipv4_range_n(struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len, int prefix_length);
+int is_ipv6_range_n(struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len, int prefix_length);
+int str_to_ipaddr_bin_n(const struct ipaddrcheck_ctx* ctx, const char* ptr, size_t len,
+                        struct ipaddr_bin* address);
+
+int duplicate_double_colons_r(const struct ipaddrcheck_ctx* ctx, const char* address_str);
+int is_ipv4_cidr_r(const struct ipaddrcheck_ctx* ctx, const char* address_str);
+int is_ipv4_single_r(const struct ipaddrcheck_ctx* ctx, const char* address_str);
+int is_ipv6_cidr_r(const struct ipaddrcheck_ctx* ctx, const char* address_str);
+int is_ipv6_single_r(const struct ipaddrcheck_ctx* ctx, const char* address_str);
+int is_any_cidr_r(const struct ipaddrcheck_ctx* ctx, const char* address_str);
+int is_any_single_r(const struct ipaddrcheck_ctx* ctx, const char* address_str);
+int is_valid_intf_address_r(const struct ipaddrcheck_ctx* ctx, CIDR *address, const char* address_str,
+                            int allow_loopback);
+int is_ipv4_range_r(struct ipaddrcheck_ctx* ctx, const char* range_str, int prefix_length);
+int is_ipv6_range_r(struct ipaddrcheck_ctx* ctx, const char* range_str, int prefix_length);
+int str_to_ipaddr_bin_r(const struct ipaddrcheck_ctx* ctx, const char* address_str, struct ipaddr_bin* address);
+
 int duplicate_double_colons(char* address_str);
 int is_ipv4_cidr(char* address_str);
 int is_ipv4_single(char* address_str);
@@ -78,5 +148,9 @@ int is_any_host(CIDR *address);
 int is_any_net(CIDR *address);
 int is_ipv4_range(char* range_str, int prefix_length, int verbose);
 int is_ipv6_range(char* range_str, int prefix_length, int verbose);
+int str_to_ipaddr_bin(char* address_str, struct ipaddr_bin* address);
+int cidr_to_ipaddr_bin(CIDR* cidr, struct ipaddr_bin* address);
+uint64_t classify_address(CIDR* address);
+int ipaddr_bin_to_str(const struct ipaddr_bin* address, char* buf);
 
 #endif /* IPADDRCHECK_FUNCTIONS_H */
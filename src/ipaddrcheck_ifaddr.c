@@ -0,0 +1,643 @@
+/*
+ * ipaddrcheck_ifaddr.c: conflicts with addresses configured on the host
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "ipaddrcheck_ifaddr.h"
+
+void ifaddr_table_init(struct ifaddr_table* table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+void ifaddr_table_free(struct ifaddr_table* table)
+{
+    free(table->entries);
+    free(table->links);
+    interval_tree_free(&table->subnets);
+    memset(table, 0, sizeof(*table));
+}
+
+static int add_entry(struct ifaddr_table* table, const struct ifaddr_entry* entry)
+{
+    if( table->count == table->size )
+    {
+        size_t new_size = table->size ? table->size * 2 : 64;
+        struct ifaddr_entry* new_entries = realloc(table->entries, new_size * sizeof(*new_entries));
+
+        if( new_entries == NULL )
+        {
+            return(RESULT_INT_ERROR);
+        }
+        table->entries = new_entries;
+        table->size = new_size;
+    }
+    table->entries[table->count++] = *entry;
+
+    return(RESULT_SUCCESS);
+}
+
+static int add_link(struct ifaddr_table* table, const struct ifaddr_link* link)
+{
+    if( table->link_count == table->link_size )
+    {
+        size_t new_size = table->link_size ? table->link_size * 2 : 16;
+        struct ifaddr_link* new_links = realloc(table->links, new_size * sizeof(*new_links));
+
+        if( new_links == NULL )
+        {
+            return(RESULT_INT_ERROR);
+        }
+        table->links = new_links;
+        table->link_size = new_size;
+    }
+    table->links[table->link_count++] = *link;
+
+    return(RESULT_SUCCESS);
+}
+
+/* Find the attribute of given type in the attributes of a message,
+   set data and its length and return RESULT_SUCCESS if there is one,
+   RESULT_FAILURE if there is none and RESULT_INT_ERROR if they are malformed */
+static int find_attribute(const uint8_t* attributes, size_t length, unsigned short type,
+                          const uint8_t** data, size_t* data_length)
+{
+    size_t offset = 0;
+    int result = RESULT_FAILURE;
+
+    while( length - offset >= sizeof(struct rtattr) )
+    {
+        struct rtattr attribute;
+
+        memcpy(&attribute, attributes + offset, sizeof(attribute));
+        if( (attribute.rta_len < sizeof(attribute)) || (attribute.rta_len > length - offset) )
+        {
+            return(RESULT_INT_ERROR);
+        }
+        if( (attribute.rta_type == type) && (result == RESULT_FAILURE) )
+        {
+            *data = attributes + offset + RTA_LENGTH(0);
+            *data_length = attribute.rta_len - RTA_LENGTH(0);
+            result = RESULT_SUCCESS;
+        }
+        if( RTA_ALIGN(attribute.rta_len) >= length - offset )
+        {
+            break;
+        }
+        offset += RTA_ALIGN(attribute.rta_len);
+    }
+
+    return(result);
+}
+
+static int parse_link(struct ifaddr_table* table, const uint8_t* payload, size_t length)
+{
+    struct ifinfomsg info;
+    struct ifaddr_link link;
+    const uint8_t* name;
+    size_t name_length;
+    int found;
+
+    if( length < NLMSG_ALIGN(sizeof(info)) )
+    {
+        return(RESULT_FAILURE);
+    }
+    memcpy(&info, payload, sizeof(info));
+
+    found = find_attribute(payload + NLMSG_ALIGN(sizeof(info)), length - NLMSG_ALIGN(sizeof(info)),
+                           IFLA_IFNAME, &name, &name_length);
+    if( found == RESULT_INT_ERROR )
+    {
+        return(RESULT_FAILURE);
+    }
+    if( found == RESULT_FAILURE )
+    {
+        return(RESULT_SUCCESS);
+    }
+
+    memset(&link, 0, sizeof(link));
+    link.ifindex = (uint32_t)info.ifi_index;
+    memcpy(link.name, name, (name_length < IFADDR_NAME_MAX) ? name_length : IFADDR_NAME_MAX - 1);
+
+    return(add_link(table, &link));
+}
+
+static int parse_address(struct ifaddr_table* table, const uint8_t* payload, size_t length)
+{
+    struct ifaddrmsg info;
+    struct ifaddr_entry entry;
+    const uint8_t* attributes = payload + NLMSG_ALIGN(sizeof(info));
+    size_t attributes_length;
+    const uint8_t* address;
+    size_t address_length;
+    size_t found_length;
+    int found;
+
+    if( length < NLMSG_ALIGN(sizeof(info)) )
+    {
+        return(RESULT_FAILURE);
+    }
+    memcpy(&info, payload, sizeof(info));
+    attributes_length = length - NLMSG_ALIGN(sizeof(info));
+
+    memset(&entry, 0, sizeof(entry));
+    if( info.ifa_family == AF_INET )
+    {
+        entry.address.proto = CIDR_IPV4;
+        address_length = 4;
+    }
+    else if( info.ifa_family == AF_INET6 )
+    {
+        entry.address.proto = CIDR_IPV6;
+        address_length = 16;
+    }
+    else
+    {
+        return(RESULT_SUCCESS);
+    }
+    if( info.ifa_prefixlen > address_length * 8 )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    /* IFA_ADDRESS is the peer of point-to-point IPv4 addresses,
+       the local address is IFA_LOCAL then */
+    found = find_attribute(attributes, attributes_length, IFA_LOCAL, &address, &found_length);
+    if( found == RESULT_FAILURE )
+    {
+        found = find_attribute(attributes, attributes_length, IFA_ADDRESS, &address, &found_length);
+    }
+    if( found == RESULT_FAILURE )
+    {
+        return(RESULT_SUCCESS);
+    }
+    if( (found == RESULT_INT_ERROR) || (found_length != address_length) )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    memcpy(&entry.address.addr[16 - address_length], address, address_length);
+    entry.address.pflen = info.ifa_prefixlen;
+    entry.ifindex = info.ifa_index;
+    entry.scope = info.ifa_scope;
+
+    return(add_entry(table, &entry));
+}
+
+/* Add the links and addresses of a dump, which may be several dumps one
+ * after another, to the table. Other messages are skipped.
+ *
+ * Returns RESULT_FAILURE if the messages are malformed or there is
+ * an error message, RESULT_INT_ERROR if memory ran out.
+ */
+int ifaddr_table_parse(struct ifaddr_table* table, const void* messages, size_t length)
+{
+    const uint8_t* bytes = messages;
+    size_t offset = 0;
+
+    while( offset < length )
+    {
+        struct nlmsghdr header;
+        const uint8_t* payload = bytes + offset + NLMSG_HDRLEN;
+        size_t payload_length;
+        int result = RESULT_SUCCESS;
+
+        if( length - offset < sizeof(header) )
+        {
+            return(RESULT_FAILURE);
+        }
+        memcpy(&header, bytes + offset, sizeof(header));
+        if( (header.nlmsg_len < NLMSG_HDRLEN) || (header.nlmsg_len > length - offset) )
+        {
+            return(RESULT_FAILURE);
+        }
+        payload_length = header.nlmsg_len - NLMSG_HDRLEN;
+
+        if( header.nlmsg_type == NLMSG_ERROR )
+        {
+            return(RESULT_FAILURE);
+        }
+        else if( header.nlmsg_type == RTM_NEWLINK )
+        {
+            result = parse_link(table, payload, payload_length);
+        }
+        else if( header.nlmsg_type == RTM_NEWADDR )
+        {
+            result = parse_address(table, payload, payload_length);
+        }
+        if( result != RESULT_SUCCESS )
+        {
+            return(result);
+        }
+
+        if( NLMSG_ALIGN(header.nlmsg_len) >= length - offset )
+        {
+            break;
+        }
+        offset += NLMSG_ALIGN(header.nlmsg_len);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Index the subnets of the entries, after all of them are added */
+int ifaddr_table_index(struct ifaddr_table* table)
+{
+    struct address_interval* intervals = malloc((table->count > 0 ? table->count : 1) * sizeof(*intervals));
+    size_t i;
+
+    if( intervals == NULL )
+    {
+        return(RESULT_INT_ERROR);
+    }
+    for( i = 0; i < table->count; i++ )
+    {
+        interval_from_bin(&table->entries[i].address, &intervals[i]);
+        intervals[i].line = (uint32_t)i;
+    }
+
+    interval_tree_free(&table->subnets);
+    if( interval_tree_build(&table->subnets, intervals, table->count) != RESULT_SUCCESS )
+    {
+        free(intervals);
+        table->subnets.intervals = NULL;
+        return(RESULT_INT_ERROR);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+static int append_bytes(uint8_t** buffer, size_t* length, size_t* size, const uint8_t* bytes, size_t count)
+{
+    if( *length + count > *size )
+    {
+        size_t new_size = (*length + count) * 2;
+        uint8_t* new_buffer = realloc(*buffer, new_size);
+
+        if( new_buffer == NULL )
+        {
+            return(RESULT_INT_ERROR);
+        }
+        *buffer = new_buffer;
+        *size = new_size;
+    }
+    memcpy(*buffer + *length, bytes, count);
+    *length += count;
+
+    return(RESULT_SUCCESS);
+}
+
+/* Send a dump request and append the replies to the dump, up to
+   and including NLMSG_DONE. Errors are reported to stderr. */
+static int request_dump(int fd, uint16_t type, uint32_t seq, uint8_t* receive_buffer,
+                        uint8_t** dump, size_t* dump_length, size_t* dump_size)
+{
+    struct {
+        struct nlmsghdr header;
+        struct ifinfomsg body;  /* Zero, so it is also an ifaddrmsg for any family */
+    } request;
+    struct sockaddr_nl kernel;
+    int done = 0;
+
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH((type == RTM_GETLINK) ? sizeof(struct ifinfomsg) : sizeof(struct ifaddrmsg));
+    request.header.nlmsg_type = type;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = seq;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    if( sendto(fd, &request, request.header.nlmsg_len, 0, (struct sockaddr*)&kernel, sizeof(kernel)) < 0 )
+    {
+        fprintf(stderr, "Error: could not request interface addresses: %s\n", strerror(errno));
+        return(RESULT_INT_ERROR);
+    }
+
+    while( !done )
+    {
+        ssize_t received = recv(fd, receive_buffer, IFADDR_RECV_SIZE, 0);
+        size_t offset = 0;
+
+        if( received < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            fprintf(stderr, "Error: could not read interface addresses: %s\n", strerror(errno));
+            return(RESULT_INT_ERROR);
+        }
+
+        /* Only look for the end and errors here, the parser checks the rest */
+        while( (size_t)received - offset >= sizeof(struct nlmsghdr) )
+        {
+            struct nlmsghdr header;
+
+            memcpy(&header, receive_buffer + offset, sizeof(header));
+            if( (header.nlmsg_len < NLMSG_HDRLEN) || (header.nlmsg_len > (size_t)received - offset) )
+            {
+                break;
+            }
+            if( header.nlmsg_type == NLMSG_DONE )
+            {
+                done = 1;
+            }
+            else if( header.nlmsg_type == NLMSG_ERROR )
+            {
+                struct nlmsgerr error;
+
+                memcpy(&error, receive_buffer + offset + NLMSG_HDRLEN,
+                       (header.nlmsg_len - NLMSG_HDRLEN < sizeof(error)) ? header.nlmsg_len - NLMSG_HDRLEN : sizeof(error));
+                fprintf(stderr, "Error: could not dump interface addresses: %s\n", strerror(-error.error));
+                return(RESULT_INT_ERROR);
+            }
+            offset += NLMSG_ALIGN(header.nlmsg_len);
+        }
+
+        /* Datagrams are padded, so that messages stay aligned in the dump */
+        if( (append_bytes(dump, dump_length, dump_size, receive_buffer, (size_t)received) != RESULT_SUCCESS) ||
+            (append_bytes(dump, dump_length, dump_size, (const uint8_t*)"\0\0\0",
+                          NLMSG_ALIGN((size_t)received) - (size_t)received) != RESULT_SUCCESS) )
+        {
+            fprintf(stderr, "Error: could not allocate memory!\n");
+            return(RESULT_INT_ERROR);
+        }
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Dump the links and addresses of the kernel over rtnetlink into the table
+   and index it. With dump_name, the dump is also saved to that file. */
+int ifaddr_table_load_kernel(struct ifaddr_table* table, const char* dump_name)
+{
+    uint8_t* receive_buffer;
+    uint8_t* dump = NULL;
+    size_t dump_length = 0;
+    size_t dump_size = 0;
+    int result;
+    int fd;
+
+    fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if( fd < 0 )
+    {
+        fprintf(stderr, "Error: could not open a netlink socket: %s\n", strerror(errno));
+        return(RESULT_INT_ERROR);
+    }
+    receive_buffer = malloc(IFADDR_RECV_SIZE);
+    if( receive_buffer == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        close(fd);
+        return(RESULT_INT_ERROR);
+    }
+
+    result = request_dump(fd, RTM_GETLINK, 1, receive_buffer, &dump, &dump_length, &dump_size);
+    if( result == RESULT_SUCCESS )
+    {
+        result = request_dump(fd, RTM_GETADDR, 2, receive_buffer, &dump, &dump_length, &dump_size);
+    }
+    close(fd);
+    free(receive_buffer);
+
+    if( result == RESULT_SUCCESS )
+    {
+        result = ifaddr_table_parse(table, dump, dump_length);
+        if( result == RESULT_FAILURE )
+        {
+            fprintf(stderr, "Error: malformed interface addresses from the kernel\n");
+            result = RESULT_INT_ERROR;
+        }
+    }
+    if( result == RESULT_SUCCESS )
+    {
+        result = ifaddr_table_index(table);
+    }
+
+    if( (result == RESULT_SUCCESS) && (dump_name != NULL) )
+    {
+        FILE* output = fopen(dump_name, "wb");
+
+        if( (output == NULL) || (fwrite(dump, 1, dump_length, output) != dump_length) ||
+            (fclose(output) != 0) )
+        {
+            fprintf(stderr, "Error: could not write %s: %s\n", dump_name, strerror(errno));
+            remove(dump_name);
+            result = RESULT_INT_ERROR;
+        }
+    }
+    free(dump);
+
+    return(result);
+}
+
+/* Read a dump saved by ifaddr_table_load_kernel() into the table and index it */
+int ifaddr_table_load_file(struct ifaddr_table* table, const char* dump_name)
+{
+    uint8_t* dump = NULL;
+    size_t dump_length = 0;
+    size_t dump_size = 0;
+    uint8_t buffer[4096];
+    size_t bytes_read;
+    int result = RESULT_SUCCESS;
+    FILE* input;
+
+    input = fopen(dump_name, "rb");
+    if( input == NULL )
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n", dump_name, strerror(errno));
+        return(RESULT_INT_ERROR);
+    }
+    while( (result == RESULT_SUCCESS) && ((bytes_read = fread(buffer, 1, sizeof(buffer), input)) > 0) )
+    {
+        result = append_bytes(&dump, &dump_length, &dump_size, buffer, bytes_read);
+    }
+    if( ferror(input) )
+    {
+        fprintf(stderr, "Error: could not read %s\n", dump_name);
+        result = RESULT_INT_ERROR;
+    }
+    fclose(input);
+
+    if( result == RESULT_SUCCESS )
+    {
+        result = ifaddr_table_parse(table, dump, dump_length);
+        if( result == RESULT_FAILURE )
+        {
+            fprintf(stderr, "Error: %s is not a valid netlink dump\n", dump_name);
+            result = RESULT_INT_ERROR;
+        }
+    }
+    if( result == RESULT_SUCCESS )
+    {
+        result = ifaddr_table_index(table);
+    }
+    free(dump);
+
+    return(result);
+}
+
+/* The name of an interface, or NULL if the dump has no link with that index */
+const char* ifaddr_table_link_name(const struct ifaddr_table* table, uint32_t ifindex)
+{
+    size_t i;
+
+    for( i = 0; i < table->link_count; i++ )
+    {
+        if( table->links[i].ifindex == ifindex )
+        {
+            return(table->links[i].name);
+        }
+    }
+
+    return(NULL);
+}
+
+struct conflict_state {
+    const struct ifaddr_table* table;
+    const struct ipaddr_bin* address;
+    const char* interface;
+    FILE* output;
+    size_t conflicts;
+};
+
+static void report_conflict(void* data, const struct address_interval* found)
+{
+    struct conflict_state* state = data;
+    const struct ifaddr_entry* entry = &state->table->entries[found->line];
+    const char* name = ifaddr_table_link_name(state->table, entry->ifindex);
+    const char* kind;
+    char address_str[IPADDR_STR_MAX];
+    char entry_str[IPADDR_STR_MAX];
+    char index_str[24];
+
+    if( memcmp(entry->address.addr, state->address->addr, 16) == 0 )
+    {
+        kind = "duplicate";
+    }
+    else if( (entry->scope == RT_SCOPE_LINK) ||
+             ((state->interface != NULL) && (name != NULL) && (strcmp(name, state->interface) == 0)) )
+    {
+        /* Link-local subnets are on every link, and subnets
+           of the interface the address is for are expected */
+        return;
+    }
+    else
+    {
+        kind = "overlap";
+    }
+
+    if( name == NULL )
+    {
+        sprintf(index_str, "if%lu", (unsigned long)entry->ifindex);
+        name = index_str;
+    }
+    ipaddr_bin_to_str(state->address, address_str);
+    ipaddr_bin_to_str(&entry->address, entry_str);
+    fprintf(state->output, "%s %s %s %s\n", kind, address_str, name, entry_str);
+    state->conflicts++;
+}
+
+/* Print the configured addresses that an address conflicts with:
+ * the same address on any interface as "duplicate", and subnets that
+ * overlap with the subnet of the address, other than link-local ones and
+ * those of the given interface, as "overlap". Returns their number.
+ */
+size_t ifaddr_conflicts(const struct ifaddr_table* table, const struct ipaddr_bin* address,
+                        const char* interface, FILE* output)
+{
+    struct conflict_state state;
+    struct address_interval query;
+
+    state.table = table;
+    state.address = address;
+    state.interface = interface;
+    state.output = output;
+    state.conflicts = 0;
+
+    interval_from_bin(address, &query);
+    interval_tree_query(&table->subnets, &query, report_conflict, &state);
+
+    return(state.conflicts);
+}
+
+/* Check address_str or, if it is NULL, every line of input for conflicts
+ * with the configured addresses and print them.
+ *
+ * Returns RESULT_SUCCESS if there were none, RESULT_FAILURE if there were
+ * any or an address was malformed.
+ */
+int check_ifaddr_conflicts(const struct ifaddr_table* table, FILE* input, const char* address_str,
+                           const char* interface, FILE* output, int verbose)
+{
+    int result = RESULT_SUCCESS;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+    struct ipaddr_bin address;
+
+    if( address_str != NULL )
+    {
+        if( str_to_ipaddr_bin_r(ipaddrcheck_default_ctx(), address_str, &address) != RESULT_SUCCESS )
+        {
+            if( verbose )
+            {
+                fprintf(stderr, "Malformed address %s\n", address_str);
+            }
+            return(RESULT_FAILURE);
+        }
+        result = (ifaddr_conflicts(table, &address, interface, output) == 0) ? RESULT_SUCCESS : RESULT_FAILURE;
+        fflush(output);
+        return(result);
+    }
+
+    while( (line_length = getline(&line, &line_size, input)) != -1 )
+    {
+        while( (line_length > 0) && ((line[line_length - 1] == '\n') || (line[line_length - 1] == '\r')) )
+        {
+            line[--line_length] = '\0';
+        }
+
+        if( str_to_ipaddr_bin_r(ipaddrcheck_default_ctx(), line, &address) != RESULT_SUCCESS )
+        {
+            if( verbose )
+            {
+                fprintf(stderr, "Malformed address %s\n", line);
+            }
+            result = RESULT_FAILURE;
+        }
+        else if( ifaddr_conflicts(table, &address, interface, output) > 0 )
+        {
+            result = RESULT_FAILURE;
+        }
+    }
+
+    free(line);
+    fflush(output);
+
+    return(result);
+}
@@ -0,0 +1,77 @@
+/*
+ * ipaddrcheck_ifaddr.h: conflicts with addresses configured on the host
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_IFADDR_H
+#define IPADDRCHECK_IFADDR_H
+
+#include "ipaddrcheck_functions.h"
+#include "ipaddrcheck_interval.h"
+
+/* Same as IFNAMSIZ */
+#define IFADDR_NAME_MAX     16
+
+/* Size of the buffer for one netlink datagram */
+#define IFADDR_RECV_SIZE    65536
+
+/* An address configured on an interface, with the prefix length of its subnet */
+struct ifaddr_entry {
+    struct ipaddr_bin address;
+    uint32_t ifindex;
+    uint8_t scope;      /* RT_SCOPE_UNIVERSE, RT_SCOPE_LINK etc. */
+};
+
+struct ifaddr_link {
+    uint32_t ifindex;
+    char name[IFADDR_NAME_MAX];
+};
+
+/*
+ * Interface addresses from an rtnetlink dump of links and addresses,
+ * taken from the kernel once or from a file it was saved to.
+ * The file holds the netlink messages as the kernel sent them,
+ * in host byte order.
+ *
+ * The subnets of the addresses are indexed in an interval tree,
+ * with the number of their entry as the line of the interval.
+ */
+struct ifaddr_table {
+    struct ifaddr_entry* entries;
+    size_t count;
+    size_t size;
+    struct ifaddr_link* links;
+    size_t link_count;
+    size_t link_size;
+    struct interval_tree subnets;
+};
+
+void ifaddr_table_init(struct ifaddr_table* table);
+void ifaddr_table_free(struct ifaddr_table* table);
+int ifaddr_table_parse(struct ifaddr_table* table, const void* messages, size_t length);
+int ifaddr_table_index(struct ifaddr_table* table);
+int ifaddr_table_load_kernel(struct ifaddr_table* table, const char* dump_name);
+int ifaddr_table_load_file(struct ifaddr_table* table, const char* dump_name);
+const char* ifaddr_table_link_name(const struct ifaddr_table* table, uint32_t ifindex);
+size_t ifaddr_conflicts(const struct ifaddr_table* table, const struct ipaddr_bin* address,
+                        const char* interface, FILE* output);
+int check_ifaddr_conflicts(const struct ifaddr_table* table, FILE* input, const char* address_str,
+                           const char* interface, FILE* output, int verbose);
+
+#endif /* IPADDRCHECK_IFADDR_H */
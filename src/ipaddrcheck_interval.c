@@ -0,0 +1,494 @@
+/*
+ * ipaddrcheck_interval.c: interval tree of address ranges and subnets
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+
+#include "ipaddrcheck_interval.h"
+
+static int key_less(const struct interval_key* a, const struct interval_key* b)
+{
+    return( (a->high < b->high) || ((a->high == b->high) && (a->low < b->low)) );
+}
+
+void interval_key_from_bin(const struct ipaddr_bin* address, struct interval_key* key)
+{
+    int i;
+
+    key->high = 0;
+    key->low = 0;
+    for( i = 0; i < 8; i++ )
+    {
+        key->high = (key->high << 8) | address->addr[i];
+        key->low = (key->low << 8) | address->addr[i + 8];
+    }
+}
+
+void interval_key_to_bin(const struct interval_key* key, int proto, int pflen, struct ipaddr_bin* address)
+{
+    int i;
+
+    address->proto = (uint8_t)proto;
+    address->pflen = (uint8_t)pflen;
+    for( i = 0; i < 8; i++ )
+    {
+        address->addr[i] = (uint8_t)(key->high >> (56 - 8 * i));
+        address->addr[i + 8] = (uint8_t)(key->low >> (56 - 8 * i));
+    }
+}
+
+/* Write "FIRST-LAST" for ranges and "NETWORK/LENGTH" for subnets into buf,
+   which must be at least INTERVAL_STR_MAX bytes long. Returns the length. */
+int interval_to_str(const struct address_interval* interval, char* buf)
+{
+    int full_length = (interval->proto == CIDR_IPV4) ? 32 : 128;
+    struct ipaddr_bin address;
+    int length;
+
+    if( interval->is_subnet )
+    {
+        interval_key_to_bin(&interval->first, interval->proto, interval->pflen, &address);
+        length = ipaddr_bin_to_str(&address, buf);
+        if( interval->pflen == full_length )
+        {
+            length += sprintf(buf + length, "/%d", full_length);
+        }
+        return(length);
+    }
+
+    interval_key_to_bin(&interval->first, interval->proto, full_length, &address);
+    length = ipaddr_bin_to_str(&address, buf);
+    buf[length++] = '-';
+    interval_key_to_bin(&interval->last, interval->proto, full_length, &address);
+    length += ipaddr_bin_to_str(&address, buf + length);
+
+    return(length);
+}
+
+/* Parse "FIRST-LAST", a subnet in the usual notation or a single address,
+ * which makes a range of one. Range boundaries follow the rules of
+ * --is-ipv4-range and --is-ipv6-range. Host bits of subnets are ignored.
+ */
+int interval_from_str(const char* str, struct address_interval* interval)
+{
+    const struct ipaddrcheck_ctx* ctx = ipaddrcheck_default_ctx();
+    struct ipaddr_bin first;
+    struct ipaddr_bin last;
+    const char* dash = strchr(str, '-');
+
+    memset(interval, 0, sizeof(*interval));
+
+    if( dash != NULL )
+    {
+        int result;
+
+        if( (strchr(dash + 1, '-') != NULL) || (strchr(str, '/') != NULL) )
+        {
+            return(RESULT_FAILURE);
+        }
+
+        result = str_to_ipaddr_bin_n(ctx, str, dash - str, &first);
+        if( result == RESULT_SUCCESS )
+        {
+            result = str_to_ipaddr_bin_r(ctx, dash + 1, &last);
+        }
+
+        if( (result != RESULT_SUCCESS) || (first.proto != last.proto) )
+        {
+            return(RESULT_FAILURE);
+        }
+
+        interval->proto = first.proto;
+        interval->pflen = first.pflen;
+        interval_key_from_bin(&first, &interval->first);
+        interval_key_from_bin(&last, &interval->last);
+
+        return( key_less(&interval->last, &interval->first) ? RESULT_FAILURE : RESULT_SUCCESS );
+    }
+
+    if( str_to_ipaddr_bin_r(ctx, str, &first) != RESULT_SUCCESS )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    interval_from_bin(&first, interval);
+    interval->is_subnet = (strchr(str, '/') != NULL);
+
+    return(RESULT_SUCCESS);
+}
+
+/* The subnet an address with prefix length belongs to */
+void interval_from_bin(const struct ipaddr_bin* address, struct address_interval* interval)
+{
+    int host_bits = ((address->proto == CIDR_IPV4) ? 32 : 128) - address->pflen;
+
+    memset(interval, 0, sizeof(*interval));
+    interval->proto = address->proto;
+    interval->pflen = address->pflen;
+    interval->is_subnet = 1;
+    interval_key_from_bin(address, &interval->first);
+
+    /* Set the host bits of the last address, clear those of the first one */
+    interval->last = interval->first;
+    if( host_bits >= 64 )
+    {
+        uint64_t high_mask = (host_bits == 128) ? UINT64_MAX : ((UINT64_C(1) << (host_bits - 64)) - 1);
+
+        interval->first.high &= ~high_mask;
+        interval->first.low = 0;
+        interval->last.high |= high_mask;
+        interval->last.low = UINT64_MAX;
+    }
+    else if( host_bits > 0 )
+    {
+        uint64_t low_mask = (UINT64_C(1) << host_bits) - 1;
+
+        interval->first.low &= ~low_mask;
+        interval->last.low |= low_mask;
+    }
+}
+
+/* Order by family, then first address, then last address */
+static int compare_intervals(const void* a, const void* b)
+{
+    const struct address_interval* left = a;
+    const struct address_interval* right = b;
+
+    if( left->proto != right->proto )
+    {
+        return( (left->proto < right->proto) ? -1 : 1 );
+    }
+    if( key_less(&left->first, &right->first) )
+    {
+        return(-1);
+    }
+    if( key_less(&right->first, &left->first) )
+    {
+        return(1);
+    }
+    if( key_less(&left->last, &right->last) )
+    {
+        return(-1);
+    }
+    if( key_less(&right->last, &left->last) )
+    {
+        return(1);
+    }
+
+    return( (left->line < right->line) ? -1 : (left->line > right->line) );
+}
+
+/* Fill in max_last for the subtree of the slice [begin, end) */
+static void build_subtree(struct interval_tree* tree, size_t begin, size_t end)
+{
+    size_t middle = begin + (end - begin) / 2;
+    struct interval_key* max_last = &tree->max_last[middle];
+
+    if( begin >= end )
+    {
+        return;
+    }
+
+    build_subtree(tree, begin, middle);
+    build_subtree(tree, middle + 1, end);
+
+    *max_last = tree->intervals[middle].last;
+    if( (begin < middle) && key_less(max_last, &tree->max_last[begin + (middle - begin) / 2]) )
+    {
+        *max_last = tree->max_last[begin + (middle - begin) / 2];
+    }
+    if( (middle + 1 < end) && key_less(max_last, &tree->max_last[middle + 1 + (end - middle - 1) / 2]) )
+    {
+        *max_last = tree->max_last[middle + 1 + (end - middle - 1) / 2];
+    }
+}
+
+/* Build a tree from count intervals, which are sorted in place
+   and owned by the tree afterwards */
+int interval_tree_build(struct interval_tree* tree, struct address_interval* intervals, size_t count)
+{
+    size_t i;
+
+    tree->intervals = intervals;
+    tree->count = count;
+    tree->max_last = malloc((count > 0 ? count : 1) * sizeof(*tree->max_last));
+    if( tree->max_last == NULL )
+    {
+        return(RESULT_INT_ERROR);
+    }
+
+    if( count > 0 )
+    {
+        qsort(intervals, count, sizeof(*intervals), compare_intervals);
+    }
+
+    i = 0;
+    while( (i < count) && (intervals[i].proto == CIDR_IPV4) )
+    {
+        i++;
+    }
+    tree->ipv4_count = i;
+
+    build_subtree(tree, 0, tree->ipv4_count);
+    build_subtree(tree, tree->ipv4_count, count);
+
+    return(RESULT_SUCCESS);
+}
+
+void interval_tree_free(struct interval_tree* tree)
+{
+    free(tree->intervals);
+    free(tree->max_last);
+    tree->intervals = NULL;
+    tree->max_last = NULL;
+    tree->count = 0;
+}
+
+static size_t query_subtree(const struct interval_tree* tree, size_t begin, size_t end,
+                            const struct address_interval* query,
+                            interval_callback callback, void* callback_data)
+{
+    size_t found = 0;
+
+    while( begin < end )
+    {
+        size_t middle = begin + (end - begin) / 2;
+        const struct address_interval* interval = &tree->intervals[middle];
+
+        /* Everything in this subtree ends before the query starts */
+        if( key_less(&tree->max_last[middle], &query->first) )
+        {
+            break;
+        }
+
+        found += query_subtree(tree, begin, middle, query, callback, callback_data);
+
+        /* This interval and everything to the right start after the query ends */
+        if( key_less(&query->last, &interval->first) )
+        {
+            break;
+        }
+
+        if( !key_less(&interval->last, &query->first) )
+        {
+            callback(callback_data, interval);
+            found++;
+        }
+
+        begin = middle + 1;
+    }
+
+    return(found);
+}
+
+/* Call the callback for every interval of the same family that shares
+   at least one address with the query, in ascending order.
+   Returns their number. */
+size_t interval_tree_query(const struct interval_tree* tree, const struct address_interval* query,
+                           interval_callback callback, void* callback_data)
+{
+    if( query->proto == CIDR_IPV4 )
+    {
+        return(query_subtree(tree, 0, tree->ipv4_count, query, callback, callback_data));
+    }
+    else
+    {
+        return(query_subtree(tree, tree->ipv4_count, tree->count, query, callback, callback_data));
+    }
+}
+
+struct overlap_state {
+    FILE* output;
+    const struct address_interval* range;
+    size_t violations;
+};
+
+/* Report a subnet that a range is not entirely inside of */
+static void check_containment(void* data, const struct address_interval* subnet)
+{
+    struct overlap_state* state = data;
+    char range_str[INTERVAL_STR_MAX];
+    char subnet_str[INTERVAL_STR_MAX];
+
+    if( !key_less(&state->range->first, &subnet->first) && !key_less(&subnet->last, &state->range->last) )
+    {
+        return;
+    }
+
+    interval_to_str(state->range, range_str);
+    interval_to_str(subnet, subnet_str);
+    fprintf(state->output, "escape %lu %s %lu %s\n",
+            (unsigned long)state->range->line, range_str, (unsigned long)subnet->line, subnet_str);
+    state->violations++;
+}
+
+static int append_interval(struct address_interval** intervals, size_t* count, size_t* size,
+                           const struct address_interval* interval)
+{
+    if( *count == *size )
+    {
+        size_t new_size = *size ? *size * 2 : 1024;
+        struct address_interval* new_intervals = realloc(*intervals, new_size * sizeof(**intervals));
+
+        if( new_intervals == NULL )
+        {
+            return(RESULT_INT_ERROR);
+        }
+        *intervals = new_intervals;
+        *size = new_size;
+    }
+
+    (*intervals)[(*count)++] = *interval;
+
+    return(RESULT_SUCCESS);
+}
+
+/* Read ranges and subnets, one per line, and report ranges that
+ * overlap each other and ranges that are partly outside of a subnet:
+ *
+ *   overlap 3 10.0.0.1-10.0.0.50 7 10.0.0.40-10.0.0.60
+ *   escape 5 10.0.0.200-10.0.1.10 2 10.0.0.0/24
+ *   malformed 9 10.0.0.9-10.0.0.1
+ *
+ * Line numbers refer to the input, addresses are printed in canonical form.
+ * Subnets may nest. Empty lines and lines starting with "#" are skipped.
+ *
+ * Ranges are sorted by their first address, so the ranges that overlap one
+ * follow it directly and all pairs are found in O(n log n + pairs).
+ * Subnets that a range touches are found with an interval tree query.
+ *
+ * Returns RESULT_SUCCESS if nothing was reported.
+ */
+int check_overlaps(FILE* input, FILE* output, int verbose)
+{
+    int result = RESULT_SUCCESS;
+    struct address_interval* ranges = NULL;
+    struct address_interval* subnets = NULL;
+    size_t range_count = 0;
+    size_t range_size = 0;
+    size_t subnet_count = 0;
+    size_t subnet_size = 0;
+    struct interval_tree range_tree;
+    struct interval_tree subnet_tree;
+    struct overlap_state state;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+    uint32_t line_number = 0;
+    size_t i;
+
+    while( (line_length = getline(&line, &line_size, input)) != -1 )
+    {
+        struct address_interval interval;
+        char* str = line;
+        char* end = line + line_length;
+
+        line_number++;
+        while( isspace((unsigned char)*str) )
+        {
+            str++;
+        }
+        while( (end > str) && isspace((unsigned char)end[-1]) )
+        {
+            *--end = '\0';
+        }
+        if( (*str == '\0') || (*str == '#') )
+        {
+            continue;
+        }
+
+        if( interval_from_str(str, &interval) != RESULT_SUCCESS )
+        {
+            if( verbose )
+            {
+                fprintf(stderr, "Malformed range or subnet %s on line %lu\n", str, (unsigned long)line_number);
+            }
+            fprintf(output, "malformed %lu %s\n", (unsigned long)line_number, str);
+            result = RESULT_FAILURE;
+            continue;
+        }
+        interval.line = line_number;
+
+        if( ((interval.is_subnet ?
+              append_interval(&subnets, &subnet_count, &subnet_size, &interval) :
+              append_interval(&ranges, &range_count, &range_size, &interval))) != RESULT_SUCCESS )
+        {
+            fprintf(stderr, "Error: could not allocate memory!\n");
+            free(line);
+            free(ranges);
+            free(subnets);
+            return(RESULT_INT_ERROR);
+        }
+    }
+    free(line);
+
+    if( interval_tree_build(&range_tree, ranges, range_count) != RESULT_SUCCESS )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free(ranges);
+        free(subnets);
+        return(RESULT_INT_ERROR);
+    }
+    if( interval_tree_build(&subnet_tree, subnets, subnet_count) != RESULT_SUCCESS )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        interval_tree_free(&range_tree);
+        free(subnets);
+        return(RESULT_INT_ERROR);
+    }
+
+    state.output = output;
+    state.violations = 0;
+
+    for( i = 0; i < range_count; i++ )
+    {
+        const struct address_interval* range = &range_tree.intervals[i];
+        size_t j;
+
+        for( j = i + 1; (j < range_count) && (range_tree.intervals[j].proto == range->proto) &&
+                        !key_less(&range->last, &range_tree.intervals[j].first); j++ )
+        {
+            char range_str[INTERVAL_STR_MAX];
+            char other_str[INTERVAL_STR_MAX];
+
+            interval_to_str(range, range_str);
+            interval_to_str(&range_tree.intervals[j], other_str);
+            fprintf(output, "overlap %lu %s %lu %s\n", (unsigned long)range->line, range_str,
+                    (unsigned long)range_tree.intervals[j].line, other_str);
+            state.violations++;
+        }
+
+        state.range = range;
+        interval_tree_query(&subnet_tree, range, check_containment, &state);
+    }
+
+    if( state.violations > 0 )
+    {
+        result = RESULT_FAILURE;
+    }
+
+    interval_tree_free(&range_tree);
+    interval_tree_free(&subnet_tree);
+    fflush(output);
+
+    return(result);
+}
@@ -0,0 +1,72 @@
+/*
+ * ipaddrcheck_interval.h: interval tree of address ranges and subnets
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_INTERVAL_H
+#define IPADDRCHECK_INTERVAL_H
+
+#include "ipaddrcheck_functions.h"
+
+/* A 128 bit address as two host order halves, IPv4 addresses
+   only use the low 32 bits */
+struct interval_key {
+    uint64_t high;
+    uint64_t low;
+};
+
+/* Inclusive range of addresses of one family */
+struct address_interval {
+    struct interval_key first;
+    struct interval_key last;
+    uint32_t line;
+    uint8_t proto;      /* CIDR_IPV4 or CIDR_IPV6 */
+    uint8_t pflen;      /* Prefix length of subnets */
+    uint8_t is_subnet;
+};
+
+/* Static interval tree: the intervals sorted by family and first address
+ * form an implicit balanced search tree, the middle of every slice being
+ * the root of its subtree. Each node also stores the greatest last address
+ * in its subtree, so that subtrees that end before a query are skipped.
+ */
+struct interval_tree {
+    struct address_interval* intervals;
+    struct interval_key* max_last;
+    size_t count;
+    size_t ipv4_count;  /* IPv4 intervals come first */
+};
+
+/* Longest text form of an interval, "FIRST-LAST" plus the null byte */
+#define INTERVAL_STR_MAX (2 * IPADDR_STR_MAX)
+
+typedef void (*interval_callback)(void* data, const struct address_interval* found);
+
+void interval_key_from_bin(const struct ipaddr_bin* address, struct interval_key* key);
+void interval_key_to_bin(const struct interval_key* key, int proto, int pflen, struct ipaddr_bin* address);
+int interval_to_str(const struct address_interval* interval, char* buf);
+int interval_from_str(const char* str, struct address_interval* interval);
+void interval_from_bin(const struct ipaddr_bin* address, struct address_interval* interval);
+int interval_tree_build(struct interval_tree* tree, struct address_interval* intervals, size_t count);
+void interval_tree_free(struct interval_tree* tree);
+size_t interval_tree_query(const struct interval_tree* tree, const struct address_interval* query,
+                           interval_callback callback, void* callback_data);
+int check_overlaps(FILE* input, FILE* output, int verbose);
+
+#endif /* IPADDRCHECK_INTERVAL_H */
@@ -0,0 +1,386 @@
+/*
+ * ipaddrcheck_ipam.c: allocation of free subnets from an address pool
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+
+#include "ipaddrcheck_ipam.h"
+
+/* Bit of an address at given position, counting from the most significant one */
+static int key_bit(const struct interval_key* key, int full_length, int position)
+{
+    int bit = full_length - 1 - position;
+
+    if( bit >= 64 )
+    {
+        return((int)((key->high >> (bit - 64)) & 1));
+    }
+    else
+    {
+        return((int)((key->low >> bit) & 1));
+    }
+}
+
+static void key_set_bit(struct interval_key* key, int full_length, int position)
+{
+    int bit = full_length - 1 - position;
+
+    if( bit >= 64 )
+    {
+        key->high |= UINT64_C(1) << (bit - 64);
+    }
+    else
+    {
+        key->low |= UINT64_C(1) << bit;
+    }
+}
+
+/* Append a free node for a block of given prefix length,
+   returns its index or 0 if out of memory (the root is never a child) */
+static uint32_t ipam_new_node(struct ipam_pool* pool, int length)
+{
+    struct ipam_node* node;
+
+    if( pool->node_count == pool->node_size )
+    {
+        size_t new_size = pool->node_size * 2;
+        struct ipam_node* new_nodes;
+
+        if( new_size > UINT32_MAX )
+        {
+            return(0);
+        }
+        new_nodes = realloc(pool->nodes, new_size * sizeof(*new_nodes));
+        if( new_nodes == NULL )
+        {
+            return(0);
+        }
+        pool->nodes = new_nodes;
+        pool->node_size = new_size;
+    }
+
+    node = &pool->nodes[pool->node_count];
+    node->children[0] = 0;
+    node->children[1] = 0;
+    node->state = IPAM_FREE;
+    node->best = (uint8_t)length;
+
+    return((uint32_t)pool->node_count++);
+}
+
+/* Split a free block of given prefix length into two free halves */
+static int ipam_split(struct ipam_pool* pool, uint32_t index, int length)
+{
+    uint32_t left = ipam_new_node(pool, length + 1);
+    uint32_t right = ipam_new_node(pool, length + 1);
+
+    if( (left == 0) || (right == 0) )
+    {
+        return(RESULT_INT_ERROR);
+    }
+
+    pool->nodes[index].children[0] = left;
+    pool->nodes[index].children[1] = right;
+    pool->nodes[index].state = IPAM_SPLIT;
+
+    return(RESULT_SUCCESS);
+}
+
+/* Recompute the nodes on the path to a changed node, bottom up */
+static void ipam_update(struct ipam_pool* pool, const uint32_t* path, int depth)
+{
+    while( depth-- > 0 )
+    {
+        struct ipam_node* node = &pool->nodes[path[depth]];
+        const struct ipam_node* left = &pool->nodes[node->children[0]];
+        const struct ipam_node* right = &pool->nodes[node->children[1]];
+
+        if( (left->state == IPAM_USED) && (right->state == IPAM_USED) )
+        {
+            node->state = IPAM_USED;
+            node->best = IPAM_NO_FREE_BLOCK;
+        }
+        else
+        {
+            node->best = (left->best < right->best) ? left->best : right->best;
+        }
+    }
+}
+
+int ipam_init(struct ipam_pool* pool, const struct address_interval* prefix)
+{
+    pool->prefix = *prefix;
+    pool->full_length = (prefix->proto == CIDR_IPV4) ? 32 : 128;
+    pool->node_count = 0;
+    pool->node_size = 1024;
+    pool->nodes = malloc(pool->node_size * sizeof(*pool->nodes));
+    if( pool->nodes == NULL )
+    {
+        return(RESULT_INT_ERROR);
+    }
+
+    ipam_new_node(pool, prefix->pflen);
+
+    return(RESULT_SUCCESS);
+}
+
+void ipam_free(struct ipam_pool* pool)
+{
+    free(pool->nodes);
+    pool->nodes = NULL;
+    pool->node_count = 0;
+}
+
+/* Take a subnet out of the free space. Subnets of the other family
+   or outside of the pool are ignored, ones that contain it use it up. */
+int ipam_mark_used(struct ipam_pool* pool, const struct address_interval* used)
+{
+    uint32_t path[129];
+    int depth = 0;
+    uint32_t index = 0;
+    int position;
+
+    if( used->proto != pool->prefix.proto )
+    {
+        return(RESULT_SUCCESS);
+    }
+
+    /* Disjoint unless the shorter prefix contains the longer one */
+    for( position = 0; (position < used->pflen) && (position < pool->prefix.pflen); position++ )
+    {
+        if( key_bit(&used->first, pool->full_length, position) !=
+            key_bit(&pool->prefix.first, pool->full_length, position) )
+        {
+            return(RESULT_SUCCESS);
+        }
+    }
+
+    for( position = pool->prefix.pflen; position < used->pflen; position++ )
+    {
+        if( pool->nodes[index].state == IPAM_USED )
+        {
+            return(RESULT_SUCCESS);
+        }
+        if( (pool->nodes[index].state == IPAM_FREE) && (ipam_split(pool, index, position) != RESULT_SUCCESS) )
+        {
+            return(RESULT_INT_ERROR);
+        }
+
+        path[depth++] = index;
+        index = pool->nodes[index].children[key_bit(&used->first, pool->full_length, position)];
+    }
+
+    pool->nodes[index].state = IPAM_USED;
+    pool->nodes[index].best = IPAM_NO_FREE_BLOCK;
+    ipam_update(pool, path, depth);
+
+    return(RESULT_SUCCESS);
+}
+
+/* Allocate the free block of given prefix length with the lowest address.
+   Returns RESULT_FAILURE if there is none. */
+int ipam_allocate(struct ipam_pool* pool, int length, struct address_interval* block)
+{
+    uint32_t path[129];
+    int depth = 0;
+    uint32_t index = 0;
+    struct interval_key address = pool->prefix.first;
+    struct ipaddr_bin address_bin;
+    int position;
+
+    if( (length < pool->prefix.pflen) || (length > pool->full_length) || (pool->nodes[0].best > length) )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    for( position = pool->prefix.pflen; position < length; position++ )
+    {
+        struct ipam_node* node = &pool->nodes[index];
+        int side;
+
+        if( (node->state == IPAM_FREE) && (ipam_split(pool, index, position) != RESULT_SUCCESS) )
+        {
+            return(RESULT_INT_ERROR);
+        }
+
+        /* The split may have moved the nodes */
+        node = &pool->nodes[index];
+        side = (pool->nodes[node->children[0]].best <= length) ? 0 : 1;
+        if( side == 1 )
+        {
+            key_set_bit(&address, pool->full_length, position);
+        }
+
+        path[depth++] = index;
+        index = node->children[side];
+    }
+
+    pool->nodes[index].state = IPAM_USED;
+    pool->nodes[index].best = IPAM_NO_FREE_BLOCK;
+    ipam_update(pool, path, depth);
+
+    interval_key_to_bin(&address, pool->prefix.proto, length, &address_bin);
+    interval_from_bin(&address_bin, block);
+
+    return(RESULT_SUCCESS);
+}
+
+/* Read used subnets and addresses, one per line, into the pool.
+ * Lines that pass --is-any-net take their whole subnet, other lines
+ * must pass --is-any-host and take only their own address.
+ */
+static int ipam_load_used(struct ipam_pool* pool, FILE* used, const char* used_name)
+{
+    int result = RESULT_SUCCESS;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+    size_t line_number = 0;
+
+    while( (result == RESULT_SUCCESS) && ((line_length = getline(&line, &line_size, used)) != -1) )
+    {
+        struct address_interval interval;
+        struct ipaddr_bin address;
+        char* str = line;
+        char* end = line + line_length;
+        CIDR* cidr;
+
+        line_number++;
+        while( isspace((unsigned char)*str) )
+        {
+            str++;
+        }
+        while( (end > str) && isspace((unsigned char)end[-1]) )
+        {
+            *--end = '\0';
+        }
+        if( (*str == '\0') || (*str == '#') )
+        {
+            continue;
+        }
+
+        if( str_to_ipaddr_bin(str, &address) != RESULT_SUCCESS )
+        {
+            fprintf(stderr, "Error: %s line %zu: %s is not a valid network or host address\n",
+                    used_name, line_number, str);
+            result = RESULT_INT_ERROR;
+            break;
+        }
+
+        cidr = cidr_from_str(str);
+        if( is_any_net(cidr) != RESULT_SUCCESS )
+        {
+            if( is_any_host(cidr) != RESULT_SUCCESS )
+            {
+                fprintf(stderr, "Error: %s line %zu: %s is not a valid network or host address\n",
+                        used_name, line_number, str);
+                result = RESULT_INT_ERROR;
+            }
+            address.pflen = (address.proto == CIDR_IPV4) ? 32 : 128;
+        }
+        cidr_free(cidr);
+
+        if( result == RESULT_SUCCESS )
+        {
+            interval_from_bin(&address, &interval);
+            result = ipam_mark_used(pool, &interval);
+            if( result != RESULT_SUCCESS )
+            {
+                fprintf(stderr, "Error: could not allocate memory!\n");
+            }
+        }
+    }
+
+    free(line);
+
+    return(result);
+}
+
+/* Print the first count free subnets of given length in the pool,
+ * after taking out the used subnets and addresses.
+ * Returns RESULT_FAILURE if the pool has fewer free subnets.
+ */
+int allocate_subnets(char* pool_str, FILE* used, const char* used_name, int length, long count,
+                     FILE* output)
+{
+    struct address_interval prefix;
+    struct ipaddr_bin address;
+    struct ipam_pool pool;
+    int result;
+    long allocated;
+    CIDR* cidr;
+
+    if( str_to_ipaddr_bin(pool_str, &address) != RESULT_SUCCESS )
+    {
+        fprintf(stderr, "Error: %s is not a valid network address\n", pool_str);
+        return(RESULT_INT_ERROR);
+    }
+    cidr = cidr_from_str(pool_str);
+    result = is_any_net(cidr);
+    cidr_free(cidr);
+    if( result != RESULT_SUCCESS )
+    {
+        fprintf(stderr, "Error: %s is not a valid network address\n", pool_str);
+        return(RESULT_INT_ERROR);
+    }
+
+    interval_from_bin(&address, &prefix);
+    if( (length < prefix.pflen) || (length > ((prefix.proto == CIDR_IPV4) ? 32 : 128)) )
+    {
+        fprintf(stderr, "Error: subnet length must be between the pool prefix length and %d\n",
+                (prefix.proto == CIDR_IPV4) ? 32 : 128);
+        return(RESULT_INT_ERROR);
+    }
+
+    if( ipam_init(&pool, &prefix) != RESULT_SUCCESS )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    result = ipam_load_used(&pool, used, used_name);
+    for( allocated = 0; (result == RESULT_SUCCESS) && (allocated < count); allocated++ )
+    {
+        struct address_interval block;
+        char block_str[INTERVAL_STR_MAX];
+
+        result = ipam_allocate(&pool, length, &block);
+        if( result == RESULT_SUCCESS )
+        {
+            interval_to_str(&block, block_str);
+            fprintf(output, "%s\n", block_str);
+        }
+        else if( result == RESULT_FAILURE )
+        {
+            fprintf(stderr, "Error: %s has only %ld free /%d subnets\n", pool_str, allocated, length);
+        }
+        else
+        {
+            fprintf(stderr, "Error: could not allocate memory!\n");
+        }
+    }
+
+    ipam_free(&pool);
+    fflush(output);
+
+    return(result);
+}
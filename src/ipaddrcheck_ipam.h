@@ -0,0 +1,61 @@
+/*
+ * ipaddrcheck_ipam.h: allocation of free subnets from an address pool
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_IPAM_H
+#define IPADDRCHECK_IPAM_H
+
+#include "ipaddrcheck_functions.h"
+#include "ipaddrcheck_interval.h"
+
+#define IPAM_FREE   0
+#define IPAM_USED   1
+#define IPAM_SPLIT  2
+
+/* No free block in a subtree, longer than any prefix length */
+#define IPAM_NO_FREE_BLOCK 255
+
+/* Binary tree of the pool like in a buddy allocator: a node is a block
+ * that is entirely free, entirely used, or split into two halves.
+ * Every node knows the shortest prefix length of a free block under it,
+ * so an allocation goes straight down to the first block that fits.
+ */
+struct ipam_node {
+    uint32_t children[2];
+    uint8_t state;
+    uint8_t best;       /* Shortest free prefix length in the subtree */
+};
+
+struct ipam_pool {
+    struct address_interval prefix;
+    int full_length;
+    struct ipam_node* nodes;
+    size_t node_count;
+    size_t node_size;
+};
+
+int ipam_init(struct ipam_pool* pool, const struct address_interval* prefix);
+void ipam_free(struct ipam_pool* pool);
+int ipam_mark_used(struct ipam_pool* pool, const struct address_interval* used);
+int ipam_allocate(struct ipam_pool* pool, int length, struct address_interval* block);
+int allocate_subnets(char* pool_str, FILE* used, const char* used_name, int length, long count,
+                     FILE* output);
+
+#endif /* IPADDRCHECK_IPAM_H */
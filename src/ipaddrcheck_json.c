@@ -0,0 +1,352 @@
+/*
+ * ipaddrcheck_json.c: JSON Lines output of check results
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "ipaddrcheck_json.h"
+#include "ipaddrcheck_actions.h"
+
+#define JSON_WRITE_LITERAL(writer, str) json_write_raw(writer, str, sizeof(str) - 1)
+
+void json_writer_init(struct json_writer* writer, FILE* output)
+{
+    writer->output = output;
+    writer->length = 0;
+    writer->error = 0;
+}
+
+/* Write out the buffer, returns RESULT_FAILURE if this or any earlier write failed */
+int json_flush(struct json_writer* writer)
+{
+    if( (writer->length > 0) &&
+        (fwrite(writer->buffer, 1, writer->length, writer->output) != writer->length) )
+    {
+        writer->error = 1;
+    }
+    writer->length = 0;
+
+    if( fflush(writer->output) != 0 )
+    {
+        writer->error = 1;
+    }
+
+    return(writer->error ? RESULT_FAILURE : RESULT_SUCCESS);
+}
+
+void json_write_raw(struct json_writer* writer, const char* data, size_t length)
+{
+    if( writer->length + length > JSON_BUFFER_SIZE )
+    {
+        if( fwrite(writer->buffer, 1, writer->length, writer->output) != writer->length )
+        {
+            writer->error = 1;
+        }
+        writer->length = 0;
+
+        if( length > JSON_BUFFER_SIZE )
+        {
+            if( fwrite(data, 1, length, writer->output) != length )
+            {
+                writer->error = 1;
+            }
+            return;
+        }
+    }
+
+    memcpy(writer->buffer + writer->length, data, length);
+    writer->length += length;
+}
+
+/* Write a quoted string. Runs of characters that need no escaping
+   are copied in one go. Bytes outside of ASCII are passed through as is. */
+void json_write_string(struct json_writer* writer, const char* str)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+    const unsigned char* run = (const unsigned char*)str;
+    const unsigned char* c = run;
+
+    JSON_WRITE_LITERAL(writer, "\"");
+
+    while( 1 )
+    {
+        char escape[6];
+        size_t escape_length = 2;
+
+        while( (*c >= 0x20) && (*c != '"') && (*c != '\\') )
+        {
+            c++;
+        }
+        json_write_raw(writer, (const char*)run, c - run);
+        if( *c == '\0' )
+        {
+            break;
+        }
+
+        escape[0] = '\\';
+        switch( *c )
+        {
+            case '"':
+                escape[1] = '"';
+                break;
+            case '\\':
+                escape[1] = '\\';
+                break;
+            case '\n':
+                escape[1] = 'n';
+                break;
+            case '\r':
+                escape[1] = 'r';
+                break;
+            case '\t':
+                escape[1] = 't';
+                break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hex_digits[*c >> 4];
+                escape[5] = hex_digits[*c & 0x0F];
+                escape_length = 6;
+                break;
+        }
+        json_write_raw(writer, escape, escape_length);
+        run = ++c;
+    }
+
+    JSON_WRITE_LITERAL(writer, "\"");
+}
+
+void json_write_int(struct json_writer* writer, long value)
+{
+    char digits[24];
+    char* d = digits + sizeof(digits);
+    unsigned long magnitude = (value < 0) ? -(unsigned long)value : (unsigned long)value;
+
+    do
+    {
+        *--d = '0' + (magnitude % 10);
+        magnitude /= 10;
+    }
+    while( magnitude > 0 );
+
+    if( value < 0 )
+    {
+        *--d = '-';
+    }
+
+    json_write_raw(writer, d, digits + sizeof(digits) - d);
+}
+
+/* Write the result of all selected checks for one address as a JSON object:
+ *
+ *   {"input":"192.0.2.1/24","family":"ipv4","prefix_length":24,
+ *    "checks":{"is-ipv4-host":true},"valid":true,"reason":null}
+ *
+ * Unlike the normal mode, all checks are evaluated, and "reason" explains
+ * the first failure. Malformed addresses have null family and prefix length
+ * and fail every check. Returns RESULT_SUCCESS if the address passed all checks.
+ */
+static int json_write_record(struct json_writer* writer, char* address_str,
+                             const int* actions, int action_count, int allow_loopback,
+                             char* reason, char* check_reason, size_t reason_size)
+{
+    CIDR* address = cidr_from_str(address_str);
+    int format_result = check_address_format(address, address_str, reason, reason_size);
+    int valid = (format_result == RESULT_SUCCESS);
+    int first = 1;
+    int i;
+
+    JSON_WRITE_LITERAL(writer, "{\"input\":");
+    json_write_string(writer, address_str);
+
+    if( format_result == RESULT_SUCCESS )
+    {
+        if( cidr_get_proto(address) == CIDR_IPV4 )
+        {
+            JSON_WRITE_LITERAL(writer, ",\"family\":\"ipv4\",\"prefix_length\":");
+        }
+        else
+        {
+            JSON_WRITE_LITERAL(writer, ",\"family\":\"ipv6\",\"prefix_length\":");
+        }
+        json_write_int(writer, cidr_get_pflen(address));
+    }
+    else
+    {
+        JSON_WRITE_LITERAL(writer, ",\"family\":null,\"prefix_length\":null");
+    }
+
+    JSON_WRITE_LITERAL(writer, ",\"checks\":{");
+    for( i = 0; i <= action_count; i++ )
+    {
+        const char* name = action_name(actions[i]);
+        int result = RESULT_FAILURE;
+
+        if( name == NULL )
+        {
+            continue;
+        }
+
+        if( format_result == RESULT_SUCCESS )
+        {
+            result = check_address(actions[i], address, address_str, allow_loopback,
+                                   check_reason, reason_size);
+        }
+
+        if( (result != RESULT_SUCCESS) && valid )
+        {
+            valid = 0;
+            if( check_reason[0] != '\0' )
+            {
+                memcpy(reason, check_reason, strlen(check_reason) + 1);
+            }
+            else
+            {
+                snprintf(reason, reason_size, "%s did not pass --%s", address_str, name);
+            }
+        }
+
+        if( !first )
+        {
+            JSON_WRITE_LITERAL(writer, ",");
+        }
+        first = 0;
+        json_write_string(writer, name);
+        if( result == RESULT_SUCCESS )
+        {
+            JSON_WRITE_LITERAL(writer, ":true");
+        }
+        else
+        {
+            JSON_WRITE_LITERAL(writer, ":false");
+        }
+    }
+
+    if( valid )
+    {
+        JSON_WRITE_LITERAL(writer, "},\"valid\":true,\"reason\":null}\n");
+    }
+    else
+    {
+        JSON_WRITE_LITERAL(writer, "},\"valid\":false,\"reason\":");
+        json_write_string(writer, reason);
+        JSON_WRITE_LITERAL(writer, "}\n");
+    }
+
+    if( address != NULL )
+    {
+        cidr_free(address);
+    }
+
+    return(valid ? RESULT_SUCCESS : RESULT_FAILURE);
+}
+
+/* Write one JSON object per address, either for address_str alone
+ * or, if it is NULL, for every line of input.
+ *
+ * Returns RESULT_SUCCESS if all addresses passed all checks,
+ * RESULT_FAILURE if any did not, RESULT_INT_ERROR on I/O errors.
+ */
+int check_addresses_json(FILE* input, char* address_str, FILE* output,
+                         const int* actions, int action_count, int allow_loopback)
+{
+    int result = RESULT_SUCCESS;
+    struct json_writer* writer;
+    char* reason = NULL;
+    char* check_reason = NULL;
+    size_t reason_size = 0;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+
+    writer = malloc(sizeof(*writer));
+    if( writer == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+    json_writer_init(writer, output);
+
+    while( 1 )
+    {
+        char* record;
+
+        if( address_str == NULL )
+        {
+            line_length = getline(&line, &line_size, input);
+            if( line_length == -1 )
+            {
+                break;
+            }
+            while( (line_length > 0) &&
+                   ((line[line_length-1] == '\n') || (line[line_length-1] == '\r')) )
+            {
+                line[--line_length] = '\0';
+            }
+            record = line;
+        }
+        else
+        {
+            record = address_str;
+            line_length = strlen(address_str);
+        }
+
+        /* Diagnostics quote the address, so the buffers grow with the longest one */
+        if( CHECK_REASON_SIZE((size_t)line_length) > reason_size )
+        {
+            reason_size = CHECK_REASON_SIZE((size_t)line_length) * 2;
+            free(reason);
+            free(check_reason);
+            reason = malloc(reason_size);
+            check_reason = malloc(reason_size);
+            if( (reason == NULL) || (check_reason == NULL) )
+            {
+                fprintf(stderr, "Error: could not allocate memory!\n");
+                result = RESULT_INT_ERROR;
+                break;
+            }
+        }
+
+        if( json_write_record(writer, record, actions, action_count, allow_loopback,
+                              reason, check_reason, reason_size) != RESULT_SUCCESS )
+        {
+            result = RESULT_FAILURE;
+        }
+
+        if( address_str != NULL )
+        {
+            break;
+        }
+    }
+
+    if( (json_flush(writer) != RESULT_SUCCESS) && (result != RESULT_INT_ERROR) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        result = RESULT_INT_ERROR;
+    }
+
+    free(line);
+    free(reason);
+    free(check_reason);
+    free(writer);
+
+    return(result);
+}
@@ -0,0 +1,47 @@
+/*
+ * ipaddrcheck_json.h: JSON Lines output of check results
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_JSON_H
+#define IPADDRCHECK_JSON_H
+
+#include "ipaddrcheck_functions.h"
+
+#define JSON_BUFFER_SIZE 65536
+
+/* Output buffer that is written out only when full or flushed,
+   so that a record costs a few memcpy calls rather than a printf per field */
+struct json_writer {
+    FILE* output;
+    size_t length;
+    int error;
+    char buffer[JSON_BUFFER_SIZE];
+};
+
+void json_writer_init(struct json_writer* writer, FILE* output);
+int json_flush(struct json_writer* writer);
+void json_write_raw(struct json_writer* writer, const char* data, size_t length);
+void json_write_string(struct json_writer* writer, const char* str);
+void json_write_int(struct json_writer* writer, long value);
+
+int check_addresses_json(FILE* input, char* address_str, FILE* output,
+                         const int* actions, int action_count, int allow_loopback);
+
+#endif /* IPADDRCHECK_JSON_H */
@@ -0,0 +1,395 @@
+/*
+ * ipaddrcheck_lookup.c: mapping addresses to the longest matching prefix of a table
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <arpa/inet.h>
+
+#include "ipaddrcheck_lookup.h"
+
+/* Number of input addresses resolved with a single bulk lookup */
+#define LOOKUP_BATCH_SIZE 64
+
+/* Strip the line terminator, return the new length */
+static size_t chomp(char* line, size_t length)
+{
+    while( (length > 0) && ((line[length-1] == '\n') || (line[length-1] == '\r')) )
+    {
+        line[--length] = '\0';
+    }
+
+    return(length);
+}
+
+/* Store a prefix and its label, return its index or -1 if out of memory */
+static long lookup_table_append(struct lookup_table* table, const char* prefix_str, const char* label)
+{
+    if( table->count == table->size )
+    {
+        size_t new_size = table->size ? table->size * 2 : 1024;
+        char** new_prefixes = realloc(table->prefixes, new_size * sizeof(char*));
+        char** new_labels;
+
+        if( new_prefixes == NULL )
+        {
+            return(-1);
+        }
+        table->prefixes = new_prefixes;
+
+        new_labels = realloc(table->labels, new_size * sizeof(char*));
+        if( new_labels == NULL )
+        {
+            return(-1);
+        }
+        table->labels = new_labels;
+        table->size = new_size;
+    }
+
+    table->prefixes[table->count] = strdup(prefix_str);
+    if( table->prefixes[table->count] == NULL )
+    {
+        return(-1);
+    }
+    table->labels[table->count] = NULL;
+    if( label != NULL )
+    {
+        table->labels[table->count] = strdup(label);
+        if( table->labels[table->count] == NULL )
+        {
+            free(table->prefixes[table->count]);
+            return(-1);
+        }
+    }
+
+    return(table->count++);
+}
+
+/* Load a prefix table.
+ *
+ * Every line holds a network address with prefix length, optionally followed
+ * by whitespace and a label. Empty lines and lines starting with "#" are ignored.
+ * Prefixes must pass the same checks as --is-ipv4-net or --is-ipv6-net.
+ * IPv6 prefixes are collected first and compiled into a tree bitmap at the end.
+ *
+ * Errors are reported to stderr with the offending line number.
+ */
+int lookup_table_load(struct lookup_table* table, FILE* table_file, const char* table_name)
+{
+    int result = RESULT_SUCCESS;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+    size_t line_number = 0;
+
+    struct ipaddr_bin* ipv6_prefixes = NULL;
+    uint32_t* ipv6_values = NULL;
+    size_t ipv6_count = 0;
+    size_t ipv6_size = 0;
+
+    memset(table, 0, sizeof(*table));
+    table->lpm4 = lpm4_create();
+    if( table->lpm4 == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    while( (line_length = getline(&line, &line_size, table_file)) != -1 )
+    {
+        char* prefix_str = line;
+        char* label = NULL;
+        char* end;
+        CIDR* prefix;
+        long index;
+
+        line_number++;
+        line_length = chomp(line, line_length);
+
+        while( isspace((unsigned char)*prefix_str) )
+        {
+            prefix_str++;
+        }
+        if( (*prefix_str == '\0') || (*prefix_str == '#') )
+        {
+            continue;
+        }
+
+        /* Split off the label, if any */
+        end = prefix_str;
+        while( (*end != '\0') && !isspace((unsigned char)*end) )
+        {
+            end++;
+        }
+        if( *end != '\0' )
+        {
+            *end = '\0';
+            label = end + 1;
+            while( isspace((unsigned char)*label) )
+            {
+                label++;
+            }
+            end = label + strlen(label);
+            while( (end > label) && isspace((unsigned char)end[-1]) )
+            {
+                *--end = '\0';
+            }
+            if( *label == '\0' )
+            {
+                label = NULL;
+            }
+        }
+
+        prefix = cidr_from_str(prefix_str);
+        if( !( ((is_ipv4_cidr(prefix_str) == RESULT_SUCCESS) && (is_ipv4_net(prefix) == RESULT_SUCCESS)) ||
+               ((is_ipv6_cidr(prefix_str) == RESULT_SUCCESS) && (is_ipv6_net(prefix) == RESULT_SUCCESS) &&
+                (duplicate_double_colons(prefix_str) == RESULT_FAILURE)) ) )
+        {
+            fprintf(stderr, "Error: %s line %zu: %s is not a valid IPv4 or IPv6 network address\n",
+                    table_name, line_number, prefix_str);
+            if( prefix != NULL )
+            {
+                cidr_free(prefix);
+            }
+            result = RESULT_INT_ERROR;
+            break;
+        }
+
+        index = lookup_table_append(table, prefix_str, label);
+        if( (index < 0) || (index > LPM4_MAX_VALUE) )
+        {
+            fprintf(stderr, "Error: could not allocate memory!\n");
+            cidr_free(prefix);
+            result = RESULT_INT_ERROR;
+            break;
+        }
+
+        if( cidr_get_proto(prefix) == CIDR_IPV4 )
+        {
+            struct in_addr in_addr;
+            cidr_to_inaddr(prefix, &in_addr);
+            if( lpm4_add(table->lpm4, ntohl(in_addr.s_addr), cidr_get_pflen(prefix), (uint32_t)index) != RESULT_SUCCESS )
+            {
+                fprintf(stderr, "Error: could not allocate memory!\n");
+                cidr_free(prefix);
+                result = RESULT_INT_ERROR;
+                break;
+            }
+        }
+        else
+        {
+            struct in6_addr in6_addr;
+
+            if( ipv6_count == ipv6_size )
+            {
+                size_t new_size = ipv6_size ? ipv6_size * 2 : 1024;
+                struct ipaddr_bin* new_prefixes = realloc(ipv6_prefixes, new_size * sizeof(*ipv6_prefixes));
+                uint32_t* new_values;
+
+                if( new_prefixes != NULL )
+                {
+                    ipv6_prefixes = new_prefixes;
+                }
+                new_values = realloc(ipv6_values, new_size * sizeof(*ipv6_values));
+                if( new_values != NULL )
+                {
+                    ipv6_values = new_values;
+                }
+                if( (new_prefixes == NULL) || (new_values == NULL) )
+                {
+                    fprintf(stderr, "Error: could not allocate memory!\n");
+                    cidr_free(prefix);
+                    result = RESULT_INT_ERROR;
+                    break;
+                }
+                ipv6_size = new_size;
+            }
+
+            cidr_to_in6addr(prefix, &in6_addr);
+            ipv6_prefixes[ipv6_count].proto = CIDR_IPV6;
+            memcpy(ipv6_prefixes[ipv6_count].addr, in6_addr.s6_addr, 16);
+            ipv6_prefixes[ipv6_count].pflen = (uint8_t)cidr_get_pflen(prefix);
+            ipv6_values[ipv6_count] = (uint32_t)index;
+            ipv6_count++;
+        }
+
+        cidr_free(prefix);
+    }
+
+    if( result == RESULT_SUCCESS )
+    {
+        table->lpm6 = lpm6_build(ipv6_prefixes, ipv6_values, ipv6_count);
+        if( table->lpm6 == NULL )
+        {
+            fprintf(stderr, "Error: could not allocate memory!\n");
+            result = RESULT_INT_ERROR;
+        }
+    }
+
+    free(ipv6_prefixes);
+    free(ipv6_values);
+    free(line);
+
+    if( result != RESULT_SUCCESS )
+    {
+        lookup_table_free(table);
+    }
+
+    return(result);
+}
+
+void lookup_table_free(struct lookup_table* table)
+{
+    size_t i;
+
+    for( i = 0; i < table->count; i++ )
+    {
+        free(table->prefixes[i]);
+        free(table->labels[i]);
+    }
+    free(table->prefixes);
+    free(table->labels);
+    lpm4_free(table->lpm4);
+    lpm6_free(table->lpm6);
+    memset(table, 0, sizeof(*table));
+}
+
+/* Text to print for a lookup result: the label if the prefix has one,
+   or the prefix itself */
+const char* lookup_table_result(const struct lookup_table* table, uint32_t value)
+{
+    if( value == LPM4_NO_MATCH )
+    {
+        return(LOOKUP_NO_MATCH_STR);
+    }
+    else if( table->labels[value] != NULL )
+    {
+        return(table->labels[value]);
+    }
+    else
+    {
+        return(table->prefixes[value]);
+    }
+}
+
+/* Print the longest matching prefix (or its label) for every input line.
+ *
+ * Output lines correspond to input lines one to one, so that they can be
+ * pasted together. Addresses with no match and malformed addresses produce
+ * LOOKUP_NO_MATCH_STR, and the latter also make the function return RESULT_FAILURE.
+ * If an address comes with a prefix length, the address part is looked up.
+ * Returns RESULT_INT_ERROR if the output could not be written.
+ */
+int lookup_addresses(const struct lookup_table* table, FILE* input, FILE* output, int verbose)
+{
+    int result = RESULT_SUCCESS;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+
+    uint32_t ipv4_addresses[LOOKUP_BATCH_SIZE];
+    uint8_t ipv6_addresses[LOOKUP_BATCH_SIZE][16];
+    uint32_t ipv4_values[LOOKUP_BATCH_SIZE];
+    uint32_t ipv6_values[LOOKUP_BATCH_SIZE];
+    int protos[LOOKUP_BATCH_SIZE];
+    size_t batch_count = 0;
+    size_t ipv4_count = 0;
+    size_t ipv6_count = 0;
+    int done = 0;
+
+    while( !done )
+    {
+        line_length = getline(&line, &line_size, input);
+        if( line_length == -1 )
+        {
+            done = 1;
+        }
+        else
+        {
+            struct ipaddr_bin address;
+            int parse_result;
+
+            chomp(line, line_length);
+            parse_result = str_to_ipaddr_bin(line, &address);
+            if( parse_result != RESULT_SUCCESS )
+            {
+                if( verbose )
+                {
+                    fprintf(stderr, "Malformed address %s\n", line);
+                }
+                result = RESULT_FAILURE;
+                protos[batch_count] = INVALID_PROTO;
+            }
+            else if( address.proto == CIDR_IPV4 )
+            {
+                ipv4_addresses[ipv4_count++] = ((uint32_t)address.addr[12] << 24) | ((uint32_t)address.addr[13] << 16) |
+                                               ((uint32_t)address.addr[14] << 8) | (uint32_t)address.addr[15];
+                protos[batch_count] = CIDR_IPV4;
+            }
+            else
+            {
+                memcpy(ipv6_addresses[ipv6_count++], address.addr, 16);
+                protos[batch_count] = CIDR_IPV6;
+            }
+            batch_count++;
+        }
+
+        if( (batch_count == LOOKUP_BATCH_SIZE) || (done && (batch_count > 0)) )
+        {
+            size_t i;
+            size_t ipv4_index = 0;
+            size_t ipv6_index = 0;
+
+            lpm4_lookup_bulk(table->lpm4, ipv4_addresses, ipv4_values, ipv4_count);
+            lpm6_lookup_bulk(table->lpm6, (const uint8_t (*)[16])ipv6_addresses, ipv6_values, ipv6_count);
+
+            for( i = 0; i < batch_count; i++ )
+            {
+                if( protos[i] == CIDR_IPV4 )
+                {
+                    fputs(lookup_table_result(table, ipv4_values[ipv4_index++]), output);
+                }
+                else if( protos[i] == CIDR_IPV6 )
+                {
+                    fputs(lookup_table_result(table, ipv6_values[ipv6_index++]), output);
+                }
+                else
+                {
+                    fputs(LOOKUP_NO_MATCH_STR, output);
+                }
+                fputc('\n', output);
+            }
+
+            batch_count = 0;
+            ipv4_count = 0;
+            ipv6_count = 0;
+        }
+    }
+
+    free(line);
+    if( (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        result = RESULT_INT_ERROR;
+    }
+
+    return(result);
+}
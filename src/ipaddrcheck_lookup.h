@@ -0,0 +1,48 @@
+/*
+ * ipaddrcheck_lookup.h: mapping addresses to the longest matching prefix of a table
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_LOOKUP_H
+#define IPADDRCHECK_LOOKUP_H
+
+#include "ipaddrcheck_functions.h"
+#include "ipaddrcheck_lpm4.h"
+#include "ipaddrcheck_lpm6.h"
+
+/* Prefix table loaded from a file with "PREFIX [LABEL]" lines.
+   Values stored in the LPM structures are indices into prefixes and labels. */
+struct lookup_table {
+    struct lpm4* lpm4;
+    struct lpm6* lpm6;
+    char** prefixes;
+    char** labels;      /* NULL for prefixes without a label */
+    size_t count;
+    size_t size;
+};
+
+/* Printed for addresses that match no prefix or are malformed */
+#define LOOKUP_NO_MATCH_STR "-"
+
+int lookup_table_load(struct lookup_table* table, FILE* table_file, const char* table_name);
+void lookup_table_free(struct lookup_table* table);
+const char* lookup_table_result(const struct lookup_table* table, uint32_t value);
+int lookup_addresses(const struct lookup_table* table, FILE* input, FILE* output, int verbose);
+
+#endif /* IPADDRCHECK_LOOKUP_H */
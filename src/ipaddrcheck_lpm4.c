@@ -0,0 +1,250 @@
+/*
+ * ipaddrcheck_lpm4.c: IPv4 longest prefix match tables
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ipaddrcheck_functions.h"
+#include "ipaddrcheck_lpm4.h"
+
+/*
+ * Table entry layout:
+ *   bit 31      entry is valid
+ *   bit 30      tbl24 entry points to a tbl8 group rather than holding a value
+ *   bits 24-29  length of the prefix the entry came from
+ *   bits 0-23   value, or tbl8 group number for extended entries
+ *
+ * Keeping prefix length in every entry allows adding prefixes in any order:
+ * an entry is only overwritten by a prefix at least as long as its own.
+ */
+#define LPM4_VALID       0x80000000
+#define LPM4_EXTENDED    0x40000000
+#define LPM4_DEPTH_SHIFT 24
+#define LPM4_DEPTH_MASK  0x3F000000
+#define LPM4_VALUE_MASK  0x00FFFFFF
+
+#define LPM4_TBL24_SIZE  (1 << 24)
+#define LPM4_GROUP_SIZE  256
+
+/* How many addresses ahead the bulk lookup prefetches tbl24 entries */
+#define LPM4_PREFETCH_DISTANCE 8
+
+#ifdef __GNUC__
+#define LPM4_PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#define LPM4_PREFETCH(ptr)
+#endif
+
+static inline uint32_t lpm4_make_entry(int prefix_length, uint32_t value)
+{
+    return LPM4_VALID | ((uint32_t)prefix_length << LPM4_DEPTH_SHIFT) | value;
+}
+
+static inline int lpm4_entry_depth(uint32_t entry)
+{
+    return (entry & LPM4_DEPTH_MASK) >> LPM4_DEPTH_SHIFT;
+}
+
+/* Overwrite entries that are empty or come from a prefix no longer than this one */
+static void lpm4_fill(uint32_t* entries, size_t count, int prefix_length, uint32_t entry)
+{
+    size_t i;
+
+    for( i = 0; i < count; i++ )
+    {
+        if( !(entries[i] & LPM4_VALID) || (lpm4_entry_depth(entries[i]) <= prefix_length) )
+        {
+            entries[i] = entry;
+        }
+    }
+}
+
+/* Allocate a tbl8 group initialized with the entry it replaces in tbl24 */
+static int lpm4_alloc_group(struct lpm4* lpm, uint32_t inherited, uint32_t* group)
+{
+    int i;
+
+    if( lpm->tbl8_used == lpm->tbl8_groups )
+    {
+        uint32_t new_groups = lpm->tbl8_groups ? lpm->tbl8_groups * 2 : 256;
+        uint32_t* new_tbl8;
+
+        if( new_groups > LPM4_VALUE_MASK + 1 )
+        {
+            return(RESULT_FAILURE);
+        }
+
+        new_tbl8 = realloc(lpm->tbl8, (size_t)new_groups * LPM4_GROUP_SIZE * sizeof(uint32_t));
+        if( new_tbl8 == NULL )
+        {
+            return(RESULT_FAILURE);
+        }
+        lpm->tbl8 = new_tbl8;
+        lpm->tbl8_groups = new_groups;
+    }
+
+    *group = lpm->tbl8_used++;
+    for( i = 0; i < LPM4_GROUP_SIZE; i++ )
+    {
+        lpm->tbl8[(size_t)*group * LPM4_GROUP_SIZE + i] = inherited;
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Create an empty table.
+   tbl24 takes 64 MiB of address space, but pages that are never
+   written to stay shared with the zero page. */
+struct lpm4* lpm4_create(void)
+{
+    struct lpm4* lpm = calloc(1, sizeof(struct lpm4));
+    if( lpm == NULL )
+    {
+        return(NULL);
+    }
+
+    lpm->tbl24 = calloc(LPM4_TBL24_SIZE, sizeof(uint32_t));
+    if( lpm->tbl24 == NULL )
+    {
+        free(lpm);
+        return(NULL);
+    }
+
+    return(lpm);
+}
+
+void lpm4_free(struct lpm4* lpm)
+{
+    if( lpm != NULL )
+    {
+        free(lpm->tbl24);
+        free(lpm->tbl8);
+        free(lpm);
+    }
+}
+
+/* Associate a value with a prefix given in host byte order.
+   Host bits of the prefix are ignored. */
+int lpm4_add(struct lpm4* lpm, uint32_t prefix, int prefix_length, uint32_t value)
+{
+    uint32_t entry;
+
+    if( (prefix_length < 0) || (prefix_length > 32) || (value > LPM4_MAX_VALUE) )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    if( prefix_length > 0 )
+    {
+        prefix &= 0xFFFFFFFF << (32 - prefix_length);
+    }
+    else
+    {
+        prefix = 0;
+    }
+    entry = lpm4_make_entry(prefix_length, value);
+
+    if( prefix_length <= 24 )
+    {
+        size_t first = prefix >> 8;
+        size_t count = (size_t)1 << (24 - prefix_length);
+        size_t i;
+
+        for( i = first; i < first + count; i++ )
+        {
+            if( lpm->tbl24[i] & LPM4_EXTENDED )
+            {
+                uint32_t group = lpm->tbl24[i] & LPM4_VALUE_MASK;
+                lpm4_fill(&lpm->tbl8[(size_t)group * LPM4_GROUP_SIZE], LPM4_GROUP_SIZE, prefix_length, entry);
+            }
+            else
+            {
+                lpm4_fill(&lpm->tbl24[i], 1, prefix_length, entry);
+            }
+        }
+    }
+    else
+    {
+        uint32_t* tbl24_entry = &lpm->tbl24[prefix >> 8];
+        uint32_t group;
+
+        if( *tbl24_entry & LPM4_EXTENDED )
+        {
+            group = *tbl24_entry & LPM4_VALUE_MASK;
+        }
+        else
+        {
+            if( lpm4_alloc_group(lpm, *tbl24_entry, &group) != RESULT_SUCCESS )
+            {
+                return(RESULT_FAILURE);
+            }
+            *tbl24_entry = LPM4_VALID | LPM4_EXTENDED | group;
+        }
+
+        lpm4_fill(&lpm->tbl8[(size_t)group * LPM4_GROUP_SIZE + (prefix & 0xFF)],
+                  (size_t)1 << (32 - prefix_length), prefix_length, entry);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Find the value of the longest prefix that contains an address given in host byte order.
+   Returns LPM4_NO_MATCH if there is none. */
+uint32_t lpm4_lookup(const struct lpm4* lpm, uint32_t address)
+{
+    uint32_t entry = lpm->tbl24[address >> 8];
+
+    if( entry & LPM4_EXTENDED )
+    {
+        entry = lpm->tbl8[(size_t)(entry & LPM4_VALUE_MASK) * LPM4_GROUP_SIZE + (address & 0xFF)];
+    }
+
+    if( entry & LPM4_VALID )
+    {
+        return(entry & LPM4_VALUE_MASK);
+    }
+    else
+    {
+        return(LPM4_NO_MATCH);
+    }
+}
+
+/* Look up many addresses at once.
+   tbl24 entries are prefetched a few addresses ahead, so that cache misses
+   of independent lookups overlap instead of being paid one after another. */
+void lpm4_lookup_bulk(const struct lpm4* lpm, const uint32_t* addresses, uint32_t* values, size_t count)
+{
+    size_t i;
+
+    for( i = 0; (i < count) && (i < LPM4_PREFETCH_DISTANCE); i++ )
+    {
+        LPM4_PREFETCH(&lpm->tbl24[addresses[i] >> 8]);
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        if( i + LPM4_PREFETCH_DISTANCE < count )
+        {
+            LPM4_PREFETCH(&lpm->tbl24[addresses[i + LPM4_PREFETCH_DISTANCE] >> 8]);
+        }
+        values[i] = lpm4_lookup(lpm, addresses[i]);
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * ipaddrcheck_lpm4.h: IPv4 longest prefix match tables
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_LPM4_H
+#define IPADDRCHECK_LPM4_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Returned by lookups when no prefix matches */
+#define LPM4_NO_MATCH 0xFFFFFFFF
+
+/* Largest value that can be associated with a prefix */
+#define LPM4_MAX_VALUE 0x00FFFFFF
+
+/* DIR-24-8 table: the first 24 bits of an address index tbl24 directly,
+   and prefixes longer than /24 live in 256-entry tbl8 groups
+   that tbl24 entries can point to. */
+struct lpm4 {
+    uint32_t* tbl24;
+    uint32_t* tbl8;
+    uint32_t tbl8_groups;       /* Number of groups tbl8 has room for */
+    uint32_t tbl8_used;         /* Number of groups in use */
+};
+
+struct lpm4* lpm4_create(void);
+void lpm4_free(struct lpm4* lpm);
+int lpm4_add(struct lpm4* lpm, uint32_t prefix, int prefix_length, uint32_t value);
+uint32_t lpm4_lookup(const struct lpm4* lpm, uint32_t address);
+void lpm4_lookup_bulk(const struct lpm4* lpm, const uint32_t* addresses, uint32_t* values, size_t count);
+
+#endif /* IPADDRCHECK_LPM4_H */
@@ -0,0 +1,420 @@
+/*
+ * ipaddrcheck_lpm6.c: IPv6 longest prefix match tables
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "ipaddrcheck_lpm6.h"
+#include "ipaddrcheck_sort.h"
+
+#define LPM6_STRIDE       8
+#define LPM6_MAX_DEPTH    16     /* A /128 ends in a node below the last full byte */
+#define LPM6_INTERNAL_MAX 255
+
+/* Number of lookups the bulk function walks down the tree side by side */
+#define LPM6_BULK_GROUP   8
+
+#ifdef __GNUC__
+#define LPM6_POPCOUNT(x) __builtin_popcountll(x)
+#define LPM6_PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+static int lpm6_popcount(uint64_t x)
+{
+    int count = 0;
+    while( x )
+    {
+        x &= x - 1;
+        count++;
+    }
+    return(count);
+}
+#define LPM6_POPCOUNT(x) lpm6_popcount(x)
+#define LPM6_PREFETCH(ptr)
+#endif
+
+struct lpm6_builder {
+    struct lpm6* lpm;
+    const struct ipaddr_sort_record* records;
+    const uint32_t* values;
+    size_t nodes_size;
+    size_t results_size;
+};
+
+static inline int lpm6_bit_is_set(const uint64_t* bitmap, int pos)
+{
+    return (bitmap[pos >> 6] >> (pos & 63)) & 1;
+}
+
+static inline void lpm6_set_bit(uint64_t* bitmap, int pos)
+{
+    bitmap[pos >> 6] |= (uint64_t)1 << (pos & 63);
+}
+
+/* Number of bits set before the given position */
+static inline uint32_t lpm6_count_before(const uint64_t* bitmap, int pos)
+{
+    uint32_t count = 0;
+    int word = pos >> 6;
+    int i;
+
+    for( i = 0; i < word; i++ )
+    {
+        count += LPM6_POPCOUNT(bitmap[i]);
+    }
+    if( pos & 63 )
+    {
+        count += LPM6_POPCOUNT(bitmap[word] & (((uint64_t)1 << (pos & 63)) - 1));
+    }
+
+    return(count);
+}
+
+/* Position of a prefix inside a node: prefixes are numbered
+   level by level, so the one of relative length l starts at 2^l - 1 */
+static inline int lpm6_internal_pos(int length, uint8_t byte)
+{
+    return (1 << length) - 1 + (byte >> (LPM6_STRIDE - length));
+}
+
+/* Position of the longest prefix of the node that matches the byte, -1 if none */
+static inline int lpm6_internal_match(const struct lpm6_node* node, uint8_t byte)
+{
+    int length;
+
+    if( (node->internal[0] | node->internal[1] | node->internal[2] | node->internal[3]) == 0 )
+    {
+        return(-1);
+    }
+
+    for( length = LPM6_STRIDE - 1; length >= 0; length-- )
+    {
+        int pos = lpm6_internal_pos(length, byte);
+        if( lpm6_bit_is_set(node->internal, pos) )
+        {
+            return(pos);
+        }
+    }
+
+    return(-1);
+}
+
+static int lpm6_reserve(void** array, size_t* size, size_t needed, size_t element_size)
+{
+    if( needed > *size )
+    {
+        size_t new_size = *size ? *size : 256;
+        void* new_array;
+
+        while( new_size < needed )
+        {
+            new_size *= 2;
+        }
+
+        new_array = realloc(*array, new_size * element_size);
+        if( new_array == NULL )
+        {
+            return(RESULT_FAILURE);
+        }
+        *array = new_array;
+        *size = new_size;
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Fill in a node from a range of sorted prefixes that all share
+   the first depth bytes and are at least depth bytes long.
+   Prefixes that end in this node become its results, the rest
+   are grouped by their next byte and passed down to child nodes. */
+static int lpm6_build_node(struct lpm6_builder* builder, size_t node, size_t first, size_t last, int depth)
+{
+    struct lpm6* lpm = builder->lpm;
+    uint32_t internal_values[LPM6_INTERNAL_MAX];
+    int internal_found[LPM6_INTERNAL_MAX];
+    uint8_t child_keys[256];
+    size_t child_first[256];
+    size_t child_last[256];
+    int child_count = 0;
+    uint32_t result_count = 0;
+    size_t first_child;
+    size_t i;
+    int pos;
+
+    memset(internal_found, 0, sizeof(internal_found));
+
+    for( i = first; i < last; i++ )
+    {
+        const struct ipaddr_bin* prefix = &builder->records[i].key;
+        int length = prefix->pflen - depth * LPM6_STRIDE;
+
+        if( length < LPM6_STRIDE )
+        {
+            uint8_t byte = (depth < LPM6_MAX_DEPTH) ? prefix->addr[depth] : 0;
+
+            /* Duplicates are sorted by their position in the input, the last one wins */
+            pos = lpm6_internal_pos(length, byte);
+            if( !internal_found[pos] )
+            {
+                internal_found[pos] = 1;
+                result_count++;
+            }
+            internal_values[pos] = builder->values[builder->records[i].line];
+        }
+        else
+        {
+            uint8_t key = prefix->addr[depth];
+
+            /* Prefixes with the same next byte are adjacent in sorted order */
+            if( (child_count == 0) || (child_keys[child_count-1] != key) )
+            {
+                child_keys[child_count] = key;
+                child_first[child_count] = i;
+                child_count++;
+            }
+            child_last[child_count-1] = i + 1;
+        }
+    }
+
+    if( lpm6_reserve((void**)&lpm->results, &builder->results_size,
+                     lpm->result_count + result_count, sizeof(uint32_t)) != RESULT_SUCCESS )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    lpm->nodes[node].results = (uint32_t)lpm->result_count;
+    for( pos = 0; pos < LPM6_INTERNAL_MAX; pos++ )
+    {
+        if( internal_found[pos] )
+        {
+            lpm6_set_bit(lpm->nodes[node].internal, pos);
+            lpm->results[lpm->result_count++] = internal_values[pos];
+        }
+    }
+
+    if( child_count == 0 )
+    {
+        return(RESULT_SUCCESS);
+    }
+
+    if( lpm6_reserve((void**)&lpm->nodes, &builder->nodes_size,
+                     lpm->node_count + child_count, sizeof(struct lpm6_node)) != RESULT_SUCCESS )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    first_child = lpm->node_count;
+    lpm->node_count += child_count;
+    memset(&lpm->nodes[first_child], 0, child_count * sizeof(struct lpm6_node));
+    lpm->nodes[node].children = (uint32_t)first_child;
+
+    for( i = 0; i < (size_t)child_count; i++ )
+    {
+        lpm6_set_bit(lpm->nodes[node].external, child_keys[i]);
+    }
+
+    for( i = 0; i < (size_t)child_count; i++ )
+    {
+        if( lpm6_build_node(builder, first_child + i, child_first[i], child_last[i], depth + 1) != RESULT_SUCCESS )
+        {
+            return(RESULT_FAILURE);
+        }
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/* Build a lookup structure from IPv6 prefixes and their values.
+   Host bits of the prefixes are ignored. If the same prefix
+   is given more than once, the last value wins. */
+struct lpm6* lpm6_build(const struct ipaddr_bin* prefixes, const uint32_t* values, size_t count)
+{
+    struct lpm6_builder builder;
+    struct ipaddr_sort_record* records;
+    struct ipaddr_sort_record* scratch;
+    struct lpm6* lpm;
+    size_t i;
+    int result;
+
+    lpm = calloc(1, sizeof(struct lpm6));
+    records = malloc((count ? count : 1) * sizeof(*records));
+    scratch = malloc((count ? count : 1) * sizeof(*scratch));
+    if( (lpm == NULL) || (records == NULL) || (scratch == NULL) )
+    {
+        free(lpm);
+        free(records);
+        free(scratch);
+        return(NULL);
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        int byte;
+
+        records[i].key = prefixes[i];
+        records[i].line = (uint32_t)i;
+        for( byte = 0; byte < 16; byte++ )
+        {
+            int bits = prefixes[i].pflen - byte * 8;
+            if( bits <= 0 )
+            {
+                records[i].key.addr[byte] = 0;
+            }
+            else if( bits < 8 )
+            {
+                records[i].key.addr[byte] &= (uint8_t)(0xFF << (8 - bits));
+            }
+        }
+    }
+
+    /* Sorting by address, then by prefix length, makes
+       every subtree a contiguous range of the array */
+    result = radix_sort_ipaddr(records, scratch, count);
+    free(scratch);
+    if( result != RESULT_SUCCESS )
+    {
+        free(lpm);
+        free(records);
+        return(NULL);
+    }
+
+    memset(&builder, 0, sizeof(builder));
+    builder.lpm = lpm;
+    builder.records = records;
+    builder.values = values;
+
+    result = lpm6_reserve((void**)&lpm->nodes, &builder.nodes_size, 1, sizeof(struct lpm6_node));
+    if( result == RESULT_SUCCESS )
+    {
+        memset(&lpm->nodes[0], 0, sizeof(struct lpm6_node));
+        lpm->node_count = 1;
+        result = lpm6_build_node(&builder, 0, 0, count, 0);
+    }
+
+    free(records);
+
+    if( result != RESULT_SUCCESS )
+    {
+        lpm6_free(lpm);
+        return(NULL);
+    }
+
+    return(lpm);
+}
+
+void lpm6_free(struct lpm6* lpm)
+{
+    if( lpm != NULL )
+    {
+        free(lpm->nodes);
+        free(lpm->results);
+        free(lpm);
+    }
+}
+
+/* Find the value of the longest prefix that contains an address
+   (16 bytes in network byte order). Returns LPM6_NO_MATCH if there is none. */
+uint32_t lpm6_lookup(const struct lpm6* lpm, const uint8_t* address)
+{
+    const struct lpm6_node* node = &lpm->nodes[0];
+    uint32_t value = LPM6_NO_MATCH;
+    int depth;
+
+    for( depth = 0; depth <= LPM6_MAX_DEPTH; depth++ )
+    {
+        uint8_t byte = (depth < LPM6_MAX_DEPTH) ? address[depth] : 0;
+        int pos = lpm6_internal_match(node, byte);
+
+        if( pos >= 0 )
+        {
+            value = lpm->results[node->results + lpm6_count_before(node->internal, pos)];
+        }
+
+        if( (depth == LPM6_MAX_DEPTH) || !lpm6_bit_is_set(node->external, byte) )
+        {
+            break;
+        }
+        node = &lpm->nodes[node->children + lpm6_count_before(node->external, byte)];
+    }
+
+    return(value);
+}
+
+/* Look up many addresses at once.
+   Groups of addresses walk down the tree level by level, and every
+   next node is prefetched, so that a cache miss of one lookup
+   is overlapped with the work of the others. */
+void lpm6_lookup_bulk(const struct lpm6* lpm, const uint8_t (*addresses)[16], uint32_t* values, size_t count)
+{
+    size_t base;
+
+    for( base = 0; base < count; base += LPM6_BULK_GROUP )
+    {
+        const struct lpm6_node* nodes[LPM6_BULK_GROUP];
+        size_t group = (count - base < LPM6_BULK_GROUP) ? count - base : LPM6_BULK_GROUP;
+        size_t active = group;
+        size_t i;
+        int depth;
+
+        for( i = 0; i < group; i++ )
+        {
+            nodes[i] = &lpm->nodes[0];
+            values[base + i] = LPM6_NO_MATCH;
+        }
+
+        for( depth = 0; (depth <= LPM6_MAX_DEPTH) && (active > 0); depth++ )
+        {
+            for( i = 0; i < group; i++ )
+            {
+                const struct lpm6_node* node = nodes[i];
+                uint8_t byte;
+                int pos;
+
+                if( node == NULL )
+                {
+                    continue;
+                }
+
+                byte = (depth < LPM6_MAX_DEPTH) ? addresses[base + i][depth] : 0;
+                pos = lpm6_internal_match(node, byte);
+                if( pos >= 0 )
+                {
+                    values[base + i] = lpm->results[node->results + lpm6_count_before(node->internal, pos)];
+                }
+
+                if( (depth == LPM6_MAX_DEPTH) || !lpm6_bit_is_set(node->external, byte) )
+                {
+                    nodes[i] = NULL;
+                    active--;
+                }
+                else
+                {
+                    nodes[i] = &lpm->nodes[node->children + lpm6_count_before(node->external, byte)];
+                    LPM6_PREFETCH(nodes[i]);
+                }
+            }
+        }
+    }
+}
+
+/* Memory taken by the lookup structure, in bytes */
+size_t lpm6_memory(const struct lpm6* lpm)
+{
+    return sizeof(struct lpm6) +
+           lpm->node_count * sizeof(struct lpm6_node) +
+           lpm->result_count * sizeof(uint32_t);
+}
@@ -0,0 +1,56 @@
+/*
+ * ipaddrcheck_lpm6.h: IPv6 longest prefix match tables
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_LPM6_H
+#define IPADDRCHECK_LPM6_H
+
+#include "ipaddrcheck_functions.h"
+
+/* Returned by lookups when no prefix matches */
+#define LPM6_NO_MATCH 0xFFFFFFFF
+
+/* Tree bitmap node with an 8 bit stride.
+   The internal bitmap marks prefixes that end inside the node
+   (lengths 0 to 7 relative to the node, 255 positions),
+   the external bitmap marks which of the 256 possible children exist.
+   Children and results of a node are stored contiguously,
+   so their positions are found by counting bits set before the one of interest. */
+struct lpm6_node {
+    uint64_t internal[4];
+    uint64_t external[4];
+    uint32_t children;      /* Index of the first child in the node array */
+    uint32_t results;       /* Index of the first result in the result array */
+};
+
+struct lpm6 {
+    struct lpm6_node* nodes;
+    uint32_t* results;
+    size_t node_count;
+    size_t result_count;
+};
+
+struct lpm6* lpm6_build(const struct ipaddr_bin* prefixes, const uint32_t* values, size_t count);
+void lpm6_free(struct lpm6* lpm);
+uint32_t lpm6_lookup(const struct lpm6* lpm, const uint8_t* address);
+void lpm6_lookup_bulk(const struct lpm6* lpm, const uint8_t (*addresses)[16], uint32_t* values, size_t count);
+size_t lpm6_memory(const struct lpm6* lpm);
+
+#endif /* IPADDRCHECK_LPM6_H */
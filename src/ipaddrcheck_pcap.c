@@ -0,0 +1,603 @@
+/*
+ * ipaddrcheck_pcap.c: classification of addresses in packet capture files
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ipaddrcheck_pcap.h"
+#include "ipaddrcheck_actions.h"
+#include "ipaddrcheck_special.h"
+
+/* File format constants, see https://www.ietf.org/archive/id/draft-ietf-opsawg-pcap-03.html
+   and https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-01.html */
+#define PCAP_MAGIC_USEC          0xa1b2c3d4
+#define PCAP_MAGIC_NSEC          0xa1b23c4d
+#define PCAP_HEADER_SIZE         24
+#define PCAP_RECORD_HEADER_SIZE  16
+
+#define PCAPNG_SECTION_HEADER    0x0A0D0D0A
+#define PCAPNG_INTERFACE         0x00000001
+#define PCAPNG_PACKET            0x00000002
+#define PCAPNG_SIMPLE_PACKET     0x00000003
+#define PCAPNG_ENHANCED_PACKET   0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC  0x1A2B3C4D
+
+#define ETHERTYPE_IPV4           0x0800
+#define ETHERTYPE_IPV6           0x86DD
+#define ETHERTYPE_VLAN           0x8100
+#define ETHERTYPE_QINQ           0x88A8
+#define ETHERTYPE_QINQ_OLD       0x9100
+
+/* Result of dissecting a single packet */
+#define PACKET_OTHER             0
+#define PACKET_IP                1
+#define PACKET_TRUNCATED         2
+
+/* Checks used when none are given: sources of bogus traffic */
+static const int default_checks[] = { IS_IPV4_RFC1918, IS_IPV4_LOOPBACK, IS_IPV4_LINKLOCAL,
+                                      IS_IPV4_MULTICAST, IS_IPV6_LINKLOCAL, IS_IPV6_MULTICAST };
+
+static inline uint16_t read16(const unsigned char* p, int little_endian)
+{
+    return little_endian ? (uint16_t)(p[0] | (p[1] << 8)) : (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t read32(const unsigned char* p, int little_endian)
+{
+    if( little_endian )
+    {
+        return((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+    }
+    else
+    {
+        return(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3]);
+    }
+}
+
+static void set_address(struct ipaddr_bin* address, int proto, const unsigned char* bytes)
+{
+    memset(address, 0, sizeof(*address));
+    address->proto = proto;
+    if( proto == CIDR_IPV4 )
+    {
+        memcpy(&address->addr[12], bytes, 4);
+        address->pflen = 32;
+    }
+    else
+    {
+        memcpy(address->addr, bytes, 16);
+        address->pflen = 128;
+    }
+}
+
+/* Find the source and destination addresses of an IP header */
+static int dissect_ip(const unsigned char* packet, size_t length, int version,
+                      struct ipaddr_bin* source, struct ipaddr_bin* destination)
+{
+    if( (length < 1) || ((packet[0] >> 4) != version) )
+    {
+        return((length < 1) ? PACKET_TRUNCATED : PACKET_OTHER);
+    }
+
+    if( version == 4 )
+    {
+        if( length < 20 )
+        {
+            return(PACKET_TRUNCATED);
+        }
+        set_address(source, CIDR_IPV4, packet + 12);
+        set_address(destination, CIDR_IPV4, packet + 16);
+    }
+    else
+    {
+        if( length < 40 )
+        {
+            return(PACKET_TRUNCATED);
+        }
+        set_address(source, CIDR_IPV6, packet + 8);
+        set_address(destination, CIDR_IPV6, packet + 24);
+    }
+
+    return(PACKET_IP);
+}
+
+static int dissect_ethertype(const unsigned char* packet, size_t length, uint16_t ethertype,
+                             struct ipaddr_bin* source, struct ipaddr_bin* destination)
+{
+    if( ethertype == ETHERTYPE_IPV4 )
+    {
+        return(dissect_ip(packet, length, 4, source, destination));
+    }
+    else if( ethertype == ETHERTYPE_IPV6 )
+    {
+        return(dissect_ip(packet, length, 6, source, destination));
+    }
+
+    return(PACKET_OTHER);
+}
+
+static int dissect(int linktype, const unsigned char* packet, size_t length,
+                   struct ipaddr_bin* source, struct ipaddr_bin* destination)
+{
+    size_t offset;
+    uint16_t ethertype;
+
+    switch( linktype )
+    {
+        case PCAP_LINKTYPE_ETHERNET:
+            if( length < 14 )
+            {
+                return(PACKET_OTHER);
+            }
+            ethertype = read16(packet + 12, 0);
+            offset = 14;
+            /* Any number of 802.1Q or 802.1ad tags */
+            while( (ethertype == ETHERTYPE_VLAN) || (ethertype == ETHERTYPE_QINQ) || (ethertype == ETHERTYPE_QINQ_OLD) )
+            {
+                if( length < offset + 4 )
+                {
+                    return(PACKET_OTHER);
+                }
+                ethertype = read16(packet + offset + 2, 0);
+                offset += 4;
+            }
+            return(dissect_ethertype(packet + offset, length - offset, ethertype, source, destination));
+        case PCAP_LINKTYPE_LINUX_SLL:
+            if( length < 16 )
+            {
+                return(PACKET_OTHER);
+            }
+            return(dissect_ethertype(packet + 16, length - 16, read16(packet + 14, 0), source, destination));
+        case PCAP_LINKTYPE_RAW:
+            if( (length < 1) || (((packet[0] >> 4) != 4) && ((packet[0] >> 4) != 6)) )
+            {
+                return(PACKET_OTHER);
+            }
+            return(dissect_ip(packet, length, packet[0] >> 4, source, destination));
+        case PCAP_LINKTYPE_IPV4:
+            return(dissect_ip(packet, length, 4, source, destination));
+        case PCAP_LINKTYPE_IPV6:
+            return(dissect_ip(packet, length, 6, source, destination));
+        default:
+            return(PACKET_OTHER);
+    }
+}
+
+static void walk_packet(int linktype, const unsigned char* packet, size_t length,
+                        pcap_packet_callback callback, void* callback_data, struct pcap_stats* stats)
+{
+    struct ipaddr_bin source;
+    struct ipaddr_bin destination;
+
+    stats->packets++;
+
+    switch( dissect(linktype, packet, length, &source, &destination) )
+    {
+        case PACKET_IP:
+            if( source.proto == CIDR_IPV4 )
+            {
+                stats->ipv4++;
+            }
+            else
+            {
+                stats->ipv6++;
+            }
+            callback(callback_data, stats->packets, &source, &destination);
+            break;
+        case PACKET_TRUNCATED:
+            stats->truncated++;
+            break;
+        default:
+            stats->other++;
+            break;
+    }
+}
+
+static int walk_pcap(const unsigned char* capture, size_t size, const char* name, int little_endian,
+                     pcap_packet_callback callback, void* callback_data, struct pcap_stats* stats)
+{
+    size_t offset = PCAP_HEADER_SIZE;
+    int linktype;
+
+    if( size < PCAP_HEADER_SIZE )
+    {
+        fprintf(stderr, "Error: %s: incomplete file header\n", name);
+        return(RESULT_INT_ERROR);
+    }
+    /* The upper bits may carry FCS information */
+    linktype = read32(capture + 20, little_endian) & 0x0FFFFFFF;
+
+    while( size - offset >= PCAP_RECORD_HEADER_SIZE )
+    {
+        uint32_t captured_length = read32(capture + offset + 8, little_endian);
+
+        offset += PCAP_RECORD_HEADER_SIZE;
+        if( captured_length > size - offset )
+        {
+            break;
+        }
+
+        walk_packet(linktype, capture + offset, captured_length, callback, callback_data, stats);
+        offset += captured_length;
+    }
+
+    if( offset != size )
+    {
+        fprintf(stderr, "Warning: %s ends in the middle of packet %llu\n", name,
+                (unsigned long long)stats->packets + 1);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+static int walk_pcapng(const unsigned char* capture, size_t size, const char* name,
+                       pcap_packet_callback callback, void* callback_data, struct pcap_stats* stats)
+{
+    size_t offset = 0;
+    int little_endian = 1;
+    int* linktypes = NULL;
+    size_t interface_count = 0;
+    size_t interface_size = 0;
+    int result = RESULT_SUCCESS;
+
+    while( size - offset >= 12 )
+    {
+        const unsigned char* block = capture + offset;
+        uint32_t block_type;
+        uint32_t block_length;
+        uint32_t interface = 0;
+        uint32_t captured_length = 0;
+        size_t data_offset = 0;
+
+        block_type = read32(block, little_endian);
+        if( block_type == PCAPNG_SECTION_HEADER )
+        {
+            /* Every section may have its own byte order and interfaces */
+            if( read32(block + 8, 1) == PCAPNG_BYTE_ORDER_MAGIC )
+            {
+                little_endian = 1;
+            }
+            else if( read32(block + 8, 0) == PCAPNG_BYTE_ORDER_MAGIC )
+            {
+                little_endian = 0;
+            }
+            else
+            {
+                fprintf(stderr, "Error: %s: invalid section header at offset %zu\n", name, offset);
+                result = RESULT_INT_ERROR;
+                break;
+            }
+            interface_count = 0;
+        }
+
+        block_length = read32(block + 4, little_endian);
+        if( (block_length < 12) || (block_length % 4 != 0) )
+        {
+            fprintf(stderr, "Error: %s: invalid block length at offset %zu\n", name, offset);
+            result = RESULT_INT_ERROR;
+            break;
+        }
+        if( block_length > size - offset )
+        {
+            fprintf(stderr, "Warning: %s ends in the middle of a block\n", name);
+            break;
+        }
+
+        switch( block_type )
+        {
+            case PCAPNG_INTERFACE:
+                if( block_length < 20 )
+                {
+                    break;
+                }
+                if( interface_count == interface_size )
+                {
+                    int* new_linktypes;
+
+                    interface_size = interface_size ? interface_size * 2 : 8;
+                    new_linktypes = realloc(linktypes, interface_size * sizeof(*linktypes));
+                    if( new_linktypes == NULL )
+                    {
+                        fprintf(stderr, "Error: could not allocate memory!\n");
+                        free(linktypes);
+                        return(RESULT_INT_ERROR);
+                    }
+                    linktypes = new_linktypes;
+                }
+                linktypes[interface_count++] = read16(block + 8, little_endian);
+                break;
+            case PCAPNG_ENHANCED_PACKET:
+            case PCAPNG_PACKET:
+                if( block_length < 32 )
+                {
+                    break;
+                }
+                interface = (block_type == PCAPNG_PACKET) ? read16(block + 8, little_endian)
+                                                          : read32(block + 8, little_endian);
+                captured_length = read32(block + 20, little_endian);
+                data_offset = 28;
+                break;
+            case PCAPNG_SIMPLE_PACKET:
+                if( block_length < 16 )
+                {
+                    break;
+                }
+                captured_length = read32(block + 8, little_endian);
+                if( captured_length > block_length - 16 )
+                {
+                    captured_length = block_length - 16;
+                }
+                data_offset = 12;
+                break;
+            default:
+                break;
+        }
+
+        if( data_offset > 0 )
+        {
+            if( captured_length > block_length - data_offset - 4 )
+            {
+                fprintf(stderr, "Error: %s: invalid packet length at offset %zu\n", name, offset);
+                result = RESULT_INT_ERROR;
+                break;
+            }
+            walk_packet((interface < interface_count) ? linktypes[interface] : -1,
+                        block + data_offset, captured_length, callback, callback_data, stats);
+        }
+
+        offset += block_length;
+    }
+
+    free(linktypes);
+
+    return(result);
+}
+
+/* Walk all packets of a pcap or pcapng capture held in memory and call
+ * the callback with the addresses of every IPv4 and IPv6 packet.
+ *
+ * Ethernet (with any number of VLAN tags), Linux cooked and raw IP
+ * link types are understood, other packets are only counted.
+ */
+int pcap_walk(const unsigned char* capture, size_t size, const char* name,
+              pcap_packet_callback callback, void* callback_data, struct pcap_stats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if( size >= 4 )
+    {
+        uint32_t magic = read32(capture, 1);
+
+        if( (magic == PCAP_MAGIC_USEC) || (magic == PCAP_MAGIC_NSEC) )
+        {
+            return(walk_pcap(capture, size, name, 1, callback, callback_data, stats));
+        }
+
+        magic = read32(capture, 0);
+        if( (magic == PCAP_MAGIC_USEC) || (magic == PCAP_MAGIC_NSEC) )
+        {
+            return(walk_pcap(capture, size, name, 0, callback, callback_data, stats));
+        }
+        else if( magic == PCAPNG_SECTION_HEADER )
+        {
+            return(walk_pcapng(capture, size, name, callback, callback_data, stats));
+        }
+    }
+
+    fprintf(stderr, "Error: %s is not a pcap or pcapng file\n", name);
+
+    return(RESULT_INT_ERROR);
+}
+
+/* Indices of the packets an address class was found in */
+struct packet_list {
+    uint64_t* indices;
+    size_t count;
+    size_t size;
+};
+
+struct pcap_classify_state {
+    const int* checks;
+    int check_count;
+    int allow_loopback;
+    struct packet_list* source;         /* One list per check */
+    struct packet_list* destination;
+    int out_of_memory;
+};
+
+static void packet_list_append(struct pcap_classify_state* state, struct packet_list* list, uint64_t index)
+{
+    if( list->count == list->size )
+    {
+        size_t new_size = list->size ? list->size * 2 : 64;
+        uint64_t* new_indices = realloc(list->indices, new_size * sizeof(*new_indices));
+
+        if( new_indices == NULL )
+        {
+            state->out_of_memory = 1;
+            return;
+        }
+        list->indices = new_indices;
+        list->size = new_size;
+    }
+    list->indices[list->count++] = index;
+}
+
+static void classify_packet(void* data, uint64_t index,
+                            const struct ipaddr_bin* source, const struct ipaddr_bin* destination)
+{
+    struct pcap_classify_state* state = data;
+    uint64_t source_categories = classify_ipaddr_bin(source);
+    uint64_t destination_categories = classify_ipaddr_bin(destination);
+    int i;
+
+    for( i = 0; i < state->check_count; i++ )
+    {
+        if( check_ipaddr_bin_classified(state->checks[i], source, source_categories,
+                                        state->allow_loopback) == RESULT_SUCCESS )
+        {
+            packet_list_append(state, &state->source[i], index);
+        }
+        if( check_ipaddr_bin_classified(state->checks[i], destination, destination_categories,
+                                        state->allow_loopback) == RESULT_SUCCESS )
+        {
+            packet_list_append(state, &state->destination[i], index);
+        }
+    }
+}
+
+static void print_packet_list(FILE* output, const char* check, const char* direction, const struct packet_list* list)
+{
+    size_t i;
+
+    fprintf(output, "%s %s-packets", check, direction);
+    for( i = 0; i < list->count; i++ )
+    {
+        fprintf(output, " %llu", (unsigned long long)list->indices[i]);
+    }
+    fputc('\n', output);
+}
+
+/* Run checks on the source and destination addresses of every packet
+ * in a capture file and print a report:
+ *
+ *   packets 10 ipv4 7 ipv6 2 other 1 truncated 0
+ *   is-ipv4-rfc1918 source 2 destination 1
+ *   is-ipv4-rfc1918 source-packets 1 4
+ *   is-ipv4-rfc1918 destination-packets 9
+ *
+ * Packets are numbered from 1 like in capture viewers. Without checks,
+ * addresses that should not appear on the wire are looked for.
+ * Returns RESULT_SUCCESS if no address passed any check, RESULT_FAILURE
+ * if some did, RESULT_INT_ERROR if the file could not be read.
+ */
+int classify_pcap(const char* filename, FILE* output, const int* checks, int check_count, int allow_loopback)
+{
+    struct pcap_classify_state state;
+    struct pcap_stats stats;
+    struct stat st;
+    void* capture;
+    int result;
+    int fd;
+    int i;
+
+    if( check_count == 0 )
+    {
+        checks = default_checks;
+        check_count = sizeof(default_checks) / sizeof(default_checks[0]);
+    }
+
+    fd = open(filename, O_RDONLY);
+    if( (fd < 0) || (fstat(fd, &st) != 0) )
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n", filename, strerror(errno));
+        if( fd >= 0 )
+        {
+            close(fd);
+        }
+        return(RESULT_INT_ERROR);
+    }
+    if( st.st_size == 0 )
+    {
+        fprintf(stderr, "Error: %s is not a pcap or pcapng file\n", filename);
+        close(fd);
+        return(RESULT_INT_ERROR);
+    }
+
+    capture = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( capture == MAP_FAILED )
+    {
+        fprintf(stderr, "Error: could not map %s: %s\n", filename, strerror(errno));
+        return(RESULT_INT_ERROR);
+    }
+    posix_madvise(capture, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    memset(&state, 0, sizeof(state));
+    state.checks = checks;
+    state.check_count = check_count;
+    state.allow_loopback = allow_loopback;
+    state.source = calloc(check_count, sizeof(struct packet_list));
+    state.destination = calloc(check_count, sizeof(struct packet_list));
+    if( (state.source == NULL) || (state.destination == NULL) )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        result = RESULT_INT_ERROR;
+    }
+    else
+    {
+        result = pcap_walk(capture, st.st_size, filename, classify_packet, &state, &stats);
+        if( state.out_of_memory )
+        {
+            fprintf(stderr, "Error: could not allocate memory!\n");
+            result = RESULT_INT_ERROR;
+        }
+    }
+    munmap(capture, st.st_size);
+
+    if( result == RESULT_SUCCESS )
+    {
+        fprintf(output, "packets %llu ipv4 %llu ipv6 %llu other %llu truncated %llu\n",
+                (unsigned long long)stats.packets, (unsigned long long)stats.ipv4,
+                (unsigned long long)stats.ipv6, (unsigned long long)stats.other,
+                (unsigned long long)stats.truncated);
+
+        for( i = 0; i < check_count; i++ )
+        {
+            const char* check = action_name(checks[i]);
+
+            fprintf(output, "%s source %zu destination %zu\n", check,
+                    state.source[i].count, state.destination[i].count);
+            print_packet_list(output, check, "source", &state.source[i]);
+            print_packet_list(output, check, "destination", &state.destination[i]);
+
+            if( (state.source[i].count > 0) || (state.destination[i].count > 0) )
+            {
+                result = RESULT_FAILURE;
+            }
+        }
+    }
+
+    if( state.source != NULL )
+    {
+        for( i = 0; i < check_count; i++ )
+        {
+            free(state.source[i].indices);
+        }
+    }
+    if( state.destination != NULL )
+    {
+        for( i = 0; i < check_count; i++ )
+        {
+            free(state.destination[i].indices);
+        }
+    }
+    free(state.source);
+    free(state.destination);
+    fflush(output);
+
+    return(result);
+}
@@ -0,0 +1,50 @@
+/*
+ * ipaddrcheck_pcap.h: classification of addresses in packet capture files
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_PCAP_H
+#define IPADDRCHECK_PCAP_H
+
+#include "ipaddrcheck_functions.h"
+
+/* Link layer types of capture files, see https://www.tcpdump.org/linktypes.html */
+#define PCAP_LINKTYPE_ETHERNET   1
+#define PCAP_LINKTYPE_RAW        101
+#define PCAP_LINKTYPE_LINUX_SLL  113
+#define PCAP_LINKTYPE_IPV4       228
+#define PCAP_LINKTYPE_IPV6       229
+
+struct pcap_stats {
+    uint64_t packets;
+    uint64_t ipv4;
+    uint64_t ipv6;
+    uint64_t other;         /* Non-IP packets and unsupported link types */
+    uint64_t truncated;     /* IP packets cut off before the end of the addresses */
+};
+
+/* Called for every IP packet, index counts all packets from 1 */
+typedef void (*pcap_packet_callback)(void* data, uint64_t index,
+                                     const struct ipaddr_bin* source, const struct ipaddr_bin* destination);
+
+int pcap_walk(const unsigned char* capture, size_t size, const char* name,
+              pcap_packet_callback callback, void* callback_data, struct pcap_stats* stats);
+int classify_pcap(const char* filename, FILE* output, const int* checks, int check_count, int allow_loopback);
+
+#endif /* IPADDRCHECK_PCAP_H */
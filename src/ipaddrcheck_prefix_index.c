@@ -0,0 +1,683 @@
+/*
+ * ipaddrcheck_prefix_index.c: compiled prefix table files
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ipaddrcheck_prefix_index.h"
+#include "ipaddrcheck_lookup.h"
+
+#define PREFIX_INDEX_ALIGN(size) (((size) + 7) & ~(uint64_t)7)
+
+/* Primes of XXH64 */
+#define PREFIX_INDEX_PRIME1 0x9E3779B185EBCA87ULL
+#define PREFIX_INDEX_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PREFIX_INDEX_PRIME3 0x165667B19E3779F9ULL
+#define PREFIX_INDEX_PRIME4 0x85EBCA77C2B2AE63ULL
+#define PREFIX_INDEX_PRIME5 0x27D4EB2F165667C5ULL
+
+/* A prefix of the table while the index is built */
+struct prefix_index_entry {
+    uint8_t start[16];
+    uint8_t end[16];
+    uint32_t value;
+    uint8_t length;
+    size_t order;       /* Line order, the last of duplicate prefixes wins */
+};
+
+/* A range with a single longest match, up to the start of the next one */
+struct prefix_index_range {
+    uint8_t start[16];
+    uint32_t value;
+    uint8_t length;     /* Of the shortest prefix containing the range */
+};
+
+struct prefix_index_ranges {
+    struct prefix_index_range* ranges;
+    size_t count;
+    size_t size;
+};
+
+static uint64_t prefix_index_rotl(uint64_t x, int bits)
+{
+    return((x << bits) | (x >> (64 - bits)));
+}
+
+/* The single-lane loop and the final mix of XXH64 */
+static uint64_t prefix_index_checksum(const void* data, size_t size)
+{
+    const uint8_t* p = data;
+    uint64_t h = PREFIX_INDEX_PRIME5 + size;
+
+    while( size >= 8 )
+    {
+        uint64_t word;
+
+        memcpy(&word, p, 8);
+        h ^= prefix_index_rotl(word * PREFIX_INDEX_PRIME2, 31) * PREFIX_INDEX_PRIME1;
+        h = prefix_index_rotl(h, 27) * PREFIX_INDEX_PRIME1 + PREFIX_INDEX_PRIME4;
+        p += 8;
+        size -= 8;
+    }
+    while( size > 0 )
+    {
+        h ^= *p * PREFIX_INDEX_PRIME5;
+        h = prefix_index_rotl(h, 11) * PREFIX_INDEX_PRIME1;
+        p++;
+        size--;
+    }
+
+    h ^= h >> 33;
+    h *= PREFIX_INDEX_PRIME2;
+    h ^= h >> 29;
+    h *= PREFIX_INDEX_PRIME3;
+    h ^= h >> 32;
+
+    return(h);
+}
+
+/* Section offsets follow from the counts, so the header only has
+   to be compared with them to know the sections are in bounds */
+static void prefix_index_layout(struct prefix_index_header* header)
+{
+    header->ipv4_starts_offset = sizeof(struct prefix_index_header);
+    header->ipv4_values_offset = header->ipv4_starts_offset + PREFIX_INDEX_ALIGN(header->ipv4_count * 4);
+    header->ipv4_lengths_offset = header->ipv4_values_offset + PREFIX_INDEX_ALIGN(header->ipv4_count * 4);
+    header->ipv6_starts_offset = header->ipv4_lengths_offset + PREFIX_INDEX_ALIGN(header->ipv4_count);
+    header->ipv6_values_offset = header->ipv6_starts_offset + header->ipv6_count * 16;
+    header->ipv6_lengths_offset = header->ipv6_values_offset + PREFIX_INDEX_ALIGN(header->ipv6_count * 4);
+    header->strings_offset = header->ipv6_lengths_offset + PREFIX_INDEX_ALIGN(header->ipv6_count);
+    header->file_size = header->strings_offset + PREFIX_INDEX_ALIGN(header->string_size);
+}
+
+static int prefix_index_compare_entries(const void* a, const void* b)
+{
+    const struct prefix_index_entry* first = a;
+    const struct prefix_index_entry* second = b;
+    int cmp = memcmp(first->start, second->start, 16);
+
+    if( cmp != 0 )
+    {
+        return(cmp);
+    }
+    if( first->length != second->length )
+    {
+        return((first->length < second->length) ? -1 : 1);
+    }
+    return((first->order > second->order) - (first->order < second->order));
+}
+
+/* Start a range, replacing one that starts at the same address
+   and leaving it out if it is the same as the one before */
+static int prefix_index_emit(struct prefix_index_ranges* ranges, const uint8_t* start, uint32_t value,
+                             uint8_t length)
+{
+    if( (ranges->count > 0) && (memcmp(ranges->ranges[ranges->count - 1].start, start, 16) == 0) )
+    {
+        ranges->count--;
+    }
+    if( (ranges->count > 0) && (ranges->ranges[ranges->count - 1].value == value) &&
+        (ranges->ranges[ranges->count - 1].length == length) )
+    {
+        return(RESULT_SUCCESS);
+    }
+
+    if( ranges->count == ranges->size )
+    {
+        size_t new_size = ranges->size ? ranges->size * 2 : 1024;
+        struct prefix_index_range* new_ranges = realloc(ranges->ranges, new_size * sizeof(*new_ranges));
+
+        if( new_ranges == NULL )
+        {
+            return(RESULT_INT_ERROR);
+        }
+        ranges->ranges = new_ranges;
+        ranges->size = new_size;
+    }
+    memcpy(ranges->ranges[ranges->count].start, start, 16);
+    ranges->ranges[ranges->count].value = value;
+    ranges->ranges[ranges->count].length = length;
+    ranges->count++;
+
+    return(RESULT_SUCCESS);
+}
+
+/* Turn the prefixes of a family into ranges. Sorted by start address and
+ * then length, every prefix either lies in the ones before it that are
+ * still open or comes after them, so they form a stack: a prefix starts
+ * a range with its own result, and where it ends, the range of the prefix
+ * below it on the stack continues. The bottom of the stack is the shortest
+ * prefix containing the range.
+ */
+static int prefix_index_flatten(struct prefix_index_entry* entries, size_t count, const uint8_t* last,
+                                struct prefix_index_ranges* ranges)
+{
+    static const uint8_t first[16];
+    size_t* stack;
+    size_t depth = 0;
+    size_t kept = 0;
+    size_t i;
+    int result;
+
+    qsort(entries, count, sizeof(*entries), prefix_index_compare_entries);
+    for( i = 0; i < count; i++ )
+    {
+        if( (kept > 0) && (memcmp(entries[kept - 1].start, entries[i].start, 16) == 0) &&
+            (entries[kept - 1].length == entries[i].length) )
+        {
+            kept--;
+        }
+        entries[kept++] = entries[i];
+    }
+
+    stack = malloc((kept + 1) * sizeof(size_t));
+    if( stack == NULL )
+    {
+        return(RESULT_INT_ERROR);
+    }
+
+    result = prefix_index_emit(ranges, first, PREFIX_INDEX_NO_MATCH, 0);
+    for( i = 0; (i <= kept) && (result == RESULT_SUCCESS); i++ )
+    {
+        /* Close the prefixes that end before this one, or all of them at the end */
+        while( (depth > 0) && (result == RESULT_SUCCESS) &&
+               ((i == kept) || (memcmp(entries[stack[depth - 1]].end, entries[i].start, 16) < 0)) )
+        {
+            const struct prefix_index_entry* closed = &entries[stack[--depth]];
+            uint8_t next[16];
+            int byte;
+
+            if( memcmp(closed->end, last, 16) == 0 )
+            {
+                depth = 0;
+                break;
+            }
+            memcpy(next, closed->end, 16);
+            for( byte = 15; (byte >= 0) && (++next[byte] == 0); byte-- )
+            {
+            }
+            if( depth > 0 )
+            {
+                result = prefix_index_emit(ranges, next, entries[stack[depth - 1]].value,
+                                           entries[stack[0]].length);
+            }
+            else
+            {
+                result = prefix_index_emit(ranges, next, PREFIX_INDEX_NO_MATCH, 0);
+            }
+        }
+
+        if( (i < kept) && (result == RESULT_SUCCESS) )
+        {
+            result = prefix_index_emit(ranges, entries[i].start, entries[i].value,
+                                       (depth > 0) ? entries[stack[0]].length : entries[i].length);
+            stack[depth++] = i;
+        }
+    }
+
+    free(stack);
+
+    return(result);
+}
+
+/* Add a string to the string section, or find it there if it is already
+   in it, and return its offset. Labels tend to repeat, so strings are
+   looked up in an open addressing table of offsets. */
+static int prefix_index_add_string(char** strings, uint64_t* string_size, uint64_t* string_alloc,
+                                   uint32_t* slots, size_t slot_mask, const char* str, uint32_t* offset)
+{
+    size_t length = strlen(str) + 1;
+    uint64_t hash = 14695981039346656037ULL;
+    size_t slot;
+    size_t i;
+
+    for( i = 0; i < length; i++ )
+    {
+        hash = (hash ^ (uint8_t)str[i]) * 1099511628211ULL;
+    }
+
+    for( slot = hash & slot_mask; slots[slot] != PREFIX_INDEX_NO_MATCH; slot = (slot + 1) & slot_mask )
+    {
+        if( strcmp(*strings + slots[slot], str) == 0 )
+        {
+            *offset = slots[slot];
+            return(RESULT_SUCCESS);
+        }
+    }
+
+    if( *string_size + length > PREFIX_INDEX_NO_MATCH )
+    {
+        return(RESULT_INT_ERROR);
+    }
+    if( *string_size + length > *string_alloc )
+    {
+        uint64_t new_alloc = (*string_alloc + length) * 2;
+        char* new_strings = realloc(*strings, new_alloc);
+
+        if( new_strings == NULL )
+        {
+            return(RESULT_INT_ERROR);
+        }
+        *strings = new_strings;
+        *string_alloc = new_alloc;
+    }
+
+    memcpy(*strings + *string_size, str, length);
+    *offset = (uint32_t)*string_size;
+    slots[slot] = *offset;
+    *string_size += length;
+
+    return(RESULT_SUCCESS);
+}
+
+static int prefix_index_write(const char* index_name, struct prefix_index_ranges* families,
+                              const char* strings, uint64_t string_size)
+{
+    struct prefix_index_header header;
+    char* file;
+    FILE* output;
+    uint64_t i;
+    int result = RESULT_SUCCESS;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PREFIX_INDEX_MAGIC, sizeof(header.magic));
+    header.version = PREFIX_INDEX_VERSION;
+    header.byte_order = PREFIX_INDEX_BYTE_ORDER;
+    header.ipv4_count = families[0].count;
+    header.ipv6_count = families[1].count;
+    header.string_size = string_size;
+    prefix_index_layout(&header);
+
+    file = calloc(1, header.file_size);
+    if( file == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    for( i = 0; i < header.ipv4_count; i++ )
+    {
+        const uint8_t* start = families[0].ranges[i].start;
+        uint32_t start32 = ((uint32_t)start[12] << 24) | ((uint32_t)start[13] << 16) |
+                           ((uint32_t)start[14] << 8) | (uint32_t)start[15];
+
+        memcpy(file + header.ipv4_starts_offset + i * 4, &start32, 4);
+        memcpy(file + header.ipv4_values_offset + i * 4, &families[0].ranges[i].value, 4);
+        file[header.ipv4_lengths_offset + i] = (char)families[0].ranges[i].length;
+    }
+    for( i = 0; i < header.ipv6_count; i++ )
+    {
+        memcpy(file + header.ipv6_starts_offset + i * 16, families[1].ranges[i].start, 16);
+        memcpy(file + header.ipv6_values_offset + i * 4, &families[1].ranges[i].value, 4);
+        file[header.ipv6_lengths_offset + i] = (char)families[1].ranges[i].length;
+    }
+    memcpy(file + header.strings_offset, strings, string_size);
+
+    header.data_checksum = prefix_index_checksum(file + sizeof(header), header.file_size - sizeof(header));
+    header.header_checksum = prefix_index_checksum(&header, offsetof(struct prefix_index_header, header_checksum));
+    memcpy(file, &header, sizeof(header));
+
+    output = fopen(index_name, "wb");
+    if( output == NULL )
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n", index_name, strerror(errno));
+        free(file);
+        return(RESULT_INT_ERROR);
+    }
+    if( fwrite(file, 1, header.file_size, output) != header.file_size )
+    {
+        result = RESULT_FAILURE;
+    }
+    if( fclose(output) != 0 )
+    {
+        result = RESULT_FAILURE;
+    }
+    if( result != RESULT_SUCCESS )
+    {
+        fprintf(stderr, "Error: could not write %s: %s\n", index_name, strerror(errno));
+        remove(index_name);
+        result = RESULT_INT_ERROR;
+    }
+    free(file);
+
+    return(result);
+}
+
+/* Build a prefix index file from a prefix table in the format of --lookup,
+ * which is checked the same way. Errors are reported to stderr.
+ */
+int prefix_index_build(FILE* input, const char* input_name, const char* index_name)
+{
+    static const uint8_t ipv4_last[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0xff, 0xff };
+    static const uint8_t ipv6_last[16] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                           0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    struct lookup_table table;
+    struct prefix_index_entry* entries[2] = { NULL, NULL };
+    size_t entry_counts[2] = { 0, 0 };
+    struct prefix_index_ranges families[2];
+    char* strings = NULL;
+    uint64_t string_size = 0;
+    uint64_t string_alloc = 0;
+    uint32_t* slots = NULL;
+    size_t slot_count = 1;
+    size_t i;
+    int result;
+
+    result = lookup_table_load(&table, input, input_name);
+    if( result != RESULT_SUCCESS )
+    {
+        return(RESULT_INT_ERROR);
+    }
+
+    memset(families, 0, sizeof(families));
+    while( slot_count < 2 * table.count + 2 )
+    {
+        slot_count *= 2;
+    }
+    slots = malloc(slot_count * sizeof(uint32_t));
+    entries[0] = malloc((table.count + 1) * sizeof(struct prefix_index_entry));
+    entries[1] = malloc((table.count + 1) * sizeof(struct prefix_index_entry));
+    if( (slots == NULL) || (entries[0] == NULL) || (entries[1] == NULL) )
+    {
+        result = RESULT_INT_ERROR;
+    }
+    else
+    {
+        memset(slots, 0xff, slot_count * sizeof(uint32_t));
+    }
+
+    for( i = 0; (i < table.count) && (result == RESULT_SUCCESS); i++ )
+    {
+        const char* str = (table.labels[i] != NULL) ? table.labels[i] : table.prefixes[i];
+        struct ipaddr_bin prefix;
+        struct prefix_index_entry* entry;
+        int family;
+        int start;
+        int bit;
+
+        /* The table has checked the prefix already */
+        str_to_ipaddr_bin_r(ipaddrcheck_default_ctx(), table.prefixes[i], &prefix);
+        family = (prefix.proto == CIDR_IPV4) ? 0 : 1;
+        start = (prefix.proto == CIDR_IPV4) ? 12 * 8 : 0;
+        entry = &entries[family][entry_counts[family]++];
+
+        memcpy(entry->start, prefix.addr, 16);
+        memcpy(entry->end, prefix.addr, 16);
+        for( bit = start + prefix.pflen; bit < 128; bit++ )
+        {
+            entry->end[bit / 8] |= 0x80 >> (bit % 8);
+        }
+        entry->length = prefix.pflen;
+        entry->order = i;
+        result = prefix_index_add_string(&strings, &string_size, &string_alloc, slots, slot_count - 1,
+                                         str, &entry->value);
+    }
+
+    if( result == RESULT_SUCCESS )
+    {
+        result = prefix_index_flatten(entries[0], entry_counts[0], ipv4_last, &families[0]);
+    }
+    if( result == RESULT_SUCCESS )
+    {
+        result = prefix_index_flatten(entries[1], entry_counts[1], ipv6_last, &families[1]);
+    }
+
+    /* An empty table still gets a string section, which must end with NUL */
+    if( (result == RESULT_SUCCESS) && (string_size == 0) )
+    {
+        uint32_t offset;
+
+        result = prefix_index_add_string(&strings, &string_size, &string_alloc, slots, slot_count - 1,
+                                         "", &offset);
+    }
+
+    if( result == RESULT_SUCCESS )
+    {
+        result = prefix_index_write(index_name, families, strings, string_size);
+    }
+    else
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+    }
+
+    lookup_table_free(&table);
+    free(entries[0]);
+    free(entries[1]);
+    free(families[0].ranges);
+    free(families[1].ranges);
+    free(strings);
+    free(slots);
+
+    return(result);
+}
+
+/* Map a prefix index file into memory after checking that its header
+   matches this program and the size of the file. With verify, the
+   checksum of the sections is checked too, which reads the whole file. */
+int prefix_index_open(struct prefix_index* index, const char* index_name, int verify)
+{
+    static const uint8_t first[16];
+    const struct prefix_index_header* header;
+    struct prefix_index_header expected;
+    struct stat st;
+    int valid;
+    int fd;
+
+    memset(index, 0, sizeof(*index));
+
+    fd = open(index_name, O_RDONLY);
+    if( fd < 0 )
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n", index_name, strerror(errno));
+        return(RESULT_INT_ERROR);
+    }
+    if( (fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(struct prefix_index_header)) )
+    {
+        fprintf(stderr, "Error: %s is not a valid prefix index file\n", index_name);
+        close(fd);
+        return(RESULT_INT_ERROR);
+    }
+
+    index->map_size = (size_t)st.st_size;
+    index->map = mmap(NULL, index->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( index->map == MAP_FAILED )
+    {
+        fprintf(stderr, "Error: could not map %s: %s\n", index_name, strerror(errno));
+        index->map = NULL;
+        return(RESULT_INT_ERROR);
+    }
+
+    header = index->map;
+    if( (memcmp(header->magic, PREFIX_INDEX_MAGIC, sizeof(header->magic)) != 0) ||
+        (header->byte_order != PREFIX_INDEX_BYTE_ORDER) )
+    {
+        fprintf(stderr, "Error: %s is not a valid prefix index file\n", index_name);
+        prefix_index_close(index);
+        return(RESULT_INT_ERROR);
+    }
+    if( header->version != PREFIX_INDEX_VERSION )
+    {
+        fprintf(stderr, "Error: %s has unsupported prefix index format version %u\n",
+                index_name, (unsigned int)header->version);
+        prefix_index_close(index);
+        return(RESULT_INT_ERROR);
+    }
+
+    /* The counts are small enough for the layout not to overflow
+       before it is compared with the header */
+    memset(&expected, 0, sizeof(expected));
+    valid = (header->header_checksum ==
+             prefix_index_checksum(header, offsetof(struct prefix_index_header, header_checksum))) &&
+            (header->ipv4_count >= 1) && (header->ipv4_count <= index->map_size / 4) &&
+            (header->ipv6_count >= 1) && (header->ipv6_count <= index->map_size / 16) &&
+            (header->string_size >= 1) && (header->string_size <= index->map_size);
+    if( valid )
+    {
+        expected.ipv4_count = header->ipv4_count;
+        expected.ipv6_count = header->ipv6_count;
+        expected.string_size = header->string_size;
+        prefix_index_layout(&expected);
+        valid = (header->ipv4_starts_offset == expected.ipv4_starts_offset) &&
+                (header->ipv4_values_offset == expected.ipv4_values_offset) &&
+                (header->ipv4_lengths_offset == expected.ipv4_lengths_offset) &&
+                (header->ipv6_starts_offset == expected.ipv6_starts_offset) &&
+                (header->ipv6_values_offset == expected.ipv6_values_offset) &&
+                (header->ipv6_lengths_offset == expected.ipv6_lengths_offset) &&
+                (header->strings_offset == expected.strings_offset) &&
+                (header->file_size == expected.file_size) &&
+                (header->file_size == index->map_size);
+    }
+    if( valid )
+    {
+        const char* base = index->map;
+
+        index->ipv4_starts = (const uint32_t*)(base + header->ipv4_starts_offset);
+        index->ipv4_values = (const uint32_t*)(base + header->ipv4_values_offset);
+        index->ipv4_lengths = (const uint8_t*)(base + header->ipv4_lengths_offset);
+        index->ipv6_starts = (const uint8_t (*)[16])(base + header->ipv6_starts_offset);
+        index->ipv6_values = (const uint32_t*)(base + header->ipv6_values_offset);
+        index->ipv6_lengths = (const uint8_t*)(base + header->ipv6_lengths_offset);
+        index->strings = base + header->strings_offset;
+        index->ipv4_count = header->ipv4_count;
+        index->ipv6_count = header->ipv6_count;
+        index->string_size = header->string_size;
+
+        /* Lookups rely on these, the rest of the data can only give wrong answers */
+        valid = (index->ipv4_starts[0] == 0) && (memcmp(index->ipv6_starts[0], first, 16) == 0) &&
+                (index->strings[index->string_size - 1] == '\0');
+    }
+    if( valid && verify )
+    {
+        valid = (header->data_checksum ==
+                 prefix_index_checksum((const char*)index->map + sizeof(*header), index->map_size - sizeof(*header)));
+    }
+    if( !valid )
+    {
+        fprintf(stderr, "Error: %s is not a valid prefix index file\n", index_name);
+        prefix_index_close(index);
+        return(RESULT_INT_ERROR);
+    }
+
+    /* Binary searches visit a few pages of each section */
+    posix_madvise(index->map, index->map_size, POSIX_MADV_RANDOM);
+
+    return(RESULT_SUCCESS);
+}
+
+void prefix_index_close(struct prefix_index* index)
+{
+    if( index->map != NULL )
+    {
+        munmap(index->map, index->map_size);
+    }
+    memset(index, 0, sizeof(*index));
+}
+
+/* Position of the range of an address in the arrays of its family */
+static uint64_t prefix_index_find(const struct prefix_index* index, const struct ipaddr_bin* address)
+{
+    uint64_t low = 0;
+    uint64_t count;
+
+    if( address->proto == CIDR_IPV4 )
+    {
+        uint32_t address32 = ((uint32_t)address->addr[12] << 24) | ((uint32_t)address->addr[13] << 16) |
+                             ((uint32_t)address->addr[14] << 8) | (uint32_t)address->addr[15];
+
+        /* Find the last range that starts at or before the address */
+        count = index->ipv4_count;
+        while( count > 1 )
+        {
+            uint64_t half = count / 2;
+
+            if( index->ipv4_starts[low + half] <= address32 )
+            {
+                low += half;
+            }
+            count -= half;
+        }
+    }
+    else
+    {
+        count = index->ipv6_count;
+        while( count > 1 )
+        {
+            uint64_t half = count / 2;
+
+            if( memcmp(index->ipv6_starts[low + half], address->addr, 16) <= 0 )
+            {
+                low += half;
+            }
+            count -= half;
+        }
+    }
+
+    return(low);
+}
+
+/* The label or prefix of the longest prefix that contains an address,
+   or NULL if there is none. The prefix length of the address is ignored. */
+const char* prefix_index_lookup(const struct prefix_index* index, const struct ipaddr_bin* address)
+{
+    uint64_t position = prefix_index_find(index, address);
+    uint32_t value = (address->proto == CIDR_IPV4) ? index->ipv4_values[position] : index->ipv6_values[position];
+
+    if( value >= index->string_size )
+    {
+        return(NULL);
+    }
+
+    return(index->strings + value);
+}
+
+/* Check if an address, and with a prefix length the whole prefix,
+   is in a prefix of the index */
+int prefix_index_contains(const struct prefix_index* index, const struct ipaddr_bin* address)
+{
+    uint64_t position = prefix_index_find(index, address);
+    uint32_t value;
+    uint8_t length;
+
+    if( address->proto == CIDR_IPV4 )
+    {
+        value = index->ipv4_values[position];
+        length = index->ipv4_lengths[position];
+    }
+    else
+    {
+        value = index->ipv6_values[position];
+        length = index->ipv6_lengths[position];
+    }
+
+    if( (value >= index->string_size) || (length > address->pflen) )
+    {
+        return(RESULT_FAILURE);
+    }
+
+    return(RESULT_SUCCESS);
+}
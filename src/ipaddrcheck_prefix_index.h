@@ -0,0 +1,99 @@
+/*
+ * ipaddrcheck_prefix_index.h: compiled prefix table files
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_PREFIX_INDEX_H
+#define IPADDRCHECK_PREFIX_INDEX_H
+
+#include "ipaddrcheck_functions.h"
+
+/*
+ * A prefix table in the format of --lookup, compiled into a file that is
+ * used where it is mapped, with no parsing or building on startup.
+ *
+ * File layout, all integers in native byte order, every section starting
+ * at a multiple of 8 bytes. There are only offsets, no pointers:
+ *   header       struct prefix_index_header
+ *   IPv4 starts   ipv4_count uint32_t first addresses of ranges, ascending
+ *   IPv4 values   ipv4_count uint32_t results of those ranges
+ *   IPv4 lengths  ipv4_count uint8_t outer lengths of those ranges
+ *   IPv6 starts   ipv6_count 16-byte first addresses of ranges, ascending
+ *   IPv6 values   ipv6_count uint32_t results of those ranges
+ *   IPv6 lengths  ipv6_count uint8_t outer lengths of those ranges
+ *   strings       string_size bytes of NUL-terminated labels and prefixes
+ *
+ * Nested prefixes are flattened into ranges that each have a single
+ * longest match, which extend to the start of the next one. The first
+ * range of a family starts at its lowest address. A result is an offset
+ * into the strings, or PREFIX_INDEX_NO_MATCH. The outer length is that of
+ * the shortest prefix containing the range, so an address with a prefix
+ * length is in a prefix of the table if it is not shorter.
+ *
+ * Opening a file checks the header, its checksum and the section bounds,
+ * which takes the same time for any size. The checksum of the sections
+ * is only checked by --verify-prefix-index.
+ */
+#define PREFIX_INDEX_MAGIC        "IPCPFXIX"
+#define PREFIX_INDEX_VERSION      2
+#define PREFIX_INDEX_BYTE_ORDER   0x01020304
+#define PREFIX_INDEX_NO_MATCH     0xFFFFFFFF
+
+struct prefix_index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t ipv4_count;
+    uint64_t ipv6_count;
+    uint64_t string_size;
+    uint64_t ipv4_starts_offset;
+    uint64_t ipv4_values_offset;
+    uint64_t ipv4_lengths_offset;
+    uint64_t ipv6_starts_offset;
+    uint64_t ipv6_values_offset;
+    uint64_t ipv6_lengths_offset;
+    uint64_t strings_offset;
+    uint64_t file_size;
+    uint64_t data_checksum;     /* Of everything after the header */
+    uint64_t header_checksum;   /* Of the header up to this field */
+};
+
+/* A prefix index file mapped into memory */
+struct prefix_index {
+    void* map;
+    size_t map_size;
+    const uint32_t* ipv4_starts;
+    const uint32_t* ipv4_values;
+    const uint8_t* ipv4_lengths;
+    const uint8_t (*ipv6_starts)[16];
+    const uint32_t* ipv6_values;
+    const uint8_t* ipv6_lengths;
+    const char* strings;
+    uint64_t ipv4_count;
+    uint64_t ipv6_count;
+    uint64_t string_size;
+};
+
+int prefix_index_build(FILE* input, const char* input_name, const char* index_name);
+int prefix_index_open(struct prefix_index* index, const char* index_name, int verify);
+void prefix_index_close(struct prefix_index* index);
+const char* prefix_index_lookup(const struct prefix_index* index, const struct ipaddr_bin* address);
+int prefix_index_contains(const struct prefix_index* index, const struct ipaddr_bin* address);
+
+#endif /* IPADDRCHECK_PREFIX_INDEX_H */
@@ -0,0 +1,218 @@
+/*
+ * ipaddrcheck_reverse.c: reverse DNS names of addresses and prefixes
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "ipaddrcheck_reverse.h"
+
+/* Labels of every byte value, built by the preprocessor:
+ * IPv4 bytes as "192.", IPv6 bytes as two nibbles, low one first, "a.b."
+ */
+#define REVERSE_HEX(n)  ((char)(((n) < 10) ? ('0' + (n)) : ('a' + (n) - 10)))
+#define REVERSE_NIBBLES(b) { REVERSE_HEX((b) & 0xF), '.', REVERSE_HEX((b) >> 4), '.' }
+
+#define REVERSE_DIGIT(n) ((char)('0' + (n)))
+#define REVERSE_DECIMAL(b) { { \
+    ((b) >= 100) ? REVERSE_DIGIT((b) / 100) : ((b) >= 10) ? REVERSE_DIGIT((b) / 10) : REVERSE_DIGIT(b), \
+    ((b) >= 100) ? REVERSE_DIGIT(((b) / 10) % 10) : ((b) >= 10) ? REVERSE_DIGIT((b) % 10) : '.', \
+    ((b) >= 100) ? REVERSE_DIGIT((b) % 10) : ((b) >= 10) ? '.' : '\0', \
+    ((b) >= 100) ? '.' : '\0' }, \
+    ((b) >= 100) ? 4 : ((b) >= 10) ? 3 : 2 }
+
+#define REVERSE_ROW(f, h) \
+    f(h * 16 + 0),  f(h * 16 + 1),  f(h * 16 + 2),  f(h * 16 + 3), \
+    f(h * 16 + 4),  f(h * 16 + 5),  f(h * 16 + 6),  f(h * 16 + 7), \
+    f(h * 16 + 8),  f(h * 16 + 9),  f(h * 16 + 10), f(h * 16 + 11), \
+    f(h * 16 + 12), f(h * 16 + 13), f(h * 16 + 14), f(h * 16 + 15)
+#define REVERSE_TABLE(f) \
+    REVERSE_ROW(f, 0),  REVERSE_ROW(f, 1),  REVERSE_ROW(f, 2),  REVERSE_ROW(f, 3), \
+    REVERSE_ROW(f, 4),  REVERSE_ROW(f, 5),  REVERSE_ROW(f, 6),  REVERSE_ROW(f, 7), \
+    REVERSE_ROW(f, 8),  REVERSE_ROW(f, 9),  REVERSE_ROW(f, 10), REVERSE_ROW(f, 11), \
+    REVERSE_ROW(f, 12), REVERSE_ROW(f, 13), REVERSE_ROW(f, 14), REVERSE_ROW(f, 15)
+
+static const char reverse_nibbles[256][4] = { REVERSE_TABLE(REVERSE_NIBBLES) };
+
+static const struct {
+    char text[4];
+    uint8_t length;
+} reverse_decimal[256] = { REVERSE_TABLE(REVERSE_DECIMAL) };
+
+/* True if the address has no bits set past its prefix length */
+static int is_network(const struct ipaddr_bin* address, int first_byte)
+{
+    int bit;
+
+    for( bit = address->pflen; bit < (16 - first_byte) * 8; bit++ )
+    {
+        if( address->addr[first_byte + bit / 8] & (0x80 >> (bit % 8)) )
+        {
+            return(0);
+        }
+    }
+
+    return(1);
+}
+
+/* Write the reverse DNS name of an address into buf, which must be at least
+ * REVERSE_NAME_MAX bytes long, and return its length.
+ *
+ * Network addresses with a shorter prefix length get the name of their zone,
+ * which only exists for prefix lengths on an octet (IPv4) or nibble (IPv6)
+ * boundary. Others return -1. Addresses with host bits set are named
+ * as single addresses.
+ */
+int ipaddr_bin_to_reverse(const struct ipaddr_bin* address, char* buf)
+{
+    char* p = buf;
+    int i;
+
+    if( address->proto == CIDR_IPV4 )
+    {
+        int bytes = 4;
+
+        if( (address->pflen < 32) && is_network(address, 12) )
+        {
+            if( address->pflen % 8 != 0 )
+            {
+                return(-1);
+            }
+            bytes = address->pflen / 8;
+        }
+
+        for( i = 12 + bytes - 1; i >= 12; i-- )
+        {
+            memcpy(p, reverse_decimal[address->addr[i]].text, 4);
+            p += reverse_decimal[address->addr[i]].length;
+        }
+        memcpy(p, "in-addr.arpa", 13);
+
+        return(p - buf + 12);
+    }
+    else
+    {
+        int nibbles = 32;
+
+        if( (address->pflen < 128) && is_network(address, 0) )
+        {
+            if( address->pflen % 4 != 0 )
+            {
+                return(-1);
+            }
+            nibbles = address->pflen / 4;
+        }
+
+        /* A trailing half byte only contributes its high nibble */
+        if( nibbles % 2 != 0 )
+        {
+            memcpy(p, reverse_nibbles[address->addr[nibbles / 2]] + 2, 2);
+            p += 2;
+        }
+        for( i = nibbles / 2 - 1; i >= 0; i-- )
+        {
+            memcpy(p, reverse_nibbles[address->addr[i]], 4);
+            p += 4;
+        }
+        memcpy(p, "ip6.arpa", 9);
+
+        return(p - buf + 8);
+    }
+}
+
+/* Print the reverse DNS name of every input line.
+   Output lines correspond to input lines one to one. Malformed addresses
+   and prefixes without a zone of their own produce REVERSE_NONE_STR
+   and make the function return RESULT_FAILURE.
+   Returns RESULT_INT_ERROR if the output could not be written. */
+int reverse_addresses(FILE* input, FILE* output, int verbose)
+{
+    int result = RESULT_SUCCESS;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+    char* buffer;
+    size_t buffer_length = 0;
+
+    buffer = malloc(REVERSE_BUFFER_SIZE);
+    if( buffer == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    while( (line_length = getline(&line, &line_size, input)) != -1 )
+    {
+        struct ipaddr_bin address;
+        int length = -1;
+
+        while( (line_length > 0) &&
+               ((line[line_length-1] == '\n') || (line[line_length-1] == '\r')) )
+        {
+            line[--line_length] = '\0';
+        }
+
+        if( buffer_length + REVERSE_NAME_MAX + 1 > REVERSE_BUFFER_SIZE )
+        {
+            if( fwrite(buffer, 1, buffer_length, output) != buffer_length )
+            {
+                result = RESULT_INT_ERROR;
+                break;
+            }
+            buffer_length = 0;
+        }
+
+        if( str_to_ipaddr_bin(line, &address) != RESULT_SUCCESS )
+        {
+            if( verbose )
+            {
+                fprintf(stderr, "Malformed address %s\n", line);
+            }
+        }
+        else
+        {
+            length = ipaddr_bin_to_reverse(&address, buffer + buffer_length);
+            if( (length < 0) && verbose )
+            {
+                fprintf(stderr, "%s does not end on an %s boundary\n", line,
+                        (address.proto == CIDR_IPV4) ? "octet" : "nibble");
+            }
+        }
+
+        if( length < 0 )
+        {
+            memcpy(buffer + buffer_length, REVERSE_NONE_STR, sizeof(REVERSE_NONE_STR) - 1);
+            length = sizeof(REVERSE_NONE_STR) - 1;
+            result = RESULT_FAILURE;
+        }
+        buffer_length += length;
+        buffer[buffer_length++] = '\n';
+    }
+
+    if( (result == RESULT_INT_ERROR) || (fwrite(buffer, 1, buffer_length, output) != buffer_length) ||
+        (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        result = RESULT_INT_ERROR;
+    }
+    free(buffer);
+    free(line);
+
+    return(result);
+}
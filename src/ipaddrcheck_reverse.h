@@ -0,0 +1,39 @@
+/*
+ * ipaddrcheck_reverse.h: reverse DNS names of addresses and prefixes
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_REVERSE_H
+#define IPADDRCHECK_REVERSE_H
+
+#include "ipaddrcheck_functions.h"
+
+/* Longest name: 32 nibbles with dots and "ip6.arpa", plus the null byte */
+#define REVERSE_NAME_MAX 74
+
+#define REVERSE_BUFFER_SIZE 65536
+
+/* Printed for malformed addresses and prefixes that do not end
+   on an octet (IPv4) or nibble (IPv6) boundary */
+#define REVERSE_NONE_STR "-"
+
+int ipaddr_bin_to_reverse(const struct ipaddr_bin* address, char* buf);
+int reverse_addresses(FILE* input, FILE* output, int verbose);
+
+#endif /* IPADDRCHECK_REVERSE_H */
@@ -0,0 +1,603 @@
+/*
+ * ipaddrcheck_rules.c: rules combining checks with and, or and not
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+
+#include "ipaddrcheck_rules.h"
+#include "ipaddrcheck_actions.h"
+
+/* Checks that can be used in rules, by their option names */
+static const int rule_checks[] = {
+    IS_VALID, IS_IPV4, IS_IPV4_CIDR, IS_IPV4_SINGLE, IS_IPV4_HOST, IS_IPV4_NET, IS_IPV4_BROADCAST,
+    IS_IPV4_MULTICAST, IS_IPV4_RFC1918, IS_IPV4_LOOPBACK, IS_IPV4_LINKLOCAL, IS_IPV6, IS_IPV6_CIDR,
+    IS_IPV6_SINGLE, IS_IPV6_HOST, IS_IPV6_NET, IS_IPV6_MULTICAST, IS_IPV6_LINKLOCAL, IS_VALID_INTF_ADDR,
+    IS_ANY_CIDR, IS_ANY_SINGLE, IS_ANY_HOST, IS_ANY_NET
+};
+
+/* Longest word that can be a check name or a prefix */
+#define RULES_WORD_MAX 64
+
+struct rule_parser {
+    struct rule_set* rules;
+    const char* p;
+    int depth;
+    char* error;
+    size_t error_size;
+};
+
+void rules_init(struct rule_set* rules)
+{
+    memset(rules, 0, sizeof(*rules));
+
+    /* Node 0 is always true, the rule of an empty rule file */
+    rules->nodes[0].op = RULE_TRUE;
+    rules->node_count = 1;
+    rules->root = 0;
+}
+
+void rules_free(struct rule_set* rules)
+{
+    free(rules->prefixes);
+    rules->prefixes = NULL;
+    rules->prefix_count = 0;
+    rules->prefix_size = 0;
+}
+
+/* Add a node, or find an identical one, and return its index or -1 */
+static int rules_node(struct rule_parser* parser, uint8_t op, int a, int b)
+{
+    struct rule_set* rules = parser->rules;
+    size_t i;
+
+    /* Simplify what is trivial, and order the operands
+       so that "x and y" and "y and x" become the same node */
+    if( (op == RULE_NOT) && (rules->nodes[a].op == RULE_NOT) )
+    {
+        return(rules->nodes[a].a);
+    }
+    if( (op == RULE_AND) || (op == RULE_OR) )
+    {
+        if( a == b )
+        {
+            return(a);
+        }
+        if( a > b )
+        {
+            int swap = a;
+            a = b;
+            b = swap;
+        }
+    }
+
+    for( i = 0; i < rules->node_count; i++ )
+    {
+        if( (rules->nodes[i].op == op) && (rules->nodes[i].a == a) && (rules->nodes[i].b == b) )
+        {
+            return((int)i);
+        }
+    }
+
+    if( rules->node_count == RULES_MAX_NODES )
+    {
+        snprintf(parser->error, parser->error_size, "more than %d distinct subexpressions", RULES_MAX_NODES);
+        return(-1);
+    }
+
+    rules->nodes[rules->node_count].op = op;
+    rules->nodes[rules->node_count].a = (uint16_t)a;
+    rules->nodes[rules->node_count].b = (uint16_t)b;
+
+    return((int)rules->node_count++);
+}
+
+/* Add a prefix with its host bits cleared, or find an identical one,
+   and return its index or -1 */
+static int rules_prefix(struct rule_parser* parser, struct ipaddr_bin* prefix)
+{
+    struct rule_set* rules = parser->rules;
+    int offset = (prefix->proto == CIDR_IPV4) ? 12 : 0;
+    int bit;
+    size_t i;
+
+    for( bit = prefix->pflen; bit < (16 - offset) * 8; bit++ )
+    {
+        prefix->addr[offset + bit / 8] &= (uint8_t)~(0x80 >> (bit % 8));
+    }
+
+    for( i = 0; i < rules->prefix_count; i++ )
+    {
+        if( memcmp(&rules->prefixes[i], prefix, sizeof(*prefix)) == 0 )
+        {
+            return((int)i);
+        }
+    }
+
+    if( rules->prefix_count == rules->prefix_size )
+    {
+        size_t new_size = rules->prefix_size ? rules->prefix_size * 2 : 16;
+        struct ipaddr_bin* new_prefixes = NULL;
+
+        if( new_size <= UINT16_MAX )
+        {
+            new_prefixes = realloc(rules->prefixes, new_size * sizeof(*new_prefixes));
+        }
+        if( new_prefixes == NULL )
+        {
+            snprintf(parser->error, parser->error_size, "too many prefixes");
+            return(-1);
+        }
+        rules->prefixes = new_prefixes;
+        rules->prefix_size = new_size;
+    }
+
+    rules->prefixes[rules->prefix_count] = *prefix;
+
+    return((int)rules->prefix_count++);
+}
+
+/* Find the next word, "(" or ")" without consuming it.
+   Returns its length, 0 at the end of the rule. */
+static size_t rules_peek(struct rule_parser* parser)
+{
+    const char* p;
+    size_t length = 0;
+
+    while( (*parser->p == ' ') || (*parser->p == '\t') )
+    {
+        parser->p++;
+    }
+
+    p = parser->p;
+    if( (*p == '\0') || (*p == '#') || (*p == '\n') || (*p == '\r') )
+    {
+        return(0);
+    }
+    if( (*p == '(') || (*p == ')') )
+    {
+        return(1);
+    }
+
+    while( (p[length] != '\0') && !isspace((unsigned char)p[length]) &&
+           (p[length] != '(') && (p[length] != ')') && (p[length] != '#') )
+    {
+        length++;
+    }
+
+    return(length);
+}
+
+static int rules_next_is(struct rule_parser* parser, const char* word)
+{
+    size_t length = rules_peek(parser);
+
+    return( (length == strlen(word)) && (strncmp(parser->p, word, length) == 0) );
+}
+
+static int parse_expression(struct rule_parser* parser);
+
+/* Check name in the option form, with or without the leading dashes,
+   or with underscores as in the function names */
+static int parse_check(struct rule_parser* parser, size_t length)
+{
+    char name[RULES_WORD_MAX];
+    const char* word = parser->p;
+    size_t i;
+
+    if( (length > 2) && (word[0] == '-') && (word[1] == '-') )
+    {
+        word += 2;
+        length -= 2;
+    }
+
+    if( length < sizeof(name) )
+    {
+        for( i = 0; i < length; i++ )
+        {
+            name[i] = (word[i] == '_') ? '-' : word[i];
+        }
+        name[length] = '\0';
+
+        for( i = 0; i < sizeof(rule_checks) / sizeof(rule_checks[0]); i++ )
+        {
+            if( strcmp(name, action_name(rule_checks[i])) == 0 )
+            {
+                parser->p = word + length;
+                return(rules_node(parser, RULE_CHECK, rule_checks[i], 0));
+            }
+        }
+    }
+
+    snprintf(parser->error, parser->error_size, "unknown check \"%.*s\"",
+             (int)((length < RULES_WORD_MAX) ? length : RULES_WORD_MAX), word);
+
+    return(-1);
+}
+
+/* factor := "not" factor | "(" expression ")" | "in" PREFIX | CHECK */
+static int parse_factor(struct rule_parser* parser)
+{
+    size_t length = rules_peek(parser);
+    int node;
+
+    if( length == 0 )
+    {
+        snprintf(parser->error, parser->error_size, "expected a check, \"in\", \"not\" or \"(\"");
+        return(-1);
+    }
+
+    if( ++parser->depth > RULES_MAX_DEPTH )
+    {
+        snprintf(parser->error, parser->error_size, "nested deeper than %d levels", RULES_MAX_DEPTH);
+        return(-1);
+    }
+
+    if( rules_next_is(parser, "not") )
+    {
+        parser->p += length;
+        /* "not not x" is x, without adding a node for "not x" */
+        if( rules_next_is(parser, "not") )
+        {
+            parser->p += 3;
+            node = parse_factor(parser);
+        }
+        else
+        {
+            node = parse_factor(parser);
+            if( node >= 0 )
+            {
+                node = rules_node(parser, RULE_NOT, node, 0);
+            }
+        }
+    }
+    else if( *parser->p == '(' )
+    {
+        parser->p++;
+        node = parse_expression(parser);
+        if( (node >= 0) && (rules_peek(parser) == 1) && (*parser->p == ')') )
+        {
+            parser->p++;
+        }
+        else if( node >= 0 )
+        {
+            snprintf(parser->error, parser->error_size, "missing \")\"");
+            node = -1;
+        }
+    }
+    else if( rules_next_is(parser, "in") )
+    {
+        struct ipaddr_bin prefix;
+
+        parser->p += length;
+        length = rules_peek(parser);
+        if( (length == 0) || (*parser->p == '(') || (*parser->p == ')') ||
+            (str_to_ipaddr_bin_n(ipaddrcheck_default_ctx(), parser->p, length, &prefix) != RESULT_SUCCESS) )
+        {
+            snprintf(parser->error, parser->error_size, "\"in\" must be followed by a prefix");
+            node = -1;
+        }
+        else
+        {
+            parser->p += length;
+            node = rules_prefix(parser, &prefix);
+            if( node >= 0 )
+            {
+                node = rules_node(parser, RULE_IN, node, 0);
+            }
+        }
+    }
+    else if( *parser->p == ')' )
+    {
+        snprintf(parser->error, parser->error_size, "unexpected \")\"");
+        node = -1;
+    }
+    else
+    {
+        node = parse_check(parser, length);
+    }
+
+    parser->depth--;
+
+    return(node);
+}
+
+/* term := factor ("and" factor)* */
+static int parse_term(struct rule_parser* parser)
+{
+    int node = parse_factor(parser);
+
+    while( (node >= 0) && rules_next_is(parser, "and") )
+    {
+        int right;
+
+        parser->p += 3;
+        right = parse_factor(parser);
+        node = (right >= 0) ? rules_node(parser, RULE_AND, node, right) : -1;
+    }
+
+    return(node);
+}
+
+/* expression := term ("or" term)* */
+static int parse_expression(struct rule_parser* parser)
+{
+    int node = parse_term(parser);
+
+    while( (node >= 0) && rules_next_is(parser, "or") )
+    {
+        int right;
+
+        parser->p += 2;
+        right = parse_term(parser);
+        node = (right >= 0) ? rules_node(parser, RULE_OR, node, right) : -1;
+    }
+
+    return(node);
+}
+
+/* Compile one rule and add it to the set: an address must match all of them.
+ * Rules that are empty or only hold a "#" comment are ignored.
+ * On failure the set is left as it was,
+ * and the error message is written to the error buffer.
+ */
+int rules_add(struct rule_set* rules, const char* text, char* error, size_t error_size)
+{
+    struct rule_parser parser;
+    size_t node_count = rules->node_count;
+    size_t prefix_count = rules->prefix_count;
+    int node;
+
+    parser.rules = rules;
+    parser.p = text;
+    parser.depth = 0;
+    parser.error = error;
+    parser.error_size = error_size;
+    error[0] = '\0';
+
+    if( rules_peek(&parser) == 0 )
+    {
+        return(RESULT_SUCCESS);
+    }
+
+    node = parse_expression(&parser);
+    if( (node >= 0) && (rules_peek(&parser) != 0) )
+    {
+        snprintf(error, error_size, "unexpected \"%.*s\"",
+                 (int)((rules_peek(&parser) < RULES_WORD_MAX) ? rules_peek(&parser) : RULES_WORD_MAX), parser.p);
+        node = -1;
+    }
+    if( node >= 0 )
+    {
+        node = (rules->root == 0) ? node : rules_node(&parser, RULE_AND, rules->root, node);
+    }
+    if( node < 0 )
+    {
+        /* Drop the nodes of the partly compiled rule */
+        rules->node_count = node_count;
+        rules->prefix_count = prefix_count;
+        return(RESULT_FAILURE);
+    }
+
+    rules->root = (uint16_t)node;
+
+    return(RESULT_SUCCESS);
+}
+
+/* Compile a rule file, one rule per line */
+int rules_load(struct rule_set* rules, FILE* rules_file, const char* rules_name)
+{
+    int result = RESULT_SUCCESS;
+    char error[RULES_ERROR_SIZE];
+    char* line = NULL;
+    size_t line_size = 0;
+    size_t line_number = 0;
+
+    while( getline(&line, &line_size, rules_file) != -1 )
+    {
+        line_number++;
+        if( rules_add(rules, line, error, sizeof(error)) != RESULT_SUCCESS )
+        {
+            fprintf(stderr, "Error: %s line %zu: %s\n", rules_name, line_number, error);
+            result = RESULT_INT_ERROR;
+            break;
+        }
+    }
+
+    free(line);
+
+    return(result);
+}
+
+struct rule_eval {
+    const struct ipaddrcheck_ctx* ctx;
+    const struct rule_set* rules;
+    CIDR* cidr;
+    const char* address_str;
+    struct ipaddr_bin address;
+    int allow_loopback;
+    uint8_t known[RULES_MAX_NODES];     /* 0 if not evaluated yet, else result + 1 */
+};
+
+/* Is the address, regardless of its own prefix length, in the prefix? */
+static int prefix_contains(const struct ipaddr_bin* prefix, const struct ipaddr_bin* address)
+{
+    int offset = (prefix->proto == CIDR_IPV4) ? 12 : 0;
+    int bytes = prefix->pflen / 8;
+    int bits = prefix->pflen % 8;
+
+    if( address->proto != prefix->proto )
+    {
+        return(0);
+    }
+    if( memcmp(&address->addr[offset], &prefix->addr[offset], bytes) != 0 )
+    {
+        return(0);
+    }
+    if( (bits != 0) &&
+        ((address->addr[offset + bytes] ^ prefix->addr[offset + bytes]) & (uint8_t)(0xFF << (8 - bits))) )
+    {
+        return(0);
+    }
+
+    return(1);
+}
+
+/* Evaluate a node with short-circuit and/or, each node at most once */
+static int rule_eval(struct rule_eval* eval, uint16_t index)
+{
+    const struct rule_node* node = &eval->rules->nodes[index];
+    char reason[CHECK_REASON_SIZE(ADDRESS_SLICE_MAX)];
+    int result;
+
+    if( eval->known[index] != 0 )
+    {
+        return(eval->known[index] - 1);
+    }
+
+    switch( node->op )
+    {
+        case RULE_CHECK:
+            result = (check_address_r(eval->ctx, node->a, eval->cidr, eval->address_str,
+                                      eval->allow_loopback, reason, sizeof(reason)) == RESULT_SUCCESS);
+            break;
+        case RULE_IN:
+            result = prefix_contains(&eval->rules->prefixes[node->a], &eval->address);
+            break;
+        case RULE_NOT:
+            result = !rule_eval(eval, node->a);
+            break;
+        case RULE_AND:
+            result = rule_eval(eval, node->a) && rule_eval(eval, node->b);
+            break;
+        case RULE_OR:
+            result = rule_eval(eval, node->a) || rule_eval(eval, node->b);
+            break;
+        default:
+            result = 1;
+            break;
+    }
+
+    eval->known[index] = (uint8_t)(result + 1);
+
+    return(result);
+}
+
+/* Does the address in the first len bytes at ptr match all rules?
+ * Malformed addresses match none. The rule set is only read,
+ * so threads can share it.
+ */
+int rules_match_n(const struct ipaddrcheck_ctx* ctx, const struct rule_set* rules,
+                  const char* ptr, size_t len, int allow_loopback)
+{
+    char address_str[ADDRESS_SLICE_MAX];
+    char reason[CHECK_REASON_SIZE(ADDRESS_SLICE_MAX)];
+    struct rule_eval eval;
+    int result = RESULT_FAILURE;
+
+    if( (len >= sizeof(address_str)) || (memchr(ptr, '\0', len) != NULL) )
+    {
+        return(RESULT_FAILURE);
+    }
+    memcpy(address_str, ptr, len);
+    address_str[len] = '\0';
+
+    eval.cidr = cidr_from_str(address_str);
+    if( (check_address_format_r(ctx, eval.cidr, address_str, reason, sizeof(reason)) == RESULT_SUCCESS) &&
+        (cidr_to_ipaddr_bin(eval.cidr, &eval.address) == RESULT_SUCCESS) )
+    {
+        eval.ctx = ctx;
+        eval.rules = rules;
+        eval.address_str = address_str;
+        eval.allow_loopback = allow_loopback;
+        memset(eval.known, 0, rules->node_count);
+
+        result = rule_eval(&eval, rules->root) ? RESULT_SUCCESS : RESULT_FAILURE;
+    }
+
+    if( eval.cidr != NULL )
+    {
+        cidr_free(eval.cidr);
+    }
+
+    return(result);
+}
+
+/* Match address_str against the rules or, if it is NULL, every line
+ * of input and print "pass" or "fail" for each.
+ *
+ * Returns RESULT_SUCCESS if all addresses matched, RESULT_FAILURE if any did not,
+ * and RESULT_INT_ERROR if the results could not be written.
+ */
+int check_rules(const struct rule_set* rules, FILE* input, char* address_str, FILE* output,
+                int allow_loopback, int verbose)
+{
+    const struct ipaddrcheck_ctx* ctx = ipaddrcheck_default_ctx();
+    int result = RESULT_SUCCESS;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+
+    if( address_str != NULL )
+    {
+        result = rules_match_n(ctx, rules, address_str, strlen(address_str), allow_loopback);
+        if( (result != RESULT_SUCCESS) && verbose )
+        {
+            fprintf(stderr, "%s does not match the rules\n", address_str);
+        }
+        return(result);
+    }
+
+    while( (line_length = getline(&line, &line_size, input)) != -1 )
+    {
+        int line_result;
+
+        while( (line_length > 0) &&
+               ((line[line_length-1] == '\n') || (line[line_length-1] == '\r')) )
+        {
+            line[--line_length] = '\0';
+        }
+
+        line_result = rules_match_n(ctx, rules, line, line_length, allow_loopback);
+        if( line_result == RESULT_SUCCESS )
+        {
+            fputs(RULES_PASS_STR "\n", output);
+        }
+        else
+        {
+            fputs(RULES_FAIL_STR "\n", output);
+            if( verbose )
+            {
+                fprintf(stderr, "%s does not match the rules\n", line);
+            }
+            result = RESULT_FAILURE;
+        }
+    }
+
+    free(line);
+    if( (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        result = RESULT_INT_ERROR;
+    }
+
+    return(result);
+}
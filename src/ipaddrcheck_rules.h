@@ -0,0 +1,73 @@
+/*
+ * ipaddrcheck_rules.h: rules combining checks with and, or and not
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_RULES_H
+#define IPADDRCHECK_RULES_H
+
+#include "ipaddrcheck_functions.h"
+
+/* Node operations */
+#define RULE_TRUE    0
+#define RULE_CHECK   1    /* a is the action code of a check */
+#define RULE_IN      2    /* a is the index of a prefix */
+#define RULE_NOT     3    /* a is the operand node */
+#define RULE_AND     4    /* a and b are the operand nodes */
+#define RULE_OR      5
+
+/* Limits that keep evaluation on the stack */
+#define RULES_MAX_NODES 1024
+#define RULES_MAX_DEPTH 64
+
+/* Size of a buffer large enough for any compilation error message */
+#define RULES_ERROR_SIZE 256
+
+#define RULES_PASS_STR "pass"
+#define RULES_FAIL_STR "fail"
+
+/* Rules are compiled into a DAG of nodes, where every node only refers
+ * to nodes before it. Identical subexpressions are merged into one node,
+ * so every check and prefix is evaluated at most once per address.
+ */
+struct rule_node {
+    uint8_t op;
+    uint16_t a;
+    uint16_t b;
+};
+
+struct rule_set {
+    struct rule_node nodes[RULES_MAX_NODES];
+    size_t node_count;
+    struct ipaddr_bin* prefixes;
+    size_t prefix_count;
+    size_t prefix_size;
+    uint16_t root;
+};
+
+void rules_init(struct rule_set* rules);
+void rules_free(struct rule_set* rules);
+int rules_add(struct rule_set* rules, const char* text, char* error, size_t error_size);
+int rules_load(struct rule_set* rules, FILE* rules_file, const char* rules_name);
+int rules_match_n(const struct ipaddrcheck_ctx* ctx, const struct rule_set* rules,
+                  const char* ptr, size_t len, int allow_loopback);
+int check_rules(const struct rule_set* rules, FILE* input, char* address_str, FILE* output,
+                int allow_loopback, int verbose);
+
+#endif /* IPADDRCHECK_RULES_H */
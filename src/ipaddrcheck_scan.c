@@ -0,0 +1,492 @@
+/*
+ * ipaddrcheck_scan.c: extraction of address tokens from free text
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "ipaddrcheck_scan.h"
+#include "ipaddrcheck_actions.h"
+
+/* Vector implementations are built for x86 with GCC-compatible compilers
+   and used when the CPU supports them */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/* Classes of the bytes that can make up an address token */
+#define SCAN_DIGIT  0x01
+#define SCAN_HEX    0x02
+#define SCAN_DOT    0x04
+#define SCAN_COLON  0x08
+#define SCAN_SLASH  0x10
+#define SCAN_TOKEN  (SCAN_DIGIT | SCAN_HEX | SCAN_DOT | SCAN_COLON | SCAN_SLASH)
+
+static const unsigned char scan_byte_class[256] =
+{
+    ['0'] = SCAN_DIGIT, ['1'] = SCAN_DIGIT, ['2'] = SCAN_DIGIT, ['3'] = SCAN_DIGIT,
+    ['4'] = SCAN_DIGIT, ['5'] = SCAN_DIGIT, ['6'] = SCAN_DIGIT, ['7'] = SCAN_DIGIT,
+    ['8'] = SCAN_DIGIT, ['9'] = SCAN_DIGIT,
+    ['a'] = SCAN_HEX, ['b'] = SCAN_HEX, ['c'] = SCAN_HEX,
+    ['d'] = SCAN_HEX, ['e'] = SCAN_HEX, ['f'] = SCAN_HEX,
+    ['A'] = SCAN_HEX, ['B'] = SCAN_HEX, ['C'] = SCAN_HEX,
+    ['D'] = SCAN_HEX, ['E'] = SCAN_HEX, ['F'] = SCAN_HEX,
+    ['.'] = SCAN_DOT, [':'] = SCAN_COLON, ['/'] = SCAN_SLASH
+};
+
+#define SCAN_CLASS(c) (scan_byte_class[(unsigned char)(c)])
+
+/* Word-at-a-time search, see "Determine if a word has a byte equal to n"
+   in Bit Twiddling Hacks */
+#define SCAN_ONES               0x0101010101010101ULL
+#define SCAN_HIGHS              0x8080808080808080ULL
+#define SCAN_HAS_ZERO_BYTE(w)   (((w) - SCAN_ONES) & ~(w) & SCAN_HIGHS)
+#define SCAN_HAS_BYTE(w, c)     SCAN_HAS_ZERO_BYTE((w) ^ (SCAN_ONES * (unsigned char)(c)))
+
+/* Find the next byte that is either a line break or a dot or colon,
+ * one of which every address has. Text without them is skipped
+ * eight bytes at a time.
+ */
+static const char* scan_find_stop_swar(const char* p, const char* end)
+{
+    while( end - p >= 8 )
+    {
+        uint64_t word;
+
+        memcpy(&word, p, 8);
+        if( SCAN_HAS_BYTE(word, '.') | SCAN_HAS_BYTE(word, ':') | SCAN_HAS_BYTE(word, '\n') )
+        {
+            break;
+        }
+        p += 8;
+    }
+
+    while( (p < end) && (*p != '.') && (*p != ':') && (*p != '\n') )
+    {
+        p++;
+    }
+
+    return(p);
+}
+
+#ifdef SCAN_X86
+/* The same search 32 bytes at a time: a compare per stop byte,
+   and the first set bit of the mask is the position */
+__attribute__((target("avx2")))
+static const char* scan_find_stop_avx2(const char* p, const char* end)
+{
+    const __m256i dot = _mm256_set1_epi8('.');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    while( end - p >= 32 )
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)p);
+        __m256i stops = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, dot),
+                                                        _mm256_cmpeq_epi8(bytes, colon)),
+                                        _mm256_cmpeq_epi8(bytes, newline));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(stops);
+
+        if( mask != 0 )
+        {
+            return(p + __builtin_ctz(mask));
+        }
+        p += 32;
+    }
+
+    return(scan_find_stop_swar(p, end));
+}
+#endif /* SCAN_X86 */
+
+static const char* scan_find_stop(const char* p, const char* end, int impl)
+{
+#ifdef SCAN_X86
+    if( impl == SCAN_IMPL_AVX2 )
+    {
+        return(scan_find_stop_avx2(p, end));
+    }
+#else
+    (void)impl;
+#endif
+
+    return(scan_find_stop_swar(p, end));
+}
+
+/* The fastest implementation this CPU can run */
+int scan_best_impl(void)
+{
+#ifdef SCAN_X86
+    if( __builtin_cpu_supports("avx2") )
+    {
+        return(SCAN_IMPL_AVX2);
+    }
+#endif
+    return(SCAN_IMPL_SWAR);
+}
+
+/* Letters, digits and underscores: a candidate next to one
+   is part of a longer word such as "eth0.100" or "v1.2.3.4" */
+static int is_word_char(const char* text, const char* text_end, const char* p)
+{
+    unsigned char c;
+
+    if( (p < text) || (p >= text_end) )
+    {
+        return(0);
+    }
+
+    c = (unsigned char)*p;
+    return( ((c >= '0') && (c <= '9')) || (((c | 0x20) >= 'a') && ((c | 0x20) <= 'z')) || (c == '_') );
+}
+
+/* Strip punctuation around a token, such as the dot that ends a sentence
+   or the colon after a label, but keep a leading or trailing "::" */
+static void scan_trim(const char** start, const char** stop)
+{
+    while( (*start < *stop) && (SCAN_CLASS(**start) & (SCAN_DOT | SCAN_COLON | SCAN_SLASH)) &&
+           !((*stop - *start >= 2) && ((*start)[0] == ':') && ((*start)[1] == ':')) )
+    {
+        (*start)++;
+    }
+
+    while( (*start < *stop) && (SCAN_CLASS((*stop)[-1]) & (SCAN_DOT | SCAN_COLON | SCAN_SLASH)) &&
+           !((*stop - *start >= 2) && ((*stop)[-1] == ':') && ((*stop)[-2] == ':')) )
+    {
+        (*stop)--;
+    }
+}
+
+/* Dotted quad shape: digits and at least three dots, optionally followed
+   by a prefix length. Anything wrong with the numbers is left to the checks. */
+static int is_ipv4_candidate(const char* start, const char* stop)
+{
+    int dots = 0;
+
+    if( !(SCAN_CLASS(*start) & SCAN_DIGIT) )
+    {
+        return(0);
+    }
+
+    for( ; start < stop; start++ )
+    {
+        if( SCAN_CLASS(*start) & SCAN_HEX )
+        {
+            return(0);
+        }
+        if( (*start == '.') && (dots >= 0) )
+        {
+            dots++;
+        }
+        else if( *start == '/' )
+        {
+            /* Dots after the slash are not part of the address */
+            dots = (dots >= 3) ? -1 : 0;
+        }
+    }
+
+    return( (dots >= 3) || (dots == -1) );
+}
+
+/* Report the candidates in a run of token bytes.
+ *
+ * A run with a "::" or at least seven colons is an IPv6 candidate.
+ * Other runs are split at colons, which leaves times, MAC addresses
+ * and "host:port" pairs, and the parts are IPv4 candidates.
+ */
+static void scan_run(const char* text, const char* text_end, const char* line_start, uint64_t line,
+                     const char* start, const char* stop,
+                     scan_token_callback callback, void* callback_data)
+{
+    const char* p;
+    int colons = 0;
+    int double_colon = 0;
+
+    scan_trim(&start, &stop);
+
+    for( p = start; p < stop; p++ )
+    {
+        if( *p == ':' )
+        {
+            colons++;
+            if( (p + 1 < stop) && (p[1] == ':') )
+            {
+                double_colon = 1;
+            }
+        }
+    }
+
+    if( (colons >= 2) && (double_colon || (colons >= 7)) )
+    {
+        if( !is_word_char(text, text_end, start - 1) && !is_word_char(text, text_end, stop) )
+        {
+            callback(callback_data, line, start - line_start + 1, start, stop - start);
+        }
+        return;
+    }
+
+    while( start < stop )
+    {
+        const char* part_start = start;
+        const char* part_stop = start;
+
+        while( (part_stop < stop) && (*part_stop != ':') )
+        {
+            part_stop++;
+        }
+        start = part_stop + 1;
+
+        scan_trim(&part_start, &part_stop);
+        if( (part_start < part_stop) && is_ipv4_candidate(part_start, part_stop) &&
+            !is_word_char(text, text_end, part_start - 1) && !is_word_char(text, text_end, part_stop) )
+        {
+            callback(callback_data, line, part_start - line_start + 1, part_start, part_stop - part_start);
+        }
+    }
+}
+
+/* Find the address candidates in text that starts at the beginning
+ * of the given line and call the callback for each of them, searching
+ * with the given implementation, which must not be better than
+ * scan_best_impl(). Returns the line number at the end of the text.
+ */
+uint64_t scan_text_impl(const char* text, size_t length, uint64_t line,
+                        scan_token_callback callback, void* callback_data, int impl)
+{
+    const char* end = text + length;
+    const char* line_start = text;
+    const char* p = text;
+
+    while( (p = scan_find_stop(p, end, impl)) < end )
+    {
+        const char* start = p;
+        const char* stop = p + 1;
+
+        if( *p == '\n' )
+        {
+            line++;
+            line_start = ++p;
+            continue;
+        }
+
+        while( (start > line_start) && (SCAN_CLASS(start[-1]) & SCAN_TOKEN) )
+        {
+            start--;
+        }
+        while( (stop < end) && (SCAN_CLASS(*stop) & SCAN_TOKEN) )
+        {
+            stop++;
+        }
+
+        scan_run(text, end, line_start, line, start, stop, callback, callback_data);
+        p = stop;
+    }
+
+    return(line);
+}
+
+uint64_t scan_text(const char* text, size_t length, uint64_t line,
+                   scan_token_callback callback, void* callback_data)
+{
+    return(scan_text_impl(text, length, line, callback, callback_data, scan_best_impl()));
+}
+
+struct scan_state {
+    FILE* output;
+    const char* name;
+    const int* checks;
+    int check_count;
+    int allow_loopback;
+    int verbose;
+    char* reason;
+    size_t reason_size;
+    int result;
+};
+
+/* Run the checks on one token in place and print the result line */
+static void check_token(void* data, uint64_t line, uint64_t column, const char* token, size_t length)
+{
+    struct scan_state* state = data;
+    int result;
+
+    if( state->result == RESULT_INT_ERROR )
+    {
+        return;
+    }
+
+    /* Diagnostics quote the token, so the buffer grows with the longest one */
+    if( CHECK_REASON_SIZE(length) > state->reason_size )
+    {
+        state->reason_size = CHECK_REASON_SIZE(length) * 2;
+        free(state->reason);
+        state->reason = malloc(state->reason_size);
+        if( state->reason == NULL )
+        {
+            fprintf(stderr, "Error: could not allocate memory!\n");
+            state->result = RESULT_INT_ERROR;
+            return;
+        }
+    }
+
+    result = check_address_n(ipaddrcheck_default_ctx(), token, length, state->checks, state->check_count,
+                             state->allow_loopback, state->reason, state->reason_size);
+
+    if( state->name != NULL )
+    {
+        fprintf(state->output, "%s:", state->name);
+    }
+    fprintf(state->output, "%llu:%llu %.*s %s\n", (unsigned long long)line, (unsigned long long)column,
+            (int)length, token, (result == RESULT_SUCCESS) ? SCAN_PASS_STR : SCAN_FAIL_STR);
+    if( result != RESULT_SUCCESS )
+    {
+        if( state->verbose )
+        {
+            fprintf(stderr, "%s%s%llu:%llu: %s\n", (state->name != NULL) ? state->name : "",
+                    (state->name != NULL) ? ":" : "", (unsigned long long)line, (unsigned long long)column,
+                    state->reason);
+        }
+        state->result = RESULT_FAILURE;
+    }
+}
+
+/* Find every address in a text, run the checks on it
+ * and print its position and the result:
+ *
+ *   12:17 192.0.2.1/24 pass
+ *   14:9 192.0.2.256 fail
+ *
+ * Without checks, addresses are only checked to be well-formed.
+ * Returns RESULT_SUCCESS if all addresses passed, RESULT_FAILURE if any
+ * did not, and RESULT_INT_ERROR on read and write errors.
+ */
+int scan_addresses(FILE* input, FILE* output, const int* checks, int check_count,
+                   int allow_loopback, int verbose)
+{
+    struct scan_state state;
+    size_t buffer_size = SCAN_BUFFER_SIZE;
+    size_t filled = 0;
+    uint64_t line = 1;
+    char* buffer;
+
+    state.output = output;
+    state.name = NULL;
+    state.checks = checks;
+    state.check_count = check_count;
+    state.allow_loopback = allow_loopback;
+    state.verbose = verbose;
+    state.reason = NULL;
+    state.reason_size = 0;
+    state.result = RESULT_SUCCESS;
+
+    buffer = malloc(buffer_size);
+    if( buffer == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+
+    /* Whole lines are scanned, the incomplete last one is kept for the next read */
+    while( state.result != RESULT_INT_ERROR )
+    {
+        size_t count;
+        size_t complete;
+
+        if( filled == buffer_size )
+        {
+            char* larger = realloc(buffer, buffer_size * 2);
+            if( larger == NULL )
+            {
+                fprintf(stderr, "Error: could not allocate memory!\n");
+                state.result = RESULT_INT_ERROR;
+                break;
+            }
+            buffer = larger;
+            buffer_size *= 2;
+        }
+
+        count = fread(buffer + filled, 1, buffer_size - filled, input);
+        if( count == 0 )
+        {
+            if( ferror(input) )
+            {
+                fprintf(stderr, "Error: could not read input\n");
+                state.result = RESULT_INT_ERROR;
+            }
+            else
+            {
+                scan_text(buffer, filled, line, check_token, &state);
+            }
+            break;
+        }
+
+        /* The kept part has no line break, only the new bytes are searched */
+        complete = filled + count;
+        while( (complete > filled) && (buffer[complete - 1] != '\n') )
+        {
+            complete--;
+        }
+        if( complete == filled )
+        {
+            complete = 0;
+        }
+        filled += count;
+
+        if( complete > 0 )
+        {
+            line = scan_text(buffer, complete, line, check_token, &state);
+            memmove(buffer, buffer + complete, filled - complete);
+            filled -= complete;
+        }
+    }
+
+    free(buffer);
+    free(state.reason);
+    if( (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        state.result = RESULT_INT_ERROR;
+    }
+
+    return(state.result);
+}
+
+/* Check the addresses in a text that is already in memory as a whole,
+ * such as a file, and print the results like scan_addresses does,
+ * with the name of the text in front of the position:
+ *
+ *   dhcpd.leases:12:17 192.0.2.1 pass
+ */
+int scan_buffer(const char* text, size_t length, const char* name, FILE* output,
+                const int* checks, int check_count, int allow_loopback, int verbose)
+{
+    struct scan_state state;
+
+    state.output = output;
+    state.name = name;
+    state.checks = checks;
+    state.check_count = check_count;
+    state.allow_loopback = allow_loopback;
+    state.verbose = verbose;
+    state.reason = NULL;
+    state.reason_size = 0;
+    state.result = RESULT_SUCCESS;
+
+    scan_text(text, length, 1, check_token, &state);
+    free(state.reason);
+
+    return(state.result);
+}
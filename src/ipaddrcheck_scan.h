@@ -0,0 +1,53 @@
+/*
+ * ipaddrcheck_scan.h: extraction of address tokens from free text
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_SCAN_H
+#define IPADDRCHECK_SCAN_H
+
+#include "ipaddrcheck_functions.h"
+
+#define SCAN_BUFFER_SIZE 65536
+
+/* Printed after the position and the token */
+#define SCAN_PASS_STR "pass"
+#define SCAN_FAIL_STR "fail"
+
+/* Implementations of the search for the bytes every address has,
+   the best one the CPU supports is used by default */
+#define SCAN_IMPL_SWAR  0   /* 8 bytes per step in a 64-bit word */
+#define SCAN_IMPL_AVX2  1   /* 32 bytes per instruction */
+
+/* Called for every address candidate, line and column count from 1,
+   the token is not NUL-terminated */
+typedef void (*scan_token_callback)(void* data, uint64_t line, uint64_t column,
+                                    const char* token, size_t length);
+
+int scan_best_impl(void);
+uint64_t scan_text_impl(const char* text, size_t length, uint64_t line,
+                        scan_token_callback callback, void* callback_data, int impl);
+uint64_t scan_text(const char* text, size_t length, uint64_t line,
+                   scan_token_callback callback, void* callback_data);
+int scan_addresses(FILE* input, FILE* output, const int* checks, int check_count,
+                   int allow_loopback, int verbose);
+int scan_buffer(const char* text, size_t length, const char* name, FILE* output,
+                const int* checks, int check_count, int allow_loopback, int verbose);
+
+#endif /* IPADDRCHECK_SCAN_H */
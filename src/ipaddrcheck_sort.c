@@ -0,0 +1,320 @@
+/*
+ * ipaddrcheck_sort.c: numeric sorting of address lists
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "ipaddrcheck_sort.h"
+
+/* Protocol byte, 16 address bytes and prefix length byte */
+#define SORT_KEY_BYTES 18
+
+/* Output buffer size for writing sorted lists */
+#define SORT_OUTPUT_BUFFER (1 << 20)
+
+/* Byte of the sort key used by the given LSD pass,
+   passes go from the least significant byte to the most significant one. */
+static inline uint8_t sort_key_byte(const struct ipaddr_bin* key, int pass)
+{
+    if( pass == 0 )
+    {
+        return key->pflen;
+    }
+    else if( pass < SORT_KEY_BYTES - 1 )
+    {
+        return key->addr[16 - pass];
+    }
+    else
+    {
+        return key->proto;
+    }
+}
+
+/* Stable LSD radix sort of address records.
+ *
+ * Histograms of all key bytes are built in a single pass over the input,
+ * and passes where every record has the same byte value are skipped.
+ * That way lists of IPv4 addresses only pay for the bytes that actually vary.
+ *
+ * The scratch array must have room for count records.
+ * Returns RESULT_INT_ERROR if the histograms could not be allocated.
+ */
+int radix_sort_ipaddr(struct ipaddr_sort_record* records, struct ipaddr_sort_record* scratch, size_t count)
+{
+    size_t (*histograms)[256];
+    struct ipaddr_sort_record* from = records;
+    struct ipaddr_sort_record* to = scratch;
+    struct ipaddr_sort_record* tmp;
+    size_t i;
+    int pass;
+
+    if( count < 2 )
+    {
+        return(RESULT_SUCCESS);
+    }
+
+    histograms = calloc(SORT_KEY_BYTES, sizeof(*histograms));
+    if( histograms == NULL )
+    {
+        return(RESULT_INT_ERROR);
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        for( pass = 0; pass < SORT_KEY_BYTES; pass++ )
+        {
+            histograms[pass][sort_key_byte(&records[i].key, pass)]++;
+        }
+    }
+
+    for( pass = 0; pass < SORT_KEY_BYTES; pass++ )
+    {
+        size_t* histogram = histograms[pass];
+        size_t offset = 0;
+        int byte;
+
+        /* All records share this byte, the pass would not change the order */
+        if( histogram[sort_key_byte(&records[0].key, pass)] == count )
+        {
+            continue;
+        }
+
+        /* Turn counts into starting offsets */
+        for( byte = 0; byte < 256; byte++ )
+        {
+            size_t bucket_size = histogram[byte];
+            histogram[byte] = offset;
+            offset += bucket_size;
+        }
+
+        for( i = 0; i < count; i++ )
+        {
+            to[histogram[sort_key_byte(&from[i].key, pass)]++] = from[i];
+        }
+
+        tmp = from;
+        from = to;
+        to = tmp;
+    }
+
+    if( from != records )
+    {
+        memcpy(records, from, count * sizeof(*records));
+    }
+
+    free(histograms);
+
+    return(RESULT_SUCCESS);
+}
+
+/* Read addresses from input, one per line, and write them to output
+   in numeric order: IPv4 before IPv6, then by address, then by prefix length.
+
+   Lines are written either as they were or in canonical form.
+   Malformed addresses are left out, and the function returns RESULT_FAILURE
+   if there were any. Returns RESULT_INT_ERROR if the output could not be written.
+ */
+int sort_addresses(FILE* input, FILE* output, int normalize, int verbose)
+{
+    int result = RESULT_SUCCESS;
+
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+
+    /* Original text of valid lines, stored back to back with null bytes */
+    char* text = NULL;
+    size_t text_length = 0;
+    size_t text_size = 0;
+    size_t* offsets = NULL;
+
+    struct ipaddr_sort_record* records = NULL;
+    struct ipaddr_sort_record* scratch;
+    size_t count = 0;
+    size_t records_size = 0;
+    size_t i;
+
+    char* output_buffer;
+    size_t output_length = 0;
+    int write_error = 0;
+
+    while( (line_length = getline(&line, &line_size, input)) != -1 )
+    {
+        struct ipaddr_bin address;
+
+        while( (line_length > 0) &&
+               ((line[line_length-1] == '\n') || (line[line_length-1] == '\r')) )
+        {
+            line[--line_length] = '\0';
+        }
+
+        if( line_length == 0 )
+        {
+            continue;
+        }
+
+        if( str_to_ipaddr_bin(line, &address) != RESULT_SUCCESS )
+        {
+            if( verbose )
+            {
+                fprintf(stderr, "Malformed address %s\n", line);
+            }
+            result = RESULT_FAILURE;
+            continue;
+        }
+
+        /* Records refer to their lines with 32-bit numbers, and the sort
+           is only stable as long as those are distinct */
+        if( count > UINT32_MAX )
+        {
+            fprintf(stderr, "Error: more than %lu addresses to sort\n", (unsigned long)UINT32_MAX + 1);
+            free(line);
+            free(text);
+            free(records);
+            free(offsets);
+            return(RESULT_INT_ERROR);
+        }
+
+        if( count == records_size )
+        {
+            size_t new_size = records_size ? records_size * 2 : 4096;
+            struct ipaddr_sort_record* new_records = realloc(records, new_size * sizeof(*records));
+            size_t* new_offsets;
+
+            if( new_records != NULL )
+            {
+                records = new_records;
+            }
+            new_offsets = realloc(offsets, new_size * sizeof(*offsets));
+            if( new_offsets != NULL )
+            {
+                offsets = new_offsets;
+            }
+            if( (new_records == NULL) || (new_offsets == NULL) )
+            {
+                fprintf(stderr, "Error: could not allocate memory!\n");
+                free(line);
+                free(text);
+                free(records);
+                free(offsets);
+                return(RESULT_INT_ERROR);
+            }
+            records_size = new_size;
+        }
+
+        if( normalize == SORT_ORIGINAL )
+        {
+            if( text_length + line_length + 1 > text_size )
+            {
+                size_t new_size = (text_size + line_length + 1) * 2;
+                char* new_text = realloc(text, new_size);
+                if( new_text == NULL )
+                {
+                    fprintf(stderr, "Error: could not allocate memory!\n");
+                    free(line);
+                    free(text);
+                    free(records);
+                    free(offsets);
+                    return(RESULT_INT_ERROR);
+                }
+                text = new_text;
+                text_size = new_size;
+            }
+            memcpy(text + text_length, line, line_length + 1);
+            offsets[count] = text_length;
+            text_length += line_length + 1;
+        }
+
+        records[count].key = address;
+        records[count].line = (uint32_t)count;
+        count++;
+    }
+    free(line);
+
+    scratch = malloc((count ? count : 1) * sizeof(*scratch));
+    output_buffer = malloc(SORT_OUTPUT_BUFFER);
+    if( (scratch == NULL) || (output_buffer == NULL) )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free(records);
+        free(offsets);
+        free(text);
+        free(scratch);
+        free(output_buffer);
+        return(RESULT_INT_ERROR);
+    }
+
+    if( radix_sort_ipaddr(records, scratch, count) != RESULT_SUCCESS )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free(records);
+        free(offsets);
+        free(text);
+        free(scratch);
+        free(output_buffer);
+        return(RESULT_INT_ERROR);
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        /* Flush when there may not be room for another line */
+        if( output_length + IPADDR_STR_MAX + 1 > SORT_OUTPUT_BUFFER )
+        {
+            write_error |= (fwrite(output_buffer, 1, output_length, output) != output_length);
+            output_length = 0;
+        }
+
+        if( normalize == SORT_NORMALIZE )
+        {
+            output_length += ipaddr_bin_to_str(&records[i].key, output_buffer + output_length);
+        }
+        else
+        {
+            const char* original = text + offsets[records[i].line];
+            size_t original_length = strlen(original);
+
+            if( output_length + original_length + 1 > SORT_OUTPUT_BUFFER )
+            {
+                write_error |= (fwrite(output_buffer, 1, output_length, output) != output_length);
+                output_length = 0;
+            }
+
+            /* Lines longer than the buffer itself cannot pass validation,
+               so after a flush there is always room. */
+            memcpy(output_buffer + output_length, original, original_length);
+            output_length += original_length;
+        }
+        output_buffer[output_length++] = '\n';
+    }
+    write_error |= (fwrite(output_buffer, 1, output_length, output) != output_length);
+    if( write_error || (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        result = RESULT_INT_ERROR;
+    }
+
+    free(records);
+    free(scratch);
+    free(offsets);
+    free(text);
+    free(output_buffer);
+
+    return(result);
+}
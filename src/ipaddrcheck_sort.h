@@ -0,0 +1,41 @@
+/*
+ * ipaddrcheck_sort.h: numeric sorting of address lists
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_SORT_H
+#define IPADDRCHECK_SORT_H
+
+#include "ipaddrcheck_functions.h"
+
+/* Sort key: protocol, then address, then prefix length.
+   The line number refers back to the original text of the record,
+   so inputs are limited to 2^32 records. */
+struct ipaddr_sort_record {
+    struct ipaddr_bin key;
+    uint32_t line;
+};
+
+#define SORT_ORIGINAL   0
+#define SORT_NORMALIZE  1
+
+int radix_sort_ipaddr(struct ipaddr_sort_record* records, struct ipaddr_sort_record* scratch, size_t count);
+int sort_addresses(FILE* input, FILE* output, int normalize, int verbose);
+
+#endif /* IPADDRCHECK_SORT_H */
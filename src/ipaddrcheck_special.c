@@ -0,0 +1,145 @@
+/*
+ * ipaddrcheck_special.c: special-purpose address classification
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "ipaddrcheck_functions.h"
+#include "ipaddrcheck_special.h"
+
+/* Bit mask of the categories an address belongs to.
+ *
+ * Like cidr_contains(), an address with a prefix length
+ * only belongs to a category if the whole prefix is inside it,
+ * so 10.0.0.0/8 is private use but 10.0.0.0/7 is not.
+ */
+uint64_t classify_ipaddr_bin(const struct ipaddr_bin* address)
+{
+    const struct special_range* ranges;
+    size_t low = 0;
+    size_t high;
+    uint64_t categories = 0;
+    int i;
+
+    if( address->proto == CIDR_IPV4 )
+    {
+        ranges = special_ranges_ipv4;
+        high = special_ranges_ipv4_count;
+    }
+    else
+    {
+        ranges = special_ranges_ipv6;
+        high = special_ranges_ipv6_count;
+    }
+
+    /* Find the last range that starts at or before the address.
+       The first range always starts at the all-zeros address. */
+    while( high - low > 1 )
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if( memcmp(ranges[middle].start, address->addr, 16) <= 0 )
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    for( i = 0; i < ranges[low].count; i++ )
+    {
+        if( ranges[low].chain[i].pflen > address->pflen )
+        {
+            break;
+        }
+        categories |= (uint64_t)1 << ranges[low].chain[i].category;
+    }
+
+    return(categories);
+}
+
+/* Print the comma-separated categories of every input line.
+   Output lines correspond to input lines one to one. Addresses that
+   belong to no category and malformed addresses produce CLASSIFY_NONE_STR,
+   and the latter also make the function return RESULT_FAILURE.
+   Returns RESULT_INT_ERROR if the output could not be written. */
+int classify_addresses(FILE* input, FILE* output, int verbose)
+{
+    int result = RESULT_SUCCESS;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length;
+
+    while( (line_length = getline(&line, &line_size, input)) != -1 )
+    {
+        struct ipaddr_bin address;
+        uint64_t categories = 0;
+        int category;
+        int first = 1;
+
+        while( (line_length > 0) &&
+               ((line[line_length-1] == '\n') || (line[line_length-1] == '\r')) )
+        {
+            line[--line_length] = '\0';
+        }
+
+        if( str_to_ipaddr_bin(line, &address) == RESULT_SUCCESS )
+        {
+            categories = classify_ipaddr_bin(&address);
+        }
+        else
+        {
+            if( verbose )
+            {
+                fprintf(stderr, "Malformed address %s\n", line);
+            }
+            result = RESULT_FAILURE;
+        }
+
+        for( category = 0; category < SPECIAL_CATEGORY_COUNT; category++ )
+        {
+            if( categories & ((uint64_t)1 << category) )
+            {
+                if( !first )
+                {
+                    fputc(',', output);
+                }
+                fputs(special_category_names[category], output);
+                first = 0;
+            }
+        }
+        if( first )
+        {
+            fputs(CLASSIFY_NONE_STR, output);
+        }
+        fputc('\n', output);
+    }
+
+    free(line);
+    if( (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        result = RESULT_INT_ERROR;
+    }
+
+    return(result);
+}
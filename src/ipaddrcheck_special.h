@@ -0,0 +1,58 @@
+/*
+ * ipaddrcheck_special.h: special-purpose address classification
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_SPECIAL_H
+#define IPADDRCHECK_SPECIAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* Category bits, generated from the registries in data/ */
+#include "ipaddrcheck_special_registry.h"
+
+/* A range of addresses that belongs to the same set of registry entries.
+   Ranges are sorted and contiguous, every one extends to the start of the next.
+   The chain lists the entries that contain the range, shortest prefix first. */
+struct special_range {
+    uint8_t start[16];
+    uint8_t count;
+    struct {
+        uint8_t pflen;
+        uint8_t category;
+    } chain[SPECIAL_MAX_CHAIN];
+};
+
+extern const char* const special_category_names[SPECIAL_CATEGORY_COUNT];
+extern const struct special_range special_ranges_ipv4[];
+extern const size_t special_ranges_ipv4_count;
+extern const struct special_range special_ranges_ipv6[];
+extern const size_t special_ranges_ipv6_count;
+
+/* Printed for addresses that belong to no category or are malformed */
+#define CLASSIFY_NONE_STR "-"
+
+struct ipaddr_bin;
+
+uint64_t classify_ipaddr_bin(const struct ipaddr_bin* address);
+int classify_addresses(FILE* input, FILE* output, int verbose);
+
+#endif /* IPADDRCHECK_SPECIAL_H */
@@ -0,0 +1,45 @@
+/* Generated by gen_special_registry from iana-ipv4-special-registry.csv iana-ipv6-special-registry.csv ipaddrcheck-extra-ranges.csv, do not edit. */
+
+#ifndef IPADDRCHECK_SPECIAL_REGISTRY_H
+#define IPADDRCHECK_SPECIAL_REGISTRY_H
+
+#define SPECIAL_CATEGORY_COUNT 35
+#define SPECIAL_MAX_CHAIN 2
+
+#define SPECIAL_THIS_NETWORK ((uint64_t)1 << 0)
+#define SPECIAL_THIS_HOST_ON_THIS_NETWORK ((uint64_t)1 << 1)
+#define SPECIAL_PRIVATE_USE ((uint64_t)1 << 2)
+#define SPECIAL_SHARED_ADDRESS_SPACE ((uint64_t)1 << 3)
+#define SPECIAL_LOOPBACK ((uint64_t)1 << 4)
+#define SPECIAL_LINK_LOCAL ((uint64_t)1 << 5)
+#define SPECIAL_IETF_PROTOCOL_ASSIGNMENTS ((uint64_t)1 << 6)
+#define SPECIAL_IPV4_SERVICE_CONTINUITY_PREFIX ((uint64_t)1 << 7)
+#define SPECIAL_IPV4_DUMMY_ADDRESS ((uint64_t)1 << 8)
+#define SPECIAL_PORT_CONTROL_PROTOCOL_ANYCAST ((uint64_t)1 << 9)
+#define SPECIAL_TRAVERSAL_USING_RELAYS_AROUND_NAT_ANYCAST ((uint64_t)1 << 10)
+#define SPECIAL_NAT64_DNS64_DISCOVERY ((uint64_t)1 << 11)
+#define SPECIAL_DOCUMENTATION ((uint64_t)1 << 12)
+#define SPECIAL_AS112_V4 ((uint64_t)1 << 13)
+#define SPECIAL_AMT ((uint64_t)1 << 14)
+#define SPECIAL_DIRECT_DELEGATION_AS112_SERVICE ((uint64_t)1 << 15)
+#define SPECIAL_BENCHMARKING ((uint64_t)1 << 16)
+#define SPECIAL_RESERVED ((uint64_t)1 << 17)
+#define SPECIAL_LIMITED_BROADCAST ((uint64_t)1 << 18)
+#define SPECIAL_LOOPBACK_ADDRESS ((uint64_t)1 << 19)
+#define SPECIAL_UNSPECIFIED_ADDRESS ((uint64_t)1 << 20)
+#define SPECIAL_IPV4_MAPPED_ADDRESS ((uint64_t)1 << 21)
+#define SPECIAL_IPV4_IPV6_TRANSLAT ((uint64_t)1 << 22)
+#define SPECIAL_DISCARD_ONLY_ADDRESS_BLOCK ((uint64_t)1 << 23)
+#define SPECIAL_TEREDO ((uint64_t)1 << 24)
+#define SPECIAL_DNS_SD_SERVICE_REGISTRATION_PROTOCOL_ANYCAST ((uint64_t)1 << 25)
+#define SPECIAL_AS112_V6 ((uint64_t)1 << 26)
+#define SPECIAL_ORCHIDV2 ((uint64_t)1 << 27)
+#define SPECIAL_DRONE_REMOTE_ID_PROTOCOL_ENTITY_TAGS_PREFIX ((uint64_t)1 << 28)
+#define SPECIAL_6TO4 ((uint64_t)1 << 29)
+#define SPECIAL_SEGMENT_ROUTING_SIDS ((uint64_t)1 << 30)
+#define SPECIAL_UNIQUE_LOCAL ((uint64_t)1 << 31)
+#define SPECIAL_LINK_LOCAL_UNICAST ((uint64_t)1 << 32)
+#define SPECIAL_MULTICAST ((uint64_t)1 << 33)
+#define SPECIAL_LINK_LOCAL_SUBNET ((uint64_t)1 << 34)
+
+#endif /* IPADDRCHECK_SPECIAL_REGISTRY_H */
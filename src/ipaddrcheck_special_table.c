@@ -0,0 +1,134 @@
+/* Generated by gen_special_registry from iana-ipv4-special-registry.csv iana-ipv6-special-registry.csv ipaddrcheck-extra-ranges.csv, do not edit. */
+
+#include "ipaddrcheck_special.h"
+
+const char* const special_category_names[SPECIAL_CATEGORY_COUNT] = {
+    "this-network",
+    "this-host-on-this-network",
+    "private-use",
+    "shared-address-space",
+    "loopback",
+    "link-local",
+    "ietf-protocol-assignments",
+    "ipv4-service-continuity-prefix",
+    "ipv4-dummy-address",
+    "port-control-protocol-anycast",
+    "traversal-using-relays-around-nat-anycast",
+    "nat64-dns64-discovery",
+    "documentation",
+    "as112-v4",
+    "amt",
+    "direct-delegation-as112-service",
+    "benchmarking",
+    "reserved",
+    "limited-broadcast",
+    "loopback-address",
+    "unspecified-address",
+    "ipv4-mapped-address",
+    "ipv4-ipv6-translat",
+    "discard-only-address-block",
+    "teredo",
+    "dns-sd-service-registration-protocol-anycast",
+    "as112-v6",
+    "orchidv2",
+    "drone-remote-id-protocol-entity-tags-prefix",
+    "6to4",
+    "segment-routing-sids",
+    "unique-local",
+    "link-local-unicast",
+    "multicast",
+    "link-local-subnet",
+};
+
+const struct special_range special_ranges_ipv4[] = {
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 2, { { 8, 0 }, { 32, 1 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x01}, 1, { { 8, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x01,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0a,0x00,0x00,0x00}, 1, { { 8, 2 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x0b,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x64,0x40,0x00,0x00}, 1, { { 10, 3 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x64,0x80,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x7f,0x00,0x00,0x00}, 1, { { 8, 4 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x80,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xa9,0xfe,0x00,0x00}, 1, { { 16, 5 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xa9,0xff,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xac,0x10,0x00,0x00}, 1, { { 12, 2 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xac,0x20,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x00,0x00}, 2, { { 24, 6 }, { 29, 7 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x00,0x08}, 2, { { 24, 6 }, { 32, 8 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x00,0x09}, 2, { { 24, 6 }, { 32, 9 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x00,0x0a}, 2, { { 24, 6 }, { 32, 10 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x00,0x0b}, 1, { { 24, 6 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x00,0xaa}, 2, { { 24, 6 }, { 32, 11 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x00,0xab}, 2, { { 24, 6 }, { 32, 11 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x00,0xac}, 1, { { 24, 6 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x01,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x02,0x00}, 1, { { 24, 12 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x00,0x03,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x1f,0xc4,0x00}, 1, { { 24, 13 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x1f,0xc5,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x34,0xc1,0x00}, 1, { { 24, 14 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0x34,0xc2,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0xa8,0x00,0x00}, 1, { { 16, 2 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0xa9,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0xaf,0x30,0x00}, 1, { { 24, 15 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc0,0xaf,0x31,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc6,0x12,0x00,0x00}, 1, { { 15, 16 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc6,0x14,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc6,0x33,0x64,0x00}, 1, { { 24, 12 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xc6,0x33,0x65,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xcb,0x00,0x71,0x00}, 1, { { 24, 12 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xcb,0x00,0x72,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xe0,0x00,0x00,0x00}, 1, { { 4, 33 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xf0,0x00,0x00,0x00}, 1, { { 4, 17 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xff,0xff,0xff,0xff}, 2, { { 4, 17 }, { 32, 18 } } },
+};
+const size_t special_ranges_ipv4_count = 41;
+
+const struct special_range special_ranges_ipv6[] = {
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 128, 20 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x01}, 1, { { 128, 19 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x02}, 0, { { 0, 0 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xff,0xff,0x00,0x00,0x00,0x00}, 1, { { 96, 21 } } },
+    { {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x64,0xff,0x9b,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 96, 22 } } },
+    { {0x00,0x64,0xff,0x9b,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x01,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x00,0x64,0xff,0x9b,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 48, 22 } } },
+    { {0x00,0x64,0xff,0x9b,0x00,0x02,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 64, 23 } } },
+    { {0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x20,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 2, { { 23, 6 }, { 32, 24 } } },
+    { {0x20,0x01,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 23, 6 } } },
+    { {0x20,0x01,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x01}, 2, { { 23, 6 }, { 128, 9 } } },
+    { {0x20,0x01,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x02}, 2, { { 23, 6 }, { 128, 10 } } },
+    { {0x20,0x01,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x03}, 2, { { 23, 6 }, { 128, 25 } } },
+    { {0x20,0x01,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x04}, 1, { { 23, 6 } } },
+    { {0x20,0x01,0x00,0x02,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 2, { { 23, 6 }, { 48, 16 } } },
+    { {0x20,0x01,0x00,0x02,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 23, 6 } } },
+    { {0x20,0x01,0x00,0x03,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 2, { { 23, 6 }, { 32, 14 } } },
+    { {0x20,0x01,0x00,0x04,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 23, 6 } } },
+    { {0x20,0x01,0x00,0x04,0x01,0x12,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 2, { { 23, 6 }, { 48, 26 } } },
+    { {0x20,0x01,0x00,0x04,0x01,0x13,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 23, 6 } } },
+    { {0x20,0x01,0x00,0x20,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 2, { { 23, 6 }, { 28, 27 } } },
+    { {0x20,0x01,0x00,0x30,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 2, { { 23, 6 }, { 28, 28 } } },
+    { {0x20,0x01,0x00,0x40,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 23, 6 } } },
+    { {0x20,0x01,0x02,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x20,0x01,0x0d,0xb8,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 32, 12 } } },
+    { {0x20,0x01,0x0d,0xb9,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x20,0x02,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 16, 29 } } },
+    { {0x20,0x03,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x26,0x20,0x00,0x4f,0x80,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 48, 15 } } },
+    { {0x26,0x20,0x00,0x4f,0x80,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x3f,0xff,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 20, 12 } } },
+    { {0x3f,0xff,0x10,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0x5f,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 16, 30 } } },
+    { {0x5f,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0xfc,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 7, 31 } } },
+    { {0xfe,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0xfe,0x80,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 2, { { 10, 32 }, { 64, 34 } } },
+    { {0xfe,0x80,0x00,0x00,0x00,0x00,0x00,0x01,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 10, 32 } } },
+    { {0xfe,0xc0,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 0, { { 0, 0 } } },
+    { {0xff,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}, 1, { { 8, 33 } } },
+};
+const size_t special_ranges_ipv6_count = 43;
+
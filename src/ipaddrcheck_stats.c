@@ -0,0 +1,860 @@
+/*
+ * ipaddrcheck_stats.c: class counts and top prefixes of address streams
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <unistd.h>
+#include "ipaddrcheck_stats.h"
+#include "ipaddrcheck_special.h"
+
+#define STATS_SKETCH_WIDTH ((size_t)1 << STATS_SKETCH_BITS)
+#define STATS_SKETCH_MASK  (STATS_SKETCH_WIDTH - 1)
+
+/* Aggregates */
+#define STATS_KIND_IPV4    0
+#define STATS_KIND_IPV6    1
+#define STATS_KIND_COUNT   2
+
+/* A prefix that may be among the most frequent ones */
+struct stats_candidate {
+    uint64_t key;
+    uint64_t hash;
+    uint64_t count;    /* Estimated */
+    size_t slot;       /* Where it is in the index */
+};
+
+/* The most frequent prefixes seen so far: a min-heap on their estimated
+   count, and an open addressing index from prefixes to heap positions */
+struct stats_top {
+    struct stats_candidate* heap;
+    size_t count;
+    size_t capacity;
+    size_t* index;     /* Heap position plus one, 0 for empty slots */
+    size_t index_mask;
+};
+
+struct stats_sketch {
+    uint64_t* cells;   /* STATS_SKETCH_DEPTH rows of STATS_SKETCH_WIDTH counters */
+    struct stats_top top;
+};
+
+/* Everything a counting thread counts. Threads only touch their own
+   counters, they are added up at the end. */
+struct stats_counters {
+    uint64_t addresses;
+    uint64_t ipv4;
+    uint64_t ipv6;
+    uint64_t malformed;
+    uint64_t global;
+    uint64_t categories[SPECIAL_CATEGORY_COUNT];
+    struct stats_sketch sketches[STATS_KIND_COUNT];
+};
+
+/* Lines from the input, always whole ones */
+struct stats_block {
+    char* data;
+    size_t size;
+    size_t length;
+    struct stats_block* next;
+};
+
+struct stats_state {
+    pthread_mutex_t lock;
+    pthread_cond_t queue_ready;
+    pthread_cond_t block_free;
+    struct stats_block* free_blocks;
+    struct stats_block* queue_head;
+    struct stats_block* queue_tail;
+    int reading_done;
+    struct stats_counters* inline_counters;  /* Set if there are no counting threads */
+};
+
+struct stats_worker {
+    struct stats_state* state;
+    struct stats_counters counters;
+    pthread_t thread;
+};
+
+/* The splitmix64 finalizer, prefixes that differ in a single bit
+   get unrelated hashes */
+static uint64_t stats_hash(uint64_t key)
+{
+    key += 0x9e3779b97f4a7c15ULL;
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return(key ^ (key >> 31));
+}
+
+/* Every row of the sketch takes its own bits of the hash */
+static uint64_t* sketch_cell(uint64_t* cells, uint64_t hash, int row)
+{
+    return(&cells[row * STATS_SKETCH_WIDTH + ((hash >> (row * STATS_SKETCH_BITS)) & STATS_SKETCH_MASK)]);
+}
+
+static uint64_t sketch_estimate(uint64_t* cells, uint64_t hash)
+{
+    uint64_t estimate = UINT64_MAX;
+    int row;
+
+    for( row = 0; row < STATS_SKETCH_DEPTH; row++ )
+    {
+        uint64_t value = *sketch_cell(cells, hash, row);
+        if( value < estimate )
+        {
+            estimate = value;
+        }
+    }
+
+    return(estimate);
+}
+
+/* Count one more occurrence and return the new estimate. This is the
+   conservative update: counters that already exceed the estimate are
+   left alone, which keeps the overestimates from collisions smaller. */
+static uint64_t sketch_add(uint64_t* cells, uint64_t hash)
+{
+    uint64_t* row_cells[STATS_SKETCH_DEPTH];
+    uint64_t estimate = UINT64_MAX;
+    int row;
+
+    for( row = 0; row < STATS_SKETCH_DEPTH; row++ )
+    {
+        row_cells[row] = sketch_cell(cells, hash, row);
+        if( *row_cells[row] < estimate )
+        {
+            estimate = *row_cells[row];
+        }
+    }
+
+    estimate++;
+    for( row = 0; row < STATS_SKETCH_DEPTH; row++ )
+    {
+        if( *row_cells[row] < estimate )
+        {
+            *row_cells[row] = estimate;
+        }
+    }
+
+    return(estimate);
+}
+
+static size_t top_home(const struct stats_top* top, uint64_t hash)
+{
+    return((size_t)(hash ^ (hash >> 32)) & top->index_mask);
+}
+
+/* The index slot of a prefix, or the empty slot where it would go */
+static size_t top_slot(const struct stats_top* top, uint64_t key, uint64_t hash)
+{
+    size_t slot = top_home(top, hash);
+
+    while( (top->index[slot] != 0) && (top->heap[top->index[slot] - 1].key != key) )
+    {
+        slot = (slot + 1) & top->index_mask;
+    }
+
+    return(slot);
+}
+
+/* Empty a slot of the index. Later entries of the same probe sequence
+   move back into the hole, so lookups never need to skip over it. */
+static void top_unindex(struct stats_top* top, size_t slot)
+{
+    size_t next = slot;
+
+    top->index[slot] = 0;
+    while( 1 )
+    {
+        size_t home;
+
+        next = (next + 1) & top->index_mask;
+        if( top->index[next] == 0 )
+        {
+            break;
+        }
+
+        /* The entry can move unless its home lies between the hole and itself */
+        home = top_home(top, top->heap[top->index[next] - 1].hash);
+        if( ((next - home) & top->index_mask) >= ((next - slot) & top->index_mask) )
+        {
+            top->index[slot] = top->index[next];
+            top->heap[top->index[slot] - 1].slot = slot;
+            top->index[next] = 0;
+            slot = next;
+        }
+    }
+}
+
+static void top_place(struct stats_top* top, size_t position, const struct stats_candidate* candidate)
+{
+    top->heap[position] = *candidate;
+    top->index[candidate->slot] = position + 1;
+}
+
+static void top_sift_down(struct stats_top* top, size_t position)
+{
+    struct stats_candidate moving = top->heap[position];
+
+    while( 1 )
+    {
+        size_t child = 2 * position + 1;
+
+        if( child >= top->count )
+        {
+            break;
+        }
+        if( (child + 1 < top->count) && (top->heap[child + 1].count < top->heap[child].count) )
+        {
+            child++;
+        }
+        if( top->heap[child].count >= moving.count )
+        {
+            break;
+        }
+        top_place(top, position, &top->heap[child]);
+        position = child;
+    }
+
+    top_place(top, position, &moving);
+}
+
+static void top_sift_up(struct stats_top* top, size_t position)
+{
+    struct stats_candidate moving = top->heap[position];
+
+    while( position > 0 )
+    {
+        size_t parent = (position - 1) / 2;
+
+        if( top->heap[parent].count <= moving.count )
+        {
+            break;
+        }
+        top_place(top, position, &top->heap[parent]);
+        position = parent;
+    }
+
+    top_place(top, position, &moving);
+}
+
+/* Record the new estimate of a prefix. It becomes a candidate if there
+   is room, or if it is now more frequent than the least frequent one. */
+static void top_update(struct stats_top* top, uint64_t key, uint64_t hash, uint64_t count)
+{
+    struct stats_candidate candidate;
+    size_t slot = top_slot(top, key, hash);
+
+    if( top->index[slot] != 0 )
+    {
+        /* Estimates never shrink, so candidates only move down */
+        size_t position = top->index[slot] - 1;
+
+        top->heap[position].count = count;
+        top_sift_down(top, position);
+        return;
+    }
+
+    candidate.key = key;
+    candidate.hash = hash;
+    candidate.count = count;
+
+    if( top->count < top->capacity )
+    {
+        candidate.slot = slot;
+        top_place(top, top->count, &candidate);
+        top->count++;
+        top_sift_up(top, top->count - 1);
+    }
+    else if( count > top->heap[0].count )
+    {
+        top_unindex(top, top->heap[0].slot);
+        candidate.slot = top_slot(top, key, hash);
+        top_place(top, 0, &candidate);
+        top_sift_down(top, 0);
+    }
+}
+
+static int top_init(struct stats_top* top, size_t capacity)
+{
+    size_t index_size = 1;
+
+    while( index_size < 2 * capacity )
+    {
+        index_size *= 2;
+    }
+
+    top->heap = malloc(capacity * sizeof(struct stats_candidate));
+    top->index = calloc(index_size, sizeof(size_t));
+    top->count = 0;
+    top->capacity = capacity;
+    top->index_mask = index_size - 1;
+
+    return(((top->heap != NULL) && (top->index != NULL)) ? RESULT_SUCCESS : RESULT_INT_ERROR);
+}
+
+static void top_free(struct stats_top* top)
+{
+    free(top->heap);
+    free(top->index);
+}
+
+static int counters_init(struct stats_counters* counters, size_t candidate_count)
+{
+    int result = RESULT_SUCCESS;
+    int kind;
+
+    memset(counters, 0, sizeof(*counters));
+    for( kind = 0; kind < STATS_KIND_COUNT; kind++ )
+    {
+        struct stats_sketch* sketch = &counters->sketches[kind];
+
+        sketch->cells = calloc(STATS_SKETCH_DEPTH * STATS_SKETCH_WIDTH, sizeof(uint64_t));
+        if( (top_init(&sketch->top, candidate_count) != RESULT_SUCCESS) || (sketch->cells == NULL) )
+        {
+            result = RESULT_INT_ERROR;
+        }
+    }
+
+    return(result);
+}
+
+static void counters_free(struct stats_counters* counters)
+{
+    int kind;
+
+    for( kind = 0; kind < STATS_KIND_COUNT; kind++ )
+    {
+        free(counters->sketches[kind].cells);
+        top_free(&counters->sketches[kind].top);
+    }
+}
+
+/* Count every non-empty line of text */
+static void stats_lines(struct stats_counters* counters, const char* text, size_t length)
+{
+    const char* end = text + length;
+    const char* p = text;
+
+    while( p < end )
+    {
+        const char* line_end = memchr(p, '\n', end - p);
+        const char* stop = (line_end != NULL) ? line_end : end;
+        const char* line = p;
+        struct ipaddr_bin address;
+        struct stats_sketch* sketch;
+        uint64_t categories;
+        uint64_t key;
+        uint64_t hash;
+
+        p = (line_end != NULL) ? line_end + 1 : end;
+        if( (stop > line) && (stop[-1] == '\r') )
+        {
+            stop--;
+        }
+        if( stop == line )
+        {
+            continue;
+        }
+
+        counters->addresses++;
+        if( str_to_ipaddr_bin_n(ipaddrcheck_default_ctx(), line, stop - line, &address) != RESULT_SUCCESS )
+        {
+            counters->malformed++;
+            continue;
+        }
+
+        categories = classify_ipaddr_bin(&address);
+        if( categories == 0 )
+        {
+            counters->global++;
+        }
+        else
+        {
+            int category;
+
+            for( category = 0; category < SPECIAL_CATEGORY_COUNT; category++ )
+            {
+                if( categories & ((uint64_t)1 << category) )
+                {
+                    counters->categories[category]++;
+                }
+            }
+        }
+
+        /* Prefixes are counted towards the aggregate of their first address */
+        if( address.proto == CIDR_IPV4 )
+        {
+            counters->ipv4++;
+            sketch = &counters->sketches[STATS_KIND_IPV4];
+            key = ((uint64_t)address.addr[12] << 16) | ((uint64_t)address.addr[13] << 8) | address.addr[14];
+        }
+        else
+        {
+            int i;
+
+            counters->ipv6++;
+            sketch = &counters->sketches[STATS_KIND_IPV6];
+            key = 0;
+            for( i = 0; i < STATS_IPV6_PREFIX / 8; i++ )
+            {
+                key = (key << 8) | address.addr[i];
+            }
+        }
+
+        hash = stats_hash(key);
+        top_update(&sketch->top, key, hash, sketch_add(sketch->cells, hash));
+    }
+}
+
+static void* stats_worker(void* data)
+{
+    struct stats_worker* worker = data;
+    struct stats_state* state = worker->state;
+
+    while( 1 )
+    {
+        struct stats_block* block;
+
+        pthread_mutex_lock(&state->lock);
+        while( (state->queue_head == NULL) && !state->reading_done )
+        {
+            pthread_cond_wait(&state->queue_ready, &state->lock);
+        }
+        block = state->queue_head;
+        if( block != NULL )
+        {
+            state->queue_head = block->next;
+            if( state->queue_head == NULL )
+            {
+                state->queue_tail = NULL;
+            }
+        }
+        pthread_mutex_unlock(&state->lock);
+
+        if( block == NULL )
+        {
+            break;
+        }
+
+        stats_lines(&worker->counters, block->data, block->length);
+
+        pthread_mutex_lock(&state->lock);
+        block->next = state->free_blocks;
+        state->free_blocks = block;
+        pthread_cond_signal(&state->block_free);
+        pthread_mutex_unlock(&state->lock);
+    }
+
+    return(NULL);
+}
+
+static struct stats_block* stats_take_block(struct stats_state* state)
+{
+    struct stats_block* block;
+
+    pthread_mutex_lock(&state->lock);
+    while( state->free_blocks == NULL )
+    {
+        pthread_cond_wait(&state->block_free, &state->lock);
+    }
+    block = state->free_blocks;
+    state->free_blocks = block->next;
+    pthread_mutex_unlock(&state->lock);
+
+    return(block);
+}
+
+static void stats_queue_block(struct stats_state* state, struct stats_block* block)
+{
+    /* With a single thread, starting another one costs more than it saves:
+       glibc malloc, which the parser uses, gets slower with threads */
+    if( state->inline_counters != NULL )
+    {
+        stats_lines(state->inline_counters, block->data, block->length);
+        block->next = state->free_blocks;
+        state->free_blocks = block;
+        return;
+    }
+
+    block->next = NULL;
+    pthread_mutex_lock(&state->lock);
+    if( state->queue_tail == NULL )
+    {
+        state->queue_head = block;
+    }
+    else
+    {
+        state->queue_tail->next = block;
+    }
+    state->queue_tail = block;
+    pthread_cond_signal(&state->queue_ready);
+    pthread_mutex_unlock(&state->lock);
+}
+
+static int stats_grow_block(struct stats_block* block, size_t size)
+{
+    char* larger;
+
+    if( block->size >= size )
+    {
+        return(RESULT_SUCCESS);
+    }
+
+    larger = realloc(block->data, size);
+    if( larger == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return(RESULT_INT_ERROR);
+    }
+    block->data = larger;
+    block->size = size;
+
+    return(RESULT_SUCCESS);
+}
+
+/* Read the input in blocks of whole lines and hand them to the counting threads */
+static int stats_read(struct stats_state* state, FILE* input)
+{
+    struct stats_block* block = stats_take_block(state);
+    size_t filled = 0;
+
+    while( 1 )
+    {
+        struct stats_block* next;
+        size_t count;
+        size_t complete;
+
+        if( (filled == block->size) && (stats_grow_block(block, block->size * 2) != RESULT_SUCCESS) )
+        {
+            block->length = 0;
+            stats_queue_block(state, block);
+            return(RESULT_INT_ERROR);
+        }
+
+        count = fread(block->data + filled, 1, block->size - filled, input);
+        if( count == 0 )
+        {
+            block->length = filled;
+            stats_queue_block(state, block);
+            if( ferror(input) )
+            {
+                fprintf(stderr, "Error: could not read input\n");
+                return(RESULT_INT_ERROR);
+            }
+            return(RESULT_SUCCESS);
+        }
+
+        /* The bytes before the new ones have no line break */
+        complete = filled + count;
+        while( (complete > filled) && (block->data[complete - 1] != '\n') )
+        {
+            complete--;
+        }
+        filled += count;
+        if( complete == filled - count )
+        {
+            continue;
+        }
+
+        /* The incomplete last line starts the next block */
+        next = stats_take_block(state);
+        if( stats_grow_block(next, filled - complete) != RESULT_SUCCESS )
+        {
+            block->length = complete;
+            stats_queue_block(state, block);
+            next->length = 0;
+            stats_queue_block(state, next);
+            return(RESULT_INT_ERROR);
+        }
+        memcpy(next->data, block->data + complete, filled - complete);
+        filled -= complete;
+        block->length = complete;
+        stats_queue_block(state, block);
+        block = next;
+    }
+}
+
+static int stats_compare_candidates(const void* a, const void* b)
+{
+    const struct stats_candidate* first = a;
+    const struct stats_candidate* second = b;
+
+    if( first->count != second->count )
+    {
+        return((first->count > second->count) ? -1 : 1);
+    }
+    if( first->key != second->key )
+    {
+        return((first->key < second->key) ? -1 : 1);
+    }
+    return(0);
+}
+
+/* Add the counters of all threads to the first one and print them */
+static int stats_print(struct stats_worker* workers, int worker_count, FILE* output, size_t top_count)
+{
+    struct stats_counters* total = &workers[0].counters;
+    int category;
+    int kind;
+    int i;
+
+    for( i = 1; i < worker_count; i++ )
+    {
+        struct stats_counters* counters = &workers[i].counters;
+
+        total->addresses += counters->addresses;
+        total->ipv4 += counters->ipv4;
+        total->ipv6 += counters->ipv6;
+        total->malformed += counters->malformed;
+        total->global += counters->global;
+        for( category = 0; category < SPECIAL_CATEGORY_COUNT; category++ )
+        {
+            total->categories[category] += counters->categories[category];
+        }
+        for( kind = 0; kind < STATS_KIND_COUNT; kind++ )
+        {
+            size_t cell;
+
+            for( cell = 0; cell < STATS_SKETCH_DEPTH * STATS_SKETCH_WIDTH; cell++ )
+            {
+                total->sketches[kind].cells[cell] += counters->sketches[kind].cells[cell];
+            }
+        }
+    }
+
+    fprintf(output, "addresses %llu ipv4 %llu ipv6 %llu malformed %llu\n",
+            (unsigned long long)total->addresses, (unsigned long long)total->ipv4,
+            (unsigned long long)total->ipv6, (unsigned long long)total->malformed);
+    for( category = 0; category < SPECIAL_CATEGORY_COUNT; category++ )
+    {
+        if( total->categories[category] > 0 )
+        {
+            fprintf(output, "class %s %llu\n", special_category_names[category],
+                    (unsigned long long)total->categories[category]);
+        }
+    }
+    if( total->global > 0 )
+    {
+        fprintf(output, "class %s %llu\n", STATS_GLOBAL_STR, (unsigned long long)total->global);
+    }
+
+    /* The candidates of all threads are estimated again with the summed sketch */
+    for( kind = 0; kind < STATS_KIND_COUNT; kind++ )
+    {
+        struct stats_top top;
+        size_t j;
+
+        if( top_init(&top, top_count) != RESULT_SUCCESS )
+        {
+            top_free(&top);
+            fprintf(stderr, "Error: could not allocate memory!\n");
+            return(RESULT_INT_ERROR);
+        }
+        for( i = 0; i < worker_count; i++ )
+        {
+            struct stats_top* candidates = &workers[i].counters.sketches[kind].top;
+
+            for( j = 0; j < candidates->count; j++ )
+            {
+                top_update(&top, candidates->heap[j].key, candidates->heap[j].hash,
+                           sketch_estimate(total->sketches[kind].cells, candidates->heap[j].hash));
+            }
+        }
+
+        qsort(top.heap, top.count, sizeof(struct stats_candidate), stats_compare_candidates);
+        for( j = 0; j < top.count; j++ )
+        {
+            struct ipaddr_bin prefix;
+            char prefix_str[IPADDR_STR_MAX];
+            uint64_t key = top.heap[j].key;
+            int byte;
+
+            memset(&prefix, 0, sizeof(prefix));
+            if( kind == STATS_KIND_IPV4 )
+            {
+                prefix.proto = CIDR_IPV4;
+                prefix.pflen = STATS_IPV4_PREFIX;
+                for( byte = 14; byte >= 12; byte-- )
+                {
+                    prefix.addr[byte] = key & 0xff;
+                    key >>= 8;
+                }
+            }
+            else
+            {
+                prefix.proto = CIDR_IPV6;
+                prefix.pflen = STATS_IPV6_PREFIX;
+                for( byte = STATS_IPV6_PREFIX / 8 - 1; byte >= 0; byte-- )
+                {
+                    prefix.addr[byte] = key & 0xff;
+                    key >>= 8;
+                }
+            }
+            ipaddr_bin_to_str(&prefix, prefix_str);
+            fprintf(output, "top %s %llu\n", prefix_str, (unsigned long long)top.heap[j].count);
+        }
+        top_free(&top);
+    }
+
+    return(RESULT_SUCCESS);
+}
+
+/*
+ * Read addresses one per line and print how many there are, how many
+ * belong to each IANA special-purpose category (or to none, "global"),
+ * and the top_count most frequent IPv4 /24 and IPv6 /48 aggregates.
+ *
+ * Memory does not grow with the input: every thread counts into its own
+ * counters and count-min sketch, and keeps a heap of the prefixes with the
+ * highest estimates. The sketches are summed at the end. Category counts
+ * are exact; prefix counts are estimates that can only be too high, by at
+ * most a small fraction of the total when many prefixes collide.
+ *
+ * A thread count of 0 uses one thread per processor.
+ *
+ * Returns RESULT_SUCCESS if every line is a well-formed address,
+ * RESULT_FAILURE if some are not, and RESULT_INT_ERROR on errors.
+ */
+int address_stats(FILE* input, FILE* output, size_t top_count, int thread_count)
+{
+    struct stats_state state;
+    struct stats_worker* workers;
+    struct stats_block* blocks;
+    int block_count;
+    int started = 0;
+    int result = RESULT_SUCCESS;
+    int i;
+
+    if( thread_count <= 0 )
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (processors > 0) ? (int)processors : 1;
+    }
+    if( thread_count > STATS_MAX_THREADS )
+    {
+        thread_count = STATS_MAX_THREADS;
+    }
+
+    /* Every thread can have a block in hand and one waiting,
+       and the reading thread fills one more */
+    block_count = 2 * thread_count + 1;
+    workers = calloc(thread_count, sizeof(struct stats_worker));
+    blocks = calloc(block_count, sizeof(struct stats_block));
+    if( (workers == NULL) || (blocks == NULL) )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        free(workers);
+        free(blocks);
+        return(RESULT_INT_ERROR);
+    }
+
+    memset(&state, 0, sizeof(state));
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_cond_init(&state.queue_ready, NULL);
+    pthread_cond_init(&state.block_free, NULL);
+
+    for( i = 0; i < block_count; i++ )
+    {
+        blocks[i].data = malloc(STATS_BLOCK_SIZE);
+        blocks[i].size = STATS_BLOCK_SIZE;
+        blocks[i].next = state.free_blocks;
+        state.free_blocks = &blocks[i];
+        if( blocks[i].data == NULL )
+        {
+            result = RESULT_INT_ERROR;
+        }
+    }
+    for( i = 0; i < thread_count; i++ )
+    {
+        workers[i].state = &state;
+        if( counters_init(&workers[i].counters, top_count * STATS_CANDIDATE_FACTOR) != RESULT_SUCCESS )
+        {
+            result = RESULT_INT_ERROR;
+        }
+    }
+    if( result != RESULT_SUCCESS )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+    }
+
+    if( thread_count == 1 )
+    {
+        state.inline_counters = &workers[0].counters;
+        started = 1;
+    }
+    for( i = 0; (i < thread_count) && (result == RESULT_SUCCESS) && (state.inline_counters == NULL); i++ )
+    {
+        if( pthread_create(&workers[started].thread, NULL, stats_worker, &workers[started]) == 0 )
+        {
+            started++;
+        }
+    }
+    if( (result == RESULT_SUCCESS) && (started == 0) )
+    {
+        fprintf(stderr, "Error: could not start threads\n");
+        result = RESULT_INT_ERROR;
+    }
+
+    if( result == RESULT_SUCCESS )
+    {
+        result = stats_read(&state, input);
+    }
+
+    pthread_mutex_lock(&state.lock);
+    state.reading_done = 1;
+    pthread_cond_broadcast(&state.queue_ready);
+    pthread_mutex_unlock(&state.lock);
+    for( i = 0; (i < started) && (state.inline_counters == NULL); i++ )
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    if( result == RESULT_SUCCESS )
+    {
+        result = stats_print(workers, started, output, top_count);
+        if( (result == RESULT_SUCCESS) && (workers[0].counters.malformed > 0) )
+        {
+            result = RESULT_FAILURE;
+        }
+    }
+
+    for( i = 0; i < thread_count; i++ )
+    {
+        counters_free(&workers[i].counters);
+    }
+    for( i = 0; i < block_count; i++ )
+    {
+        free(blocks[i].data);
+    }
+    free(workers);
+    free(blocks);
+    pthread_mutex_destroy(&state.lock);
+    pthread_cond_destroy(&state.queue_ready);
+    pthread_cond_destroy(&state.block_free);
+    if( (fflush(output) != 0) || ferror(output) )
+    {
+        fprintf(stderr, "Error: could not write output\n");
+        result = RESULT_INT_ERROR;
+    }
+
+    return(result);
+}
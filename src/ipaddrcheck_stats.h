@@ -0,0 +1,53 @@
+/*
+ * ipaddrcheck_stats.h: class counts and top prefixes of address streams
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef IPADDRCHECK_STATS_H
+#define IPADDRCHECK_STATS_H
+
+#include "ipaddrcheck_functions.h"
+
+/* The input is split into blocks of whole lines for the counting threads */
+#define STATS_BLOCK_SIZE   (1024 * 1024)
+#define STATS_MAX_THREADS  16
+
+/* Prefix counts are estimated with a count-min sketch of this many rows
+   of 2^STATS_SKETCH_BITS counters. The row indices are taken from one
+   64-bit hash, so depth times bits must not exceed 64. */
+#define STATS_SKETCH_DEPTH 4
+#define STATS_SKETCH_BITS  14
+
+/* Every thread keeps this many times more top prefix candidates
+   than are printed */
+#define STATS_CANDIDATE_FACTOR 4
+
+#define STATS_DEFAULT_TOP  10
+#define STATS_MAX_TOP      10000
+
+/* Lengths of the aggregated prefixes */
+#define STATS_IPV4_PREFIX  24
+#define STATS_IPV6_PREFIX  48
+
+/* Printed for addresses that belong to no special-purpose category */
+#define STATS_GLOBAL_STR   "global"
+
+int address_stats(FILE* input, FILE* output, size_t top_count, int thread_count);
+
+#endif /* IPADDRCHECK_STATS_H */
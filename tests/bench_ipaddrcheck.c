@@ -0,0 +1,551 @@
+/*
+ * bench_ipaddrcheck.c: ipaddrcheck library benchmarks
+ *
+ * Copyright (C) 2018-2024 VyOS maintainers and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 or later as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Not run by "make check", build with "make bench_ipaddrcheck" and run
+ *   bench_ipaddrcheck [IPV4_PREFIXES] [IPV6_PREFIXES] [LOOKUPS] [FILES]
+ * Defaults approximate full BGP tables. --sort is timed on LOOKUPS lines,
+ * against "sort -V" when it is available.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include <unistd.h>
+#include "../src/ipaddrcheck_functions.h"
+#include "../src/ipaddrcheck_sort.h"
+#include "../src/ipaddrcheck_lpm4.h"
+#include "../src/ipaddrcheck_lpm6.h"
+#include "../src/ipaddrcheck_scan.h"
+#include "../src/ipaddrcheck_files.h"
+#include "../src/ipaddrcheck_special.h"
+#include "../src/ipaddrcheck_actions.h"
+#include "../src/ipaddrcheck_batch.h"
+
+#define DEFAULT_IPV4_PREFIXES 1000000
+#define DEFAULT_IPV6_PREFIXES 200000
+#define DEFAULT_LOOKUPS       10000000
+#define DEFAULT_FILES         5000
+
+/* Lines of a generated config file, a few kilobytes like a lease file */
+#define FILE_LINES 64
+
+#define BULK_SIZE 64
+
+/* Addresses classified at a time, as many as --binary reads at once */
+#define CLASSIFY_BATCH_SIZE 4096
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+/* xorshift64*, so that runs are reproducible */
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char* name, size_t operations, double seconds)
+{
+    printf("  %-28s %10.2f M/s\n", name, operations / seconds / 1e6);
+}
+
+static void report_files(const char* name, size_t files, size_t bytes, double seconds)
+{
+    printf("  %-28s %10.0f files/s %8.2f MiB/s\n", name, files / seconds, bytes / seconds / (1024 * 1024));
+}
+
+/* Prefix lengths roughly follow the shape of the IPv4 DFZ: mostly /24 */
+static int ipv4_prefix_length(void)
+{
+    uint64_t r = rng_next() % 100;
+
+    if( r < 60 ) return 24;
+    if( r < 75 ) return 22 + (int)(rng_next() % 2);
+    if( r < 95 ) return 16 + (int)(rng_next() % 6);
+    return 25 + (int)(rng_next() % 8);
+}
+
+/* And of the IPv6 DFZ: mostly /48, /32 and /44-/47 out of 2000::/3 */
+static int ipv6_prefix_length(void)
+{
+    uint64_t r = rng_next() % 100;
+
+    if( r < 45 ) return 48;
+    if( r < 65 ) return 32;
+    if( r < 85 ) return 44 + (int)(rng_next() % 4);
+    return 29 + (int)(rng_next() % 36);
+}
+
+static void bench_lpm4(size_t prefix_count, size_t lookup_count)
+{
+    struct lpm4* lpm = lpm4_create();
+    uint32_t* addresses = malloc(lookup_count * sizeof(uint32_t));
+    uint32_t* values = malloc(lookup_count * sizeof(uint32_t));
+    uint32_t checksum = 0;
+    double start;
+    size_t i;
+
+    printf("IPv4 DIR-24-8, %zu prefixes, %zu lookups\n", prefix_count, lookup_count);
+
+    start = now();
+    for( i = 0; i < prefix_count; i++ )
+    {
+        lpm4_add(lpm, (uint32_t)rng_next(), ipv4_prefix_length(), (uint32_t)(i & LPM4_MAX_VALUE));
+    }
+    printf("  build                        %10.2f s\n", now() - start);
+    printf("  memory                       %10.2f MiB (tbl24 64 MiB, %u tbl8 groups)\n",
+           (64.0 * 1024 * 1024 + (double)lpm->tbl8_used * 256 * 4) / (1024 * 1024), lpm->tbl8_used);
+
+    for( i = 0; i < lookup_count; i++ )
+    {
+        addresses[i] = (uint32_t)rng_next();
+    }
+    memset(values, 0, lookup_count * sizeof(uint32_t));
+
+    start = now();
+    for( i = 0; i < lookup_count; i++ )
+    {
+        checksum += lpm4_lookup(lpm, addresses[i]);
+    }
+    report("single lookups", lookup_count, now() - start);
+
+    start = now();
+    for( i = 0; i < lookup_count; i += BULK_SIZE )
+    {
+        size_t n = (lookup_count - i < BULK_SIZE) ? lookup_count - i : BULK_SIZE;
+        lpm4_lookup_bulk(lpm, &addresses[i], &values[i], n);
+    }
+    report("bulk lookups", lookup_count, now() - start);
+
+    for( i = 0; i < lookup_count; i++ )
+    {
+        checksum -= values[i];
+    }
+    printf("  checksum                     %10u\n", checksum);
+
+    free(addresses);
+    free(values);
+    lpm4_free(lpm);
+}
+
+static void bench_lpm6(size_t prefix_count, size_t lookup_count)
+{
+    struct ipaddr_bin* prefixes = calloc(prefix_count, sizeof(struct ipaddr_bin));
+    uint32_t* prefix_values = malloc(prefix_count * sizeof(uint32_t));
+    uint8_t (*addresses)[16] = malloc(lookup_count * 16);
+    uint32_t* values = malloc(lookup_count * sizeof(uint32_t));
+    uint32_t checksum = 0;
+    struct lpm6* lpm;
+    double start;
+    size_t i;
+    int j;
+
+    printf("IPv6 tree bitmap, %zu prefixes, %zu lookups\n", prefix_count, lookup_count);
+
+    for( i = 0; i < prefix_count; i++ )
+    {
+        uint64_t high = rng_next();
+        uint64_t low = rng_next();
+
+        prefixes[i].proto = CIDR_IPV6;
+        prefixes[i].pflen = (uint8_t)ipv6_prefix_length();
+        high = (high & 0x1FFFFFFFFFFFFFFFULL) | 0x2000000000000000ULL;
+        for( j = 0; j < 8; j++ )
+        {
+            prefixes[i].addr[j] = (uint8_t)(high >> (56 - 8 * j));
+            prefixes[i].addr[8 + j] = (uint8_t)(low >> (56 - 8 * j));
+        }
+        prefix_values[i] = (uint32_t)i;
+    }
+
+    start = now();
+    lpm = lpm6_build(prefixes, prefix_values, prefix_count);
+    printf("  build                        %10.2f s\n", now() - start);
+    printf("  memory                       %10.2f MiB (%zu nodes)\n",
+           lpm6_memory(lpm) / (1024.0 * 1024), lpm->node_count);
+
+    /* Half of the lookups hit announced space, the rest are random */
+    for( i = 0; i < lookup_count; i++ )
+    {
+        if( i & 1 )
+        {
+            memcpy(addresses[i], prefixes[rng_next() % prefix_count].addr, 16);
+            addresses[i][15] ^= (uint8_t)rng_next();
+        }
+        else
+        {
+            for( j = 0; j < 16; j++ )
+            {
+                addresses[i][j] = (uint8_t)rng_next();
+            }
+            addresses[i][0] = 0x20 | (addresses[i][0] & 0x1F);
+        }
+    }
+    memset(values, 0, lookup_count * sizeof(uint32_t));
+
+    start = now();
+    for( i = 0; i < lookup_count; i++ )
+    {
+        checksum += lpm6_lookup(lpm, addresses[i]);
+    }
+    report("single lookups", lookup_count, now() - start);
+
+    start = now();
+    for( i = 0; i < lookup_count; i += BULK_SIZE )
+    {
+        size_t n = (lookup_count - i < BULK_SIZE) ? lookup_count - i : BULK_SIZE;
+        lpm6_lookup_bulk(lpm, (const uint8_t (*)[16])&addresses[i], &values[i], n);
+    }
+    report("bulk lookups", lookup_count, now() - start);
+
+    for( i = 0; i < lookup_count; i++ )
+    {
+        checksum -= values[i];
+    }
+    printf("  checksum                     %10u\n", checksum);
+
+    free(prefixes);
+    free(prefix_values);
+    free(addresses);
+    free(values);
+    lpm6_free(lpm);
+}
+
+/* The six classifiers that are masked compares, run on the same batch of
+ * addresses again and again: through libcidr, one check at a time on
+ * binary addresses like --binary without a batch, and on the batch
+ * with every implementation the CPU supports.
+ */
+static void bench_classify(size_t lookup_count)
+{
+    static const int checks[] = {
+        IS_IPV4_MULTICAST, IS_IPV4_LOOPBACK, IS_IPV4_LINKLOCAL,
+        IS_IPV4_RFC1918, IS_IPV6_MULTICAST, IS_IPV6_LINKLOCAL
+    };
+    static const uint8_t ipv4_firsts[] = { 10, 127, 169, 172, 192, 224, 8, 100 };
+    struct ipaddr_bin* addresses = calloc(CLASSIFY_BATCH_SIZE, sizeof(struct ipaddr_bin));
+    CIDR** cidrs = calloc(CLASSIFY_BATCH_SIZE, sizeof(CIDR*));
+    uint8_t* properties = malloc(CLASSIFY_BATCH_SIZE);
+    struct ipaddr_batch batch;
+    size_t rounds = (lookup_count + CLASSIFY_BATCH_SIZE - 1) / CLASSIFY_BATCH_SIZE;
+    size_t count = rounds * CLASSIFY_BATCH_SIZE;
+    uint32_t checksum = 0;
+    double start;
+    size_t round;
+    size_t i;
+    int impl;
+    int j;
+
+    printf("Classifying %zu addresses, %d checks each\n", count, (int)(sizeof(checks) / sizeof(checks[0])));
+
+    /* Half IPv4 and half IPv6, mostly in or next to the ranges */
+    ipaddr_batch_init(&batch, CLASSIFY_BATCH_SIZE);
+    for( i = 0; i < CLASSIFY_BATCH_SIZE; i++ )
+    {
+        uint64_t r = rng_next();
+        char address_str[IPADDR_STR_MAX];
+
+        if( i & 1 )
+        {
+            addresses[i].proto = CIDR_IPV4;
+            addresses[i].pflen = 32;
+            memcpy(&addresses[i].addr[12], &r, 4);
+            addresses[i].addr[12] = ipv4_firsts[(r >> 32) % 8];
+        }
+        else
+        {
+            addresses[i].proto = CIDR_IPV6;
+            addresses[i].pflen = 128;
+            for( j = 0; j < 16; j++ )
+            {
+                addresses[i].addr[j] = (uint8_t)rng_next();
+            }
+            addresses[i].addr[0] = (r & 1) ? 0xFF : ((r & 2) ? 0xFE : 0x20);
+            if( r & 4 )
+            {
+                addresses[i].addr[1] = 0x80;
+                memset(&addresses[i].addr[2], 0, 6);
+            }
+        }
+        ipaddr_bin_to_str(&addresses[i], address_str);
+        cidrs[i] = cidr_from_str(address_str);
+        ipaddr_batch_set(&batch, i, &addresses[i]);
+    }
+    batch.count = CLASSIFY_BATCH_SIZE;
+
+    start = now();
+    for( round = 0; round < rounds; round++ )
+    {
+        for( i = 0; i < CLASSIFY_BATCH_SIZE; i++ )
+        {
+            checksum += is_ipv4_multicast(cidrs[i]) + is_ipv4_loopback(cidrs[i]) +
+                        is_ipv4_link_local(cidrs[i]) + is_ipv4_rfc1918(cidrs[i]) +
+                        is_ipv6_multicast(cidrs[i]) + is_ipv6_link_local(cidrs[i]);
+        }
+    }
+    report("libcidr, per address", count, now() - start);
+
+    start = now();
+    for( round = 0; round < rounds; round++ )
+    {
+        for( i = 0; i < CLASSIFY_BATCH_SIZE; i++ )
+        {
+            uint64_t categories = classify_ipaddr_bin(&addresses[i]);
+
+            for( j = 0; j < 6; j++ )
+            {
+                checksum -= check_ipaddr_bin_classified(checks[j], &addresses[i], categories, NO_LOOPBACK);
+            }
+        }
+    }
+    report("binary, per address", count, now() - start);
+
+    for( impl = BATCH_IMPL_SCALAR; impl <= classify_batch_best_impl(); impl++ )
+    {
+        char name[32];
+
+        start = now();
+        for( round = 0; round < rounds; round++ )
+        {
+            classify_ipaddr_batch_impl(&batch, properties, impl);
+            checksum += properties[round % CLASSIFY_BATCH_SIZE];
+        }
+        sprintf(name, "batch, %s", classify_batch_impl_name(impl));
+        report(name, count, now() - start);
+    }
+    printf("  checksum                     %10u\n", checksum);
+
+    for( i = 0; i < CLASSIFY_BATCH_SIZE; i++ )
+    {
+        cidr_free(cidrs[i]);
+    }
+    ipaddr_batch_free(&batch);
+    free(addresses);
+    free(cidrs);
+    free(properties);
+}
+
+/* Lines like those of a BGP table dump: mostly IPv4 prefixes,
+   a fifth IPv6 ones, in random order */
+static void bench_sort(size_t line_count)
+{
+    char name[] = "/tmp/bench_ipaddrcheck.XXXXXX";
+    char command[64];
+    FILE* file;
+    FILE* output = fopen("/dev/null", "w");
+    double start;
+    size_t i;
+    int fd = mkstemp(name);
+
+    if( (fd == -1) || (output == NULL) || ((file = fdopen(fd, "w+")) == NULL) )
+    {
+        fprintf(stderr, "Error: could not create the file\n");
+        return;
+    }
+
+    printf("Sorting %zu lines\n", line_count);
+
+    for( i = 0; i < line_count; i++ )
+    {
+        uint64_t address = rng_next();
+
+        if( (i % 5) == 4 )
+        {
+            fprintf(file, "2001:db8:%x:%x::/%d\n", (unsigned)(address >> 48), (unsigned)(address >> 32) & 0xFFFF,
+                    ipv6_prefix_length());
+        }
+        else
+        {
+            fprintf(file, "%u.%u.%u.0/%d\n", (unsigned)(address >> 24) & 0xFF, (unsigned)(address >> 16) & 0xFF,
+                    (unsigned)(address >> 8) & 0xFF, ipv4_prefix_length());
+        }
+    }
+
+    rewind(file);
+    start = now();
+    sort_addresses(file, output, SORT_ORIGINAL, 0);
+    report("sort_addresses", line_count, now() - start);
+
+    rewind(file);
+    start = now();
+    sort_addresses(file, output, SORT_NORMALIZE, 0);
+    report("sort_addresses, normalized", line_count, now() - start);
+
+    snprintf(command, sizeof(command), "sort -V %s > /dev/null", name);
+    start = now();
+    if( system(command) != 0 )
+    {
+        printf("  sort -V                      unavailable\n");
+    }
+    else
+    {
+        report("sort -V", line_count, now() - start);
+    }
+
+    fclose(file);
+    fclose(output);
+    remove(name);
+}
+
+static void count_scan_token(void* data, uint64_t line, uint64_t column, const char* token, size_t length)
+{
+    (*(size_t*)data)++;
+}
+
+/* Log-like text where most bytes are not part of any address:
+   one address in every line of about 140 bytes */
+static void bench_scan(size_t line_count)
+{
+    const char* words = "Oct 19 kernel audit type service started for user session opened by ";
+    size_t size = line_count * 160;
+    char* text = malloc(size);
+    size_t length = 0;
+    size_t tokens;
+    double start;
+    size_t i;
+    int impl;
+
+    if( text == NULL )
+    {
+        fprintf(stderr, "Error: could not allocate memory!\n");
+        return;
+    }
+
+    for( i = 0; i < line_count; i++ )
+    {
+        uint32_t address = (uint32_t)rng_next();
+        length += sprintf(text + length, "%s%s%u.%u.%u.%u\n", words, words + (i % 16), address >> 24,
+                          (address >> 16) & 0xFF, (address >> 8) & 0xFF, address & 0xFF);
+    }
+
+    printf("Scanning %.2f MiB of text, %zu lines\n", length / (1024.0 * 1024), line_count);
+
+    for( impl = SCAN_IMPL_SWAR; impl <= scan_best_impl(); impl++ )
+    {
+        tokens = 0;
+        start = now();
+        scan_text_impl(text, length, 1, count_scan_token, &tokens, impl);
+        printf("  %-28s %10.2f MiB/s (%zu tokens)\n", (impl == SCAN_IMPL_AVX2) ? "scan_text avx2" : "scan_text swar",
+               length / (now() - start) / (1024 * 1024), tokens);
+    }
+
+    free(text);
+}
+
+/* A directory of small files with an address on every line, scanned with
+ * one fopen and scan_addresses per file, as a shell loop would, and with
+ * scan_files reading them with pread and with io_uring.
+ *
+ * The files are in the page cache after they are written, which hides
+ * most of the difference that keeping the disk queue full makes.
+ * Run with cold caches ("echo 3 > /proc/sys/vm/drop_caches" between
+ * runs of an existing directory) to see that.
+ */
+static void bench_files(size_t file_count)
+{
+    char directory[] = "/tmp/bench_ipaddrcheck.XXXXXX";
+    char** names = calloc(file_count, sizeof(char*));
+    FILE* output = fopen("/dev/null", "w");
+    size_t bytes = 0;
+    double start;
+    size_t i;
+    int j;
+
+    if( (names == NULL) || (output == NULL) || (mkdtemp(directory) == NULL) )
+    {
+        fprintf(stderr, "Error: could not create the files\n");
+        return;
+    }
+
+    for( i = 0; i < file_count; i++ )
+    {
+        FILE* file;
+
+        names[i] = malloc(sizeof(directory) + 16);
+        sprintf(names[i], "%s/%zu.conf", directory, i);
+        file = fopen(names[i], "w");
+        for( j = 0; j < FILE_LINES; j++ )
+        {
+            uint32_t address = (uint32_t)rng_next();
+            bytes += fprintf(file, "host h%d { fixed-address %u.%u.%u.%u; }\n", j, address >> 24,
+                             (address >> 16) & 0xFF, (address >> 8) & 0xFF, address & 0xFF);
+        }
+        fclose(file);
+    }
+
+    printf("Scanning %zu files, %.2f MiB\n", file_count, bytes / (1024.0 * 1024));
+
+    start = now();
+    for( i = 0; i < file_count; i++ )
+    {
+        FILE* file = fopen(names[i], "r");
+        scan_addresses(file, output, NULL, 0, NO_LOOPBACK, 0);
+        fclose(file);
+    }
+    report_files("sequential stdio", file_count, bytes, now() - start);
+
+    start = now();
+    scan_files(names, file_count, output, NULL, 0, NO_LOOPBACK, 0, FILES_READ_PLAIN, 0);
+    report_files("pread, thread pool", file_count, bytes, now() - start);
+
+    start = now();
+    if( scan_files(names, file_count, output, NULL, 0, NO_LOOPBACK, 0, FILES_READ_URING, 0) == RESULT_INT_ERROR )
+    {
+        printf("  io_uring, thread pool        unavailable\n");
+    }
+    else
+    {
+        report_files("io_uring, thread pool", file_count, bytes, now() - start);
+    }
+
+    for( i = 0; i < file_count; i++ )
+    {
+        remove(names[i]);
+        free(names[i]);
+    }
+    remove(directory);
+    free(names);
+    fclose(output);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t ipv4_prefixes = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_IPV4_PREFIXES;
+    size_t ipv6_prefixes = (argc > 2) ? strtoul(argv[2], NULL, 10) : DEFAULT_IPV6_PREFIXES;
+    size_t lookups = (argc > 3) ? strtoul(argv[3], NULL, 10) : DEFAULT_LOOKUPS;
+    size_t files = (argc > 4) ? strtoul(argv[4], NULL, 10) : DEFAULT_FILES;
+
+    bench_lpm4(ipv4_prefixes, lookups);
+    bench_lpm6(ipv6_prefixes, lookups);
+    bench_classify(lookups);
+    bench_sort(lookups);
+    bench_scan(lookups);
+    bench_files(files);
+
+    return(EXIT_SUCCESS);
+}
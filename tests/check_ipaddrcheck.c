@@ -18,8 +18,39 @@
  *
  */
 
+#define _DEFAULT_SOURCE
+
 #include <check.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/rtnetlink.h>
 #include "../src/ipaddrcheck_functions.h"
+#include "../src/ipaddrcheck_sort.h"
+#include "../src/ipaddrcheck_lpm4.h"
+#include "../src/ipaddrcheck_lpm6.h"
+#include "../src/ipaddrcheck_special.h"
+#include "../src/ipaddrcheck_blocklist.h"
+#include "../src/ipaddrcheck_json.h"
+#include "../src/ipaddrcheck_binary.h"
+#include "../src/ipaddrcheck_actions.h"
+#include "../src/ipaddrcheck_pcap.h"
+#include "../src/ipaddrcheck_scan.h"
+#include "../src/ipaddrcheck_interval.h"
+#include "../src/ipaddrcheck_enumerate.h"
+#include "../src/ipaddrcheck_ipam.h"
+#include "../src/ipaddrcheck_reverse.h"
+#include "../src/ipaddrcheck_rules.h"
+#include "../src/ipaddrcheck_csv.h"
+#include "../src/ipaddrcheck_filter.h"
+#include "../src/ipaddrcheck_files.h"
+#include "../src/ipaddrcheck_stats.h"
+#include "../src/ipaddrcheck_distinct.h"
+#include "../src/ipaddrcheck_prefix_index.h"
+#include "../src/ipaddrcheck_batch.h"
+#include "../src/ipaddrcheck_ifaddr.h"
 
 START_TEST (test_is_valid_address)
 {
@@ -433,6 +464,1631 @@ START_TEST (test_is_ipv6_range_prefix)
 }
 END_TEST
 
+START_TEST (test_str_to_ipaddr_bin)
+{
+    struct ipaddr_bin address;
+    char buf[IPADDR_STR_MAX];
+
+    ck_assert_int_eq(str_to_ipaddr_bin("192.0.2.1/24", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(address.proto, CIDR_IPV4);
+    ck_assert_int_eq(address.pflen, 24);
+    ck_assert_int_eq(address.addr[12], 192);
+    ck_assert_int_eq(address.addr[15], 1);
+    ipaddr_bin_to_str(&address, buf);
+    ck_assert_str_eq(buf, "192.0.2.1/24");
+
+    ck_assert_int_eq(str_to_ipaddr_bin("2001:0db8::0001", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(address.proto, CIDR_IPV6);
+    ck_assert_int_eq(address.pflen, 128);
+    ipaddr_bin_to_str(&address, buf);
+    ck_assert_str_eq(buf, "2001:db8::1");
+
+    ck_assert_int_eq(str_to_ipaddr_bin("192.0.2.666", &address), RESULT_FAILURE);
+    ck_assert_int_eq(str_to_ipaddr_bin("192.0.2.1/255.255.255.0", &address), RESULT_FAILURE);
+    ck_assert_int_eq(str_to_ipaddr_bin("2001:db8::1::1", &address), RESULT_FAILURE);
+}
+END_TEST
+
+START_TEST (test_radix_sort_ipaddr)
+{
+    char* addresses[] = { "2001:db8::1", "192.0.2.10", "::1", "192.0.2.10/24", "10.0.0.1", "192.0.2.9" };
+    char* expected[] = { "10.0.0.1", "192.0.2.9", "192.0.2.10/24", "192.0.2.10", "::1", "2001:db8::1" };
+    struct ipaddr_sort_record records[6];
+    struct ipaddr_sort_record scratch[6];
+    char buf[IPADDR_STR_MAX];
+    int i;
+
+    for( i = 0; i < 6; i++ )
+    {
+        ck_assert_int_eq(str_to_ipaddr_bin(addresses[i], &records[i].key), RESULT_SUCCESS);
+        records[i].line = i;
+    }
+
+    ck_assert_int_eq(radix_sort_ipaddr(records, scratch, 6), RESULT_SUCCESS);
+
+    for( i = 0; i < 6; i++ )
+    {
+        ipaddr_bin_to_str(&records[i].key, buf);
+        ck_assert_str_eq(buf, expected[i]);
+    }
+}
+END_TEST
+
+START_TEST (test_lpm4)
+{
+    struct lpm4* lpm = lpm4_create();
+    uint32_t addresses[] = { 0x0A010280, 0x0A0102FF, 0x0A01027F, 0x0A020001, 0xC0000201 };
+    uint32_t values[5];
+
+    /* Longer prefixes first, to make sure shorter ones don't overwrite them */
+    ck_assert_int_eq(lpm4_add(lpm, 0x0A010280, 25, 3), RESULT_SUCCESS); /* 10.1.2.128/25 */
+    ck_assert_int_eq(lpm4_add(lpm, 0x0A010000, 16, 2), RESULT_SUCCESS); /* 10.1.0.0/16 */
+    ck_assert_int_eq(lpm4_add(lpm, 0x0A000000, 8, 1), RESULT_SUCCESS);  /* 10.0.0.0/8 */
+    ck_assert_int_eq(lpm4_add(lpm, 0x0A010203, 32, 4), RESULT_SUCCESS); /* 10.1.2.3/32 */
+
+    ck_assert_int_eq(lpm4_lookup(lpm, 0x0A010203), 4);
+    ck_assert_int_eq(lpm4_lookup(lpm, 0x0A010204), 2);
+
+    lpm4_lookup_bulk(lpm, addresses, values, 5);
+    ck_assert_int_eq(values[0], 3);
+    ck_assert_int_eq(values[1], 3);
+    ck_assert_int_eq(values[2], 2);
+    ck_assert_int_eq(values[3], 1);
+    ck_assert_int_eq(values[4], LPM4_NO_MATCH);
+
+    ck_assert_int_eq(lpm4_add(lpm, 0, 33, 5), RESULT_FAILURE);
+
+    lpm4_free(lpm);
+}
+END_TEST
+
+START_TEST (test_lpm6)
+{
+    char* prefix_strs[] = { "2001:db8::/32", "2001:db8:1::/48", "2001:db8:1:2::/63", "::/0", "2001:db8::1/128" };
+    char* address_strs[] = { "2001:db8:1:4::1", "2001:db8:1:2::1", "2001:db8::1", "2001:db8::2", "fe80::1" };
+    uint32_t expected[] = { 1, 2, 4, 0, 3 };
+    struct ipaddr_bin prefixes[5];
+    uint32_t prefix_values[5] = { 0, 1, 2, 3, 4 };
+    uint8_t addresses[5][16];
+    uint32_t values[5];
+    struct lpm6* lpm;
+    struct ipaddr_bin address;
+    int i;
+
+    for( i = 0; i < 5; i++ )
+    {
+        ck_assert_int_eq(str_to_ipaddr_bin(prefix_strs[i], &prefixes[i]), RESULT_SUCCESS);
+        ck_assert_int_eq(str_to_ipaddr_bin(address_strs[i], &address), RESULT_SUCCESS);
+        memcpy(addresses[i], address.addr, 16);
+    }
+
+    lpm = lpm6_build(prefixes, prefix_values, 5);
+    ck_assert_ptr_ne(lpm, NULL);
+
+    lpm6_lookup_bulk(lpm, (const uint8_t (*)[16])addresses, values, 5);
+    for( i = 0; i < 5; i++ )
+    {
+        ck_assert_int_eq(lpm6_lookup(lpm, addresses[i]), expected[i]);
+        ck_assert_int_eq(values[i], expected[i]);
+    }
+    lpm6_free(lpm);
+
+    /* Without a default route, unrelated addresses match nothing */
+    lpm = lpm6_build(prefixes, prefix_values, 3);
+    ck_assert_int_eq(lpm6_lookup(lpm, addresses[4]), LPM6_NO_MATCH);
+    lpm6_free(lpm);
+}
+END_TEST
+
+START_TEST (test_classify_ipaddr_bin)
+{
+    struct ipaddr_bin address;
+
+    ck_assert_int_eq(str_to_ipaddr_bin("100.64.0.1", &address), RESULT_SUCCESS);
+    ck_assert(classify_ipaddr_bin(&address) == SPECIAL_SHARED_ADDRESS_SPACE);
+
+    ck_assert_int_eq(str_to_ipaddr_bin("10.0.0.0/8", &address), RESULT_SUCCESS);
+    ck_assert(classify_ipaddr_bin(&address) == SPECIAL_PRIVATE_USE);
+
+    /* A prefix only belongs to a category if it is entirely inside it */
+    ck_assert_int_eq(str_to_ipaddr_bin("10.0.0.0/7", &address), RESULT_SUCCESS);
+    ck_assert(classify_ipaddr_bin(&address) == 0);
+
+    /* Nested registry entries produce several categories */
+    ck_assert_int_eq(str_to_ipaddr_bin("192.0.0.8", &address), RESULT_SUCCESS);
+    ck_assert(classify_ipaddr_bin(&address) == (SPECIAL_IETF_PROTOCOL_ASSIGNMENTS | SPECIAL_IPV4_DUMMY_ADDRESS));
+
+    ck_assert_int_eq(str_to_ipaddr_bin("192.0.2.1", &address), RESULT_SUCCESS);
+    ck_assert(classify_ipaddr_bin(&address) & SPECIAL_DOCUMENTATION);
+
+    ck_assert_int_eq(str_to_ipaddr_bin("fc00::1", &address), RESULT_SUCCESS);
+    ck_assert(classify_ipaddr_bin(&address) == SPECIAL_UNIQUE_LOCAL);
+
+    ck_assert_int_eq(str_to_ipaddr_bin("8.8.8.8", &address), RESULT_SUCCESS);
+    ck_assert(classify_ipaddr_bin(&address) == 0);
+
+    ck_assert_int_eq(str_to_ipaddr_bin("2606:4700::1", &address), RESULT_SUCCESS);
+    ck_assert(classify_ipaddr_bin(&address) == 0);
+}
+END_TEST
+
+START_TEST (test_blocklist)
+{
+    const char* blocklist_name = "check_ipaddrcheck.blocklist";
+    struct blocklist blocklist;
+    struct ipaddr_bin address;
+    FILE* hosts = tmpfile();
+    FILE* blocklist_file;
+    char address_str[IPADDR_STR_MAX];
+    int i;
+
+    fprintf(hosts, "# test hosts\n192.0.2.1\n2001:db8::1/128\n\n192.0.2.1\n");
+    for( i = 0; i < 1000; i++ )
+    {
+        fprintf(hosts, "10.0.%d.%d\n", i / 256, i % 256);
+    }
+    rewind(hosts);
+    ck_assert_int_eq(blocklist_build(hosts, "hosts", blocklist_name), RESULT_SUCCESS);
+
+    ck_assert_int_eq(blocklist_open(&blocklist, blocklist_name), RESULT_SUCCESS);
+    ck_assert(blocklist.key_count == 1002);
+
+    ck_assert_int_eq(str_to_ipaddr_bin("192.0.2.1", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(blocklist_contains(&blocklist, &address), RESULT_SUCCESS);
+    ck_assert_int_eq(str_to_ipaddr_bin("2001:db8::1", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(blocklist_contains(&blocklist, &address), RESULT_SUCCESS);
+    for( i = 0; i < 1000; i++ )
+    {
+        sprintf(address_str, "10.0.%d.%d", i / 256, i % 256);
+        ck_assert_int_eq(str_to_ipaddr_bin(address_str, &address), RESULT_SUCCESS);
+        ck_assert_int_eq(blocklist_contains(&blocklist, &address), RESULT_SUCCESS);
+    }
+
+    /* Filter false positives must not get through the exact check */
+    for( i = 1000; i < 5000; i++ )
+    {
+        sprintf(address_str, "10.%d.%d.%d", 1 + i / 65536, (i / 256) % 256, i % 256);
+        ck_assert_int_eq(str_to_ipaddr_bin(address_str, &address), RESULT_SUCCESS);
+        ck_assert_int_eq(blocklist_contains(&blocklist, &address), RESULT_FAILURE);
+    }
+    /* IPv6 address with the same low 32 bits as a blocked IPv4 one */
+    ck_assert_int_eq(str_to_ipaddr_bin("::c000:201", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(blocklist_contains(&blocklist, &address), RESULT_FAILURE);
+    blocklist_close(&blocklist);
+
+    /* Networks are not hosts */
+    rewind(hosts);
+    fprintf(hosts, "192.0.2.0/24\n");
+    rewind(hosts);
+    ck_assert_int_eq(blocklist_build(hosts, "hosts", blocklist_name), RESULT_INT_ERROR);
+    fclose(hosts);
+
+    /* Truncated files are rejected */
+    blocklist_file = fopen(blocklist_name, "w");
+    fputs("IPCBLOOM", blocklist_file);
+    fclose(blocklist_file);
+    ck_assert_int_eq(blocklist_open(&blocklist, blocklist_name), RESULT_INT_ERROR);
+
+    remove(blocklist_name);
+}
+END_TEST
+
+START_TEST (test_json_writer)
+{
+    struct json_writer* writer = malloc(sizeof(*writer));
+    FILE* output = tmpfile();
+    char result[128];
+    size_t length;
+    int i;
+
+    json_writer_init(writer, output);
+    json_write_string(writer, "a\"b\\c\n\x01");
+    json_write_raw(writer, ",", 1);
+    json_write_int(writer, 0);
+    json_write_raw(writer, ",", 1);
+    json_write_int(writer, -128);
+    ck_assert_int_eq(json_flush(writer), RESULT_SUCCESS);
+
+    rewind(output);
+    length = fread(result, 1, sizeof(result) - 1, output);
+    result[length] = '\0';
+    ck_assert_str_eq(result, "\"a\\\"b\\\\c\\n\\u0001\",0,-128");
+
+    /* Records larger than the buffer go through unchanged */
+    rewind(output);
+    for( i = 0; i < 3 * JSON_BUFFER_SIZE / 8; i++ )
+    {
+        json_write_raw(writer, "12345678", 8);
+    }
+    ck_assert_int_eq(json_flush(writer), RESULT_SUCCESS);
+    ck_assert_int_eq(ftell(output), 3 * JSON_BUFFER_SIZE);
+
+    fclose(output);
+    free(writer);
+}
+END_TEST
+
+START_TEST (test_check_ipaddr_bin)
+{
+    /* Binary checks must agree with the text ones for addresses with prefix length */
+    char* address_strs[] = { "192.0.2.1/24", "192.0.2.0/24", "192.0.2.255/24", "192.0.2.1/32", "192.0.2.0/31",
+                             "10.1.2.3/8", "127.0.0.1/8", "169.254.1.1/16", "224.0.0.1/4", "0.0.0.0/0",
+                             "0.1.2.3/8", "255.255.255.255/32", "2001:db8::1/64", "2001:db8::/64",
+                             "2001:db8::/127", "fe80::1/64", "ff02::1/16", "::1/128", "::/0" };
+    int actions[] = { IS_VALID, IS_IPV4, IS_IPV4_CIDR, IS_IPV4_HOST, IS_IPV4_NET, IS_IPV4_BROADCAST,
+                      IS_IPV4_MULTICAST, IS_IPV4_RFC1918, IS_IPV4_LOOPBACK, IS_IPV4_LINKLOCAL, IS_IPV6,
+                      IS_IPV6_CIDR, IS_IPV6_HOST, IS_IPV6_NET, IS_IPV6_MULTICAST, IS_IPV6_LINKLOCAL,
+                      IS_VALID_INTF_ADDR, IS_ANY_CIDR, IS_ANY_HOST, IS_ANY_NET };
+    char reason[256];
+    size_t i, j;
+    int allow_loopback;
+
+    for( i = 0; i < sizeof(address_strs) / sizeof(address_strs[0]); i++ )
+    {
+        CIDR* address = cidr_from_str(address_strs[i]);
+        struct ipaddr_bin address_bin;
+        struct binary_record record;
+
+        ck_assert_int_eq(str_to_ipaddr_bin(address_strs[i], &address_bin), RESULT_SUCCESS);
+        ipaddr_bin_to_binary_record(&address_bin, &record);
+        ck_assert_int_eq(binary_record_to_ipaddr_bin(&record, &address_bin), RESULT_SUCCESS);
+
+        for( j = 0; j < sizeof(actions) / sizeof(actions[0]); j++ )
+        {
+            for( allow_loopback = NO_LOOPBACK; allow_loopback <= LOOPBACK_ALLOWED; allow_loopback++ )
+            {
+                ck_assert_msg(check_ipaddr_bin(actions[j], &address_bin, allow_loopback) ==
+                              check_address(actions[j], address, address_strs[i], allow_loopback, reason, sizeof(reason)),
+                              "--%s differs for %s", action_name(actions[j]), address_strs[i]);
+            }
+        }
+        cidr_free(address);
+    }
+
+    /* Malformed records */
+    struct binary_record record;
+    struct ipaddr_bin address_bin;
+    memset(&record, 0, sizeof(record));
+    ck_assert_int_eq(binary_record_to_ipaddr_bin(&record, &address_bin), RESULT_FAILURE);
+    record.family = BINARY_FAMILY_IPV4;
+    record.pflen = 33;
+    ck_assert_int_eq(binary_record_to_ipaddr_bin(&record, &address_bin), RESULT_FAILURE);
+    record.pflen = 32;
+    record.addr[4] = 1;
+    ck_assert_int_eq(binary_record_to_ipaddr_bin(&record, &address_bin), RESULT_FAILURE);
+}
+END_TEST
+
+static void put32le(unsigned char* p, uint32_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = value >> 24;
+}
+
+/* Remembers the source address of the last IP packet and its index */
+struct pcap_walk_result {
+    uint64_t index;
+    char source[IPADDR_STR_MAX];
+    int ip_packets;
+};
+
+static void count_pcap_packet(void* data, uint64_t index,
+                              const struct ipaddr_bin* source, const struct ipaddr_bin* destination)
+{
+    struct pcap_walk_result* result = data;
+
+    result->index = index;
+    ipaddr_bin_to_str(source, result->source);
+    result->ip_packets++;
+}
+
+START_TEST (test_pcap_walk)
+{
+    /* Little endian pcapng: section header, Ethernet interface,
+       an enhanced packet block with a VLAN tagged IPv6 packet,
+       a simple packet block with an ARP packet, and one with an IPv4 packet */
+    unsigned char capture[512];
+    unsigned char packet[64];
+    size_t size = 0;
+    size_t packet_length;
+    struct pcap_stats stats;
+    struct pcap_walk_result result;
+
+    memset(capture, 0, sizeof(capture));
+    memset(&result, 0, sizeof(result));
+
+    put32le(capture, 0x0A0D0D0A);
+    put32le(capture + 4, 28);
+    put32le(capture + 8, 0x1A2B3C4D);
+    capture[12] = 1;
+    memset(capture + 16, 0xFF, 8);
+    put32le(capture + 24, 28);
+    size = 28;
+
+    put32le(capture + size, 1);
+    put32le(capture + size + 4, 20);
+    capture[size + 8] = 1;
+    put32le(capture + size + 16, 20);
+    size += 20;
+
+    memset(packet, 0, sizeof(packet));
+    packet[12] = 0x81; packet[13] = 0x00;
+    packet[16] = 0x86; packet[17] = 0xDD;
+    packet[18] = 0x60;
+    packet[18 + 8] = 0xfe; packet[18 + 9] = 0x80; packet[18 + 23] = 1;
+    packet[18 + 24] = 0xff; packet[18 + 25] = 0x02; packet[18 + 39] = 1;
+    packet_length = 18 + 40;
+    put32le(capture + size, 6);
+    put32le(capture + size + 4, 32 + 60);
+    put32le(capture + size + 20, packet_length);
+    put32le(capture + size + 24, packet_length);
+    memcpy(capture + size + 28, packet, packet_length);
+    put32le(capture + size + 28 + 60, 32 + 60);
+    size += 32 + 60;
+
+    memset(packet, 0, sizeof(packet));
+    packet[12] = 0x08; packet[13] = 0x06;
+    put32le(capture + size, 3);
+    put32le(capture + size + 4, 16 + 44);
+    put32le(capture + size + 8, 42);
+    memcpy(capture + size + 12, packet, 42);
+    put32le(capture + size + 12 + 44, 16 + 44);
+    size += 16 + 44;
+
+    memset(packet, 0, sizeof(packet));
+    packet[12] = 0x08; packet[13] = 0x00;
+    packet[14] = 0x45;
+    packet[14 + 12] = 192; packet[14 + 14] = 2; packet[14 + 15] = 1;
+    packet[14 + 16] = 198; packet[14 + 17] = 51; packet[14 + 18] = 100; packet[14 + 19] = 1;
+    put32le(capture + size, 3);
+    put32le(capture + size + 4, 16 + 36);
+    put32le(capture + size + 8, 34);
+    memcpy(capture + size + 12, packet, 34);
+    put32le(capture + size + 12 + 36, 16 + 36);
+    size += 16 + 36;
+
+    /* Without the IPv4 packet */
+    ck_assert_int_eq(pcap_walk(capture, size - 52, "test", count_pcap_packet, &result, &stats), RESULT_SUCCESS);
+    ck_assert_int_eq(result.ip_packets, 1);
+    ck_assert_str_eq(result.source, "fe80::1");
+
+    ck_assert_int_eq(pcap_walk(capture, size, "test", count_pcap_packet, &result, &stats), RESULT_SUCCESS);
+    ck_assert(stats.packets == 3);
+    ck_assert(stats.ipv4 == 1);
+    ck_assert(stats.ipv6 == 1);
+    ck_assert(stats.other == 1);
+    ck_assert(result.index == 3);
+    ck_assert_str_eq(result.source, "192.0.2.1");
+
+    ck_assert_int_eq(pcap_walk((const unsigned char*)"not a capture", 13, "test",
+                               count_pcap_packet, &result, &stats), RESULT_INT_ERROR);
+}
+END_TEST
+
+
+/* Tokens found by scan_text() as "LINE:COLUMN TOKEN" separated by commas */
+struct scan_text_result {
+    char tokens[512];
+    size_t length;
+};
+
+static void collect_scan_token(void* data, uint64_t line, uint64_t column, const char* token, size_t length)
+{
+    struct scan_text_result* result = data;
+
+    result->length += snprintf(result->tokens + result->length, sizeof(result->tokens) - result->length,
+                               "%s%d:%d %.*s", (result->length > 0) ? "," : "",
+                               (int)line, (int)column, (int)length, token);
+}
+
+START_TEST (test_scan_text)
+{
+    const char* text =
+        "interface eth0.100 v1.2.3.4\n"
+        "  address 192.0.2.1/24; gateway 192.0.2.256.\n"
+        "ntp 2001:db8::1, at 12:34:56 from 00:11:22:33:44:55\n"
+        "\n"
+        "url http://10.1.2.3:8080/index, range 10.0.0.1-10.0.0.9\n"
+        "::1";
+    const char* long_text =
+        "no addresses on this line, only a long run of words without stops\n"
+        "more words before one address at the end of a vector 198.51.100.7\n"
+        "and words after it that fill a few more vectors of plain text";
+    struct scan_text_result result;
+    int impl;
+
+    /* Every implementation this CPU runs finds the same tokens */
+    for( impl = SCAN_IMPL_SWAR; impl <= scan_best_impl(); impl++ )
+    {
+        memset(&result, 0, sizeof(result));
+        ck_assert(scan_text_impl(text, strlen(text), 1, collect_scan_token, &result, impl) == 6);
+        ck_assert_str_eq(result.tokens,
+                         "2:11 192.0.2.1/24,2:33 192.0.2.256,3:5 2001:db8::1,"
+                         "5:12 10.1.2.3,5:39 10.0.0.1,5:48 10.0.0.9,6:1 ::1");
+
+        memset(&result, 0, sizeof(result));
+        ck_assert(scan_text_impl(long_text, strlen(long_text), 1, collect_scan_token, &result, impl) == 3);
+        ck_assert_str_eq(result.tokens, "2:54 198.51.100.7");
+    }
+
+    /* Line numbers continue from the given one */
+    memset(&result, 0, sizeof(result));
+    ck_assert(scan_text("fe80::1/64 ok\n", 14, 41, collect_scan_token, &result) == 42);
+    ck_assert_str_eq(result.tokens, "41:1 fe80::1/64");
+}
+END_TEST
+
+
+static void count_interval(void* data, const struct address_interval* found)
+{
+    (*(size_t*)data)++;
+}
+
+START_TEST (test_interval_tree)
+{
+    struct address_interval interval;
+    struct address_interval query;
+    struct address_interval* intervals;
+    struct interval_tree tree;
+    char str[INTERVAL_STR_MAX];
+    char subnet_str[] = "10.1.2.3/16";
+    char ipv6_range_str[] = "2001:db8::1-2001:db8::ff";
+    char default_str[] = "::/0";
+    char range_str[] = "192.0.2.10-192.0.2.1";
+    char mixed_str[] = "192.0.2.1-2001:db8::1";
+    char prefix_range_str[] = "192.0.2.0/24-192.0.2.255";
+    uint32_t random = 12345;
+    size_t count = 1000;
+    size_t i;
+
+    ck_assert_int_eq(interval_from_str(subnet_str, &interval), RESULT_SUCCESS);
+    ck_assert(interval.is_subnet);
+    interval_to_str(&interval, str);
+    ck_assert_str_eq(str, "10.1.0.0/16");
+
+    ck_assert_int_eq(interval_from_str(ipv6_range_str, &interval), RESULT_SUCCESS);
+    ck_assert(!interval.is_subnet);
+    interval_to_str(&interval, str);
+    ck_assert_str_eq(str, "2001:db8::1-2001:db8::ff");
+
+    ck_assert_int_eq(interval_from_str(default_str, &interval), RESULT_SUCCESS);
+    ck_assert(interval.last.high == UINT64_MAX);
+    ck_assert(interval.last.low == UINT64_MAX);
+
+    ck_assert_int_eq(interval_from_str(range_str, &interval), RESULT_FAILURE);
+    ck_assert_str_eq(range_str, "192.0.2.10-192.0.2.1");
+    ck_assert_int_eq(interval_from_str(mixed_str, &interval), RESULT_FAILURE);
+    ck_assert_int_eq(interval_from_str(prefix_range_str, &interval), RESULT_FAILURE);
+
+    /* Queries must find the same intervals as a linear search */
+    intervals = malloc(count * sizeof(*intervals));
+    ck_assert(intervals != NULL);
+    for( i = 0; i < count; i++ )
+    {
+        memset(&intervals[i], 0, sizeof(intervals[i]));
+        random = random * 1103515245 + 12345;
+        intervals[i].proto = (i % 10 == 0) ? CIDR_IPV6 : CIDR_IPV4;
+        intervals[i].first.low = random % 100000;
+        random = random * 1103515245 + 12345;
+        intervals[i].last.low = intervals[i].first.low + random % 500;
+    }
+    ck_assert_int_eq(interval_tree_build(&tree, intervals, count), RESULT_SUCCESS);
+
+    memset(&query, 0, sizeof(query));
+    for( query.first.low = 0; query.first.low < 101000; query.first.low += 997 )
+    {
+        size_t found = 0;
+        size_t expected = 0;
+
+        query.proto = (query.first.low % 2) ? CIDR_IPV6 : CIDR_IPV4;
+        query.last.low = query.first.low + 300;
+        for( i = 0; i < count; i++ )
+        {
+            if( (tree.intervals[i].proto == query.proto) &&
+                (tree.intervals[i].first.low <= query.last.low) && (tree.intervals[i].last.low >= query.first.low) )
+            {
+                expected++;
+            }
+        }
+
+        ck_assert(interval_tree_query(&tree, &query, count_interval, &found) == expected);
+        ck_assert(found == expected);
+    }
+
+    interval_tree_free(&tree);
+}
+END_TEST
+
+
+START_TEST (test_format_ipv6_key)
+{
+    /* Words are mostly zero so that every kind of "::" placement comes up */
+    static const uint16_t values[4] = { 0, 0, 1, 0xffff };
+    uint32_t random = 1;
+    int n;
+
+    for( n = 0; n < 100000; n++ )
+    {
+        struct ipaddr_bin address;
+        struct interval_key key;
+        char expected[IPADDR_STR_MAX];
+        char formatted[IPADDR_STR_MAX];
+        int i;
+
+        address.proto = CIDR_IPV6;
+        address.pflen = 128;
+        for( i = 0; i < 8; i++ )
+        {
+            uint16_t word;
+
+            random = random * 1103515245 + 12345;
+            word = ((random >> 16) % 5 == 4) ? (uint16_t)(random >> 8) : values[(random >> 16) % 4];
+            address.addr[2 * i] = (uint8_t)(word >> 8);
+            address.addr[2 * i + 1] = (uint8_t)word;
+        }
+
+        interval_key_from_bin(&address, &key);
+        ck_assert_int_eq(format_ipv6_key(&key, formatted), ipaddr_bin_to_str(&address, expected));
+        ck_assert_str_eq(formatted, expected);
+    }
+}
+END_TEST
+
+
+START_TEST (test_ipam_allocate)
+{
+    struct address_interval prefix;
+    struct address_interval used;
+    struct address_interval block;
+    struct ipam_pool pool;
+    char pool_str[] = "192.0.2.0/24";
+    char used_str[] = "192.0.2.0/26";
+    char host_str[] = "192.0.2.70/32";
+    char other_str[] = "2001:db8::/64";
+    char str[INTERVAL_STR_MAX];
+    int i;
+
+    ck_assert_int_eq(interval_from_str(pool_str, &prefix), RESULT_SUCCESS);
+    ck_assert_int_eq(ipam_init(&pool, &prefix), RESULT_SUCCESS);
+
+    ck_assert_int_eq(interval_from_str(used_str, &used), RESULT_SUCCESS);
+    ck_assert_int_eq(ipam_mark_used(&pool, &used), RESULT_SUCCESS);
+    ck_assert_int_eq(interval_from_str(host_str, &used), RESULT_SUCCESS);
+    ck_assert_int_eq(ipam_mark_used(&pool, &used), RESULT_SUCCESS);
+    ck_assert_int_eq(interval_from_str(other_str, &used), RESULT_SUCCESS);
+    ck_assert_int_eq(ipam_mark_used(&pool, &used), RESULT_SUCCESS);
+
+    /* The /26 with the used host is split, the next whole one is free */
+    ck_assert_int_eq(ipam_allocate(&pool, 26, &block), RESULT_SUCCESS);
+    interval_to_str(&block, str);
+    ck_assert_str_eq(str, "192.0.2.128/26");
+
+    ck_assert_int_eq(ipam_allocate(&pool, 30, &block), RESULT_SUCCESS);
+    interval_to_str(&block, str);
+    ck_assert_str_eq(str, "192.0.2.64/30");
+
+    ck_assert_int_eq(ipam_allocate(&pool, 30, &block), RESULT_SUCCESS);
+    interval_to_str(&block, str);
+    ck_assert_str_eq(str, "192.0.2.72/30");
+
+    /* 192.0.2.68, 69, 71 and 192.0.2.76 to 192.0.2.255 are left */
+    ck_assert_int_eq(ipam_allocate(&pool, 32, &block), RESULT_SUCCESS);
+    ck_assert_int_eq(ipam_allocate(&pool, 32, &block), RESULT_SUCCESS);
+    ck_assert_int_eq(ipam_allocate(&pool, 32, &block), RESULT_SUCCESS);
+    interval_to_str(&block, str);
+    ck_assert_str_eq(str, "192.0.2.71/32");
+    for( i = 0; i < 13; i++ )
+    {
+        ck_assert_int_eq(ipam_allocate(&pool, 30, &block), RESULT_SUCCESS);
+    }
+    ck_assert_int_eq(ipam_allocate(&pool, 26, &block), RESULT_SUCCESS);
+    interval_to_str(&block, str);
+    ck_assert_str_eq(str, "192.0.2.192/26");
+    ck_assert_int_eq(ipam_allocate(&pool, 32, &block), RESULT_FAILURE);
+    ck_assert(pool.nodes[0].state == IPAM_USED);
+
+    ipam_free(&pool);
+}
+END_TEST
+
+
+START_TEST (test_ipaddr_bin_to_reverse)
+{
+    static const char* cases[][2] = {
+        { "192.0.2.1", "1.2.0.192.in-addr.arpa" },
+        { "10.100.0.255/8", "255.0.100.10.in-addr.arpa" },
+        { "192.0.2.0/24", "2.0.192.in-addr.arpa" },
+        { "0.0.0.0/0", "in-addr.arpa" },
+        { "2001:db8::1",
+          "1.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.8.b.d.0.1.0.0.2.ip6.arpa" },
+        { "2001:db8::/32", "8.b.d.0.1.0.0.2.ip6.arpa" },
+        { "2001:db8:a0::/44", "a.0.0.8.b.d.0.1.0.0.2.ip6.arpa" },
+        { "::/0", "ip6.arpa" },
+        { "192.0.2.0/25", NULL },
+        { "2001:db8::/33", NULL }
+    };
+    struct ipaddr_bin address;
+    char address_str[IPADDR_STR_MAX];
+    char name[REVERSE_NAME_MAX];
+    size_t i;
+
+    for( i = 0; i < sizeof(cases) / sizeof(cases[0]); i++ )
+    {
+        strcpy(address_str, cases[i][0]);
+        ck_assert_int_eq(str_to_ipaddr_bin(address_str, &address), RESULT_SUCCESS);
+        if( cases[i][1] == NULL )
+        {
+            ck_assert_int_eq(ipaddr_bin_to_reverse(&address, name), -1);
+        }
+        else
+        {
+            ck_assert_int_eq(ipaddr_bin_to_reverse(&address, name), (int)strlen(cases[i][1]));
+            ck_assert_str_eq(name, cases[i][1]);
+        }
+    }
+}
+END_TEST
+
+
+/* Threaded stress test of the checks, meant to be run under ThreadSanitizer
+   as well (configure --enable-thread-sanitizer) */
+#define STRESS_THREADS 8
+#define STRESS_ROUNDS 20
+#define STRESS_DIAGNOSTICS_SIZE 512
+
+static char* stress_addresses[] = {
+    "192.0.2.1", "192.0.2.0/24", "192.0.2.255/24", "192.0.2.1/31", "10.1.2.3/8",
+    "172.16.0.1/12", "127.0.0.1/8", "169.254.1.1/16", "224.0.0.1", "0.0.0.0/0",
+    "255.255.255.255/32", "2001:db8::1/64", "2001:db8::/64", "fe80::1/64", "ff02::1",
+    "::1/128", "2001:db8::1::2", "192.0.2.300", "192.0.2.01", "foo"
+};
+#define STRESS_ADDRESS_COUNT (sizeof(stress_addresses) / sizeof(stress_addresses[0]))
+
+static char* stress_ranges[] = {
+    "192.0.2.1-192.0.2.10", "192.0.2.10-192.0.2.1", "192.0.2.255-192.0.3.0", "192.0.2.1-192.0.2.300",
+    "2001:db8::1-2001:db8::ff", "2001:db8::2-2001:db8::1", "2001:db8::1-192.0.2.1", "1111111111111111111-1.1.1.1"
+};
+#define STRESS_RANGE_COUNT (sizeof(stress_ranges) / sizeof(stress_ranges[0]))
+
+static const int stress_actions[] = {
+    IS_VALID, IS_IPV4, IS_IPV4_CIDR, IS_IPV4_SINGLE, IS_IPV4_HOST, IS_IPV4_NET, IS_IPV4_BROADCAST,
+    IS_IPV4_MULTICAST, IS_IPV4_RFC1918, IS_IPV4_LOOPBACK, IS_IPV4_LINKLOCAL, IS_IPV6, IS_IPV6_CIDR,
+    IS_IPV6_SINGLE, IS_IPV6_HOST, IS_IPV6_NET, IS_IPV6_MULTICAST, IS_IPV6_LINKLOCAL, IS_VALID_INTF_ADDR,
+    IS_ANY_CIDR, IS_ANY_SINGLE, IS_ANY_HOST, IS_ANY_NET
+};
+#define STRESS_ACTION_COUNT (sizeof(stress_actions) / sizeof(stress_actions[0]))
+
+struct stress_expected {
+    int checks[STRESS_ADDRESS_COUNT][STRESS_ACTION_COUNT];
+    int ranges[STRESS_RANGE_COUNT];
+    char diagnostics[STRESS_RANGE_COUNT][STRESS_DIAGNOSTICS_SIZE];
+};
+
+struct stress_thread {
+    const struct stress_expected* expected;
+    int use_default;    /* Call the functions without the _r suffix */
+    int mismatches;
+};
+
+/* Result of one check of an address, either with a context
+   or through the functions without the _r suffix if ctx is NULL */
+static int stress_check(const struct ipaddrcheck_ctx* ctx, char* address_str, int action)
+{
+    char reason[CHECK_REASON_SIZE(32)];
+    CIDR* address = cidr_from_str(address_str);
+    int result;
+
+    if( ctx != NULL )
+    {
+        result = check_address_format_r(ctx, address, address_str, reason, sizeof(reason));
+        if( result == RESULT_SUCCESS )
+        {
+            result = check_address_r(ctx, action, address, address_str, NO_LOOPBACK,
+                                     reason, sizeof(reason));
+        }
+    }
+    else
+    {
+        result = check_address_format(address, address_str, reason, sizeof(reason));
+        if( result == RESULT_SUCCESS )
+        {
+            result = check_address(action, address, address_str, NO_LOOPBACK, reason, sizeof(reason));
+        }
+    }
+
+    if( address != NULL )
+    {
+        cidr_free(address);
+    }
+
+    return(result);
+}
+
+static int stress_range(struct ipaddrcheck_ctx* ctx, char* range_str)
+{
+    if( strchr(range_str, '.') != NULL )
+    {
+        return(is_ipv4_range_r(ctx, range_str, 0));
+    }
+    else
+    {
+        return(is_ipv6_range_r(ctx, range_str, 0));
+    }
+}
+
+static void* stress_worker(void* data)
+{
+    struct stress_thread* thread = data;
+    struct ipaddrcheck_ctx ctx;
+    char diagnostics[STRESS_DIAGNOSTICS_SIZE];
+    struct ipaddr_bin address;
+    size_t i, j;
+    int round;
+
+    if( ipaddrcheck_ctx_init(&ctx) != RESULT_SUCCESS )
+    {
+        thread->mismatches = -1;
+        return(NULL);
+    }
+
+    for( round = 0; round < STRESS_ROUNDS; round++ )
+    {
+        for( i = 0; i < STRESS_ADDRESS_COUNT; i++ )
+        {
+            for( j = 0; j < STRESS_ACTION_COUNT; j++ )
+            {
+                int result = stress_check(thread->use_default ? NULL : &ctx,
+                                          stress_addresses[i], stress_actions[j]);
+                if( result != thread->expected->checks[i][j] )
+                {
+                    thread->mismatches++;
+                }
+            }
+
+            if( str_to_ipaddr_bin_r(&ctx, stress_addresses[i], &address) !=
+                str_to_ipaddr_bin(stress_addresses[i], &address) )
+            {
+                thread->mismatches++;
+            }
+        }
+
+        for( i = 0; i < STRESS_RANGE_COUNT; i++ )
+        {
+            ipaddrcheck_ctx_set_diagnostics(&ctx, diagnostics, sizeof(diagnostics));
+            if( (stress_range(&ctx, stress_ranges[i]) != thread->expected->ranges[i]) ||
+                (strcmp(diagnostics, thread->expected->diagnostics[i]) != 0) )
+            {
+                thread->mismatches++;
+            }
+        }
+    }
+
+    ipaddrcheck_ctx_free(&ctx);
+
+    return(NULL);
+}
+
+START_TEST (test_threaded_checks)
+{
+    static struct stress_expected expected;
+    struct stress_thread threads[STRESS_THREADS];
+    pthread_t thread_ids[STRESS_THREADS];
+    struct ipaddrcheck_ctx ctx;
+    size_t i, j;
+
+    /* Expected results come from a single thread with a context of its own,
+       so that the threads also race for the initialization of the default one */
+    ck_assert_int_eq(ipaddrcheck_ctx_init(&ctx), RESULT_SUCCESS);
+    for( i = 0; i < STRESS_ADDRESS_COUNT; i++ )
+    {
+        for( j = 0; j < STRESS_ACTION_COUNT; j++ )
+        {
+            expected.checks[i][j] = stress_check(&ctx, stress_addresses[i], stress_actions[j]);
+        }
+    }
+    for( i = 0; i < STRESS_RANGE_COUNT; i++ )
+    {
+        ipaddrcheck_ctx_set_diagnostics(&ctx, expected.diagnostics[i], STRESS_DIAGNOSTICS_SIZE);
+        expected.ranges[i] = stress_range(&ctx, stress_ranges[i]);
+    }
+    ipaddrcheck_ctx_free(&ctx);
+
+    ck_assert_int_eq(expected.checks[1][4], RESULT_FAILURE);    /* 192.0.2.0/24 --is-ipv4-host */
+    ck_assert_int_eq(expected.checks[2][6], RESULT_SUCCESS);    /* 192.0.2.255/24 --is-ipv4-broadcast */
+    ck_assert_int_eq(expected.ranges[2], RESULT_SUCCESS);
+    ck_assert_str_eq(expected.diagnostics[1],
+                     "Malformed IPv4 range 192.0.2.10-192.0.2.1: its first address is greater than the last\n");
+
+    for( i = 0; i < STRESS_THREADS; i++ )
+    {
+        threads[i].expected = &expected;
+        threads[i].use_default = (int)(i % 2);
+        threads[i].mismatches = 0;
+        ck_assert_int_eq(pthread_create(&thread_ids[i], NULL, stress_worker, &threads[i]), 0);
+    }
+    for( i = 0; i < STRESS_THREADS; i++ )
+    {
+        ck_assert_int_eq(pthread_join(thread_ids[i], NULL), 0);
+        ck_assert_int_eq(threads[i].mismatches, 0);
+    }
+}
+END_TEST
+
+
+START_TEST (test_slice_checks)
+{
+    const struct ipaddrcheck_ctx* ctx = ipaddrcheck_default_ctx();
+    struct ipaddrcheck_ctx range_ctx = *ctx;
+    static const char text[] = "192.0.2.1/247 2001:db8::1::2 192.0.2.0/24 192.0.2.1-192.0.2.10,";
+    static const char with_null[] = "192.0.2.1\0/24";
+    static const int host_check[] = { IS_IPV4_HOST };
+    char reason[CHECK_REASON_SIZE(sizeof(text))];
+    struct ipaddr_bin address;
+    long page_size = sysconf(_SC_PAGESIZE);
+    char* pages;
+    char* slice;
+
+    /* Only the slice counts, not what follows it */
+    ck_assert_int_eq(is_ipv4_cidr_n(ctx, text, 12), RESULT_SUCCESS);
+    ck_assert_int_eq(is_ipv4_single_n(ctx, text, 9), RESULT_SUCCESS);
+    ck_assert_int_eq(is_any_single_n(ctx, text, 12), RESULT_FAILURE);
+    ck_assert_int_eq(str_to_ipaddr_bin_n(ctx, text, 12, &address), RESULT_SUCCESS);
+    ck_assert_int_eq(address.pflen, 24);
+    ck_assert_int_eq(str_to_ipaddr_bin_n(ctx, text, 13, &address), RESULT_FAILURE);
+
+    ck_assert_int_eq(duplicate_double_colons_n(ctx, text + 14, 11), RESULT_FAILURE);
+    ck_assert_int_eq(duplicate_double_colons_n(ctx, text + 14, 14), RESULT_SUCCESS);
+    ck_assert_int_eq(is_ipv6_single_n(ctx, text + 14, 11), RESULT_SUCCESS);
+
+    ck_assert_int_eq(check_address_n(ctx, text + 29, 12, NULL, 0, NO_LOOPBACK, reason, sizeof(reason)),
+                     RESULT_SUCCESS);
+    ck_assert_int_eq(check_address_n(ctx, text + 29, 12, host_check, 1, NO_LOOPBACK, reason, sizeof(reason)),
+                     RESULT_FAILURE);
+    ck_assert_str_eq(reason, "192.0.2.0/24 is an IPv4 network address, not a host address");
+    ck_assert_int_eq(check_address_n(ctx, with_null, sizeof(with_null) - 1, NULL, 0, NO_LOOPBACK,
+                                     reason, sizeof(reason)), RESULT_FAILURE);
+
+    ck_assert_int_eq(is_ipv4_range_n(&range_ctx, text + 42, 20, 0), RESULT_SUCCESS);
+    ck_assert_int_eq(is_ipv4_range_n(&range_ctx, text + 42, 21, 0), RESULT_FAILURE);
+
+    /* An address right before an inaccessible page */
+    pages = mmap(NULL, 2 * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ck_assert(pages != MAP_FAILED);
+    ck_assert_int_eq(mprotect(pages + page_size, page_size, PROT_NONE), 0);
+    slice = pages + page_size - 14;
+    memcpy(slice, "2001:db8::1/64", 14);
+    ck_assert_int_eq(mprotect(pages, page_size, PROT_READ), 0);
+
+    ck_assert_int_eq(is_ipv6_cidr_n(ctx, slice, 14), RESULT_SUCCESS);
+    ck_assert_int_eq(is_any_cidr_n(ctx, slice, 14), RESULT_SUCCESS);
+    ck_assert_int_eq(duplicate_double_colons_n(ctx, slice, 14), RESULT_FAILURE);
+    ck_assert_int_eq(str_to_ipaddr_bin_n(ctx, slice, 14, &address), RESULT_SUCCESS);
+    ck_assert_int_eq(check_address_n(ctx, slice, 14, NULL, 0, NO_LOOPBACK, reason, sizeof(reason)),
+                     RESULT_SUCCESS);
+    ck_assert_int_eq(is_ipv6_range_n(&range_ctx, slice, 14, 0), RESULT_FAILURE);
+
+    munmap(pages, 2 * page_size);
+}
+END_TEST
+
+
+START_TEST (test_rules)
+{
+    static struct rule_set rules;
+    const struct ipaddrcheck_ctx* ctx = ipaddrcheck_default_ctx();
+    char error[RULES_ERROR_SIZE];
+    size_t node_count;
+
+    rules_init(&rules);
+    ck_assert_int_eq(rules_match_n(ctx, &rules, "192.0.2.1", 9, NO_LOOPBACK), RESULT_SUCCESS);
+    ck_assert_int_eq(rules_match_n(ctx, &rules, "192.0.2.300", 11, NO_LOOPBACK), RESULT_FAILURE);
+
+    ck_assert_int_eq(rules_add(&rules, "  # comment only", error, sizeof(error)), RESULT_SUCCESS);
+    ck_assert_int_eq(rules_add(&rules, "is_ipv4_host and not (--is-ipv4-rfc1918 or is-ipv4-loopback)",
+                               error, sizeof(error)), RESULT_SUCCESS);
+    node_count = rules.node_count;
+
+    /* The same subexpressions in another order add only the new nodes */
+    ck_assert_int_eq(rules_add(&rules, "(is-ipv4-loopback or is-ipv4-rfc1918) and not not is-ipv4-host "
+                               "or in 198.51.100.0/24", error, sizeof(error)), RESULT_SUCCESS);
+    ck_assert_int_eq(rules.node_count, node_count + 4);
+
+    ck_assert_int_eq(rules_match_n(ctx, &rules, "198.51.100.7/24", 15, NO_LOOPBACK), RESULT_SUCCESS);
+    ck_assert_int_eq(rules_match_n(ctx, &rules, "198.51.100.0/24", 15, NO_LOOPBACK), RESULT_FAILURE);
+    ck_assert_int_eq(rules_match_n(ctx, &rules, "10.0.0.1/8", 10, NO_LOOPBACK), RESULT_FAILURE);
+    ck_assert_int_eq(rules_match_n(ctx, &rules, "192.0.2.1/24", 12, NO_LOOPBACK), RESULT_FAILURE);
+
+    ck_assert_int_eq(rules_add(&rules, "is-ipv4-host and", error, sizeof(error)), RESULT_FAILURE);
+    ck_assert_str_eq(error, "expected a check, \"in\", \"not\" or \"(\"");
+    ck_assert_int_eq(rules_add(&rules, "(is-ipv4-host", error, sizeof(error)), RESULT_FAILURE);
+    ck_assert_str_eq(error, "missing \")\"");
+    ck_assert_int_eq(rules_add(&rules, "is-ipv4-host is-ipv6", error, sizeof(error)), RESULT_FAILURE);
+    ck_assert_str_eq(error, "unexpected \"is-ipv6\"");
+    ck_assert_int_eq(rules_add(&rules, "in 192.0.2.300/24", error, sizeof(error)), RESULT_FAILURE);
+    ck_assert_str_eq(error, "\"in\" must be followed by a prefix");
+    ck_assert_int_eq(rules_add(&rules, "is-ipv5", error, sizeof(error)), RESULT_FAILURE);
+    ck_assert_str_eq(error, "unknown check \"is-ipv5\"");
+
+    /* Failed rules leave the set as it was */
+    ck_assert_int_eq(rules.node_count, node_count + 4);
+    ck_assert_int_eq(rules_match_n(ctx, &rules, "198.51.100.7/24", 15, NO_LOOPBACK), RESULT_SUCCESS);
+
+    /* IPv6 prefixes that do not end on a byte boundary */
+    ck_assert_int_eq(rules_add(&rules, "in 2001:db8:8000::/33 or is-ipv4", error, sizeof(error)), RESULT_SUCCESS);
+    ck_assert_int_eq(rules_add(&rules, "is-any-host", error, sizeof(error)), RESULT_SUCCESS);
+    rules_free(&rules);
+
+    rules_init(&rules);
+    ck_assert_int_eq(rules_add(&rules, "in 2001:db8:8000::/33 and is-any-host", error, sizeof(error)),
+                     RESULT_SUCCESS);
+    ck_assert_int_eq(rules_match_n(ctx, &rules, "2001:db8:8000::1/64", 19, NO_LOOPBACK), RESULT_SUCCESS);
+    ck_assert_int_eq(rules_match_n(ctx, &rules, "2001:db8:7fff::1/64", 19, NO_LOOPBACK), RESULT_FAILURE);
+    rules_free(&rules);
+}
+END_TEST
+
+
+START_TEST (test_check_csv)
+{
+    const int host_checks[] = { IS_ANY_HOST };
+    const char* expected = "name,\"address\",gateway\r\n\"c\nd\",\"192.0.2.0/24\",192.0.2.254\r\n"
+                           "e,2001:db8::1/64\r\n";
+    const char* annotated = "name,\"address\",gateway,\"address_result\",gateway_result\n"
+                            "\"a, \"\"b\"\"\",192.0.2.1/24,192.0.2.254,pass,pass\n"
+                            "\"c\nd\",\"192.0.2.0/24\",192.0.2.254,fail,pass\n"
+                            "e,2001:db8::1/64,pass,fail\n\"xxxxxxxx";
+    struct csv_column columns[2];
+    FILE* input = tmpfile();
+    FILE* output = tmpfile();
+    char result[256];
+    size_t length;
+    int i;
+
+    /* Quoted fields with delimiters, escapes and line breaks, CRLF line ends,
+       a short row and a field longer than the read buffer */
+    fprintf(input, "name,\"address\",gateway\r\n");
+    fprintf(input, "\"a, \"\"b\"\"\",192.0.2.1/24,192.0.2.254\r\n");
+    fprintf(input, "\"c\nd\",\"192.0.2.0/24\",192.0.2.254\r\n");
+    fprintf(input, "e,2001:db8::1/64\r\n\r\n");
+    fprintf(input, "\"");
+    for( i = 0; i < 2 * CSV_BUFFER_SIZE; i++ )
+    {
+        fputc('x', input);
+    }
+    fprintf(input, "\",10.0.0.1/8,10.0.0.256");
+
+    columns[0].name = "address";
+    columns[0].checks = host_checks;
+    columns[0].check_count = 1;
+    columns[1].name = "3";
+    columns[1].checks = NULL;
+    columns[1].check_count = 0;
+
+    rewind(input);
+    ck_assert_int_eq(check_csv(input, output, ',', CSV_HEADER, columns, 2, NO_LOOPBACK, 0), RESULT_FAILURE);
+    ck_assert_int_eq(ftell(output), strlen(expected) + 2 * CSV_BUFFER_SIZE + strlen("\"\",10.0.0.1/8,10.0.0.256\n"));
+    rewind(output);
+    length = fread(result, 1, strlen(expected), output);
+    result[length] = '\0';
+    ck_assert_str_eq(result, expected);
+    fclose(output);
+
+    output = tmpfile();
+    rewind(input);
+    ck_assert_int_eq(check_csv(input, output, ',', CSV_HEADER | CSV_ANNOTATE, columns, 2, NO_LOOPBACK, 0),
+                     RESULT_FAILURE);
+    rewind(output);
+    length = fread(result, 1, strlen(annotated), output);
+    result[length] = '\0';
+    ck_assert_str_eq(result, annotated);
+    fclose(output);
+
+    /* Named columns need a header that has them */
+    output = tmpfile();
+    rewind(input);
+    ck_assert_int_eq(check_csv(input, output, ',', 0, columns, 2, NO_LOOPBACK, 0), RESULT_INT_ERROR);
+    columns[0].name = "addr";
+    rewind(input);
+    ck_assert_int_eq(check_csv(input, output, ',', CSV_HEADER, columns, 2, NO_LOOPBACK, 0), RESULT_INT_ERROR);
+    columns[0].name = "0";
+    rewind(input);
+    ck_assert_int_eq(check_csv(input, output, ',', 0, columns, 2, NO_LOOPBACK, 0), RESULT_INT_ERROR);
+    fclose(output);
+    fclose(input);
+
+    /* Unterminated quotes are an error rather than a failed row */
+    input = tmpfile();
+    output = tmpfile();
+    fprintf(input, "192.0.2.1\t\"192.0.2.2\n");
+    rewind(input);
+    columns[0].name = "1";
+    ck_assert_int_eq(check_csv(input, output, '\t', 0, columns, 2, NO_LOOPBACK, 0), RESULT_INT_ERROR);
+    fclose(output);
+    fclose(input);
+}
+END_TEST
+
+
+START_TEST (test_filter_addresses)
+{
+    const int checks[] = { IS_IPV4, IS_ANY_HOST };
+    FILE* input = tmpfile();
+    FILE* output = tmpfile();
+    char result[128];
+    size_t length;
+    int i;
+
+    /* A line longer than the read buffer, CRLF line ends
+       and no line break at the end */
+    for( i = 0; i < FILTER_BUFFER_SIZE + 1; i++ )
+    {
+        fputc('x', input);
+    }
+    fprintf(input, "\n192.0.2.1/24\n192.0.2.2/24\r\n192.0.2.0/24\n2001:db8::1/64\n10.0.0.1/8");
+    rewind(input);
+
+    ck_assert_int_eq(filter_addresses(input, output, checks, 2, NO_LOOPBACK, FILTER_PASSING, 0), RESULT_SUCCESS);
+    rewind(output);
+    length = fread(result, 1, sizeof(result) - 1, output);
+    result[length] = '\0';
+    ck_assert_str_eq(result, "192.0.2.1/24\n192.0.2.2/24\r\n10.0.0.1/8\n");
+    fclose(output);
+
+    output = tmpfile();
+    rewind(input);
+    ck_assert_int_eq(filter_addresses(input, output, checks, 2, NO_LOOPBACK, FILTER_FAILING, 0), RESULT_SUCCESS);
+    ck_assert_int_eq(ftell(output), FILTER_BUFFER_SIZE + 2 + strlen("192.0.2.0/24\n2001:db8::1/64\n"));
+    fseek(output, FILTER_BUFFER_SIZE + 2, SEEK_SET);
+    length = fread(result, 1, sizeof(result) - 1, output);
+    result[length] = '\0';
+    ck_assert_str_eq(result, "192.0.2.0/24\n2001:db8::1/64\n");
+    fclose(output);
+    fclose(input);
+
+    /* Nothing printed is a failure, as in grep */
+    input = tmpfile();
+    output = tmpfile();
+    fprintf(input, "192.0.2.1\n");
+    rewind(input);
+    ck_assert_int_eq(filter_addresses(input, output, NULL, 0, NO_LOOPBACK, FILTER_FAILING, 0), RESULT_FAILURE);
+    ck_assert_int_eq(ftell(output), 0);
+    fclose(output);
+    fclose(input);
+}
+END_TEST
+
+
+START_TEST (test_scan_files)
+{
+    char* names[] = { "check_ipaddrcheck.files.a", "check_ipaddrcheck.files.b",
+                      "check_ipaddrcheck.files.empty", "check_ipaddrcheck.files.missing" };
+    const int methods[] = { FILES_READ_PLAIN, FILES_READ_AUTO };
+    const int checks[] = { IS_IPV4 };
+    char line[128];
+    FILE* file;
+    int m;
+    int i;
+
+    file = fopen(names[0], "w");
+    fprintf(file, "host a { fixed-address 192.0.2.1; }\nhost b { fixed-address 192.0.2.300; }");
+    fclose(file);
+
+    /* Larger than a block, so it gets a buffer of its own */
+    file = fopen(names[1], "w");
+    for( i = 0; i < FILES_BLOCK_SIZE / 16; i++ )
+    {
+        fprintf(file, "lease 10.0.%d.%d\n", (i / 256) % 256, i % 256);
+    }
+    fclose(file);
+
+    file = fopen(names[2], "w");
+    fclose(file);
+
+    for( m = 0; m < 2; m++ )
+    {
+        FILE* output = tmpfile();
+        int seen_a = 0;
+        int seen_b = 0;
+
+        ck_assert_int_eq(scan_files(names, 3, output, checks, 1, NO_LOOPBACK, 0, methods[m], 4), RESULT_FAILURE);
+        rewind(output);
+        while( fgets(line, sizeof(line), output) != NULL )
+        {
+            if( strncmp(line, "check_ipaddrcheck.files.a:", 26) == 0 )
+            {
+                ck_assert(seen_a < 2);
+                ck_assert_str_eq(line, (seen_a == 0) ? "check_ipaddrcheck.files.a:1:24 192.0.2.1 pass\n"
+                                                     : "check_ipaddrcheck.files.a:2:24 192.0.2.300 fail\n");
+                seen_a++;
+            }
+            else
+            {
+                sprintf(line + 64, "check_ipaddrcheck.files.b:%d:7 10.0.%d.%d pass\n", seen_b + 1,
+                        (seen_b / 256) % 256, seen_b % 256);
+                ck_assert_str_eq(line, line + 64);
+                seen_b++;
+            }
+        }
+        ck_assert_int_eq(seen_a, 2);
+        ck_assert_int_eq(seen_b, FILES_BLOCK_SIZE / 16);
+        fclose(output);
+
+        /* Files that cannot be read are errors, the others are still scanned */
+        output = tmpfile();
+        ck_assert_int_eq(scan_files(names + 1, 3, output, NULL, 0, NO_LOOPBACK, 0, methods[m], 0), RESULT_INT_ERROR);
+        ck_assert_int_gt(ftell(output), FILES_BLOCK_SIZE);
+        fclose(output);
+    }
+
+    for( i = 0; i < 3; i++ )
+    {
+        remove(names[i]);
+    }
+}
+END_TEST
+
+
+START_TEST (test_address_stats)
+{
+    const int thread_counts[] = { 1, 3 };
+    const char* expected =
+        "addresses 212 ipv4 170 ipv6 41 malformed 1\n"
+        "class private-use 100\n"
+        "class documentation 110\n"
+        "class link-local-unicast 1\n"
+        "class link-local-subnet 1\n"
+        "top 192.0.2.0/24 50\n"
+        "top 198.51.100.0/24 20\n"
+        "top 2001:db8:1::/48 30\n"
+        "top 2001:db8:2::/48 10\n";
+    FILE* input = tmpfile();
+    char result[512];
+    size_t length;
+    int t;
+    int i;
+
+    /* A line longer than a block, blank lines, CRLF line ends,
+       and many more prefixes than there is room for among the candidates */
+    for( i = 0; i < STATS_BLOCK_SIZE + 1; i++ )
+    {
+        fputc('x', input);
+    }
+    fprintf(input, "\n\n");
+    for( i = 0; i < 100; i++ )
+    {
+        fprintf(input, "10.%d.0.1\n", i);
+        if( i < 50 )
+        {
+            fprintf(input, "192.0.2.%d\n", i);
+        }
+        if( i < 20 )
+        {
+            fprintf(input, "198.51.100.1\r\n\n");
+        }
+        if( i < 30 )
+        {
+            fprintf(input, "2001:db8:1::%x\n", i + 1);
+        }
+        if( i < 10 )
+        {
+            fprintf(input, "2001:db8:2::1/64\n");
+        }
+    }
+    fprintf(input, "fe80::1");
+
+    for( t = 0; t < 2; t++ )
+    {
+        FILE* output = tmpfile();
+
+        rewind(input);
+        ck_assert_int_eq(address_stats(input, output, 2, thread_counts[t]), RESULT_FAILURE);
+        rewind(output);
+        length = fread(result, 1, sizeof(result) - 1, output);
+        result[length] = '\0';
+        ck_assert_str_eq(result, expected);
+        fclose(output);
+    }
+    fclose(input);
+}
+END_TEST
+
+START_TEST (test_distinct)
+{
+    struct distinct_counter counter;
+    struct distinct_counter halves[2];
+    struct distinct_counter prefixes;
+    struct distinct_counter loaded;
+    struct ipaddr_bin address;
+    uint64_t estimate;
+    uint32_t value;
+    int i;
+
+    ck_assert_int_eq(distinct_init(&counter, 32, 128), RESULT_SUCCESS);
+    ck_assert_int_eq(distinct_init(&halves[0], 32, 128), RESULT_SUCCESS);
+    ck_assert_int_eq(distinct_init(&halves[1], 32, 128), RESULT_SUCCESS);
+    ck_assert_int_eq(distinct_estimate(&counter, DISTINCT_IPV4), 0);
+
+    /* Every address twice, the second time in the other half */
+    memset(&address, 0, sizeof(address));
+    address.proto = CIDR_IPV4;
+    address.pflen = 32;
+    for( i = 0; i < 200000; i++ )
+    {
+        value = (uint32_t)(i % 100000) * 2654435761u;
+        memcpy(&address.addr[12], &value, 4);
+        ck_assert_int_eq(distinct_add(&counter, &address), RESULT_SUCCESS);
+        ck_assert_int_eq(distinct_add(&halves[i % 2], &address), RESULT_SUCCESS);
+        if( i == 999 )
+        {
+            /* Still sparse, and exact */
+            ck_assert_int_eq(distinct_estimate(&counter, DISTINCT_IPV4), 1000);
+        }
+    }
+    estimate = distinct_estimate(&counter, DISTINCT_IPV4);
+    ck_assert(estimate > 98000);
+    ck_assert(estimate < 102000);
+    ck_assert_int_eq(distinct_estimate(&counter, DISTINCT_IPV6), 0);
+
+    /* A merged sketch is the sketch of the union */
+    ck_assert_int_eq(distinct_merge(&halves[0], &halves[1]), RESULT_SUCCESS);
+    ck_assert_int_eq(distinct_estimate(&halves[0], DISTINCT_IPV4), estimate);
+
+    ck_assert_int_eq(distinct_save(&counter, "check_ipaddrcheck.distinct"), RESULT_SUCCESS);
+    ck_assert_int_eq(distinct_load(&loaded, "check_ipaddrcheck.distinct"), RESULT_SUCCESS);
+    ck_assert_int_eq(distinct_estimate(&loaded, DISTINCT_IPV4), estimate);
+    remove("check_ipaddrcheck.distinct");
+
+    /* Prefixes of other lengths do not mix */
+    ck_assert_int_eq(distinct_init(&prefixes, 24, 64), RESULT_SUCCESS);
+    ck_assert_int_eq(distinct_merge(&loaded, &prefixes), RESULT_FAILURE);
+    for( i = 0; i < 256; i++ )
+    {
+        char address_str[IPADDR_STR_MAX];
+
+        sprintf(address_str, "192.0.2.%d", i);
+        ck_assert_int_eq(str_to_ipaddr_bin(address_str, &address), RESULT_SUCCESS);
+        ck_assert_int_eq(distinct_add(&prefixes, &address), RESULT_SUCCESS);
+        sprintf(address_str, "2001:db8::%x", i);
+        ck_assert_int_eq(str_to_ipaddr_bin(address_str, &address), RESULT_SUCCESS);
+        ck_assert_int_eq(distinct_add(&prefixes, &address), RESULT_SUCCESS);
+    }
+    ck_assert_int_eq(distinct_estimate(&prefixes, DISTINCT_IPV4), 1);
+    ck_assert_int_eq(distinct_estimate(&prefixes, DISTINCT_IPV6), 1);
+
+    distinct_free(&counter);
+    distinct_free(&halves[0]);
+    distinct_free(&halves[1]);
+    distinct_free(&loaded);
+    distinct_free(&prefixes);
+}
+END_TEST
+
+START_TEST (test_prefix_index)
+{
+    const char* index_name = "check_ipaddrcheck.prefix_index";
+    struct prefix_index index;
+    struct ipaddr_bin address;
+    FILE* table = tmpfile();
+    FILE* index_file;
+    const char* match;
+    uint32_t version = PREFIX_INDEX_VERSION + 1;
+    int i;
+
+    fprintf(table, "# test table\n10.0.0.0/8 corp\n10.1.0.0/16 lab\n10.1.2.0/24\n\n"
+                   "2001:db8::/32 doc\n2001:db8:1::/48 doc\n10.1.0.0/16 lab2\n");
+    rewind(table);
+    ck_assert_int_eq(prefix_index_build(table, "table", index_name), RESULT_SUCCESS);
+    ck_assert_int_eq(prefix_index_open(&index, index_name, 1), RESULT_SUCCESS);
+
+    /* The longest match, the later one of duplicates, and the prefix if there is no label */
+    ck_assert_int_eq(str_to_ipaddr_bin("10.1.2.3", &address), RESULT_SUCCESS);
+    ck_assert_str_eq(prefix_index_lookup(&index, &address), "10.1.2.0/24");
+    ck_assert_int_eq(str_to_ipaddr_bin("10.1.255.255", &address), RESULT_SUCCESS);
+    ck_assert_str_eq(prefix_index_lookup(&index, &address), "lab2");
+    ck_assert_int_eq(str_to_ipaddr_bin("10.2.0.0", &address), RESULT_SUCCESS);
+    ck_assert_str_eq(prefix_index_lookup(&index, &address), "corp");
+    ck_assert_int_eq(str_to_ipaddr_bin("11.0.0.0", &address), RESULT_SUCCESS);
+    ck_assert(prefix_index_lookup(&index, &address) == NULL);
+    ck_assert_int_eq(str_to_ipaddr_bin("2001:db8:1:ffff::1", &address), RESULT_SUCCESS);
+    match = prefix_index_lookup(&index, &address);
+    ck_assert_str_eq(match, "doc");
+    ck_assert_int_eq(str_to_ipaddr_bin("2001:db8:ffff::", &address), RESULT_SUCCESS);
+    /* Labels are stored once */
+    ck_assert(prefix_index_lookup(&index, &address) == match);
+    ck_assert_int_eq(str_to_ipaddr_bin("::a01:203", &address), RESULT_SUCCESS);
+    ck_assert(prefix_index_lookup(&index, &address) == NULL);
+
+    /* Addresses with a prefix length need a prefix of the table that is not longer */
+    ck_assert_int_eq(str_to_ipaddr_bin("10.1.2.3", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(prefix_index_contains(&index, &address), RESULT_SUCCESS);
+    ck_assert_int_eq(str_to_ipaddr_bin("10.1.2.3/16", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(prefix_index_contains(&index, &address), RESULT_SUCCESS);
+    ck_assert_int_eq(str_to_ipaddr_bin("10.1.2.3/8", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(prefix_index_contains(&index, &address), RESULT_SUCCESS);
+    ck_assert_int_eq(str_to_ipaddr_bin("10.0.0.0/7", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(prefix_index_contains(&index, &address), RESULT_FAILURE);
+    ck_assert_int_eq(str_to_ipaddr_bin("192.0.2.1", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(prefix_index_contains(&index, &address), RESULT_FAILURE);
+    ck_assert_int_eq(str_to_ipaddr_bin("2001:db8:1::/48", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(prefix_index_contains(&index, &address), RESULT_SUCCESS);
+    ck_assert_int_eq(str_to_ipaddr_bin("2001:db8::/31", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(prefix_index_contains(&index, &address), RESULT_FAILURE);
+
+    /* The check fails without an index */
+    ck_assert_int_eq(check_ipaddr_bin(IS_IN_PREFIX_INDEX, &address, NO_LOOPBACK), RESULT_FAILURE);
+    ck_assert_int_eq(str_to_ipaddr_bin("10.1.2.3/24", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(check_ipaddr_bin(IS_IN_PREFIX_INDEX, &address, NO_LOOPBACK), RESULT_FAILURE);
+    set_check_prefix_index(&index);
+    ck_assert_int_eq(check_ipaddr_bin(IS_IN_PREFIX_INDEX, &address, NO_LOOPBACK), RESULT_SUCCESS);
+    set_check_prefix_index(NULL);
+    prefix_index_close(&index);
+
+    /* Host addresses are not networks */
+    rewind(table);
+    fprintf(table, "10.0.0.1/8\n");
+    rewind(table);
+    ck_assert_int_eq(prefix_index_build(table, "table", index_name), RESULT_INT_ERROR);
+    fclose(table);
+
+    /* Damaged data only fails the full check, a damaged header always fails */
+    table = tmpfile();
+    for( i = 0; i < 1000; i++ )
+    {
+        fprintf(table, "10.%d.%d.0/24\n", i / 256, i % 256);
+    }
+    rewind(table);
+    ck_assert_int_eq(prefix_index_build(table, "table", index_name), RESULT_SUCCESS);
+    fclose(table);
+    index_file = fopen(index_name, "r+b");
+    fseek(index_file, sizeof(struct prefix_index_header) + 100, SEEK_SET);
+    fputc(0xff, index_file);
+    fflush(index_file);
+    ck_assert_int_eq(prefix_index_open(&index, index_name, 0), RESULT_SUCCESS);
+    prefix_index_close(&index);
+    ck_assert_int_eq(prefix_index_open(&index, index_name, 1), RESULT_INT_ERROR);
+    fseek(index_file, offsetof(struct prefix_index_header, ipv4_count), SEEK_SET);
+    fputc(0x7f, index_file);
+    fflush(index_file);
+    ck_assert_int_eq(prefix_index_open(&index, index_name, 0), RESULT_INT_ERROR);
+
+    /* So does another format version */
+    fseek(index_file, offsetof(struct prefix_index_header, version), SEEK_SET);
+    fwrite(&version, sizeof(version), 1, index_file);
+    fclose(index_file);
+    ck_assert_int_eq(prefix_index_open(&index, index_name, 0), RESULT_INT_ERROR);
+
+    remove(index_name);
+}
+END_TEST
+
+START_TEST (test_classify_batch)
+{
+    static const char* const boundaries[] = {
+        "223.255.255.255", "224.0.0.0", "239.255.255.255/32", "240.0.0.0", "224.0.0.0/4", "224.0.0.0/3",
+        "126.255.255.255", "127.0.0.1", "127.0.0.0/7", "169.254.0.0/16", "169.255.0.0", "169.254.0.0/15",
+        "10.255.255.255", "11.0.0.0", "172.15.255.255", "172.16.0.0/12", "172.32.0.0", "172.16.0.0/11",
+        "192.168.255.255", "192.169.0.0", "192.168.0.0/15", "0.0.0.0/0", "255.255.255.255",
+        "ff00::", "ff00::/8", "ff00::/7", "feff:ffff::", "fe80::1", "fe80::/64", "fe80::/63",
+        "fe80:0:0:1::", "fe80::ffff:ffff:ffff:ffff", "febf::", "::ffff:a00:1", "::a00:1", "::/0"
+    };
+    static const int checks[] = {
+        IS_IPV4, IS_IPV6, IS_IPV4_MULTICAST, IS_IPV4_LOOPBACK, IS_IPV4_LINKLOCAL,
+        IS_IPV4_RFC1918, IS_IPV6_MULTICAST, IS_IPV6_LINKLOCAL
+    };
+    size_t boundary_count = sizeof(boundaries) / sizeof(boundaries[0]);
+    size_t count = 1000 + boundary_count;
+    struct ipaddr_bin* addresses = calloc(count, sizeof(struct ipaddr_bin));
+    uint8_t* properties = malloc(count);
+    struct ipaddr_batch batch;
+    uint64_t state = 1;
+    size_t i;
+    int impl;
+    int j;
+
+    for( i = 0; i < boundary_count; i++ )
+    {
+        ck_assert_int_eq(str_to_ipaddr_bin((char*)boundaries[i], &addresses[i]), RESULT_SUCCESS);
+    }
+    /* Random addresses in and near the ranges, with random prefix lengths */
+    for( ; i < count; i++ )
+    {
+        struct ipaddr_bin* address = &addresses[i];
+
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        address->proto = (state >> 63) ? CIDR_IPV4 : CIDR_IPV6;
+        for( j = 0; j < 16; j++ )
+        {
+            address->addr[j] = (uint8_t)(state >> (8 * (j % 8))) ^ (uint8_t)(i * j);
+        }
+        if( address->proto == CIDR_IPV4 )
+        {
+            static const uint8_t firsts[] = { 224, 239, 127, 169, 10, 172, 192 };
+
+            memset(address->addr, 0, 12);
+            address->addr[12] = firsts[(state >> 20) % 7];
+            address->addr[13] = ((state >> 24) & 1) ? (uint8_t)(state >> 32) : (((state >> 25) & 1) ? 254 : 168);
+            address->pflen = (uint8_t)((state >> 40) % 33);
+        }
+        else
+        {
+            address->addr[0] = ((state >> 20) & 1) ? 0xff : 0xfe;
+            address->addr[1] = ((state >> 21) & 1) ? (uint8_t)(state >> 32) : 0x80;
+            if( (state >> 22) & 1 )
+            {
+                memset(&address->addr[2], 0, 6);
+            }
+            address->pflen = (uint8_t)((state >> 40) % 129);
+        }
+    }
+
+    ck_assert_int_eq(ipaddr_batch_init(&batch, count), RESULT_SUCCESS);
+    for( i = 0; i < count; i++ )
+    {
+        ipaddr_batch_set(&batch, i, &addresses[i]);
+    }
+    /* Slots without an address have no properties */
+    ipaddr_batch_set(&batch, count - 1, NULL);
+
+    /* Every implementation this CPU runs agrees with the checks,
+       also for counts that are not a multiple of the vector width */
+    for( impl = BATCH_IMPL_SCALAR; impl <= classify_batch_best_impl(); impl++ )
+    {
+        batch.count = count;
+        memset(properties, 0xaa, count);
+        classify_ipaddr_batch_impl(&batch, properties, impl);
+        for( i = 0; i < count - 1; i++ )
+        {
+            for( j = 0; j < 8; j++ )
+            {
+                ck_assert_int_eq((properties[i] & batch_property(checks[j])) != 0,
+                                 check_ipaddr_bin(checks[j], &addresses[i], NO_LOOPBACK) == RESULT_SUCCESS);
+            }
+        }
+        ck_assert_int_eq(properties[count - 1], 0);
+
+        batch.count = 21;
+        memset(properties, 0xaa, count);
+        classify_ipaddr_batch_impl(&batch, properties, impl);
+        ck_assert_int_eq(properties[21], 0xaa);
+        ck_assert_int_eq(properties[1], BATCH_IPV4 | BATCH_IPV4_MULTICAST);
+        ck_assert_int_eq(properties[18], BATCH_IPV4 | BATCH_IPV4_RFC1918);
+        ck_assert_int_eq(properties[20], BATCH_IPV4);
+    }
+
+    ipaddr_batch_free(&batch);
+    free(addresses);
+    free(properties);
+}
+END_TEST
+
+/* Append a netlink message with one attribute, like the kernel sends
+   for RTM_NEWLINK with the interface name or RTM_NEWADDR with IFA_LOCAL */
+static size_t append_netlink_message(uint8_t* dump, size_t length, uint16_t type, const void* body, size_t body_size,
+                                     uint16_t attribute_type, const void* attribute, size_t attribute_size)
+{
+    struct nlmsghdr header;
+    struct rtattr rtattr;
+
+    memset(&header, 0, sizeof(header));
+    header.nlmsg_len = NLMSG_LENGTH(NLMSG_ALIGN(body_size) + RTA_LENGTH(attribute_size));
+    header.nlmsg_type = type;
+    header.nlmsg_flags = NLM_F_MULTI;
+    rtattr.rta_len = RTA_LENGTH(attribute_size);
+    rtattr.rta_type = attribute_type;
+
+    memset(dump + length, 0, NLMSG_ALIGN(header.nlmsg_len));
+    memcpy(dump + length, &header, sizeof(header));
+    memcpy(dump + length + NLMSG_HDRLEN, body, body_size);
+    memcpy(dump + length + NLMSG_HDRLEN + NLMSG_ALIGN(body_size), &rtattr, sizeof(rtattr));
+    memcpy(dump + length + NLMSG_HDRLEN + NLMSG_ALIGN(body_size) + RTA_LENGTH(0), attribute, attribute_size);
+
+    return(length + NLMSG_ALIGN(header.nlmsg_len));
+}
+
+static size_t append_netlink_address(uint8_t* dump, size_t length, int ifindex, const char* address_str, int scope)
+{
+    struct ifaddrmsg info;
+    struct ipaddr_bin address;
+
+    str_to_ipaddr_bin((char*)address_str, &address);
+    memset(&info, 0, sizeof(info));
+    info.ifa_family = (address.proto == CIDR_IPV4) ? AF_INET : AF_INET6;
+    info.ifa_prefixlen = address.pflen;
+    info.ifa_scope = scope;
+    info.ifa_index = ifindex;
+
+    return(append_netlink_message(dump, length, RTM_NEWADDR, &info, sizeof(info), IFA_LOCAL,
+                                  (address.proto == CIDR_IPV4) ? &address.addr[12] : address.addr,
+                                  (address.proto == CIDR_IPV4) ? 4 : 16));
+}
+
+START_TEST (test_ifaddr_conflicts)
+{
+    static const char* const names[] = { "lo", "eth0", "eth1" };
+    uint8_t* dump = calloc(1, 4096);
+    struct ifaddr_table table;
+    struct ipaddr_bin address;
+    struct nlmsghdr done;
+    FILE* output = tmpfile();
+    char result[512];
+    size_t length = 0;
+    size_t result_length;
+    int i;
+
+    /* A recorded dump of links and addresses, as two dumps with NLMSG_DONE */
+    for( i = 0; i < 3; i++ )
+    {
+        struct ifinfomsg info;
+
+        memset(&info, 0, sizeof(info));
+        info.ifi_index = i + 1;
+        length = append_netlink_message(dump, length, RTM_NEWLINK, &info, sizeof(info), IFLA_IFNAME,
+                                        names[i], strlen(names[i]) + 1);
+    }
+    memset(&done, 0, sizeof(done));
+    done.nlmsg_len = NLMSG_LENGTH(sizeof(int));
+    done.nlmsg_type = NLMSG_DONE;
+    memcpy(dump + length, &done, sizeof(done));
+    length += NLMSG_ALIGN(done.nlmsg_len);
+    length = append_netlink_address(dump, length, 1, "127.0.0.1/8", RT_SCOPE_HOST);
+    length = append_netlink_address(dump, length, 2, "192.0.2.1/24", RT_SCOPE_UNIVERSE);
+    length = append_netlink_address(dump, length, 3, "198.51.100.1/24", RT_SCOPE_UNIVERSE);
+    length = append_netlink_address(dump, length, 2, "2001:db8::1/64", RT_SCOPE_UNIVERSE);
+    length = append_netlink_address(dump, length, 2, "fe80::1/64", RT_SCOPE_LINK);
+    length = append_netlink_address(dump, length, 9, "203.0.113.1/32", RT_SCOPE_UNIVERSE);
+    memcpy(dump + length, &done, sizeof(done));
+    length += NLMSG_ALIGN(done.nlmsg_len);
+
+    ifaddr_table_init(&table);
+    ck_assert_int_eq(ifaddr_table_parse(&table, dump, length), RESULT_SUCCESS);
+    ck_assert_int_eq(ifaddr_table_index(&table), RESULT_SUCCESS);
+    ck_assert_int_eq(table.count, 6);
+    ck_assert_str_eq(ifaddr_table_link_name(&table, 2), "eth0");
+    ck_assert(ifaddr_table_link_name(&table, 9) == NULL);
+
+    ck_assert_int_eq(str_to_ipaddr_bin("192.0.2.1/24", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(ifaddr_conflicts(&table, &address, "eth0", output), 1);
+    ck_assert_int_eq(str_to_ipaddr_bin("192.0.2.7/24", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(ifaddr_conflicts(&table, &address, "eth0", output), 0);
+    ck_assert_int_eq(ifaddr_conflicts(&table, &address, NULL, output), 1);
+    /* A subnet that contains two configured ones */
+    ck_assert_int_eq(str_to_ipaddr_bin("192.0.0.0/8", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(ifaddr_conflicts(&table, &address, "eth1", output), 1);
+    ck_assert_int_eq(str_to_ipaddr_bin("10.0.0.1/8", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(ifaddr_conflicts(&table, &address, NULL, output), 0);
+    /* Link-local subnets are only duplicates */
+    ck_assert_int_eq(str_to_ipaddr_bin("fe80::2/64", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(ifaddr_conflicts(&table, &address, NULL, output), 0);
+    ck_assert_int_eq(str_to_ipaddr_bin("fe80::1/64", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(ifaddr_conflicts(&table, &address, "eth1", output), 1);
+    ck_assert_int_eq(str_to_ipaddr_bin("203.0.113.1", &address), RESULT_SUCCESS);
+    ck_assert_int_eq(ifaddr_conflicts(&table, &address, NULL, output), 1);
+
+    rewind(output);
+    result_length = fread(result, 1, sizeof(result) - 1, output);
+    result[result_length] = '\0';
+    ck_assert_str_eq(result,
+                     "duplicate 192.0.2.1/24 eth0 192.0.2.1/24\n"
+                     "overlap 192.0.2.7/24 eth0 192.0.2.1/24\n"
+                     "overlap 192.0.0.0/8 eth0 192.0.2.1/24\n"
+                     "duplicate fe80::1/64 eth0 fe80::1/64\n"
+                     "duplicate 203.0.113.1 if9 203.0.113.1\n");
+    fclose(output);
+
+    ck_assert_int_eq(check_ifaddr_conflicts(&table, NULL, "198.51.100.0/25", "eth1", NULL, 0), RESULT_SUCCESS);
+    ck_assert_int_eq(check_ifaddr_conflicts(&table, NULL, "foo", NULL, NULL, 0), RESULT_FAILURE);
+    ifaddr_table_free(&table);
+
+    /* Truncated messages are rejected */
+    ifaddr_table_init(&table);
+    ck_assert_int_eq(ifaddr_table_parse(&table, dump, length - 30), RESULT_FAILURE);
+    ifaddr_table_free(&table);
+
+    free(dump);
+}
+END_TEST
 
 Suite *ipaddrcheck_suite(void)
 {
@@ -464,6 +2120,31 @@ Suite *ipaddrcheck_suite(void)
     tcase_add_test(tc_core, test_is_any_host);
     tcase_add_test(tc_core, test_is_any_net);
     tcase_add_test(tc_core, test_is_ipv4_range);
+    tcase_add_test(tc_core, test_str_to_ipaddr_bin);
+    tcase_add_test(tc_core, test_radix_sort_ipaddr);
+    tcase_add_test(tc_core, test_lpm4);
+    tcase_add_test(tc_core, test_lpm6);
+    tcase_add_test(tc_core, test_classify_ipaddr_bin);
+    tcase_add_test(tc_core, test_blocklist);
+    tcase_add_test(tc_core, test_json_writer);
+    tcase_add_test(tc_core, test_check_ipaddr_bin);
+    tcase_add_test(tc_core, test_pcap_walk);
+    tcase_add_test(tc_core, test_scan_text);
+    tcase_add_test(tc_core, test_interval_tree);
+    tcase_add_test(tc_core, test_format_ipv6_key);
+    tcase_add_test(tc_core, test_ipam_allocate);
+    tcase_add_test(tc_core, test_ipaddr_bin_to_reverse);
+    tcase_add_test(tc_core, test_threaded_checks);
+    tcase_add_test(tc_core, test_slice_checks);
+    tcase_add_test(tc_core, test_rules);
+    tcase_add_test(tc_core, test_check_csv);
+    tcase_add_test(tc_core, test_filter_addresses);
+    tcase_add_test(tc_core, test_scan_files);
+    tcase_add_test(tc_core, test_address_stats);
+    tcase_add_test(tc_core, test_distinct);
+    tcase_add_test(tc_core, test_prefix_index);
+    tcase_add_test(tc_core, test_classify_batch);
+    tcase_add_test(tc_core, test_ifaddr_conflicts);
 
     suite_add_tcase(s, tc_core);
 
@@ -50,12 +50,15 @@ ipv4_cidr_negative=(
 
 ipv4_range_positive=(
     192.0.2.0-192.0.2.100
+    192.0.2.255-192.0.3.0
 )
 
 ipv4_range_negative=(
     192.0.2.-192.0.2.100
     192.0.2.0-
     192.0.2.200-192.0.2.100
+    192.0.3.0-192.0.2.255
+    1921680000000000000-192.0.2.1
 )
 
 ipv6_range_positive=(
@@ -303,4 +306,237 @@ done
 assert_raises "$IPADDRCHECK --range-prefix-length 64 --is-ipv6-range 2001:db8::1-2001:db8::100" 0
 assert_raises "$IPADDRCHECK --range-prefix-length 64 --is-ipv6-range 2001:db8:aaaa::1-2001:db8:bbbb::1" 1
 
+# --sort
+assert "$IPADDRCHECK --sort" "192.0.2.1\n192.0.2.10/24\n192.0.2.10\n2001:db8::1" $'2001:db8::1\n192.0.2.10/24\n192.0.2.10\n192.0.2.1'
+assert "$IPADDRCHECK --sort --normalize" "192.0.2.1\n2001:db8::1" $'2001:0db8::0001\n192.0.2.1/32'
+assert_raises "$IPADDRCHECK --sort" 0 $'192.0.2.1\n10.0.0.1'
+assert_raises "$IPADDRCHECK --sort" 1 $'192.0.2.1\n192.0.2.666'
+assert_raises "$IPADDRCHECK --sort > /dev/full" 2 $'192.0.2.1\n10.0.0.1'
+assert_raises "$IPADDRCHECK --sort --is-ipv6" 2 $'10.0.0.1\n2001:db8::1'
+assert_raises "$IPADDRCHECK --sort --is-ipv4-range" 2 $'10.0.0.1'
+assert_raises "$IPADDRCHECK --sort --reverse" 2 $'10.0.0.1'
+assert_raises "$IPADDRCHECK --filter --is-ipv6 --reverse" 2 $'10.0.0.1'
+
+# --lookup
+lookup_table=$(mktemp)
+printf '10.0.0.0/8 corp\n# comment\n10.1.2.128/25\n2001:db8::/32 doc\n' > $lookup_table
+assert "$IPADDRCHECK --lookup $lookup_table" "10.1.2.128/25\ncorp\n-\ndoc\n-" $'10.1.2.200\n10.1.2.1\n192.0.2.1\n2001:db8::1\n2001:db9::1'
+assert_raises "$IPADDRCHECK --lookup $lookup_table" 1 $'10.1.2.200\n10.1.2.666'
+assert_raises "$IPADDRCHECK --lookup $lookup_table --is-ipv6" 2 $'10.1.2.200'
+assert_raises "$IPADDRCHECK --lookup $lookup_table > /dev/full" 2 $'10.1.2.200'
+printf '10.0.0.1/8 corp\n' > $lookup_table
+assert_raises "$IPADDRCHECK --lookup $lookup_table" 2 "10.0.0.1"
+printf '2001:db8::1/32\n' > $lookup_table
+assert_raises "$IPADDRCHECK --lookup $lookup_table" 2 "2001:db8::1"
+rm -f $lookup_table
+
+# --classify
+assert "$IPADDRCHECK --classify" "private-use\n-\nshared-address-space\nloopback-address\nlink-local-unicast,link-local-subnet" $'10.0.0.1\n8.8.8.8\n100.64.0.1\n::1\nfe80::1'
+assert "$IPADDRCHECK --classify" "private-use\n-" $'172.16.0.0/12\n172.16.0.0/11'
+assert_raises "$IPADDRCHECK --classify" 1 $'10.0.0.1\n10.0.0.666'
+assert_raises "$IPADDRCHECK --classify --is-ipv6" 2 $'10.0.0.1'
+assert_raises "$IPADDRCHECK --classify > /dev/full" 2 $'10.0.0.1'
+
+# --build-blocklist, --blocklist
+blocklist=$(mktemp)
+assert_raises "$IPADDRCHECK --build-blocklist $blocklist" 0 $'# hosts\n192.0.2.1\n2001:db8::1\n198.51.100.7/32'
+assert "$IPADDRCHECK --blocklist $blocklist" "blocked\n-\nblocked\nblocked\n-" $'192.0.2.1\n192.0.2.2\n2001:db8:0::1\n198.51.100.7\n2001:db8::2'
+assert_raises "$IPADDRCHECK --blocklist $blocklist" 1 $'192.0.2.1\n192.0.2.666'
+assert_raises "$IPADDRCHECK --blocklist $blocklist --is-ipv6" 2 $'192.0.2.1'
+assert_raises "$IPADDRCHECK --build-blocklist $blocklist --is-ipv4" 2 $'192.0.2.1'
+assert_raises "$IPADDRCHECK --build-blocklist $blocklist" 2 $'192.0.2.1\n192.0.2.0/24'
+echo "not a blocklist" > $blocklist
+assert_raises "$IPADDRCHECK --blocklist $blocklist" 2 "192.0.2.1"
+rm -f $blocklist
+
+# --json
+assert "$IPADDRCHECK --json --is-ipv4-host 192.0.2.1/24" '{"input":"192.0.2.1/24","family":"ipv4","prefix_length":24,"checks":{"is-ipv4-host":true},"valid":true,"reason":null}'
+assert "$IPADDRCHECK --json --is-any-host --is-ipv4" '{"input":"10.0.0.0/8","family":"ipv4","prefix_length":8,"checks":{"is-any-host":false,"is-ipv4":true},"valid":false,"reason":"10.0.0.0/8 is a network address, not a host address"}\n{"input":"foo","family":null,"prefix_length":null,"checks":{"is-any-host":false,"is-ipv4":false},"valid":false,"reason":"Malformed address foo"}' $'10.0.0.0/8\nfoo'
+assert_raises "$IPADDRCHECK --json --is-ipv4 -" 0 $'192.0.2.1\n10.0.0.1'
+assert_raises "$IPADDRCHECK --json --is-ipv4" 1 $'192.0.2.1\n2001:db8::1'
+assert_raises "$IPADDRCHECK --json --is-ipv4-range 192.0.2.1-192.0.2.10" 2
+
+# --to-binary, --binary
+assert "$IPADDRCHECK --to-binary | od -An -tx1 | tr -d ' \n'" "04c000020100000000000000000000000018000000000000000000000000000000000000" $'192.0.2.1/24\nfoo'
+assert_raises "$IPADDRCHECK --to-binary > /dev/null" 1 $'192.0.2.1\nfoo'
+assert_raises "$IPADDRCHECK --to-binary --is-ipv6 > /dev/null" 2 $'192.0.2.1'
+assert_raises "$IPADDRCHECK --to-binary > /dev/full" 2 $'192.0.2.1'
+assert "$IPADDRCHECK --to-binary | $IPADDRCHECK --binary --is-ipv4 --is-ipv6-host --is-ipv4-rfc1918 | od -An -tx1 | tr -d ' \n'" "01020005" $'192.0.2.1/24\n2001:db8::1/64\nfoo\n10.0.0.1'
+assert_raises "printf '\\x04\\xc0\\x00\\x02' | $IPADDRCHECK --binary --is-ipv4 > /dev/null" 1
+assert_raises "$IPADDRCHECK --binary < /dev/null" 2
+
+# --pcap
+pcap_file=$(mktemp)
+# Two Ethernet frames: 10.0.0.1 -> 8.8.8.8 and 8.8.8.8 -> 224.0.0.5
+printf "$(echo d4c3b2a1020004000000000000000000ffff0000010000000000000000000000220000002200000000000000000000000000000008004500000000000000000000000a0000010808080800000000000000002200000022000000000000000000000000000000080045000000000000000000000008080808e0000005 | sed 's/../\\x&/g')" > $pcap_file
+assert "$IPADDRCHECK --pcap $pcap_file --is-ipv4-rfc1918 --is-ipv4-multicast" "packets 2 ipv4 2 ipv6 0 other 0 truncated 0\nis-ipv4-rfc1918 source 1 destination 0\nis-ipv4-rfc1918 source-packets 1\nis-ipv4-rfc1918 destination-packets\nis-ipv4-multicast source 0 destination 1\nis-ipv4-multicast source-packets\nis-ipv4-multicast destination-packets 2"
+assert_raises "$IPADDRCHECK --pcap $pcap_file --is-ipv4-rfc1918" 1
+assert_raises "$IPADDRCHECK --pcap $pcap_file --is-ipv6" 0
+echo "not a capture" > $pcap_file
+assert_raises "$IPADDRCHECK --pcap $pcap_file" 2
+rm -f $pcap_file
+
+# --scan
+assert "$IPADDRCHECK --scan" "2:11 192.0.2.1/24 pass\n2:33 192.0.2.256 fail\n3:5 2001:db8::1 pass" $'interface eth0.100\n  address 192.0.2.1/24; gateway 192.0.2.256.\nntp 2001:db8::1, at 12:34:56\n'
+assert "$IPADDRCHECK --scan --is-ipv4-host" "1:9 10.0.0.0/8 fail\n1:24 10.0.0.1/8 pass" "network 10.0.0.0/8 via 10.0.0.1/8"
+assert_raises "$IPADDRCHECK --scan" 1 "gateway 192.0.2.256"
+assert_raises "$IPADDRCHECK --scan" 0 "no addresses here, 12:00"
+assert_raises "$IPADDRCHECK --scan --is-ipv4-range" 2 "10.0.0.1-10.0.0.2"
+assert_raises "$IPADDRCHECK --scan > /dev/full" 2 "gateway 192.0.2.1"
+
+# --overlaps
+assert "$IPADDRCHECK --overlaps" "overlap 2 10.0.0.1-10.0.0.50 3 10.0.0.40-10.0.0.60\nescape 4 10.0.0.200-10.0.1.10 1 10.0.0.0/24" $'10.0.0.0/24\n10.0.0.1-10.0.0.50\n10.0.0.40-10.0.0.60\n10.0.0.200-10.0.1.10\n'
+assert "$IPADDRCHECK --overlaps" "malformed 2 10.0.0.9-10.0.0.1" $'# pools\n10.0.0.9-10.0.0.1\n'
+assert_raises "$IPADDRCHECK --overlaps" 0 $'10.0.0.0/8\n10.0.0.0/24\n10.0.0.1-10.0.0.50\n10.0.0.51-10.0.0.99\n2001:db8::1-2001:db8::ff\n'
+assert_raises "$IPADDRCHECK --overlaps" 1 $'2001:db8::1-2001:db8::ff\n2001:db8::ff\n'
+assert_raises "$IPADDRCHECK --overlaps --is-ipv6" 2 $'10.0.0.0/24\n'
+
+# --hosts and --subnets
+assert "$IPADDRCHECK --hosts 192.0.2.0/30" "192.0.2.1\n192.0.2.2"
+assert "$IPADDRCHECK --hosts 192.0.2.8/31" "192.0.2.8\n192.0.2.9"
+assert "$IPADDRCHECK --hosts 2001:db8::/126" "2001:db8::1\n2001:db8::2\n2001:db8::3"
+assert "$IPADDRCHECK --hosts 10.0.0.254-10.0.1.1" "10.0.0.254\n10.0.0.255\n10.0.1.0\n10.0.1.1"
+assert "$IPADDRCHECK --subnets 26 192.0.2.0/24" "192.0.2.0/26\n192.0.2.64/26\n192.0.2.128/26\n192.0.2.192/26"
+assert "$IPADDRCHECK --subnets 64 2001:db8::/63" "2001:db8::/64\n2001:db8:0:1::/64"
+assert_raises "$IPADDRCHECK --subnets 23 192.0.2.0/24" 2
+assert_raises "$IPADDRCHECK --hosts 192.0.2.300/24" 1
+assert_raises "$IPADDRCHECK --hosts --is-ipv6 192.0.2.0/30" 2
+assert_raises "$IPADDRCHECK --subnets 26 --is-ipv4-range 192.0.2.0/24" 2
+
+# --allocate
+assert "$IPADDRCHECK --allocate 30 --count 2 10.0.0.0/26" "10.0.0.12/30\n10.0.0.32/30" $'10.0.0.0/30\n10.0.0.5\n10.0.0.9/29\n10.0.0.16/28\n'
+assert "$IPADDRCHECK --allocate 64 2001:db8::/62" "2001:db8:0:1::/64" "2001:db8::/64"
+assert_raises "$IPADDRCHECK --allocate 64 --count 4 2001:db8::/62" 1 "2001:db8::/64"
+assert_raises "$IPADDRCHECK --allocate 30 10.0.0.1/24" 2 ""
+assert_raises "$IPADDRCHECK --allocate 30 10.0.0.0/24" 2 "10.0.0.300"
+assert_raises "$IPADDRCHECK --allocate 30 --is-ipv6 10.0.0.0/24" 2 ""
+# --reverse
+assert "$IPADDRCHECK --reverse" "1.2.0.192.in-addr.arpa\n2.0.192.in-addr.arpa\n-\n8.b.d.0.1.0.0.2.ip6.arpa" $'192.0.2.1\n192.0.2.0/24\n192.0.2.300\n2001:db8::/32'
+assert "$IPADDRCHECK --reverse" "1.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.8.b.d.0.1.0.0.2.ip6.arpa" "2001:db8::1"
+assert_raises "$IPADDRCHECK --reverse" 0 "10.0.0.0/8"
+assert_raises "$IPADDRCHECK --reverse" 1 "192.0.2.0/25"
+assert_raises "$IPADDRCHECK --reverse --is-ipv6" 2 "10.0.0.1"
+assert_raises "$IPADDRCHECK --reverse > /dev/full" 2 "10.0.0.1"
+# --report
+assert "$IPADDRCHECK --report --is-ipv4 --is-ipv4-host --is-ipv4-rfc1918 --is-ipv6 192.168.1.0/24" "is-ipv4 pass\nis-ipv4-host fail\nis-ipv4-rfc1918 pass\nis-ipv6 fail"
+assert "$IPADDRCHECK --report --is-any-host --is-ipv4 foo" "is-any-host fail\nis-ipv4 fail"
+assert_raises "$IPADDRCHECK --report --is-ipv4 --is-any-host 192.0.2.1/24" 0
+assert_raises "$IPADDRCHECK --report --is-ipv4 --is-ipv6 192.0.2.1" 1
+assert_raises "$IPADDRCHECK --report --is-ipv4-range 192.0.2.1-192.0.2.10" 2
+# --rules
+rules_file=$(mktemp)
+printf '# Management hosts\nis-ipv4-host and not is-ipv4-loopback\nin 10.0.0.0/8 or in 192.0.2.0/24  # lab\n' > $rules_file
+assert_raises "$IPADDRCHECK --rules $rules_file 10.1.2.3/8" 0
+assert_raises "$IPADDRCHECK --rules $rules_file 10.0.0.0/8" 1
+assert_raises "$IPADDRCHECK --rules $rules_file 198.51.100.1/24" 1
+assert "$IPADDRCHECK --rules $rules_file" "pass\nfail\nfail\nfail" $'192.0.2.1/24\n127.0.0.1/8\n2001:db8::1/64\nfoo'
+assert_raises "$IPADDRCHECK --rules $rules_file > /dev/full" 2 $'192.0.2.1/24'
+printf 'is-ipv4-host and (is-ipv4-rfc1918\n' > $rules_file
+assert_raises "$IPADDRCHECK --rules $rules_file 10.1.2.3/8" 2
+printf 'is-ipv4-hots\n' > $rules_file
+assert_raises "$IPADDRCHECK --rules $rules_file 10.1.2.3/8" 2
+assert_raises "$IPADDRCHECK --rules $rules_file --is-ipv4 10.1.2.3/8" 2
+rm -f $rules_file
+# --csv and --tsv
+csv_file=$(mktemp)
+printf 'name,address,gateway\nr1,192.0.2.1/24,192.0.2.254\n"r2, ""b""",192.0.2.0/24,192.0.2.254\nr3,10.0.0.1/8,10.0.0.256\n' > $csv_file
+assert "$IPADDRCHECK --csv --header --column address --is-any-host --column 3 --is-ipv4-single $csv_file" "name,address,gateway\n\"r2, \"\"b\"\"\",192.0.2.0/24,192.0.2.254\nr3,10.0.0.1/8,10.0.0.256"
+assert_raises "$IPADDRCHECK --csv --header --column address --is-any-host --column 3 --is-ipv4-single $csv_file" 1
+assert "$IPADDRCHECK --csv --header --annotate --column 2 --is-any-host --verbose $csv_file" "name,address,gateway,address_result\nr1,192.0.2.1/24,192.0.2.254,pass\n\"r2, \"\"b\"\"\",192.0.2.0/24,192.0.2.254,fail\nr3,10.0.0.1/8,10.0.0.256,pass"
+assert_raises "$IPADDRCHECK --csv --header --column address --is-ipv4 $csv_file" 0
+assert_raises "$IPADDRCHECK --csv --header --column address --is-any-host $csv_file > /dev/full" 2
+assert_raises "$IPADDRCHECK --csv --header --annotate --column 2 --is-any-host $csv_file > /dev/full" 2
+assert_raises "$IPADDRCHECK --csv --header --column gw --is-ipv4 $csv_file" 2
+assert_raises "$IPADDRCHECK --csv --column address --is-ipv4 $csv_file" 2
+assert_raises "$IPADDRCHECK --csv --is-ipv4 --column 2 $csv_file" 2
+assert_raises "$IPADDRCHECK --csv $csv_file" 2
+assert_raises "$IPADDRCHECK --header --column 2 $csv_file" 2
+rm -f $csv_file
+assert "$IPADDRCHECK --tsv --annotate --column 1 --is-ipv4-rfc1918 --column 2 --is-ipv4-rfc1918" "192.0.2.1\t10.0.0.1\tfail\tpass" $'192.0.2.1\t10.0.0.1'
+# --filter and --filter-invert
+assert "$IPADDRCHECK --filter --is-ipv4-rfc1918" "10.0.0.1\n172.16.0.1/12" $'192.0.2.1\n10.0.0.1\nfoo\n172.16.0.1/12'
+assert "$IPADDRCHECK --filter-invert --is-ipv4-rfc1918" "192.0.2.1\nfoo" $'192.0.2.1\n10.0.0.1\nfoo\n172.16.0.1/12'
+assert "$IPADDRCHECK --filter" "192.0.2.1\n2001:db8::1" $'192.0.2.1\n2001:db8::1\n192.0.2.256'
+assert_raises "$IPADDRCHECK --filter --is-ipv6" 1 $'192.0.2.1\n10.0.0.1'
+assert_raises "$IPADDRCHECK --filter-invert --is-ipv4" 1 $'192.0.2.1\n10.0.0.1'
+assert_raises "$IPADDRCHECK --filter --is-ipv4 > /dev/full" 2 $'192.0.2.1\n10.0.0.1'
+assert_raises "$IPADDRCHECK --filter --is-ipv4-range" 2 "192.0.2.1-192.0.2.2"
+# --scan-files
+files_dir=$(mktemp -d)
+printf 'host a { fixed-address 192.0.2.1; }\n' > $files_dir/a.conf
+printf 'host b { fixed-address 10.0.0.1; }\nhost c { fixed-address 10.0.0.300; }\n' > $files_dir/b.conf
+assert "$IPADDRCHECK --scan-files $files_dir/a.conf $files_dir/b.conf | sort" "$files_dir/a.conf:1:24 192.0.2.1 pass\n$files_dir/b.conf:1:24 10.0.0.1 pass\n$files_dir/b.conf:2:24 10.0.0.300 fail"
+assert "ls $files_dir/*.conf | $IPADDRCHECK --scan-files --is-ipv4-rfc1918 | sort" "$files_dir/a.conf:1:24 192.0.2.1 fail\n$files_dir/b.conf:1:24 10.0.0.1 pass\n$files_dir/b.conf:2:24 10.0.0.300 fail"
+assert_raises "$IPADDRCHECK --scan-files $files_dir/a.conf" 0
+assert_raises "$IPADDRCHECK --scan-files $files_dir/a.conf > /dev/full" 2
+assert_raises "$IPADDRCHECK --scan-files $files_dir/a.conf $files_dir/b.conf" 1
+assert_raises "$IPADDRCHECK --scan-files $files_dir/a.conf $files_dir/missing.conf" 2
+rm -rf $files_dir
+# --stats
+assert "$IPADDRCHECK --stats" "addresses 5 ipv4 4 ipv6 1 malformed 0\nclass private-use 2\nclass global 3\ntop 10.0.0.0/24 2\ntop 8.8.4.0/24 1\ntop 8.8.8.0/24 1\ntop 2001:4860::/48 1" $'10.0.0.1\n8.8.8.8\n10.0.0.2\n2001:4860::8888\n8.8.4.4'
+assert "$IPADDRCHECK --stats --top 1" "addresses 3 ipv4 3 ipv6 0 malformed 0\nclass private-use 3\ntop 10.0.1.0/24 2" $'10.0.0.1\n10.0.1.1\n10.0.1.2'
+assert_raises "$IPADDRCHECK --stats" 1 $'10.0.0.1\nfoo'
+assert_raises "$IPADDRCHECK --stats > /dev/full" 2 "10.0.0.1"
+assert_raises "$IPADDRCHECK --stats --top 0" 2 "10.0.0.1"
+assert_raises "$IPADDRCHECK --stats --is-ipv6" 2 "10.0.0.1"
+# --distinct and --merge-sketches
+assert "$IPADDRCHECK --distinct" "ipv4 2 ipv6 1 total 3" $'192.0.2.1\n192.0.2.2\n192.0.2.1\n2001:db8::1\n2001:db8:0::1'
+assert "$IPADDRCHECK --distinct --ipv4-prefix-length 24 --ipv6-prefix-length 64" "ipv4 1 ipv6 2 total 3" $'192.0.2.1\n192.0.2.2\n2001:db8::1\n2001:db8::2\n2001:db8:0:1::1'
+assert_raises "$IPADDRCHECK --distinct" 1 $'192.0.2.1\nfoo'
+assert_raises "$IPADDRCHECK --distinct > /dev/full" 2 "192.0.2.1"
+assert_raises "$IPADDRCHECK --distinct --ipv4-prefix-length 33" 2 "192.0.2.1"
+assert_raises "$IPADDRCHECK --distinct --is-ipv6" 2 "192.0.2.1"
+sketch_dir=$(mktemp -d)
+printf '192.0.2.1\n192.0.2.2\n' | $IPADDRCHECK --distinct --sketch-out $sketch_dir/a.hll > /dev/null
+printf '192.0.2.2\n192.0.2.3\n2001:db8::1\n' | $IPADDRCHECK --distinct --sketch-out $sketch_dir/b.hll > /dev/null
+printf '192.0.2.1\n' | $IPADDRCHECK --distinct --ipv4-prefix-length 24 --sketch-out $sketch_dir/c.hll > /dev/null
+assert "$IPADDRCHECK --merge-sketches $sketch_dir/a.hll $sketch_dir/b.hll" "ipv4 3 ipv6 1 total 4"
+assert "$IPADDRCHECK --merge-sketches --sketch-out $sketch_dir/ab.hll $sketch_dir/a.hll $sketch_dir/b.hll > /dev/null; $IPADDRCHECK --merge-sketches $sketch_dir/ab.hll $sketch_dir/a.hll" "ipv4 3 ipv6 1 total 4"
+assert_raises "$IPADDRCHECK --merge-sketches $sketch_dir/a.hll $sketch_dir/c.hll" 2
+assert_raises "$IPADDRCHECK --merge-sketches $sketch_dir/missing.hll" 2
+assert_raises "$IPADDRCHECK --merge-sketches $sketch_dir/a.hll > /dev/full" 2
+assert_raises "$IPADDRCHECK --merge-sketches" 2
+assert_raises "$IPADDRCHECK --merge-sketches --is-ipv4 $sketch_dir/a.hll" 2
+rm -rf $sketch_dir
+
+# --build-prefix-index, --is-in-prefix-index, --verify-prefix-index
+prefix_index=$(mktemp)
+assert_raises "$IPADDRCHECK --build-prefix-index $prefix_index" 0 $'# table\n10.0.0.0/24 lab\n2001:db8::/48 doc'
+assert_raises "$IPADDRCHECK --is-in-prefix-index $prefix_index 10.0.0.5" 0
+assert_raises "$IPADDRCHECK --is-in-prefix-index $prefix_index 10.0.0.5/24" 0
+assert_raises "$IPADDRCHECK --is-in-prefix-index $prefix_index 2001:db8::1/64" 0
+assert_raises "$IPADDRCHECK --is-in-prefix-index $prefix_index 10.0.0.0/8" 1
+assert_raises "$IPADDRCHECK --is-in-prefix-index $prefix_index 2001:db8::/32" 1
+assert_raises "$IPADDRCHECK --is-in-prefix-index $prefix_index 192.0.2.1" 1
+assert_raises "$IPADDRCHECK --is-in-prefix-index $prefix_index --is-ipv4-host 10.0.0.5/24" 0
+assert_raises "$IPADDRCHECK --is-in-prefix-index $prefix_index --is-ipv6 10.0.0.5" 1
+assert_raises "$IPADDRCHECK --is-in-prefix-index $prefix_index --is-in-prefix-index $prefix_index 10.0.0.5" 2
+assert "$IPADDRCHECK --filter --is-in-prefix-index $prefix_index" "10.0.0.5\n2001:db8::1" $'10.0.0.5\n10.0.1.5\n2001:db8::1\n10.0.0.0/8\nfoo'
+assert_raises "$IPADDRCHECK --verify-prefix-index $prefix_index" 0
+assert_raises "$IPADDRCHECK --verify-prefix-index $prefix_index 10.0.0.5" 2
+assert_raises "$IPADDRCHECK --verify-prefix-index $prefix_index --is-ipv4" 2
+assert_raises "$IPADDRCHECK --build-prefix-index $prefix_index --is-ipv4" 2 $'10.0.0.0/8'
+assert_raises "$IPADDRCHECK --build-prefix-index $prefix_index" 2 $'10.0.0.1/8'
+echo "not a prefix index" > $prefix_index
+assert_raises "$IPADDRCHECK --is-in-prefix-index $prefix_index 10.0.0.5" 2
+assert_raises "$IPADDRCHECK --verify-prefix-index $prefix_index" 2
+rm -f $prefix_index
+
+# --interface-conflicts, --netlink-dump
+netlink_dump=$(mktemp)
+assert_raises "$IPADDRCHECK --save-netlink-dump $netlink_dump" 0
+assert "$IPADDRCHECK --interface-conflicts --netlink-dump $netlink_dump 0.0.0.0/0" "$($IPADDRCHECK --interface-conflicts 0.0.0.0/0)"
+assert "$IPADDRCHECK --interface-conflicts --netlink-dump $netlink_dump 203.0.113.77/32" ""
+assert_raises "$IPADDRCHECK --interface-conflicts --netlink-dump $netlink_dump 203.0.113.77/32" 0
+assert_raises "$IPADDRCHECK --interface-conflicts --netlink-dump $netlink_dump --interface lo -" 0 $'203.0.113.77\n203.0.113.78/32'
+assert_raises "$IPADDRCHECK --interface-conflicts --netlink-dump $netlink_dump foo" 1
+assert_raises "$IPADDRCHECK --interface-conflicts --netlink-dump /nonexistent 203.0.113.77" 2
+assert_raises "$IPADDRCHECK --interface-conflicts --netlink-dump $netlink_dump --save-netlink-dump $netlink_dump 203.0.113.77" 2
+assert_raises "$IPADDRCHECK --interface-conflicts --is-ipv4 203.0.113.77" 2
+assert_raises "$IPADDRCHECK --save-netlink-dump $netlink_dump --is-ipv4" 2
+assert_raises "$IPADDRCHECK --save-netlink-dump $netlink_dump 203.0.113.77" 2
+printf 'not a netlink dump' > $netlink_dump
+assert_raises "$IPADDRCHECK --interface-conflicts --netlink-dump $netlink_dump 203.0.113.77" 2
+rm -f $netlink_dump
+
 assert_end ipaddrcheck_integration